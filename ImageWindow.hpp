@@ -49,9 +49,12 @@
 #include <string.h>
 #include <process.h>
 #include <vector>
+#include <algorithm>
 #include <commctrl.h>
 #include <math.h>
 
+#include "ImageWindowKernel.hpp"
+
 
 // -----------------------------------------------------------------------------
 // 	macros
@@ -66,10 +69,33 @@
 #define	IMAGE_STR_BUF_SIZE			256
 #define DEFAULT_WINDOW_NAME			"Untitled"
 #define	MONITOR_ENUM_MAX				32
+#define	IMAGE_MAP_TABLE_SIZE			65536
+#define	IMAGE_THREAD_NUM_MAX			32
+#define	IMAGE_PARALLEL_MIN_SIZE		(2 * 1024 * 1024)	// bytes
+#define	IMAGE_LAZY_TILE_SIZE			64
+#define	IMAGE_PYRAMID_LEVEL_MAX		8
+#define	IMAGE_DEFAULT_REFRESH_RATE	60
+#define	IMAGE_BUFFER_ALIGNMENT		64
+#define	IMAGE_BUFFER_MIN_BLOCK_SIZE	4096
+#define	IMAGE_WM_PRESENT				(WM_APP + 1)
+#define	IMAGE_PRESENT_TIMER_ID		1
+#define	IMAGE_PAN_TIMER_ID			2
+#define	IMAGE_COLORMAP_MAX			64
+#define	IMAGE_COLORMAP_NAME_SIZE		64
+#define	IMAGE_AUTO_WL_SAMPLE_NUM		8192	// samples per frame at most
+#define	IMAGE_AUTO_WL_MIN_STEP		24		// every 24th line and sample at least
+#define	IMAGE_AUTO_WL_MIN_SAMPLE_NUM	256		// unless the image is too small for it
+#define	IMAGE_AUTO_WL_BIN_BITS		10
+#define	IMAGE_PIXEL_VALUE_MIN_SCALE	3000	// zoom (%) the pixel values are shown from
+#define	IMAGE_PIXEL_VALUE_GLYPH_SCALE	2		// 3x5 digits are drawn 6x10 when they fit
 
 #define IMAGE_ZOOM_STEP				1
 #define MOUSE_WHEEL_STEP				60
 
+#define	FRAME_BUFFER_NUM				3
+#define	FRAME_BUFFER_INIT_STATE		0x24	// producer:0, ready:1, display:2
+#define	FRAME_BUFFER_NEW_FRAME		0x40
+
 
 // -----------------------------------------------------------------------------
 // 	typedefs
@@ -80,1282 +106,3605 @@ typedef struct
 	RGBQUAD					RGBQuad[IMAGE_PALLET_SIZE_8BIT];
 } ImageBitmapInfoMono8;
 
+typedef struct
+{
+	unsigned char			*ImageBuffer;
+	unsigned short			*ImageBuffer16Bits;
+} ImageFrameBuffer;
+
+typedef struct
+{
+	BITMAPINFOHEADER		*BitmapInfo;
+	unsigned int			BitmapInfoSize;
+	unsigned char			*BitmapBits;
+	unsigned int			LineSize;
+	int						Width;
+	int						Height;
+	LONG					Generation;
+} ImagePyramidLevel;
+
+typedef struct
+{
+	bool					IsMapModeEnabled;
+	bool					IsMapLinear;
+	bool					IsMapTableValid;
+	unsigned short			MapBottomValue;
+	unsigned short			MapTopValue;
+	int						BitDepth;
+} ImageColormapTableParam;
+
+typedef struct
+{
+	LONG					Generation;
+	int						ImageWidth;
+	int						LineY;
+	int						Scale;
+	int						OffsetX;
+	int						Width;
+	int						Height;
+} ImagePlotParam;
+
 
 // -----------------------------------------------------------------------------
-//	ImageWindow class
+//	ImageWindowThreadPool class
 // -----------------------------------------------------------------------------
 //!
 /*!
-	The class for Image Data Container and Window
+	Worker threads that process an image in row bands. The calling thread
+	also works on the bands, and Run() returns after all of them are done.
 */
-class ImageWindow
+class ImageWindowThreadPool
 {
 public:
-	// enum --------------------------------------------------------------------
-	enum CursorMode
-	{
-		CURSOR_MODE_SCROLL_TOOL	=	1,
-		CURSOR_MODE_ZOOM_TOOL,
-		CURSOR_MODE_INFO_TOOL
-	};
+	typedef void	(*LineFunc)(void *inContext, int inStartLine, int inEndLine);
 
-	// -------------------------------------------------------------------------
-	//	ImageWindow(...)
-	// -------------------------------------------------------------------------
-	//!	ImageWindow Class Constructor
-	/*!
-		xxxx
-	*/
-	ImageWindow(const char *inWindowName = NULL,
-						int inPosX = IMAGE_WINDOW_AUTO_POS,
-						int inPosY = IMAGE_WINDOW_DEFAULT_POS)
+	ImageWindowThreadPool(int inThreadNum)
 	{
-		static int	sPrevPosX	= 0;
-		static int	sPrevPosY	= 0;
-		static int	sWindowNum	= 0;
-
-		mWindowState			= WINDOW_INIT_STATE;
-		mWindowTitle			= NULL;
-		mFileNameIndex			= 0;
-		mWindowH				= NULL;
-		mToolbarH				= NULL;
-		mStatusbarH				= NULL;
-		mRebarH					= NULL;
-		mMenuH					= NULL;
-		mMutexHandle			= NULL;
-		mEventHandle			= NULL;
-		mThreadHandle			= NULL;
-		mBitmapInfo				= NULL;
-		mBitmapInfoSize			= 0;
-		mBitmapBits				= NULL;
-		mBitmapBitsSize			= 0;
-		mModuleH				= GetModuleHandle(NULL);
-		mCursorMode				= CURSOR_MODE_SCROLL_TOOL;
-
-		mIsHiDPI = false;
-		mIsColorImage			= false;
-		mIs16BitsImage			= false;
-
-		mIsMouseDragging		= false;
-		mIsFullScreenMode		= false;
-		mIsMenubarEnabled		= true;
-		mIsToolbarEnabled		= true;
-		mIsStatusbarEnabled		= true;
-		mIsPlotEnabled			= false;
-
-		mFPSValue				= 0;
-
-		mAllocatedImageBuffer	= NULL;
-		mAllocated16BitsImageBuffer = NULL;
-		mExternal16BitsImageBuffer = NULL;
-
-		mDrawOverlayFunc		= NULL;
-		mOverlayFuncData		= NULL;
-
-		mImageClickNum			= 0;
-		mLastImageClickX		= 0;
-		mLastImageClickY		= 0;
-
-		mIsMapModeEnabled		= false;
-		mMapBottomValue			= 0;
-		mMapTopValue			= 65535;
-		mIsMapReverse			= false;
-		mMapDirectMapLimit		= 0;
+		mThreadNum		= 0;
+		mIsExiting		= false;
+		mLineFunc		= NULL;
+		mContext		= NULL;
+		mLineNum		= 0;
+		mBandNum		= 0;
+		mNextBand		= 0;
+		mPendingThreadNum = 0;
+
+		if (inThreadNum > IMAGE_THREAD_NUM_MAX)
+			inThreadNum = IMAGE_THREAD_NUM_MAX;
+
+		mRunMutexHandle = CreateMutex(NULL, false, NULL);
+		mStartSemaphoreHandle = CreateSemaphore(NULL, 0, IMAGE_THREAD_NUM_MAX, NULL);
+		mDoneEventHandle = CreateEvent(NULL, false, false, NULL);
+		if (mRunMutexHandle == NULL || mStartSemaphoreHandle == NULL || mDoneEventHandle == NULL)
+		{
+			printf("Error: Can't create sync objects (ImageWindowThreadPool)\n");
+			return;
+		}
 
-		if (inPosX == IMAGE_WINDOW_AUTO_POS ||
-			inPosY == IMAGE_WINDOW_AUTO_POS)
+		//	The caller thread also works, so one less worker is needed
+		for (int i = 0; i < inThreadNum - 1; i++)
 		{
-			if (sPrevPosX == 0 && sPrevPosY == 0)
-			{
-				mPosX = IMAGE_WINDOW_DEFAULT_POS;
-				mPosY = IMAGE_WINDOW_DEFAULT_POS;
-			}
-			else
+			mThreadHandles[mThreadNum] = (HANDLE )_beginthreadex(
+				NULL,
+				0,
+				ThreadFunc,
+				this,
+				0,
+				NULL);
+			if (mThreadHandles[mThreadNum] == NULL)
 			{
-				mPosX = sPrevPosX + IMAGE_WINDOW_POS_SPACE;
-				mPosY = sPrevPosY + IMAGE_WINDOW_POS_SPACE;
-
-				if (mPosX >= GetSystemMetrics(SM_CXMAXIMIZED) - IMAGE_WINDOW_POS_SPACE)
-					mPosX = IMAGE_WINDOW_DEFAULT_POS;
-
-				if (mPosY >= GetSystemMetrics(SM_CYMAXIMIZED) - IMAGE_WINDOW_POS_SPACE)
-					mPosY = IMAGE_WINDOW_DEFAULT_POS;
+				printf("Error: Can't create worker thread (ImageWindowThreadPool)\n");
+				break;
 			}
-
-			sPrevPosX = mPosX;
-			sPrevPosY = mPosY;
+			mThreadNum++;
 		}
+	}
 
-		if (sWindowNum == 0)
+	virtual ~ImageWindowThreadPool()
+	{
+		mIsExiting = true;
+		if (mThreadNum != 0)
+			ReleaseSemaphore(mStartSemaphoreHandle, mThreadNum, NULL);
+		for (int i = 0; i < mThreadNum; i++)
 		{
-			// TODO: Add an option to skip the following call
-			SetProcessDPIAware();
+			WaitForSingleObject(mThreadHandles[i], INFINITE);
+			CloseHandle(mThreadHandles[i]);
 		}
 
-		if (RegisterWindowClass() == 0)
+		if (mDoneEventHandle != NULL)
+			CloseHandle(mDoneEventHandle);
+		if (mStartSemaphoreHandle != NULL)
+			CloseHandle(mStartSemaphoreHandle);
+		if (mRunMutexHandle != NULL)
+			CloseHandle(mRunMutexHandle);
+	}
+
+	int		GetThreadNum()
+	{
+		return mThreadNum + 1;
+	}
+
+	void	Run(LineFunc inFunc, void *inContext, int inLineNum)
+	{
+		if (mThreadNum == 0 || inLineNum < 2)
 		{
-			printf("Error: RegisterWindowClass() failed\n");
+			inFunc(inContext, 0, inLineNum);
 			return;
 		}
 
-		char	windowName[IMAGE_STR_BUF_SIZE];
-		if (inWindowName == NULL)
+		DWORD	result = WaitForSingleObject(mRunMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
 		{
-			sprintf_s(windowName, IMAGE_STR_BUF_SIZE, "%s%d", DEFAULT_WINDOW_NAME, sWindowNum);
-			inWindowName = windowName;
+			printf("Error: WaitForSingleObject failed (ImageWindowThreadPool::Run)\n");
+			inFunc(inContext, 0, inLineNum);
+			return;
 		}
 
-		size_t	bufSize = strlen(inWindowName) + 1;
-		mWindowTitle = new char[bufSize];
-		if (mWindowTitle == NULL)
+		mLineFunc = inFunc;
+		mContext = inContext;
+		mLineNum = inLineNum;
+		mBandNum = (mThreadNum + 1) * 2;
+		if (mBandNum > inLineNum)
+			mBandNum = inLineNum;
+		mNextBand = 0;
+		mPendingThreadNum = mThreadNum;
+
+		//	mThreadNum wake-ups are released and Run() returns only after all of
+		//	them are consumed, so none can leak into the next job. A worker may
+		//	take more than one of them, the later ones find no band left.
+		ReleaseSemaphore(mStartSemaphoreHandle, mThreadNum, NULL);
+		ProcessBands();
+		WaitForSingleObject(mDoneEventHandle, INFINITE);
+
+		ReleaseMutex(mRunMutexHandle);
+	}
+
+private:
+	int					mThreadNum;
+	HANDLE				mThreadHandles[IMAGE_THREAD_NUM_MAX];
+	HANDLE				mRunMutexHandle;
+	HANDLE				mStartSemaphoreHandle;
+	HANDLE				mDoneEventHandle;
+	volatile bool		mIsExiting;
+
+	LineFunc			mLineFunc;
+	void				*mContext;
+	int					mLineNum;
+	int					mBandNum;
+	volatile LONG		mNextBand;
+	volatile LONG		mPendingThreadNum;
+
+	void	ProcessBands()
+	{
+		LONG	band;
+
+		while ((band = InterlockedIncrement(&mNextBand) - 1) < mBandNum)
 		{
-			printf("Error: Can't allocate mWindowTitle\n");
-			return;
+			int	startLine = (int )(((__int64 )mLineNum * band) / mBandNum);
+			int	endLine = (int )(((__int64 )mLineNum * (band + 1)) / mBandNum);
+			mLineFunc(mContext, startLine, endLine);
 		}
-		strcpy_s(mWindowTitle, bufSize, inWindowName);
+	}
 
-		mMutexHandle = CreateMutex(NULL, false, NULL);
-		if (mMutexHandle == NULL)
+	static unsigned int _stdcall	ThreadFunc(void *arg)
+	{
+		ImageWindowThreadPool	*threadPool = (ImageWindowThreadPool *)arg;
+
+		while (true)
 		{
-			printf("Error: Can't create Mutex object\n");
-			delete mWindowTitle;
-			return;
+			WaitForSingleObject(threadPool->mStartSemaphoreHandle, INFINITE);
+			if (threadPool->mIsExiting)
+				break;
+
+			//	Counted per wake-up, see Run()
+			threadPool->ProcessBands();
+			if (InterlockedDecrement(&(threadPool->mPendingThreadNum)) == 0)
+				SetEvent(threadPool->mDoneEventHandle);
 		}
+		return 0;
+	}
+};
 
-		mEventHandle = CreateEvent(NULL, false, false, NULL);
-		if (mEventHandle == NULL)
+
+// -----------------------------------------------------------------------------
+//	ImageWindowBufferPool class
+// -----------------------------------------------------------------------------
+//!
+/*!
+	Process-wide pool of 64-byte aligned buffers shared by all windows. Sizes
+	are rounded up to size classes (quarter steps between powers of two), and
+	freed buffers are cached so they can be reused when the image size changes
+	back and forth. Buffers are optionally backed by large pages.
+*/
+class ImageWindowBufferPool
+{
+public:
+	//	A function-local static object is not initialized thread-safely by
+	//	pre-C++11 compilers, so the first caller publishes it with an
+	//	interlocked exchange. It is never deleted, buffers may still be freed
+	//	by static windows at exit.
+	static ImageWindowBufferPool	*GetInstance()
+	{
+		static ImageWindowBufferPool	* volatile sBufferPool = NULL;
+
+		if (sBufferPool == NULL)
 		{
-			printf("Error: Can't create Event object\n");
-			CloseHandle(mMutexHandle);
-			delete mWindowTitle;
-			return;
+			ImageWindowBufferPool	*bufferPool = new ImageWindowBufferPool();
+			if (InterlockedCompareExchangePointer((void * volatile *)&sBufferPool, bufferPool, NULL) != NULL)
+				delete bufferPool;	// Another thread was first
 		}
+		return sBufferPool;
+	}
 
-		sWindowNum++;
+	ImageWindowBufferPool()
+	{
+		mFreeBlockList		= NULL;
+		mUsedSize			= 0;
+		mCachedSize			= 0;
+		mMemoryLimit		= 0;
+		mIsLargePageEnabled	= false;
+
+		mMutexHandle = CreateMutex(NULL, false, NULL);
+		if (mMutexHandle == NULL)
+			printf("Error: Can't create Mutex object (ImageWindowBufferPool)\n");
 	}
 
-	virtual ~ImageWindow()
+	virtual ~ImageWindowBufferPool()
 	{
-		if (mWindowState == WINDOW_OPEN_STATE)
-			PostMessage(mWindowH, WM_CLOSE, 0, 0);
+		Trim();
+		if (mMutexHandle != NULL)
+			CloseHandle(mMutexHandle);
+	}
 
-		if (mThreadHandle != NULL)
+	// -------------------------------------------------------------------------
+	//	Allocate(...)
+	// -------------------------------------------------------------------------
+	//!	Returns a 64-byte aligned buffer of at least inSize bytes or NULL
+	void	*Allocate(size_t inSize)
+	{
+		size_t	blockSize = CalcBlockSize(inSize + IMAGE_BUFFER_ALIGNMENT);
+		BufferBlock	*block = NULL;
+
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
 		{
-			WaitForSingleObject(mThreadHandle, INFINITE);
-			CloseHandle(mThreadHandle);
+			printf("Error: WaitForSingleObject failed (ImageWindowBufferPool::Allocate)\n");
+			return NULL;
 		}
 
-		if (mMutexHandle != NULL)
-			CloseHandle(mMutexHandle);
+		BufferBlock	**blockPtr = &mFreeBlockList;
+		while (*blockPtr != NULL)
+		{
+			if ((*blockPtr)->BlockSize == blockSize)
+			{
+				block = *blockPtr;
+				*blockPtr = block->Next;
+				mCachedSize -= block->CommittedSize;
+				break;
+			}
+			blockPtr = &((*blockPtr)->Next);
+		}
 
-		if (mEventHandle != NULL)
-			CloseHandle(mEventHandle);
+		if (block == NULL)
+		{
+			size_t	committedSize = CalcCommittedSize(blockSize);
 
-		if (mAllocatedImageBuffer != NULL)
-			delete mAllocatedImageBuffer;
+			if (mMemoryLimit != 0 && mUsedSize + mCachedSize + committedSize > mMemoryLimit)
+				TrimBlocks(committedSize);
+			if (mMemoryLimit != 0 && mUsedSize + committedSize > mMemoryLimit)
+			{
+				ReleaseMutex(mMutexHandle);
+				printf("Error: Memory limit exceeded (ImageWindowBufferPool::Allocate)\n");
+				return NULL;
+			}
+			block = AllocateBlock(blockSize);
+			if (block == NULL)
+			{
+				ReleaseMutex(mMutexHandle);
+				printf("Error: Can't allocate buffer (ImageWindowBufferPool::Allocate)\n");
+				return NULL;
+			}
+		}
 
-		if (mWindowTitle != NULL)
-			delete mWindowTitle;
+		mUsedSize += block->CommittedSize;
+		block->Next = NULL;
+		ReleaseMutex(mMutexHandle);
+
+		return (unsigned char *)block + IMAGE_BUFFER_ALIGNMENT;
 	}
 
-	void	ShowWindow()
+	void	Free(void *inBuffer)
 	{
-		if (mWindowState != WINDOW_INIT_STATE)
-			return;
-
-		if (mIsThreadRunning == true)
+		if (inBuffer == NULL)
 			return;
 
-		if (mThreadHandle != NULL)
-		{
-			::CloseHandle(mThreadHandle);
-		}
+		BufferBlock	*block = GetBlock(inBuffer);
 
-		//	Must use _beginthreadex instead of _beginthread, CreateThread
-		mIsThreadRunning = true;
-		mThreadHandle = (HANDLE )_beginthreadex(
-			NULL,
-			0,
-			ThreadFunc,
-			this,
-			0,
-			NULL);
-		if (mThreadHandle == NULL)
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
 		{
-			mIsThreadRunning = false;
-			printf("Error: Can't create process thread\n");
-			CloseHandle(mEventHandle);
-			CloseHandle(mMutexHandle);
-			delete mWindowTitle;
+			printf("Error: WaitForSingleObject failed (ImageWindowBufferPool::Free)\n");
 			return;
 		}
 
-		WaitForSingleObject(mEventHandle, INFINITE);
+		mUsedSize -= block->CommittedSize;
+		block->Next = mFreeBlockList;
+		mFreeBlockList = block;
+		mCachedSize += block->CommittedSize;
+		if (mMemoryLimit != 0 && mUsedSize + mCachedSize > mMemoryLimit)
+			TrimBlocks(0);
+
+		ReleaseMutex(mMutexHandle);
 	}
 
-	void	CloseWindow()
+	//!	Returns the number of bytes the buffer actually takes (committed)
+	static size_t	GetBlockSize(void *inBuffer)
 	{
-		if (mWindowState == WINDOW_OPEN_STATE)
-			PostMessage(mWindowH, WM_CLOSE, 0, 0);
+		return GetBlock(inBuffer)->CommittedSize;
 	}
 
-	bool	IsWindowOpen()
+	//!	Releases all cached buffers
+	void	Trim()
 	{
-		if (mWindowState == WINDOW_OPEN_STATE)
-			return true;
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (ImageWindowBufferPool::Trim)\n");
+			return;
+		}
 
-		return false;
+		TrimAllBlocks();
+		ReleaseMutex(mMutexHandle);
 	}
 
-	bool	IsWindowClosed()
+	//!	Limits the bytes held by the pool (in use and cached). 0 means no limit.
+	void	SetMemoryLimit(size_t inLimit)
 	{
-		if (mWindowState == WINDOW_CLOSED_STATE)
-			return true;
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (ImageWindowBufferPool::SetMemoryLimit)\n");
+			return;
+		}
 
-		return false;
+		mMemoryLimit = inLimit;
+		if (mMemoryLimit != 0)
+			TrimBlocks(0);
+		ReleaseMutex(mMutexHandle);
 	}
-
-	bool	WaitForWindowClose(DWORD inTimeout = INFINITE)
+	size_t	GetMemoryLimit()
 	{
-		if (mThreadHandle == NULL)
-			return false;
+		return mMemoryLimit;
+	}
+	size_t	GetUsedSize()
+	{
+		return mUsedSize;
+	}
+	size_t	GetCachedSize()
+	{
+		return mCachedSize;
+	}
 
-		if (WaitForSingleObject(mThreadHandle, inTimeout) == WAIT_OBJECT_0)
-			return true;
+	//	Large pages need the "Lock pages in memory" privilege. Buffers fall back
+	//	to regular pages when they can't be allocated.
+	bool	IsLargePageEnabled()
+	{
+		return mIsLargePageEnabled;
+	}
+	void	EnableLargePage()
+	{
+		mIsLargePageEnabled = true;
+	}
+	void	DisableLargePage()
+	{
+		mIsLargePageEnabled = false;
+	}
 
-		return false;
+private:
+	typedef struct BufferBlockTag
+	{
+		size_t					BlockSize;		// size class
+		size_t					CommittedSize;	// rounded up to large pages
+		bool					IsLargePage;
+		struct BufferBlockTag	*Next;
+	} BufferBlock;
+
+	HANDLE			mMutexHandle;
+	BufferBlock		*mFreeBlockList;
+	size_t			mUsedSize;
+	size_t			mCachedSize;
+	size_t			mMemoryLimit;
+	bool			mIsLargePageEnabled;
+
+	static BufferBlock	*GetBlock(void *inBuffer)
+	{
+		return (BufferBlock *)((unsigned char *)inBuffer - IMAGE_BUFFER_ALIGNMENT);
 	}
 
-	static bool	WaitForWindowCloseMulti(ImageWindow *inWindowArray[], int inArrayLen,
-											bool inWaitAll = false, DWORD inTimeout = INFINITE)
+	static size_t	CalcBlockSize(size_t inSize)
 	{
-		std::vector< HANDLE >	handles;
+		size_t	blockSize = IMAGE_BUFFER_MIN_BLOCK_SIZE;
 
-		for (int i = 0; i < inArrayLen; i++)
-			if (inWindowArray[i]->mThreadHandle != NULL)
-				handles.push_back(inWindowArray[i]->mThreadHandle);
+		while (blockSize < inSize)
+			blockSize *= 2;
+		if (blockSize == IMAGE_BUFFER_MIN_BLOCK_SIZE)
+			return blockSize;
 
-		if (WaitForMultipleObjects((DWORD )handles.size(), &(handles[0]), inWaitAll, inTimeout) == WAIT_TIMEOUT)
-			return false;
+		//	Quarter steps between blockSize / 2 and blockSize (25% waste at most)
+		size_t	step = blockSize / 8;
+		for (size_t size = blockSize / 2 + step; size < blockSize; size += step)
+			if (size >= inSize)
+				return size;
 
-		return true;
+		return blockSize;
 	}
 
-	void	SetColormap(int inIndex = 0)
+	bool	IsLargePageBlock(size_t inBlockSize)
 	{
-		if (mBitmapInfo == NULL)
-			return;
-
-		if (mBitmapInfo->biBitCount != 8)
-			return;
-
-		ImageBitmapInfoMono8	*bitmapInfo = (ImageBitmapInfoMono8 *)mBitmapInfo;
-
-		if (inIndex == 0)
-		{
-			for (int i = 0; i < 255; i++)
-			{
-				bitmapInfo->RGBQuad[i].rgbBlue		= i;
-				bitmapInfo->RGBQuad[i].rgbGreen		= i;
-				bitmapInfo->RGBQuad[i].rgbRed		= i;
-				bitmapInfo->RGBQuad[i].rgbReserved	= 0;
-			}
-			bitmapInfo->RGBQuad[0].rgbRed	= 0;
-			bitmapInfo->RGBQuad[0].rgbGreen	= 0;
-			bitmapInfo->RGBQuad[0].rgbBlue	= 0;
-			bitmapInfo->RGBQuad[1].rgbRed	= 255; 
-			bitmapInfo->RGBQuad[1].rgbGreen	= 255;
-			bitmapInfo->RGBQuad[1].rgbBlue	= 255;
-			return;
-		}
-		if (inIndex == 1)
-		{
-			for (int i = 0; i < 64; i++)
-			{
-				bitmapInfo->RGBQuad[i      ].rgbRed		= 0; 
-				bitmapInfo->RGBQuad[i      ].rgbGreen	= i * 4;
-				bitmapInfo->RGBQuad[i      ].rgbBlue	= 255;
-
-				bitmapInfo->RGBQuad[i +  64].rgbRed		= 0; 
-				bitmapInfo->RGBQuad[i +  64].rgbGreen	= 255;
-				bitmapInfo->RGBQuad[i +  64].rgbBlue	= (255 - i * 4);
-
-				bitmapInfo->RGBQuad[i + 128].rgbRed		= i * 4; 
-				bitmapInfo->RGBQuad[i + 128].rgbGreen	= 255;
-				bitmapInfo->RGBQuad[i + 128].rgbBlue	= 0;
-
-				bitmapInfo->RGBQuad[i + 192].rgbRed		= 255; 
-				bitmapInfo->RGBQuad[i + 192].rgbGreen	= (255 - i * 4);
-				bitmapInfo->RGBQuad[i + 192].rgbBlue	= 0;
-			}
-			bitmapInfo->RGBQuad[0].rgbRed	= 0;
-			bitmapInfo->RGBQuad[0].rgbGreen	= 0;
-			bitmapInfo->RGBQuad[0].rgbBlue	= 0;
-			bitmapInfo->RGBQuad[1].rgbRed	= 255; 
-			bitmapInfo->RGBQuad[1].rgbGreen	= 255;
-			bitmapInfo->RGBQuad[1].rgbBlue	= 255;
-			return;
-		}
-		if (inIndex == 2)
-		{
-			const unsigned char tableR[256] = {
-				60, 61, 62, 63, 64, 66, 67, 68, 69, 70, 71, 73, 74, 75, 76, 77, 79,
-				80, 81, 82, 84, 85, 86, 87, 89, 90, 91, 93, 94, 95, 96, 98, 99, 100,
-				102, 103, 104, 106, 107, 108, 110, 111, 112, 114, 115, 116, 118, 119,
-				120, 122, 123, 124, 126, 127, 129, 130, 131, 133, 134, 135, 137, 138,
-				140, 141, 142, 144, 145, 147, 148, 149, 151, 152, 153, 155, 156, 158,
-				159, 160, 162, 163, 164, 166, 167, 168, 170, 171, 172, 174, 175, 176,
-				178, 179, 180, 182, 183, 184, 185, 187, 188, 189, 190, 192, 193, 194,
-				195, 197, 198, 199, 200, 201, 203, 204, 205, 206, 207, 208, 209, 210,
-				211, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223, 224, 225,
-				226, 227, 228, 229, 230, 231, 232, 232, 233, 234, 235, 236, 236, 237,
-				238, 238, 239, 240, 240, 241, 241, 242, 242, 243, 243, 244, 244, 245,
-				245, 245, 245, 246, 246, 246, 246, 247, 247, 247, 247, 247, 247, 247,
-				247, 247, 247, 247, 247, 247, 247, 247, 247, 247, 246, 246, 246, 246,
-				245, 245, 245, 244, 244, 244, 243, 243, 242, 242, 241, 241, 240, 240,
-				239, 238, 238, 237, 236, 236, 235, 234, 233, 233, 232, 231, 230, 229,
-				228, 227, 227, 226, 225, 224, 223, 222, 221, 220, 218, 217, 216, 215,
-				214, 213, 212, 210, 209, 208, 207, 205, 204, 203, 202, 200, 199, 198,
-				196, 195, 193, 192, 190, 189, 188, 186, 185, 183, 181, 180
-			};
-			const unsigned char tableG[256] = {
-				78, 80, 81, 83, 85, 87, 88, 90, 92, 93, 95, 97, 99, 100, 102, 104,
-				105, 107, 109, 110, 112, 114, 115, 117, 119, 120, 122, 123, 125,
-				127, 128, 130, 131, 133, 135, 136, 138, 139, 141, 142, 144, 145,
-				147, 148, 150, 151, 153, 154, 156, 157, 158, 160, 161, 163, 164,
-				165, 167, 168, 169, 171, 172, 173, 174, 176, 177, 178, 179, 181,
-				182, 183, 184, 185, 186, 187, 188, 190, 191, 192, 193, 194, 195,
-				196, 197, 198, 199, 199, 200, 201, 202, 203, 204, 205, 205, 206,
-				207, 208, 208, 209, 210, 210, 211, 212, 212, 213, 213, 214, 214,
-				215, 215, 216, 216, 217, 217, 217, 218, 218, 219, 219, 219, 219,
-				220, 220, 220, 220, 220, 220, 221, 221, 220, 220, 219, 219, 218,
-				218, 217, 216, 216, 215, 215, 214, 213, 212, 212, 211, 210, 209,
-				209, 208, 207, 206, 205, 204, 203, 202, 201, 200, 199, 198, 197,
-				196, 195, 194, 193, 192, 191, 190, 188, 187, 186, 185, 184, 182,
-				181, 180, 178, 177, 176, 174, 173, 172, 170, 169, 167, 166, 164,
-				163, 161, 160, 158, 157, 155, 154, 152, 151, 149, 147, 146, 144,
-				142, 141, 139, 137, 136, 134, 132, 130, 129, 127, 125, 123, 121,
-				120, 118, 116, 114, 112, 110, 108, 106, 104, 102, 100, 98, 96,
-				94, 92, 90, 88, 86, 84, 82, 80, 78, 75, 73, 71, 69, 66, 64, 62,
-				59, 57, 54, 51, 49, 46, 43, 40, 37, 34, 30, 26, 22, 17, 11, 4
- 			};
-			const unsigned char tableB[256] = {
-				194, 195, 197, 198, 200, 201, 203, 204, 206, 207, 209, 210, 211, 213,
-				214, 215, 217, 218, 219, 221, 222, 223, 224, 225, 226, 228, 229, 230,
-				231, 232, 233, 234, 235, 236, 237, 238, 239, 239, 240, 241, 242, 243,
-				243, 244, 245, 246, 246, 247, 247, 248, 249, 249, 250, 250, 251, 251,
-				252, 252, 252, 253, 253, 253, 254, 254, 254, 254, 254, 255, 255, 255,
-				255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 254, 254, 254, 254,
-				253, 253, 253, 253, 252, 252, 251, 251, 251, 250, 250, 249, 248, 248,
-				247, 247, 246, 245, 245, 244, 243, 243, 242, 241, 240, 239, 238, 238,
-				237, 236, 235, 234, 233, 232, 231, 230, 229, 228, 227, 225, 224, 223,
-				222, 221, 219, 218, 216, 215, 214, 212, 211, 209, 208, 206, 205, 203,
-				202, 200, 199, 197, 196, 194, 193, 191, 190, 188, 187, 185, 184, 182,
-				181, 179, 178, 176, 174, 173, 171, 170, 168, 167, 165, 163, 162, 160,
-				159, 157, 156, 154, 152, 151, 149, 148, 146, 145, 143, 141, 140, 138,
-				137, 135, 134, 132, 131, 129, 127, 126, 124, 123, 121, 120, 118, 117,
-				115, 114, 112, 111, 109, 108, 106, 105, 103, 102, 100, 99, 97, 96, 95,
-				93, 92, 90, 89, 88, 86, 85, 83, 82, 81, 79, 78, 77, 75, 74, 73, 71, 70,
-				69, 67, 66, 65, 64, 62, 61, 60, 59, 57, 56, 55, 54, 53, 52, 50, 49, 48,
-				47, 46, 45, 44, 43, 41, 40, 39, 38
-			};
-			for (int i = 0; i < 256; i++)
-			{
-				bitmapInfo->RGBQuad[i].rgbRed		= tableR[i]; 
-				bitmapInfo->RGBQuad[i].rgbGreen		= tableG[i];
-				bitmapInfo->RGBQuad[i].rgbBlue		= tableB[i];
-			}
-			bitmapInfo->RGBQuad[0].rgbRed	= 0; 
-			bitmapInfo->RGBQuad[0].rgbGreen	= 0;
-			bitmapInfo->RGBQuad[0].rgbBlue	= 0;
-			bitmapInfo->RGBQuad[1].rgbRed	= 255; 
-			bitmapInfo->RGBQuad[1].rgbGreen	= 255;
-			bitmapInfo->RGBQuad[1].rgbBlue	= 255;
-			printf("I was here\n");
-			return;
-		}
-
-		if (inIndex == 3)
-		{
-			for (int j = 0; j < 4; j++)
-			{
-				for (int i = 0; i < 64; i++)
-				{
-					bitmapInfo->RGBQuad[i+j*64].rgbRed		= i * 3 + 64; 
-					bitmapInfo->RGBQuad[i+j*64].rgbGreen	= i * 3 + 64;
-					bitmapInfo->RGBQuad[i+j*64].rgbBlue		= i * 3 + 64;
-				}
-			}
-			bitmapInfo->RGBQuad[0].rgbRed	= 0; 
-			bitmapInfo->RGBQuad[0].rgbGreen	= 0;
-			bitmapInfo->RGBQuad[0].rgbBlue	= 0;
-			bitmapInfo->RGBQuad[1].rgbRed	= 255; 
-			bitmapInfo->RGBQuad[1].rgbGreen	= 255;
-			bitmapInfo->RGBQuad[1].rgbBlue	= 255;
-			return;
-		}
-		if (inIndex == 4)
-		{
-			for (int j = 0; j < 8; j++)
-			{
-				for (int i = 0; i < 32; i++)
-				{
-					bitmapInfo->RGBQuad[i+j*32].rgbRed		= i * 7 + 32; 
-					bitmapInfo->RGBQuad[i+j*32].rgbGreen	= i * 7 + 32;
-					bitmapInfo->RGBQuad[i+j*32].rgbBlue		= i * 7 + 32;
-				}
-			}
-			bitmapInfo->RGBQuad[0].rgbRed	= 0; 
-			bitmapInfo->RGBQuad[0].rgbGreen	= 0;
-			bitmapInfo->RGBQuad[0].rgbBlue	= 0;
-			bitmapInfo->RGBQuad[1].rgbRed	= 255; 
-			bitmapInfo->RGBQuad[1].rgbGreen	= 255;
-			bitmapInfo->RGBQuad[1].rgbBlue	= 255;
-			return;
-		}
-		if (inIndex == 5)
-		{
-			for (int j = 0; j < 16; j++)
-			{
-				for (int i = 0; i < 16; i++)
-				{
-					bitmapInfo->RGBQuad[i+j*16].rgbRed		= i * 15 + 16; 
-					bitmapInfo->RGBQuad[i+j*16].rgbGreen	= i * 15 + 16;
-					bitmapInfo->RGBQuad[i+j*16].rgbBlue		= i * 15 + 16;
-				}
-			}
-			bitmapInfo->RGBQuad[0].rgbRed	= 0; 
-			bitmapInfo->RGBQuad[0].rgbGreen	= 0;
-			bitmapInfo->RGBQuad[0].rgbBlue	= 0;
-			bitmapInfo->RGBQuad[1].rgbRed	= 255; 
-			bitmapInfo->RGBQuad[1].rgbGreen	= 255;
-			bitmapInfo->RGBQuad[1].rgbBlue	= 255;
-			return;
-		}
-		if (inIndex == 6)
-		{
-			for (int j = 0; j < 32; j++)
-			{
-				for (int i = 0; i < 8; i++)
-				{
-					bitmapInfo->RGBQuad[i+j* 8].rgbRed		= i * 32; 
-					bitmapInfo->RGBQuad[i+j* 8].rgbGreen	= i * 32;
-					bitmapInfo->RGBQuad[i+j* 8].rgbBlue		= i * 32;
-				}
-			}
-			bitmapInfo->RGBQuad[0].rgbRed	= 0; 
-			bitmapInfo->RGBQuad[0].rgbGreen	= 0;
-			bitmapInfo->RGBQuad[0].rgbBlue	= 0;
-			bitmapInfo->RGBQuad[1].rgbRed	= 255; 
-			bitmapInfo->RGBQuad[1].rgbGreen	= 255;
-			bitmapInfo->RGBQuad[1].rgbBlue	= 255;
-			return;
-		}
+		size_t	largePageSize = mIsLargePageEnabled ? GetLargePageMinimum() : 0;
+		return (largePageSize != 0 && inBlockSize >= largePageSize);
 	}
 
-	void	SetImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsColor, bool inIsBottomUp = false, bool inIs16Bits = false)
+	//	The bytes a new block of inBlockSize takes, large page blocks are
+	//	rounded up to whole large pages
+	size_t	CalcCommittedSize(size_t inBlockSize)
 	{
-		DWORD	result;
-		bool	doUpdateSize;
+		if (IsLargePageBlock(inBlockSize) == false)
+			return inBlockSize;
 
-		result = WaitForSingleObject(mMutexHandle, INFINITE);
-		if (result != WAIT_OBJECT_0)
-		{
-			printf("Error: WaitForSingleObject failed (SetMonoImageBufferPtr)\n");
-			return;
-		}
+		size_t	largePageSize = GetLargePageMinimum();
+		return (inBlockSize + largePageSize - 1) / largePageSize * largePageSize;
+	}
 
-		doUpdateSize = CreateBitmapInfo(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits);
+	BufferBlock	*AllocateBlock(size_t inBlockSize)
+	{
+		BufferBlock	*block = NULL;
+		size_t	committedSize = CalcCommittedSize(inBlockSize);
+		bool	isLargePage = false;
 
-		if (mAllocatedImageBuffer != NULL)
+		if (IsLargePageBlock(inBlockSize))
 		{
-			delete mAllocatedImageBuffer;
-			mAllocatedImageBuffer = NULL;
+			block = (BufferBlock *)VirtualAlloc(NULL, committedSize,
+							MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+			isLargePage = (block != NULL);
 		}
-		if (mAllocated16BitsImageBuffer != NULL)
+		if (block == NULL)
 		{
-			delete mAllocated16BitsImageBuffer;
-			mAllocated16BitsImageBuffer = NULL;
+			block = (BufferBlock *)_aligned_malloc(inBlockSize, IMAGE_BUFFER_ALIGNMENT);
+			committedSize = inBlockSize;
 		}
+		if (block == NULL)
+			return NULL;
 
-		if (inIs16Bits == false)
-		{
-			mBitmapBits = inImagePtr;
-			mExternal16BitsImageBuffer = NULL;
-		}
-		else
-		{
-			CreateNewImageBuffer(true);
-			mExternal16BitsImageBuffer = (unsigned short *)inImagePtr;
-		}
-		ReleaseMutex(mMutexHandle);
-		UpdateFPS();
+		block->BlockSize		= inBlockSize;
+		block->CommittedSize	= committedSize;
+		block->IsLargePage		= isLargePage;
+		block->Next				= NULL;
+		return block;
+	}
 
-		if (doUpdateSize)
-			UpdateWindowSize();
+	void	FreeBlock(BufferBlock *inBlock)
+	{
+		if (inBlock->IsLargePage)
+			VirtualFree(inBlock, 0, MEM_RELEASE);
 		else
-			UpdateImage();
+			_aligned_free(inBlock);
 	}
 
-	void	AllocateImageBuffer(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp = false, bool inIs16Bits = false)
+	void	TrimAllBlocks()
 	{
-		DWORD	result;
-		bool	doUpdateSize;
-
-		result = WaitForSingleObject(mMutexHandle, INFINITE);
-		if (result != WAIT_OBJECT_0)
+		while (mFreeBlockList != NULL)
 		{
-			printf("Error: WaitForSingleObject failed (AllocateMonoImageBuffer)\n");
-			return;
+			BufferBlock	*block = mFreeBlockList;
+			mFreeBlockList = block->Next;
+			mCachedSize -= block->CommittedSize;
+			FreeBlock(block);
 		}
-
-		doUpdateSize = PrepareImageBuffers(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits);
-
-		ReleaseMutex(mMutexHandle);
-		
-		if (doUpdateSize)
-			UpdateWindowSize();
 	}
 
-	void	CopyIntoImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsColor, bool inIsBottomUp = false, bool inIs16Bits = false)
+	//	Releases the least recently cached blocks until inSize more bytes fit
+	//	in the memory limit
+	void	TrimBlocks(size_t inSize)
 	{
-		DWORD	result;
-		bool	doUpdateSize;
-
-		result = WaitForSingleObject(mMutexHandle, INFINITE);
-		if (result != WAIT_OBJECT_0)
+		while (mFreeBlockList != NULL && mUsedSize + mCachedSize + inSize > mMemoryLimit)
 		{
-			printf("Error: WaitForSingleObject failed (AllocateMonoImageBuffer)\n");
-			return;
+			//	The list head is the most recently freed one, release the tail
+			BufferBlock	**blockPtr = &mFreeBlockList;
+			while ((*blockPtr)->Next != NULL)
+				blockPtr = &((*blockPtr)->Next);
+			mCachedSize -= (*blockPtr)->CommittedSize;
+			FreeBlock(*blockPtr);
+			*blockPtr = NULL;
 		}
-
-		doUpdateSize = PrepareImageBuffers(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits);
-		CopyMemory(GetImageBufferPtr(), inImage, GetImageBufferSize());
-
-		ReleaseMutex(mMutexHandle);
-		UpdateFPS();
-		
-		if (doUpdateSize)
-			UpdateWindowSize();
-		else
-			UpdateImage();
 	}
+};
 
-	void	SetMonoImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false)
-	{
-		SetImageBufferPtr(inWidth, inHeight, inImagePtr, false, inIsBottomUp);
-	}
 
-	void	AllocateMonoImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false)
+// -----------------------------------------------------------------------------
+//	ImageWindowColormap class
+// -----------------------------------------------------------------------------
+//!
+/*!
+	Process-wide colormap registry shared by all windows. The built-in
+	colormaps come first and colormaps added or loaded from files follow.
+	All of them are kept as 256-entry palettes, so selecting one only
+	copies its palette (see ImageWindow::SetColormap()).
+*/
+class ImageWindowColormap
+{
+public:
+	// enum --------------------------------------------------------------------
+	//	The first seven are the original colormaps, their entries 0 and 1 are
+	//	always black and white
+	enum BuiltinColormap
 	{
-		AllocateImageBuffer(inWidth, inHeight, false, inIsBottomUp);
-	}
+		COLORMAP_GRAY	=	0,
+		COLORMAP_JET,
+		COLORMAP_COOL_WARM,
+		COLORMAP_GRAY_BANDS_4,
+		COLORMAP_GRAY_BANDS_8,
+		COLORMAP_GRAY_BANDS_16,
+		COLORMAP_GRAY_BANDS_32,
+		COLORMAP_VIRIDIS,
+		COLORMAP_INFERNO,
+		COLORMAP_TURBO,
+		COLORMAP_BUILTIN_NUM
+	};
 
-	void	CopyIntoMonoImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false)
+	//	Created like ImageWindowBufferPool::GetInstance()
+	static ImageWindowColormap	*GetInstance()
 	{
-		CopyIntoImageBuffer(inWidth, inHeight, inImage, false, inIsBottomUp);
-	}
+		static ImageWindowColormap	* volatile sColormap = NULL;
 
-	void	Set16BitsMonoImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false)
-	{
-		SetImageBufferPtr(inWidth, inHeight, inImagePtr, false, inIsBottomUp, true);
+		if (sColormap == NULL)
+		{
+			ImageWindowColormap	*colormap = new ImageWindowColormap();
+			if (InterlockedCompareExchangePointer((void * volatile *)&sColormap, colormap, NULL) != NULL)
+				delete colormap;	// Another thread was first
+		}
+		return sColormap;
 	}
 
-	void	Allocate16BitsMonoImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false)
+	ImageWindowColormap()
 	{
-		AllocateImageBuffer(inWidth, inHeight, false, inIsBottomUp, true);
+		mColormapNum = 0;
+		mMutexHandle = CreateMutex(NULL, false, NULL);
+		if (mMutexHandle == NULL)
+			printf("Error: Can't create Mutex object (ImageWindowColormap)\n");
+
+		InitBuiltinColormaps();
 	}
 
-	void	CopyInto16BitsMonoImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false)
+	virtual ~ImageWindowColormap()
 	{
-		CopyIntoImageBuffer(inWidth, inHeight, inImage, false, inIsBottomUp, true);
+		if (mMutexHandle != NULL)
+			CloseHandle(mMutexHandle);
 	}
 
-	void	SetColorImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false)
+	//	The interlocked read orders the entry reads after it (see AddColormap)
+	int		GetColormapNum()
 	{
-		SetImageBufferPtr(inWidth, inHeight, inImagePtr, true, inIsBottomUp);
+		return InterlockedCompareExchange(&mColormapNum, 0, 0);
 	}
 
-	void	AllocateColorImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false)
+	//!	Returns the 256-entry palette of colormap inIndex or NULL
+	const RGBQUAD	*GetPalette(int inIndex)
 	{
-		AllocateImageBuffer(inWidth, inHeight, true, inIsBottomUp);
+		if (inIndex < 0 || inIndex >= GetColormapNum())
+			return NULL;
+
+		return mColormaps[inIndex].Palette;
 	}
-	void	CopyIntoColorImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false)
+
+	const char	*GetColormapName(int inIndex)
 	{
-		CopyIntoImageBuffer(inWidth, inHeight, inImage, true, inIsBottomUp);
+		if (inIndex < 0 || inIndex >= GetColormapNum())
+			return NULL;
+
+		return mColormaps[inIndex].Name;
 	}
-	void	SetMapMode(unsigned short inMapBottomValue, unsigned short inMapTopValue,
-						bool inIsMapReverse, unsigned short inDirectMapLimit)
-	{
-		if (mIs16BitsImage == false)
-			return;
 
-		mIsMapModeEnabled = true;
-		mMapBottomValue = inMapBottomValue;
-		mMapTopValue = inMapTopValue;
-		mIsMapReverse = inIsMapReverse;
-		mMapDirectMapLimit = inDirectMapLimit;
+	//!	Returns the index of the last colormap named inName or -1
+	int		FindColormap(const char *inName)
+	{
+		for (int i = GetColormapNum() - 1; i >= 0; i--)
+			if (strcmp(mColormaps[i].Name, inName) == 0)
+				return i;
 
-		UpdateImage();
+		return -1;
 	}
-	void	DisableMapMode()
+
+	// -------------------------------------------------------------------------
+	//	AddColormap(...)
+	// -------------------------------------------------------------------------
+	//!	Adds a colormap of inEntryNum RGB entries and returns its index or -1
+	/*!
+		inRGB is R, G, B for each entry. Tables that don't have 256 entries
+		are linearly resampled.
+	*/
+	int		AddColormap(const char *inName, const unsigned char *inRGB, int inEntryNum)
 	{
-		mIsMapModeEnabled = false;
+		std::vector<double>	rgb(inRGB, inRGB + inEntryNum * 3);
+
+		return AddColormap(inName, rgb, 1.0);
 	}
-	void	UpdateImage()
-	{
-		if (IsWindowOpen() == false)
-			return;
 
-		UpdateFPS();
-		UpdateMousePixelReadout();
-		if (mIs16BitsImage)
-			Update16BitsImageDisp();
-		UpdateImageDisp();
-	}	
-	void	DumpBitmapInfo()
+	// -------------------------------------------------------------------------
+	//	LoadColormap(...)
+	// -------------------------------------------------------------------------
+	//!	Loads a colormap file and returns its index or -1
+	/*!
+		Text files (CSV and text LUTs) have one entry per line, "R, G, B" or
+		"index, R, G, B", separated by commas, spaces, tabs or semicolons.
+		Values after the fourth one are ignored. Values are 0 to 255, or 0.0 to 1.0 when no value is larger than 1.
+		Lines that don't parse (headers, '#' comments) are skipped. Binary
+		ImageJ .lut files (256 R, 256 G then 256 B bytes, optionally after a
+		32-byte "ICOL" header) are read as well. The file name without the
+		directory and the extension becomes the colormap name.
+	*/
+	int		LoadColormap(const char *inFileName)
 	{
-		printf("[Dump BitmapInfo : %s]\n", mWindowTitle);
+		FILE	*fp;
+		std::vector<double>	rgb;
+		double	scale = 1.0;
 
-		if (mBitmapInfo == NULL)
+		if (fopen_s(&fp, inFileName, "rb") != 0)
 		{
-			printf("BitmapInfo is NULL \n");
-			return;
+			printf("Error: Can't open file %s (ImageWindowColormap::LoadColormap)\n", inFileName);
+			return -1;
 		}
 
-		printf(" biSize: %d\n", mBitmapInfo->biSize);
-		printf(" biWidth: %d\n", mBitmapInfo->biWidth);
-		if (mBitmapInfo->biHeight < 0)
-			printf(" biHeight: %d (Top-down DIB)\n", mBitmapInfo->biHeight);
-		else
-			printf(" biHeight: %d (Bottom-up DIB)\n", mBitmapInfo->biHeight);
-		printf(" biPlanes: %d\n", mBitmapInfo->biPlanes);
-		printf(" biBitCount: %d\n", mBitmapInfo->biBitCount);
-		printf(" biCompression: %d\n", mBitmapInfo->biCompression);
-		printf(" biSizeImage: %d\n", mBitmapInfo->biSizeImage);
-		printf(" biXPelsPerMeter: %d\n", mBitmapInfo->biXPelsPerMeter);
-		printf(" biYPelsPerMeter: %d\n", mBitmapInfo->biYPelsPerMeter);
-		printf(" biClrUsed: %d\n", mBitmapInfo->biClrUsed);
-		printf(" biClrImportant: %d\n", mBitmapInfo->biClrImportant);
-		printf("\n");
+		fseek(fp, 0, SEEK_END);
+		long	fileSize = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
 
-		printf(" mBitmapInfoSize =  %d bytes\n", mBitmapInfoSize);
-		printf(" RGBQUAD number  =  %d\n", (mBitmapInfoSize - mBitmapInfo->biSize) / sizeof(RGBQUAD));
-		printf(" mBitmapBitsSize =  %d bytes\n", mBitmapBitsSize);
-	}
+		if (IsBinaryLUTFile(inFileName, fileSize))
+			ReadBinaryLUT(fp, fileSize, &rgb);
+		else
+		{
+			ReadColormapText(fp, &rgb);
+
+			//	0.0 to 1.0 text tables are scaled to 0 to 255
+			double	maxValue = 0;
+			for (size_t i = 0; i < rgb.size(); i++)
+				if (rgb[i] > maxValue)
+					maxValue = rgb[i];
+			if (maxValue <= 1.0)
+				scale = 255.0;
+		}
+		fclose(fp);
 
-	unsigned char	*CreateDIB(bool inForceConvertToBottomUp = true)
-	{
-		if (mBitmapInfo == NULL)
-			return NULL;
+		if (rgb.size() < 2 * 3)
+		{
+			printf("Error: No colormap entries in %s (ImageWindowColormap::LoadColormap)\n", inFileName);
+			return -1;
+		}
 
-		unsigned char	*buf = new unsigned char[mBitmapInfoSize + mBitmapBitsSize];
-		CopyMemory(buf, mBitmapInfo, mBitmapInfoSize);
-		CopyMemory(&(buf[mBitmapInfoSize]), mBitmapBits, mBitmapBitsSize);
+		//	The name is the file name without the directory and the extension
+		const char	*name = inFileName;
+		for (const char *p = inFileName; *p != '\0'; p++)
+			if (*p == '\\' || *p == '/')
+				name = p + 1;
 
-		if (inForceConvertToBottomUp == true)
-			if (mBitmapInfo->biHeight < 0)
-				FlipBitmap((BITMAPINFOHEADER *)buf, &(buf[mBitmapInfoSize]));
+		char	nameBuf[IMAGE_COLORMAP_NAME_SIZE];
+		strncpy(nameBuf, name, IMAGE_COLORMAP_NAME_SIZE - 1);
+		nameBuf[IMAGE_COLORMAP_NAME_SIZE - 1] = '\0';
+		char	*extension = strrchr(nameBuf, '.');
+		if (extension != NULL && extension != nameBuf)
+			*extension = '\0';
 
-		return buf;
+		return AddColormap(nameBuf, rgb, scale);
 	}
 
-	void	FlipImageBuffer()
+private:
+	typedef struct
 	{
-		FlipBitmap(mBitmapInfo, mBitmapBits);
-	}
-
-	bool	OpenBitmapFile(const char *inFileName)
-	{	
-		FILE	*fp;
-		BITMAPFILEHEADER	fileHeader;
+		char				Name[IMAGE_COLORMAP_NAME_SIZE];
+		RGBQUAD				Palette[IMAGE_PALLET_SIZE_8BIT];
+	} ColormapEntry;
+
+	HANDLE			mMutexHandle;
+	volatile LONG	mColormapNum;
+	ColormapEntry	mColormaps[IMAGE_COLORMAP_MAX];
+
+	//	Entries are only added, and mColormapNum is incremented after the
+	//	entry is complete, so readers don't have to lock. The values are
+	//	multiplied by inScale.
+	int		AddColormap(const char *inName, const std::vector<double> &inRGB, double inScale)
+	{
+		int		entryNum = (int )(inRGB.size() / 3);
 
-		if (fopen_s(&fp, inFileName, "rb") != 0)
+		if (entryNum < 2)
 		{
-			printf("Error: Can't open file %s (OpenBitmapFile)\n", inFileName);
-			return false;
+			printf("Error: A colormap needs at least 2 entries (ImageWindowColormap::AddColormap)\n");
+			return -1;
 		}
 
-		if (fread(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp) != 1)
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
 		{
-			printf("Error: fread failed (OpenBitmapFile)\n");
-			fclose(fp);
-			return false;
+			printf("Error: WaitForSingleObject failed (ImageWindowColormap::AddColormap)\n");
+			return -1;
 		}
 
-		
-		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
-		if (result != WAIT_OBJECT_0)
+		int	index = mColormapNum;
+		if (index >= IMAGE_COLORMAP_MAX)
 		{
-			printf("Error: WaitForSingleObject failed (OpenBitmapFile)\n");
-			fclose(fp);
-			return false;
-		}
-
-		if (mBitmapInfo != NULL)
-		{
-			delete mBitmapInfo;
-			if (mAllocatedImageBuffer != NULL)
-				delete mAllocatedImageBuffer;
-		}
-
-		mBitmapInfoSize = fileHeader.bfOffBits - sizeof(BITMAPFILEHEADER);
-		mBitmapInfo = (BITMAPINFOHEADER *)(new unsigned char[mBitmapInfoSize]);
-		if (mBitmapInfo == NULL)
-		{
-			printf("Error: Can't allocate mBitmapInfo (OpenBitmapFile)\n");
 			ReleaseMutex(mMutexHandle);
-			fclose(fp);
-			return false;
+			printf("Error: Too many colormaps (ImageWindowColormap::AddColormap)\n");
+			return -1;
 		}
 
-		mBitmapBitsSize = fileHeader.bfSize - fileHeader.bfOffBits;
-		mAllocatedImageBuffer = new unsigned char[mBitmapBitsSize];
-		if (mAllocatedImageBuffer == NULL)
+		ColormapEntry	*entry = &(mColormaps[index]);
+		strncpy(entry->Name, inName, IMAGE_COLORMAP_NAME_SIZE - 1);
+		entry->Name[IMAGE_COLORMAP_NAME_SIZE - 1] = '\0';
+		for (int i = 0; i < IMAGE_PALLET_SIZE_8BIT; i++)
 		{
-			printf("Error: Can't allocate mBitmapBits (OpenBitmapFile)\n");
-			delete mBitmapInfo;
-			mBitmapInfo = NULL;
-			ReleaseMutex(mMutexHandle);
-			fclose(fp);
-			return false;
-		}
-		mBitmapBits = mAllocatedImageBuffer;
+			double	pos = i * (entryNum - 1) / (double )(IMAGE_PALLET_SIZE_8BIT - 1);
+			int		i0 = (int )pos;
+			int		i1 = (i0 + 1 < entryNum) ? i0 + 1 : i0;
+			double	t = pos - i0;
+			double	c[3];
 
-		if (fread(mBitmapInfo, mBitmapInfoSize, 1, fp) != 1)
-		{
-			printf("Error: fread failed (OpenBitmapFile)\n");
-			ReleaseMutex(mMutexHandle);
-			fclose(fp);
-			return false;
-		}
-		if (fread(mBitmapBits, mBitmapBitsSize, 1, fp) != 1)
-		{
-			printf("Error: fread failed (OpenBitmapFile)\n");
-			ReleaseMutex(mMutexHandle);
-			fclose(fp);
-			return false;
+			for (int k = 0; k < 3; k++)
+			{
+				c[k] = (inRGB[i0 * 3 + k] + (inRGB[i1 * 3 + k] - inRGB[i0 * 3 + k]) * t) * inScale;
+				if (c[k] < 0)
+					c[k] = 0;
+				if (c[k] > 255)
+					c[k] = 255;
+			}
+			entry->Palette[i].rgbRed		= (BYTE )(c[0] + 0.5);
+			entry->Palette[i].rgbGreen		= (BYTE )(c[1] + 0.5);
+			entry->Palette[i].rgbBlue		= (BYTE )(c[2] + 0.5);
+			entry->Palette[i].rgbReserved	= 0;
 		}
-		fclose(fp);
-
-		//if (mBitmapInfo->biHeight > 0)
-		//	FlipImageBuffer();
+		InterlockedIncrement(&mColormapNum);
 
 		ReleaseMutex(mMutexHandle);
+		return index;
+	}
 
-		UpdateWindowSize();
-		UpdateImageDisp();
+	static bool	IsBinaryLUTFile(const char *inFileName, long inFileSize)
+	{
+		const char	*extension = strrchr(inFileName, '.');
 
-		printf("Bitmap File opened: %s\n", inFileName);
+		if (extension == NULL || _stricmp(extension, ".lut") != 0)
+			return false;
 
-		return true;
+		return (inFileSize == 768 || inFileSize == 800);
 	}
 
-	bool	CopyToClipboard()
+	static void	ReadBinaryLUT(FILE *inFP, long inFileSize, std::vector<double> *outRGB)
 	{
-		if (mBitmapInfo == NULL || mBitmapBits == NULL)
+		unsigned char	buf[800];
+
+		if (fread(buf, inFileSize, 1, inFP) != 1)
 		{
-			printf("Error: mBitmapInfo == NULL || mBitmapBits == NULL CopyToClipboard()\n");
-			return false;
+			printf("Error: fread failed (ImageWindowColormap::ReadBinaryLUT)\n");
+			return;
 		}
 
-		unsigned char	*buf = CreateDIB(true);
-
-		OpenClipboard(mWindowH);
-		EmptyClipboard();
-		SetClipboardData(CF_DIB, buf);
-		CloseClipboard();
-
-		delete buf;
+		const unsigned char	*planes = buf;
+		if (inFileSize == 800)
+		{
+			if (memcmp(buf, "ICOL", 4) != 0)
+				return;
+			planes += 32;
+		}
 
-		return true;
+		outRGB->resize(IMAGE_PALLET_SIZE_8BIT * 3);
+		for (int i = 0; i < IMAGE_PALLET_SIZE_8BIT; i++)
+			for (int k = 0; k < 3; k++)
+				(*outRGB)[i * 3 + k] = planes[k * IMAGE_PALLET_SIZE_8BIT + i];
 	}
 
-	bool	SaveAsBitmapFile()
+	static void	ReadColormapText(FILE *inFP, std::vector<double> *outRGB)
 	{
-		const int	BUF_LEN = 512;
-		OPENFILENAME	fileName;
-		TCHAR	buf[BUF_LEN] = TEXT("Untitled.bmp");
+		char	line[IMAGE_STR_BUF_SIZE * 4];
 
-		ZeroMemory(&fileName, sizeof(fileName));
-		fileName.lStructSize = sizeof(fileName);
-		fileName.hwndOwner = mWindowH;
-		fileName.lpstrFilter = TEXT("Bitmap File (*.bmp)\0*.bmp\0");
-		fileName.nFilterIndex = 1;
-		fileName.lpstrFile = buf;
-		fileName.nMaxFile = BUF_LEN;
-		fileName.lpstrTitle = TEXT("Save Image As");
-		//fileName.Flags = OFN_EXTENSIONDIFFERENT;
-		fileName.lpstrDefExt = TEXT("bmp");
+		while (fgets(line, sizeof(line), inFP) != NULL)
+		{
+			char	*comment = strchr(line, '#');
+			if (comment != NULL)
+				*comment = '\0';
+
+			double	values[4];
+			int		valueNum = 0;
+			char	*p = line;
+			while (valueNum < 4)	// The rest of the line is skipped
+			{
+				while (*p == ',' || *p == ' ' || *p == '\t' || *p == ';')
+					p++;
+				if (*p == '\0' || *p == '\r' || *p == '\n')
+					break;
 
-		if (GetSaveFileName(&fileName) == 0)
-			return false;
+				char	*end;
+				double	value = strtod(p, &end);
+				if (end == p)
+				{
+					valueNum = 0;	// Not a number, a header line
+					break;
+				}
+				values[valueNum] = value;
+				valueNum++;
+				p = end;
+			}
 
-		return SaveBitmapFile((const char *)fileName.lpstrFile, true);
+			if (valueNum == 3)
+				outRGB->insert(outRGB->end(), values, values + 3);
+			else if (valueNum == 4)
+				outRGB->insert(outRGB->end(), values + 1, values + 4);
+		}
 	}
 
-	bool	SaveBitmapFile(const char *inFileName = NULL, bool inIsUnicode = false)
+	void	InitBuiltinColormaps()
 	{
-		if (mBitmapInfo == NULL || mBitmapBits == NULL)
-		{
-			printf("Error: mBitmapInfo == NULL || mBitmapBits == NULL SaveBitmap()\n");
-			return false;
-		}
+		unsigned char	rgb[IMAGE_PALLET_SIZE_8BIT * 3];
 
-//DumpBitmapInfo();
-
-		unsigned char	*buf = CreateDIB(true);
-
-		FILE	*fp;
-		char	fileName[IMAGE_FILE_NAME_BUF_LEN];
+		//	Gray
+		for (int i = 0; i < 256; i++)
+			SetEntry(rgb, i, i, i, i);
+		AddBuiltinColormap("Gray", rgb, true);
 
-		BITMAPFILEHEADER	fileHeader;
-		fileHeader.bfType = 'MB';
-		fileHeader.bfSize = sizeof(BITMAPFILEHEADER) + mBitmapInfoSize + mBitmapBitsSize;
-		fileHeader.bfReserved1 = 0;
-		fileHeader.bfReserved2 = 0;
-		fileHeader.bfOffBits = sizeof(BITMAPFILEHEADER) + mBitmapInfoSize;
-		
-		if (inIsUnicode == false)
+		//	Jet
+		for (int i = 0; i < 64; i++)
 		{
-			if (inFileName != NULL)
-			{
-				sprintf_s(fileName, IMAGE_FILE_NAME_BUF_LEN, "%s", inFileName);
-			}
-			else
-			{
-				sprintf_s(fileName, IMAGE_FILE_NAME_BUF_LEN, "%s%d.bmp", mWindowTitle, mFileNameIndex);
-				mFileNameIndex++;
-			}
-
-			if (fopen_s(&fp, fileName, "wb") != 0)
-			{
-				printf("Error: Can't create file %s (SaveBitmapFile)\n", fileName);
-				ReleaseMutex(mMutexHandle);
-				return false;
-			}
+			SetEntry(rgb, i      , 0, i * 4, 255);
+			SetEntry(rgb, i +  64, 0, 255, 255 - i * 4);
+			SetEntry(rgb, i + 128, i * 4, 255, 0);
+			SetEntry(rgb, i + 192, 255, 255 - i * 4, 0);
 		}
-		else
+		AddBuiltinColormap("Jet", rgb, true);
+
+		AddBuiltinColormap("Cool-warm", GetBuiltinTable(0), true);
+
+		//	Gray bands, a sawtooth of 4, 8, 16 and 32 bands
+		static const int	bandParams[4][3] = {
+			// band size, step, offset
+			{64,  3, 64},
+			{32,  7, 32},
+			{16, 15, 16},
+			{ 8, 32,  0}
+		};
+		static const char	*bandNames[4] = {
+			"Gray bands 4", "Gray bands 8", "Gray bands 16", "Gray bands 32"
+		};
+		for (int n = 0; n < 4; n++)
 		{
-			if (_wfopen_s(&fp, (wchar_t *)inFileName, L"wb") != 0)
+			for (int i = 0; i < 256; i++)
 			{
-				printf("Error: Can't create file %s (SaveBitmapFile)\n", fileName);
-				ReleaseMutex(mMutexHandle);
-				return false;
+				int	value = (i % bandParams[n][0]) * bandParams[n][1] + bandParams[n][2];
+				SetEntry(rgb, i, value, value, value);
 			}
+			AddBuiltinColormap(bandNames[n], rgb, true);
 		}
 
-		if (fwrite(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp) != 1)
-		{
-			printf("Error: Can't write file (SaveBitmapFile)\n");
-			ReleaseMutex(mMutexHandle);
-			fclose(fp);
-			return false;
-		}
-		if (fwrite(buf, mBitmapInfoSize + mBitmapBitsSize, 1, fp) != 1)
-		{
-			printf("Error: Can't write file (SaveBitmapFile)\n");
-			ReleaseMutex(mMutexHandle);
-			fclose(fp);
-			return false;
-		}
-		fclose(fp);
-
-//		if (inIsUnicode == false)
-//			printf("Bitmap File saved: %s\n", fileName);
-//		else
-//			wprintf(TEXT("Bitmap File saved: %s\n"), inFileName);
-
-		delete buf;
-
-		return true;
+		AddBuiltinColormap("Viridis", GetBuiltinTable(1), false);
+		AddBuiltinColormap("Inferno", GetBuiltinTable(2), false);
+		AddBuiltinColormap("Turbo", GetBuiltinTable(3), false);
 	}
 
-	int	GetImageWidth()
+	void	AddBuiltinColormap(const char *inName, const unsigned char *inRGB, bool inHasMarkers)
 	{
-		if (mBitmapInfo == NULL)
-			return 0;
-		return mBitmapInfo->biWidth;
-	}
+		int	index = AddColormap(inName, inRGB, IMAGE_PALLET_SIZE_8BIT);
 
-	int	GetImageHeight()
-	{
-		if (mBitmapInfo == NULL)
-			return 0;
-		return abs(mBitmapInfo->biHeight);
+		if (index < 0 || inHasMarkers == false)
+			return;
+
+		RGBQUAD	*palette = mColormaps[index].Palette;
+		palette[0].rgbRed	= 0;
+		palette[0].rgbGreen	= 0;
+		palette[0].rgbBlue	= 0;
+		palette[1].rgbRed	= 255;
+		palette[1].rgbGreen	= 255;
+		palette[1].rgbBlue	= 255;
 	}
 
-	RECT	GetImageClientRect()
+	static void	SetEntry(unsigned char *outRGB, int inIndex, int inR, int inG, int inB)
 	{
-		return mImageDispRect;
+		outRGB[inIndex * 3 + 0] = (unsigned char )inR;
+		outRGB[inIndex * 3 + 1] = (unsigned char )inG;
+		outRGB[inIndex * 3 + 2] = (unsigned char )inB;
 	}
 
-	bool	IsBottomUpImage()
+	//	R, G, B tables of the colormaps that are not generated
+	static const unsigned char	*GetBuiltinTable(int inIndex)
 	{
-		if (mBitmapInfo == NULL)
-			return false;
-
-		if (mBitmapInfo->biHeight > 0)
-			return true;
+		static const unsigned char	sTables[4][256][3] = {
+			{
+				//	Cool-warm (Moreland)
+				{ 60, 78,194}, { 61, 80,195}, { 62, 81,197}, { 63, 83,198}, { 64, 85,200}, { 66, 87,201},
+				{ 67, 88,203}, { 68, 90,204}, { 69, 92,206}, { 70, 93,207}, { 71, 95,209}, { 73, 97,210},
+				{ 74, 99,211}, { 75,100,213}, { 76,102,214}, { 77,104,215}, { 79,105,217}, { 80,107,218},
+				{ 81,109,219}, { 82,110,221}, { 84,112,222}, { 85,114,223}, { 86,115,224}, { 87,117,225},
+				{ 89,119,226}, { 90,120,228}, { 91,122,229}, { 93,123,230}, { 94,125,231}, { 95,127,232},
+				{ 96,128,233}, { 98,130,234}, { 99,131,235}, {100,133,236}, {102,135,237}, {103,136,238},
+				{104,138,239}, {106,139,239}, {107,141,240}, {108,142,241}, {110,144,242}, {111,145,243},
+				{112,147,243}, {114,148,244}, {115,150,245}, {116,151,246}, {118,153,246}, {119,154,247},
+				{120,156,247}, {122,157,248}, {123,158,249}, {124,160,249}, {126,161,250}, {127,163,250},
+				{129,164,251}, {130,165,251}, {131,167,252}, {133,168,252}, {134,169,252}, {135,171,253},
+				{137,172,253}, {138,173,253}, {140,174,254}, {141,176,254}, {142,177,254}, {144,178,254},
+				{145,179,254}, {147,181,255}, {148,182,255}, {149,183,255}, {151,184,255}, {152,185,255},
+				{153,186,255}, {155,187,255}, {156,188,255}, {158,190,255}, {159,191,255}, {160,192,255},
+				{162,193,255}, {163,194,255}, {164,195,254}, {166,196,254}, {167,197,254}, {168,198,254},
+				{170,199,253}, {171,199,253}, {172,200,253}, {174,201,253}, {175,202,252}, {176,203,252},
+				{178,204,251}, {179,205,251}, {180,205,251}, {182,206,250}, {183,207,250}, {184,208,249},
+				{185,208,248}, {187,209,248}, {188,210,247}, {189,210,247}, {190,211,246}, {192,212,245},
+				{193,212,245}, {194,213,244}, {195,213,243}, {197,214,243}, {198,214,242}, {199,215,241},
+				{200,215,240}, {201,216,239}, {203,216,238}, {204,217,238}, {205,217,237}, {206,217,236},
+				{207,218,235}, {208,218,234}, {209,219,233}, {210,219,232}, {211,219,231}, {213,219,230},
+				{214,220,229}, {215,220,228}, {216,220,227}, {217,220,225}, {218,220,224}, {219,220,223},
+				{220,221,222}, {221,221,221}, {222,220,219}, {223,220,218}, {224,219,216}, {225,219,215},
+				{226,218,214}, {227,218,212}, {228,217,211}, {229,216,209}, {230,216,208}, {231,215,206},
+				{232,215,205}, {232,214,203}, {233,213,202}, {234,212,200}, {235,212,199}, {236,211,197},
+				{236,210,196}, {237,209,194}, {238,209,193}, {238,208,191}, {239,207,190}, {240,206,188},
+				{240,205,187}, {241,204,185}, {241,203,184}, {242,202,182}, {242,201,181}, {243,200,179},
+				{243,199,178}, {244,198,176}, {244,197,174}, {245,196,173}, {245,195,171}, {245,194,170},
+				{245,193,168}, {246,192,167}, {246,191,165}, {246,190,163}, {246,188,162}, {247,187,160},
+				{247,186,159}, {247,185,157}, {247,184,156}, {247,182,154}, {247,181,152}, {247,180,151},
+				{247,178,149}, {247,177,148}, {247,176,146}, {247,174,145}, {247,173,143}, {247,172,141},
+				{247,170,140}, {247,169,138}, {247,167,137}, {247,166,135}, {246,164,134}, {246,163,132},
+				{246,161,131}, {246,160,129}, {245,158,127}, {245,157,126}, {245,155,124}, {244,154,123},
+				{244,152,121}, {244,151,120}, {243,149,118}, {243,147,117}, {242,146,115}, {242,144,114},
+				{241,142,112}, {241,141,111}, {240,139,109}, {240,137,108}, {239,136,106}, {238,134,105},
+				{238,132,103}, {237,130,102}, {236,129,100}, {236,127, 99}, {235,125, 97}, {234,123, 96},
+				{233,121, 95}, {233,120, 93}, {232,118, 92}, {231,116, 90}, {230,114, 89}, {229,112, 88},
+				{228,110, 86}, {227,108, 85}, {227,106, 83}, {226,104, 82}, {225,102, 81}, {224,100, 79},
+				{223, 98, 78}, {222, 96, 77}, {221, 94, 75}, {220, 92, 74}, {218, 90, 73}, {217, 88, 71},
+				{216, 86, 70}, {215, 84, 69}, {214, 82, 67}, {213, 80, 66}, {212, 78, 65}, {210, 75, 64},
+				{209, 73, 62}, {208, 71, 61}, {207, 69, 60}, {205, 66, 59}, {204, 64, 57}, {203, 62, 56},
+				{202, 59, 55}, {200, 57, 54}, {199, 54, 53}, {198, 51, 52}, {196, 49, 50}, {195, 46, 49},
+				{193, 43, 48}, {192, 40, 47}, {190, 37, 46}, {189, 34, 45}, {188, 30, 44}, {186, 26, 43},
+				{185, 22, 41}, {183, 17, 40}, {181, 11, 39}, {180,  4, 38},
+			},
+			{
+				//	Viridis (matplotlib, CC0)
+				{ 68,  1, 84}, { 68,  2, 86}, { 69,  4, 87}, { 69,  5, 89}, { 70,  7, 90}, { 70,  8, 92},
+				{ 70, 10, 93}, { 70, 11, 94}, { 71, 13, 96}, { 71, 14, 97}, { 71, 16, 99}, { 71, 17,100},
+				{ 71, 19,101}, { 72, 20,103}, { 72, 22,104}, { 72, 23,105}, { 72, 24,106}, { 72, 26,108},
+				{ 72, 27,109}, { 72, 28,110}, { 72, 29,111}, { 72, 31,112}, { 72, 32,113}, { 72, 33,115},
+				{ 72, 35,116}, { 72, 36,117}, { 72, 37,118}, { 72, 38,119}, { 72, 40,120}, { 72, 41,121},
+				{ 71, 42,122}, { 71, 44,122}, { 71, 45,123}, { 71, 46,124}, { 71, 47,125}, { 70, 48,126},
+				{ 70, 50,126}, { 70, 51,127}, { 70, 52,128}, { 69, 53,129}, { 69, 55,129}, { 69, 56,130},
+				{ 68, 57,131}, { 68, 58,131}, { 68, 59,132}, { 67, 61,132}, { 67, 62,133}, { 66, 63,133},
+				{ 66, 64,134}, { 66, 65,134}, { 65, 66,135}, { 65, 68,135}, { 64, 69,136}, { 64, 70,136},
+				{ 63, 71,136}, { 63, 72,137}, { 62, 73,137}, { 62, 74,137}, { 62, 76,138}, { 61, 77,138},
+				{ 61, 78,138}, { 60, 79,138}, { 60, 80,139}, { 59, 81,139}, { 59, 82,139}, { 58, 83,139},
+				{ 58, 84,140}, { 57, 85,140}, { 57, 86,140}, { 56, 88,140}, { 56, 89,140}, { 55, 90,140},
+				{ 55, 91,141}, { 54, 92,141}, { 54, 93,141}, { 53, 94,141}, { 53, 95,141}, { 52, 96,141},
+				{ 52, 97,141}, { 51, 98,141}, { 51, 99,141}, { 50,100,142}, { 50,101,142}, { 49,102,142},
+				{ 49,103,142}, { 49,104,142}, { 48,105,142}, { 48,106,142}, { 47,107,142}, { 47,108,142},
+				{ 46,109,142}, { 46,110,142}, { 46,111,142}, { 45,112,142}, { 45,113,142}, { 44,113,142},
+				{ 44,114,142}, { 44,115,142}, { 43,116,142}, { 43,117,142}, { 42,118,142}, { 42,119,142},
+				{ 42,120,142}, { 41,121,142}, { 41,122,142}, { 41,123,142}, { 40,124,142}, { 40,125,142},
+				{ 39,126,142}, { 39,127,142}, { 39,128,142}, { 38,129,142}, { 38,130,142}, { 38,130,142},
+				{ 37,131,142}, { 37,132,142}, { 37,133,142}, { 36,134,142}, { 36,135,142}, { 35,136,142},
+				{ 35,137,142}, { 35,138,141}, { 34,139,141}, { 34,140,141}, { 34,141,141}, { 33,142,141},
+				{ 33,143,141}, { 33,144,141}, { 33,145,140}, { 32,146,140}, { 32,146,140}, { 32,147,140},
+				{ 31,148,140}, { 31,149,139}, { 31,150,139}, { 31,151,139}, { 31,152,139}, { 31,153,138},
+				{ 31,154,138}, { 30,155,138}, { 30,156,137}, { 30,157,137}, { 31,158,137}, { 31,159,136},
+				{ 31,160,136}, { 31,161,136}, { 31,161,135}, { 31,162,135}, { 32,163,134}, { 32,164,134},
+				{ 33,165,133}, { 33,166,133}, { 34,167,133}, { 34,168,132}, { 35,169,131}, { 36,170,131},
+				{ 37,171,130}, { 37,172,130}, { 38,173,129}, { 39,173,129}, { 40,174,128}, { 41,175,127},
+				{ 42,176,127}, { 44,177,126}, { 45,178,125}, { 46,179,124}, { 47,180,124}, { 49,181,123},
+				{ 50,182,122}, { 52,182,121}, { 53,183,121}, { 55,184,120}, { 56,185,119}, { 58,186,118},
+				{ 59,187,117}, { 61,188,116}, { 63,188,115}, { 64,189,114}, { 66,190,113}, { 68,191,112},
+				{ 70,192,111}, { 72,193,110}, { 74,193,109}, { 76,194,108}, { 78,195,107}, { 80,196,106},
+				{ 82,197,105}, { 84,197,104}, { 86,198,103}, { 88,199,101}, { 90,200,100}, { 92,200, 99},
+				{ 94,201, 98}, { 96,202, 96}, { 99,203, 95}, {101,203, 94}, {103,204, 92}, {105,205, 91},
+				{108,205, 90}, {110,206, 88}, {112,207, 87}, {115,208, 86}, {117,208, 84}, {119,209, 83},
+				{122,209, 81}, {124,210, 80}, {127,211, 78}, {129,211, 77}, {132,212, 75}, {134,213, 73},
+				{137,213, 72}, {139,214, 70}, {142,214, 69}, {144,215, 67}, {147,215, 65}, {149,216, 64},
+				{152,216, 62}, {155,217, 60}, {157,217, 59}, {160,218, 57}, {162,218, 55}, {165,219, 54},
+				{168,219, 52}, {170,220, 50}, {173,220, 48}, {176,221, 47}, {178,221, 45}, {181,222, 43},
+				{184,222, 41}, {186,222, 40}, {189,223, 38}, {192,223, 37}, {194,223, 35}, {197,224, 33},
+				{200,224, 32}, {202,225, 31}, {205,225, 29}, {208,225, 28}, {210,226, 27}, {213,226, 26},
+				{216,226, 25}, {218,227, 25}, {221,227, 24}, {223,227, 24}, {226,228, 24}, {229,228, 25},
+				{231,228, 25}, {234,229, 26}, {236,229, 27}, {239,229, 28}, {241,229, 29}, {244,230, 30},
+				{246,230, 32}, {248,230, 33}, {251,231, 35}, {253,231, 37},
+			},
+			{
+				//	Inferno (matplotlib, CC0)
+				{  0,  0,  4}, {  1,  0,  5}, {  1,  1,  6}, {  1,  1,  8}, {  2,  1, 10}, {  2,  2, 12},
+				{  2,  2, 14}, {  3,  2, 16}, {  4,  3, 18}, {  4,  3, 20}, {  5,  4, 23}, {  6,  4, 25},
+				{  7,  5, 27}, {  8,  5, 29}, {  9,  6, 31}, { 10,  7, 34}, { 11,  7, 36}, { 12,  8, 38},
+				{ 13,  8, 41}, { 14,  9, 43}, { 16,  9, 45}, { 17, 10, 48}, { 18, 10, 50}, { 20, 11, 52},
+				{ 21, 11, 55}, { 22, 11, 57}, { 24, 12, 60}, { 25, 12, 62}, { 27, 12, 65}, { 28, 12, 67},
+				{ 30, 12, 69}, { 31, 12, 72}, { 33, 12, 74}, { 35, 12, 76}, { 36, 12, 79}, { 38, 12, 81},
+				{ 40, 11, 83}, { 41, 11, 85}, { 43, 11, 87}, { 45, 11, 89}, { 47, 10, 91}, { 49, 10, 92},
+				{ 50, 10, 94}, { 52, 10, 95}, { 54,  9, 97}, { 56,  9, 98}, { 57,  9, 99}, { 59,  9,100},
+				{ 61,  9,101}, { 62,  9,102}, { 64, 10,103}, { 66, 10,104}, { 68, 10,104}, { 69, 10,105},
+				{ 71, 11,106}, { 73, 11,106}, { 74, 12,107}, { 76, 12,107}, { 77, 13,108}, { 79, 13,108},
+				{ 81, 14,108}, { 82, 14,109}, { 84, 15,109}, { 85, 15,109}, { 87, 16,110}, { 89, 16,110},
+				{ 90, 17,110}, { 92, 18,110}, { 93, 18,110}, { 95, 19,110}, { 97, 19,110}, { 98, 20,110},
+				{100, 21,110}, {101, 21,110}, {103, 22,110}, {105, 22,110}, {106, 23,110}, {108, 24,110},
+				{109, 24,110}, {111, 25,110}, {113, 25,110}, {114, 26,110}, {116, 26,110}, {117, 27,110},
+				{119, 28,109}, {120, 28,109}, {122, 29,109}, {124, 29,109}, {125, 30,109}, {127, 30,108},
+				{128, 31,108}, {130, 32,108}, {132, 32,107}, {133, 33,107}, {135, 33,107}, {136, 34,106},
+				{138, 34,106}, {140, 35,105}, {141, 35,105}, {143, 36,105}, {144, 37,104}, {146, 37,104},
+				{147, 38,103}, {149, 38,103}, {151, 39,102}, {152, 39,102}, {154, 40,101}, {155, 41,100},
+				{157, 41,100}, {159, 42, 99}, {160, 42, 99}, {162, 43, 98}, {163, 44, 97}, {165, 44, 96},
+				{166, 45, 96}, {168, 46, 95}, {169, 46, 94}, {171, 47, 94}, {173, 48, 93}, {174, 48, 92},
+				{176, 49, 91}, {177, 50, 90}, {179, 50, 90}, {180, 51, 89}, {182, 52, 88}, {183, 53, 87},
+				{185, 53, 86}, {186, 54, 85}, {188, 55, 84}, {189, 56, 83}, {191, 57, 82}, {192, 58, 81},
+				{193, 58, 80}, {195, 59, 79}, {196, 60, 78}, {198, 61, 77}, {199, 62, 76}, {200, 63, 75},
+				{202, 64, 74}, {203, 65, 73}, {204, 66, 72}, {206, 67, 71}, {207, 68, 70}, {208, 69, 69},
+				{210, 70, 68}, {211, 71, 67}, {212, 72, 66}, {213, 74, 65}, {215, 75, 63}, {216, 76, 62},
+				{217, 77, 61}, {218, 78, 60}, {219, 80, 59}, {221, 81, 58}, {222, 82, 56}, {223, 83, 55},
+				{224, 85, 54}, {225, 86, 53}, {226, 87, 52}, {227, 89, 51}, {228, 90, 49}, {229, 92, 48},
+				{230, 93, 47}, {231, 94, 46}, {232, 96, 45}, {233, 97, 43}, {234, 99, 42}, {235,100, 41},
+				{235,102, 40}, {236,103, 38}, {237,105, 37}, {238,106, 36}, {239,108, 35}, {239,110, 33},
+				{240,111, 32}, {241,113, 31}, {241,115, 29}, {242,116, 28}, {243,118, 27}, {243,120, 25},
+				{244,121, 24}, {245,123, 23}, {245,125, 21}, {246,126, 20}, {246,128, 19}, {247,130, 18},
+				{247,132, 16}, {248,133, 15}, {248,135, 14}, {248,137, 12}, {249,139, 11}, {249,140, 10},
+				{249,142,  9}, {250,144,  8}, {250,146,  7}, {250,148,  7}, {251,150,  6}, {251,151,  6},
+				{251,153,  6}, {251,155,  6}, {251,157,  7}, {252,159,  7}, {252,161,  8}, {252,163,  9},
+				{252,165, 10}, {252,166, 12}, {252,168, 13}, {252,170, 15}, {252,172, 17}, {252,174, 18},
+				{252,176, 20}, {252,178, 22}, {252,180, 24}, {251,182, 26}, {251,184, 29}, {251,186, 31},
+				{251,188, 33}, {251,190, 35}, {250,192, 38}, {250,194, 40}, {250,196, 42}, {250,198, 45},
+				{249,199, 47}, {249,201, 50}, {249,203, 53}, {248,205, 55}, {248,207, 58}, {247,209, 61},
+				{247,211, 64}, {246,213, 67}, {246,215, 70}, {245,217, 73}, {245,219, 76}, {244,221, 79},
+				{244,223, 83}, {244,225, 86}, {243,227, 90}, {243,229, 93}, {242,230, 97}, {242,232,101},
+				{242,234,105}, {241,236,109}, {241,237,113}, {241,239,117}, {241,241,121}, {242,242,125},
+				{242,244,130}, {243,245,134}, {243,246,138}, {244,248,142}, {245,249,146}, {246,250,150},
+				{248,251,154}, {249,252,157}, {250,253,161}, {252,255,164},
+			},
+			{
+				//	Turbo (Google, Apache-2.0)
+				{ 48, 18, 59}, { 50, 21, 67}, { 51, 24, 74}, { 52, 27, 81}, { 53, 30, 88}, { 54, 33, 95},
+				{ 55, 36,102}, { 56, 39,109}, { 57, 42,115}, { 58, 45,121}, { 59, 47,128}, { 60, 50,134},
+				{ 61, 53,139}, { 62, 56,145}, { 63, 59,151}, { 63, 62,156}, { 64, 64,162}, { 65, 67,167},
+				{ 65, 70,172}, { 66, 73,177}, { 66, 75,181}, { 67, 78,186}, { 68, 81,191}, { 68, 84,195},
+				{ 68, 86,199}, { 69, 89,203}, { 69, 92,207}, { 69, 94,211}, { 70, 97,214}, { 70,100,218},
+				{ 70,102,221}, { 70,105,224}, { 70,107,227}, { 71,110,230}, { 71,113,233}, { 71,115,235},
+				{ 71,118,238}, { 71,120,240}, { 71,123,242}, { 70,125,244}, { 70,128,246}, { 70,130,248},
+				{ 70,133,250}, { 70,135,251}, { 69,138,252}, { 69,140,253}, { 68,143,254}, { 67,145,254},
+				{ 66,148,255}, { 65,150,255}, { 64,153,255}, { 62,155,254}, { 61,158,254}, { 59,160,253},
+				{ 58,163,252}, { 56,165,251}, { 55,168,250}, { 53,171,248}, { 51,173,247}, { 49,175,245},
+				{ 47,178,244}, { 46,180,242}, { 44,183,240}, { 42,185,238}, { 40,188,235}, { 39,190,233},
+				{ 37,192,231}, { 35,195,228}, { 34,197,226}, { 32,199,223}, { 31,201,221}, { 30,203,218},
+				{ 28,205,216}, { 27,208,213}, { 26,210,210}, { 26,212,208}, { 25,213,205}, { 24,215,202},
+				{ 24,217,200}, { 24,219,197}, { 24,221,194}, { 24,222,192}, { 24,224,189}, { 25,226,187},
+				{ 25,227,185}, { 26,228,182}, { 28,230,180}, { 29,231,178}, { 31,233,175}, { 32,234,172},
+				{ 34,235,170}, { 37,236,167}, { 39,238,164}, { 42,239,161}, { 44,240,158}, { 47,241,155},
+				{ 50,242,152}, { 53,243,148}, { 56,244,145}, { 60,245,142}, { 63,246,138}, { 67,247,135},
+				{ 70,248,132}, { 74,248,128}, { 78,249,125}, { 82,250,122}, { 85,250,118}, { 89,251,115},
+				{ 93,252,111}, { 97,252,108}, {101,253,105}, {105,253,102}, {109,254, 98}, {113,254, 95},
+				{117,254, 92}, {121,254, 89}, {125,255, 86}, {128,255, 83}, {132,255, 81}, {136,255, 78},
+				{139,255, 75}, {143,255, 73}, {146,255, 71}, {150,254, 68}, {153,254, 66}, {156,254, 64},
+				{159,253, 63}, {161,253, 61}, {164,252, 60}, {167,252, 58}, {169,251, 57}, {172,251, 56},
+				{175,250, 55}, {177,249, 54}, {180,248, 54}, {183,247, 53}, {185,246, 53}, {188,245, 52},
+				{190,244, 52}, {193,243, 52}, {195,241, 52}, {198,240, 52}, {200,239, 52}, {203,237, 52},
+				{205,236, 52}, {208,234, 52}, {210,233, 53}, {212,231, 53}, {215,229, 53}, {217,228, 54},
+				{219,226, 54}, {221,224, 55}, {223,223, 55}, {225,221, 55}, {227,219, 56}, {229,217, 56},
+				{231,215, 57}, {233,213, 57}, {235,211, 57}, {236,209, 58}, {238,207, 58}, {239,205, 58},
+				{241,203, 58}, {242,201, 58}, {244,199, 58}, {245,197, 58}, {246,195, 58}, {247,193, 58},
+				{248,190, 57}, {249,188, 57}, {250,186, 57}, {251,184, 56}, {251,182, 55}, {252,179, 54},
+				{252,177, 54}, {253,174, 53}, {253,172, 52}, {254,169, 51}, {254,167, 50}, {254,164, 49},
+				{254,161, 48}, {254,158, 47}, {254,155, 45}, {254,153, 44}, {254,150, 43}, {254,147, 42},
+				{254,144, 41}, {253,141, 39}, {253,138, 38}, {252,135, 37}, {252,132, 35}, {251,129, 34},
+				{251,126, 33}, {250,123, 31}, {249,120, 30}, {249,117, 29}, {248,114, 28}, {247,111, 26},
+				{246,108, 25}, {245,105, 24}, {244,102, 23}, {243, 99, 21}, {242, 96, 20}, {241, 93, 19},
+				{240, 91, 18}, {239, 88, 17}, {237, 85, 16}, {236, 83, 15}, {235, 80, 14}, {234, 78, 13},
+				{232, 75, 12}, {231, 73, 12}, {229, 71, 11}, {228, 69, 10}, {226, 67, 10}, {225, 65,  9},
+				{223, 63,  8}, {221, 61,  8}, {220, 59,  7}, {218, 57,  7}, {216, 55,  6}, {214, 53,  6},
+				{212, 51,  5}, {210, 49,  5}, {208, 47,  5}, {206, 45,  4}, {204, 43,  4}, {202, 42,  4},
+				{200, 40,  3}, {197, 38,  3}, {195, 37,  3}, {193, 35,  2}, {190, 33,  2}, {188, 32,  2},
+				{185, 30,  2}, {183, 29,  2}, {180, 27,  1}, {178, 26,  1}, {175, 24,  1}, {172, 23,  1},
+				{169, 22,  1}, {167, 20,  1}, {164, 19,  1}, {161, 18,  1}, {158, 16,  1}, {155, 15,  1},
+				{152, 14,  1}, {149, 13,  1}, {146, 11,  1}, {142, 10,  1}, {139,  9,  2}, {136,  8,  2},
+				{133,  7,  2}, {129,  6,  2}, {126,  5,  2}, {122,  4,  3},
+			}
+		};
 
-		return false;
+		return &(sTables[inIndex][0][0]);
 	}
+};
 
-	int	GetImageBitCount()
+
+// -----------------------------------------------------------------------------
+//	ImageWindow class
+// -----------------------------------------------------------------------------
+//!
+/*!
+	The class for Image Data Container and Window
+*/
+class ImageWindow
+{
+public:
+	// enum --------------------------------------------------------------------
+	enum CursorMode
 	{
-		if (mBitmapInfo == NULL)
-			return 0;
-		return mBitmapInfo->biBitCount;
-	}
-	unsigned char	*GetImageBufferPtr()
+		CURSOR_MODE_SCROLL_TOOL	=	1,
+		CURSOR_MODE_ZOOM_TOOL,
+		CURSOR_MODE_INFO_TOOL
+	};
+	//	Channel order of color images. 8-bit images can be BGR (24-bit),
+	//	BGRA or RGBA (32-bit, alpha is ignored). 16-bit images can be BGR or
+	//	RGB (48-bit).
+	enum ColorFormat
 	{
-		if (mIs16BitsImage == false)
-			return mBitmapBits;
-
-		if (mAllocated16BitsImageBuffer == NULL)
-			return (unsigned char *)mExternal16BitsImageBuffer;
-
-		return (unsigned char *)mAllocated16BitsImageBuffer;
-	}
-	unsigned int	GetImageBufferSize()
+		COLOR_FORMAT_BGR	=	0,
+		COLOR_FORMAT_RGB,
+		COLOR_FORMAT_BGRA,
+		COLOR_FORMAT_RGBA
+	};
+	//	GenICam packed mono formats, see CopyIntoPackedMonoImageBuffer()
+	enum PackedFormat
 	{
-		if (mIs16BitsImage == false)
-			return mBitmapBitsSize;
-
-		return mBitmapBitsSize * sizeof(unsigned short);
-	}
-	double	GetDispScale()
+		PACKED_FORMAT_MONO10P	=	0,
+		PACKED_FORMAT_MONO12P,
+		PACKED_FORMAT_MONO12_PACKED
+	};
+	//	Colors of the first two pixels of the first line in memory
+	enum BayerPattern
 	{
-		return mImageDispScale;
-	}
-
-	void	SetDispScale(double inScale)
+		BAYER_PATTERN_RG	=	0,
+		BAYER_PATTERN_GR,
+		BAYER_PATTERN_GB,
+		BAYER_PATTERN_BG
+	};
+	enum DemosaicMode
 	{
-		double	prevImageDispScale = mImageDispScale;
-
-		if (inScale <= 1.0)
-			inScale = 1.0;
-		mImageDispScale = inScale;
-		CheckImageDispOffset();
-		UpdateStatusBar();
-		
-		double	scale = mImageDispScale / 100.0;
-		if (prevImageDispScale > mImageDispScale &&
-			((int )(mImageSize.cx * scale) <= mImageDispRect.right - mImageDispRect.left ||
-			 (int )(mImageSize.cy * scale) <= mImageDispRect.bottom - mImageDispRect.top))
-			UpdateImageDisp(true);
-		else
-			UpdateImageDisp();
-
-		UpdateMouseCursor();
-	}
-
-	double	CalcWindowSizeFitScale()
+		DEMOSAIC_MODE_BILINEAR	=	0,
+		DEMOSAIC_MODE_HIGH_QUALITY
+	};
+	enum YUVFormat
 	{
-		double	imageRatio = (double )mImageSize.cy / (double )mImageSize.cx;
-		double	dispRatio = (double )mImageDispSize.cy / (double )mImageDispSize.cx;
-		double	scale;
+		YUV_FORMAT_YUYV	=	0,
+		YUV_FORMAT_NV12,
+		YUV_FORMAT_I420
+	};
+	//	Limited (video) range matrices
+	enum YUVMatrix
+	{
+		YUV_MATRIX_BT601	=	0,
+		YUV_MATRIX_BT709
+	};
 
-		if (imageRatio > dispRatio)
-			scale = (double )mImageDispSize.cy / (double )mImageSize.cy;
-		else
-			scale = (double )mImageDispSize.cx / (double )mImageSize.cx;
+	// -------------------------------------------------------------------------
+	//	ImageWindow(...)
+	// -------------------------------------------------------------------------
+	//!	ImageWindow Class Constructor
+	/*!
+		xxxx
+	*/
+	ImageWindow(const char *inWindowName = NULL,
+						int inPosX = IMAGE_WINDOW_AUTO_POS,
+						int inPosY = IMAGE_WINDOW_DEFAULT_POS)
+	{
+		static int	sPrevPosX	= 0;
+		static int	sPrevPosY	= 0;
+		static int	sWindowNum	= 0;
 
-		return scale * 100.0;
-	}
+		mWindowState			= WINDOW_INIT_STATE;
+		mWindowTitle			= NULL;
+		mFileNameIndex			= 0;
+		mWindowH				= NULL;
+		mToolbarH				= NULL;
+		mStatusbarH				= NULL;
+		mRebarH					= NULL;
+		mMenuH					= NULL;
+		mMutexHandle			= NULL;
+		mEventHandle			= NULL;
+		mThreadHandle			= NULL;
+		mBitmapInfo				= NULL;
+		mBitmapInfoSize			= 0;
+		mBitmapBits				= NULL;
+		mBitmapBitsSize			= 0;
+		mModuleH				= GetModuleHandle(NULL);
+		mCursorMode				= CURSOR_MODE_SCROLL_TOOL;
 
-	void	FitDispScaleToWindowSize()
-	{
-		SetDispScale(CalcWindowSizeFitScale());
-	}
+		mIsHiDPI = false;
+		mIsColorImage			= false;
+		mIs16BitsImage			= false;
+		mColorFormat			= COLOR_FORMAT_BGR;
+		m16BitsImageBitDepth	= 16;
+		mIsImageDispConverted	= 0;
+		mIsBayerImage			= false;
+		mBayerPattern			= BAYER_PATTERN_RG;
+		mDemosaicMode			= DEMOSAIC_MODE_BILINEAR;
+		mBayerImageBuffer		= NULL;
+		mBayerImageBufferSize	= 0;
+		mIsYUVImage				= false;
+		mYUVFormat				= YUV_FORMAT_YUYV;
+		mYUVMatrix				= YUV_MATRIX_BT601;
+		mYUVImageBuffer			= NULL;
+		mYUVImageBufferSize		= 0;
+		mYUVImageLineSize		= 0;
+		mIsFloatImage			= false;
+		mIsWaterfallEnabled		= false;
+		mWaterfallTopLine		= 0;
+		mIsWaterfallPaintPending	= 0;
+		mIsReadoutPending		= 0;
+		mIsFloatAutoRange		= true;
+		mFloatBottomValue		= 0.0f;
+		mFloatTopValue			= 1.0f;
+		mFloatMinValue			= HUGE_VALF;
+		mFloatMaxValue			= -HUGE_VALF;
+		mFloatImageBuffer		= NULL;
+		mFloatImageBufferSize	= 0;
+		mFloatMapBottomValue	= 0.0f;
+		mFloatMapScale			= 255.0f;
+
+		mImageDispScale			= 100;
+		mImageDispOffset.cx		= 0;
+		mImageDispOffset.cy		= 0;
 
-	void	ZoomIn()
-	{
-		SetDispScale(CalcImageScale(IMAGE_ZOOM_STEP));
-	}
+		mIsMouseDragging		= false;
+		mIsFullScreenMode		= false;
+		mIsMenubarEnabled		= true;
+		mIsToolbarEnabled		= true;
+		mIsStatusbarEnabled		= true;
+		mIsPlotEnabled			= false;
+		mIsPlotValid			= false;
 
-	void	ZoomOut()
-	{
-		SetDispScale(CalcImageScale(-IMAGE_ZOOM_STEP));
-	}
+		mFPSValue				= 0;
 
-	bool	IsFullScreenMode()
-	{
-		return mIsFullScreenMode;
-	}
+		mIsRenderCoalescingEnabled	= false;
+		mPresentRate			= 0;
+		mDisplayRefreshRate		= IMAGE_DEFAULT_REFRESH_RATE;
+		mPendingFrameNum		= 0;
+		mIsPresentPosted		= 0;
+		mLastPresentCount		= 0;
+		mIsPanPending			= false;
+		mLastPanCount			= 0;
+		mCoalescedFrameNum		= 0;
 
-	void	EnableFullScreenMode(bool inFitDispScaleToWindowSize = true, int inMonitorIndex = -1)
-	{
-		if (mIsFullScreenMode)
-			return;
+		mAllocatedImageBuffer	= NULL;
+		mAllocated16BitsImageBuffer = NULL;
+		mExternal16BitsImageBuffer = NULL;
+		m16BitsImageLineSize	= 0;
+		mExternalImageBuffer	= NULL;
+		mExternalImageLineSize	= 0;
 
-		RECT	monitorRect = {0, 0, 0, 0};
-		int		index = 0;
+		mDrawOverlayFunc		= NULL;
+		mOverlayFuncData		= NULL;
 
-		mMonitorNum = 0;
-		EnumDisplayMonitors(NULL, NULL, (MONITORENUMPROC )MyMonitorEnumProc, (LPARAM )this);
-		GetWindowRect(mWindowH, &mLastWindowRect);
+		mIsSoftwareRenderEnabled	= false;
+		mRenderOverlayFunc		= NULL;
+		mRenderOverlayFuncData	= NULL;
+		ZeroMemory(&mRenderBitmapInfo, sizeof(mRenderBitmapInfo));
+		mRenderBuffer			= NULL;
+		mRenderBufferSize		= 0;
+		mRenderXTable			= NULL;
+		mRenderXTableSize		= 0;
+		mPixValueGlyphScale		= 0;
 
-		switch (inMonitorIndex)
+		mImageClickNum			= 0;
+		mLastImageClickX		= 0;
+		mLastImageClickY		= 0;
+
+		mIsMapModeEnabled		= false;
+		mMapBottomValue			= 0;
+		mMapTopValue			= 65535;
+		mIsMapReverse			= false;
+		mMapDirectMapLimit		= 0;
+		mMapTable				= NULL;
+		mIsMapTableValid		= false;
+		mIsMapLinear			= false;
+		mIsMapPerChannel		= false;
+		for (int i = 0; i < 3; i++)
 		{
-			case -1:
-				POINT	pos;
-				for (int i = 0; i < mMonitorNum; i++)
-				{
-					pos.x = mLastWindowRect.left;
-					pos.y = mLastWindowRect.top;
-					if (PtInRect(&mMonitorRect[i], pos) == TRUE)
-					{
-						index = i;
-						break;
-					}
-				}
-				monitorRect = mMonitorRect[index];
-				break;
-			case -2:
-				for (int i = 0; i < mMonitorNum; i++)
-				{
-					if (mMonitorRect[i].left < monitorRect.left)
-						monitorRect.left = mMonitorRect[i].left;
-					if (mMonitorRect[i].top < monitorRect.top)
-						monitorRect.top = mMonitorRect[i].top;
-					if (mMonitorRect[i].right > monitorRect.right)
-						monitorRect.right = mMonitorRect[i].right;
-					if (mMonitorRect[i].bottom > monitorRect.bottom)
-						monitorRect.bottom = mMonitorRect[i].bottom;
-				}
-				break;
-			default:
-				index = inMonitorIndex;
-				if (index < 0 || index >= mMonitorNum)
-					index = 0;
-				monitorRect = mMonitorRect[index];
-				break;
+			mMapBottomValues[i]	= 0;
+			mMapTopValues[i]	= 65535;
 		}
 
-		SetWindowLong(mWindowH, GWL_STYLE, WS_POPUP | WS_VISIBLE);
-		SetWindowPos(mWindowH, HWND_TOPMOST,
-			monitorRect.left, monitorRect.top,
-			monitorRect.right, monitorRect.bottom,
-			SWP_SHOWWINDOW);
-		DisableMenubar();
-		DisableToolbar();
-		DisableStatusbar();
-		CheckMenuItem(mMenuH, IDM_FULL_SCREEN, MF_CHECKED);
-		mIsFullScreenMode = true;
-		UpdateImageDispDispRect();
-		if (inFitDispScaleToWindowSize)
-			FitDispScaleToWindowSize();
-	}
+		mIsAutoWindowLevelEnabled	= false;
+		mAutoWindowLevelLowPercent	= 1.0;
+		mAutoWindowLevelHighPercent	= 99.0;
+		mAutoWindowLevelSmoothing	= 0.8;
+		mAutoBottomValue		= 0;
+		mAutoTopValue			= 65535;
+		mIsAutoWindowLevelValid	= false;
+		mAutoWindowLevelGeneration = 0;
+
+		mColormapIndex			= 0;
+		for (int i = 0; i < IMAGE_PALLET_SIZE_8BIT; i++)
+		{
+			mColormapPalette[i].rgbBlue		= i;
+			mColormapPalette[i].rgbGreen	= i;
+			mColormapPalette[i].rgbRed		= i;
+			mColormapPalette[i].rgbReserved	= 0;
+		}
+		mIs16BitsColormapEnabled = false;
+		mColormapTable			= NULL;
+		mIsColormapTableValid	= false;
+		ZeroMemory(&mColormapTableParam, sizeof(mColormapTableParam));
+
+		mThreadPool				= NULL;
+		mThreadPoolMutexHandle	= NULL;
+		mWorkerThreadNum		= 0;
+		mParallelMinSize		= IMAGE_PARALLEL_MIN_SIZE;
+
+		mIsLazyConversionEnabled = false;
+		mTileGenerations		= NULL;
+		mTileNumX				= 0;
+		mTileNumY				= 0;
+		mFrameGeneration		= 1;
+		mConvertGeneration		= 1;
+
+		mBufferMemorySize		= 0;
+
+		mIsPyramidEnabled		= false;
+		ZeroMemory(mPyramid, sizeof(mPyramid));
+
+		mIsTripleBufferEnabled	= false;
+		mFrameBufferState		= FRAME_BUFFER_INIT_STATE;
+		mFrameProducerNum		= 0;
+		for (int i = 0; i < FRAME_BUFFER_NUM; i++)
+		{
+			mFrameBuffers[i].ImageBuffer		= NULL;
+			mFrameBuffers[i].ImageBuffer16Bits	= NULL;
+		}
 
-	void	DisableFullScreenMode(bool inFitDispScaleToWindowSize = true)
-	{
-		if (!mIsFullScreenMode)
-			return;
+		if (inPosX == IMAGE_WINDOW_AUTO_POS ||
+			inPosY == IMAGE_WINDOW_AUTO_POS)
+		{
+			if (sPrevPosX == 0 && sPrevPosY == 0)
+			{
+				mPosX = IMAGE_WINDOW_DEFAULT_POS;
+				mPosY = IMAGE_WINDOW_DEFAULT_POS;
+			}
+			else
+			{
+				mPosX = sPrevPosX + IMAGE_WINDOW_POS_SPACE;
+				mPosY = sPrevPosY + IMAGE_WINDOW_POS_SPACE;
 
-		SetWindowLong(mWindowH, GWL_STYLE,
-			WS_THICKFRAME | WS_CAPTION | WS_SYSMENU | WS_VISIBLE | WS_MINIMIZEBOX | WS_MAXIMIZEBOX);
-		SetWindowPos(mWindowH, HWND_NOTOPMOST,
-			mLastWindowRect.left, mLastWindowRect.top,
-			mLastWindowRect.right - mLastWindowRect.left,
-			mLastWindowRect.bottom - mLastWindowRect.top,
-			SWP_SHOWWINDOW);
-		EnableMenubar();
-		EnableToolbar();
-		EnableStatusbar();
-		CheckMenuItem(mMenuH, IDM_FULL_SCREEN, MF_UNCHECKED);
-		mIsFullScreenMode = false;
-		UpdateImageDispDispRect();
-		if (inFitDispScaleToWindowSize)
-			FitDispScaleToWindowSize();
-	}
+				if (mPosX >= GetSystemMetrics(SM_CXMAXIMIZED) - IMAGE_WINDOW_POS_SPACE)
+					mPosX = IMAGE_WINDOW_DEFAULT_POS;
 
-	bool	IsMenubarEnabled()
-	{
-		return mIsMenubarEnabled;
-	}
+				if (mPosY >= GetSystemMetrics(SM_CYMAXIMIZED) - IMAGE_WINDOW_POS_SPACE)
+					mPosY = IMAGE_WINDOW_DEFAULT_POS;
+			}
 
-	void	EnableMenubar()
-	{
-		if (mIsMenubarEnabled)
-			return;
+			sPrevPosX = mPosX;
+			sPrevPosY = mPosY;
+		}
 
-		::SetMenu(mWindowH, mMenuH);
-		CheckMenuItem(mMenuH, IDM_MENUBAR, MF_CHECKED);
-		mIsMenubarEnabled = true;
-	}
+		if (sWindowNum == 0)
+		{
+			// TODO: Add an option to skip the following call
+			SetProcessDPIAware();
+		}
 
-	void	DisableMenubar()
-	{
-		if (!mIsMenubarEnabled)
+		if (RegisterWindowClass() == 0)
+		{
+			printf("Error: RegisterWindowClass() failed\n");
 			return;
+		}
 
-		::SetMenu(mWindowH, NULL);
-		CheckMenuItem(mMenuH, IDM_MENUBAR, MF_UNCHECKED);
-		mIsMenubarEnabled = false;
-	}
-
-	bool	IsToolbarEnabled()
-	{
-		return mIsToolbarEnabled;
-	}
+		char	windowName[IMAGE_STR_BUF_SIZE];
+		if (inWindowName == NULL)
+		{
+			sprintf_s(windowName, IMAGE_STR_BUF_SIZE, "%s%d", DEFAULT_WINDOW_NAME, sWindowNum);
+			inWindowName = windowName;
+		}
 
-	void	EnableToolbar()
-	{
-		if (mIsToolbarEnabled)
+		size_t	bufSize = strlen(inWindowName) + 1;
+		mWindowTitle = new char[bufSize];
+		if (mWindowTitle == NULL)
+		{
+			printf("Error: Can't allocate mWindowTitle\n");
 			return;
+		}
+		strcpy_s(mWindowTitle, bufSize, inWindowName);
 
-		::ShowWindow(mRebarH, SW_SHOW);
-		CheckMenuItem(mMenuH, IDM_TOOLBAR, MF_CHECKED);
-		mIsToolbarEnabled = true;
-		UpdateImageDispDispRect();
-		UpdateImageDisp(true);
-	}
+		mMutexHandle = CreateMutex(NULL, false, NULL);
+		if (mMutexHandle == NULL)
+		{
+			printf("Error: Can't create Mutex object\n");
+			delete mWindowTitle;
+			return;
+		}
 
-	void	DisableToolbar()
-	{
-		if (!mIsToolbarEnabled)
+		mEventHandle = CreateEvent(NULL, false, false, NULL);
+		if (mEventHandle == NULL)
+		{
+			printf("Error: Can't create Event object\n");
+			CloseHandle(mMutexHandle);
+			delete mWindowTitle;
 			return;
+		}
 
-		::ShowWindow(mRebarH, SW_HIDE);
-		CheckMenuItem(mMenuH, IDM_TOOLBAR, MF_UNCHECKED);
-		mIsToolbarEnabled = false;
-		UpdateImageDispDispRect();
-		UpdateImageDisp(true);
-	}
+		//	Without it the frames are processed on the caller's thread only
+		mThreadPoolMutexHandle = CreateMutex(NULL, false, NULL);
+		if (mThreadPoolMutexHandle == NULL)
+			printf("Error: Can't create Mutex object for the thread pool\n");
 
-	bool	IsStatusbarEnabled()
-	{
-		return mIsStatusbarEnabled;
+		sWindowNum++;
 	}
 
-	void	EnableStatusbar()
+	virtual ~ImageWindow()
 	{
-		if (mIsStatusbarEnabled)
-			return;
+		if (mWindowState == WINDOW_OPEN_STATE)
+			PostMessage(mWindowH, WM_CLOSE, 0, 0);
 
-		::ShowWindow(mStatusbarH, SW_SHOW);
-		CheckMenuItem(mMenuH, IDM_STATUSBAR, MF_CHECKED);
-		mIsStatusbarEnabled = true;
+		if (mThreadHandle != NULL)
+		{
+			WaitForSingleObject(mThreadHandle, INFINITE);
+			CloseHandle(mThreadHandle);
+		}
+
+		if (mMutexHandle != NULL)
+			CloseHandle(mMutexHandle);
+
+		if (mEventHandle != NULL)
+			CloseHandle(mEventHandle);
+
+		FreeBuffer(mAllocatedImageBuffer);
+		FreeBuffer(mAllocated16BitsImageBuffer);
+		FreeBuffer(mBitmapInfo);
+		FreeBuffer(mBayerImageBuffer);
+		FreeBuffer(mYUVImageBuffer);
+		FreeBuffer(mFloatImageBuffer);
+
+		DeleteFrameBuffers();
+
+		if (mThreadPool != NULL)
+			delete mThreadPool;
+		if (mThreadPoolMutexHandle != NULL)
+			CloseHandle(mThreadPoolMutexHandle);
+
+		if (mTileGenerations != NULL)
+			delete [] mTileGenerations;
+
+		DeletePyramid();
+
+		if (mRenderBuffer != NULL)
+			delete [] mRenderBuffer;
+		if (mRenderXTable != NULL)
+			delete [] mRenderXTable;
+
+		if (mMapTable != NULL)
+			delete [] mMapTable;
+		if (mColormapTable != NULL)
+			delete [] mColormapTable;
+
+		if (mWindowTitle != NULL)
+			delete mWindowTitle;
 	}
 
-	void	DisableStatusbar()
+	void	ShowWindow()
 	{
-		if (!mIsStatusbarEnabled)
+		if (mWindowState != WINDOW_INIT_STATE)
 			return;
 
-		::ShowWindow(mStatusbarH, SW_HIDE);
-		CheckMenuItem(mMenuH, IDM_STATUSBAR, MF_UNCHECKED);
-		mIsStatusbarEnabled = false;
+		if (mIsThreadRunning == true)
+			return;
+
+		if (mThreadHandle != NULL)
+		{
+			::CloseHandle(mThreadHandle);
+		}
+
+		//	Must use _beginthreadex instead of _beginthread, CreateThread
+		mIsThreadRunning = true;
+		mThreadHandle = (HANDLE )_beginthreadex(
+			NULL,
+			0,
+			ThreadFunc,
+			this,
+			0,
+			NULL);
+		if (mThreadHandle == NULL)
+		{
+			mIsThreadRunning = false;
+			printf("Error: Can't create process thread\n");
+			CloseHandle(mEventHandle);
+			CloseHandle(mMutexHandle);
+			delete mWindowTitle;
+			return;
+		}
+
+		WaitForSingleObject(mEventHandle, INFINITE);
 	}
 
-	bool	IsPlotEnabled()
+	void	CloseWindow()
 	{
-		return mIsPlotEnabled;
+		if (mWindowState == WINDOW_OPEN_STATE)
+			PostMessage(mWindowH, WM_CLOSE, 0, 0);
 	}
 
-	void	EnablePlot()
+	bool	IsWindowOpen()
 	{
-		if (mIsPlotEnabled)
-			return;
+		if (mWindowState == WINDOW_OPEN_STATE)
+			return true;
 
-		CheckMenuItem(mMenuH, IDM_PLOT, MF_CHECKED);
-		mIsPlotEnabled = true;
+		return false;
 	}
 
-	void	DisablePlot()
+	bool	IsWindowClosed()
 	{
-		if (!mIsPlotEnabled)
-			return;
+		if (mWindowState == WINDOW_CLOSED_STATE)
+			return true;
 
-		CheckMenuItem(mMenuH, IDM_PLOT, MF_UNCHECKED);
-		mIsPlotEnabled = false;
+		return false;
 	}
 
+	bool	WaitForWindowClose(DWORD inTimeout = INFINITE)
+	{
+		if (mThreadHandle == NULL)
+			return false;
 
-	static void	FlipBitmap(BITMAPINFOHEADER *inBitmapInfo, unsigned char *inBitmapBits)
+		if (WaitForSingleObject(mThreadHandle, inTimeout) == WAIT_OBJECT_0)
+			return true;
+
+		return false;
+	}
+
+	static bool	WaitForWindowCloseMulti(ImageWindow *inWindowArray[], int inArrayLen,
+											bool inWaitAll = false, DWORD inTimeout = INFINITE)
 	{
-		if (inBitmapInfo == NULL)
+		std::vector< HANDLE >	handles;
+
+		for (int i = 0; i < inArrayLen; i++)
+			if (inWindowArray[i]->mThreadHandle != NULL)
+				handles.push_back(inWindowArray[i]->mThreadHandle);
+
+		if (WaitForMultipleObjects((DWORD )handles.size(), &(handles[0]), inWaitAll, inTimeout) == WAIT_TIMEOUT)
+			return false;
+
+		return true;
+	}
+
+	//	inIndex is an ImageWindowColormap index (BuiltinColormap or the index
+	//	returned by LoadColormap()). Only the 256-entry palette is copied, so
+	//	this is cheap enough to be called for every frame. The palette is
+	//	applied to 8-bit images and to 16-bit mono images shown through the
+	//	64K-entry colormap (see Enable16BitsColormap()).
+	void	SetColormap(int inIndex = 0)
+	{
+		const RGBQUAD	*palette = ImageWindowColormap::GetInstance()->GetPalette(inIndex);
+
+		if (palette == NULL)
+		{
+			printf("Error: Unknown colormap %d (SetColormap)\n", inIndex);
 			return;
-		if (inBitmapBits == NULL)
+		}
+		if (inIndex == mColormapIndex &&
+			memcmp(mColormapPalette, palette, sizeof(mColormapPalette)) == 0)
 			return;
 
-		unsigned char	*srcPtr, *dstPtr, tmp;
-		int	width = inBitmapInfo->biWidth;
-		int	height = abs(inBitmapInfo->biHeight);
+		CopyMemory(mColormapPalette, palette, sizeof(mColormapPalette));
+		mColormapIndex = inIndex;
+		mIsColormapTableValid = false;
+
+		if (mBitmapInfo == NULL)
+			return;
 
-		if (inBitmapInfo->biBitCount == 8)
+		if (mBitmapInfo->biBitCount == 8)
 		{
-			for (int y = 0; y < height / 2; y++)
-			{
-				srcPtr = &(inBitmapBits[width * y]);
-				dstPtr = &(inBitmapBits[width * (height - y - 1)]);
-				for (int x = 0; x < width; x++)
-				{
-					tmp = *dstPtr;
-					*dstPtr = *srcPtr;
-					*srcPtr = tmp;
-					srcPtr++;
-					dstPtr++;
-				}
-			}
+			ImageBitmapInfoMono8	*bitmapInfo = (ImageBitmapInfoMono8 *)mBitmapInfo;
+			CopyMemory(bitmapInfo->RGBQuad, mColormapPalette, sizeof(mColormapPalette));
+			return;
+		}
+
+		if (Is16BitsColormapImage())
+		{
+			mIsImageDispConverted = 0;
+			IncrementFrameGeneration();
+			UpdateImage();
+		}
+	}
+	int		GetColormap()
+	{
+		return mColormapIndex;
+	}
+	//	Loads a colormap file into the registry and selects it. Returns the
+	//	colormap index or -1 (see ImageWindowColormap::LoadColormap())
+	int		LoadColormap(const char *inFileName)
+	{
+		int	index = ImageWindowColormap::GetInstance()->LoadColormap(inFileName);
+
+		if (index >= 0)
+			SetColormap(index);
+		return index;
+	}
+	//	Shows 16-bit mono images through a 32-bit DIB, colored straight from
+	//	the 16-bit values with a 64K-entry BGRA table instead of being cut
+	//	down to 8 bits first. The table is rebuilt only when the colormap or
+	//	the map parameters change. Takes effect at the next frame in triple
+	//	buffer mode.
+	void	Enable16BitsColormap()
+	{
+		if (mIs16BitsColormapEnabled)
+			return;
+		mIs16BitsColormapEnabled = true;
+		Recreate16BitsImageDisp();
+	}
+	void	Disable16BitsColormap()
+	{
+		if (mIs16BitsColormapEnabled == false)
+			return;
+		mIs16BitsColormapEnabled = false;
+		Recreate16BitsImageDisp();
+	}
+	bool	Is16BitsColormapEnabled()
+	{
+		return mIs16BitsColormapEnabled;
+	}
+	// -------------------------------------------------------------------------
+	//	SetImageBufferPtr(...)
+	// -------------------------------------------------------------------------
+	//!	Displays the caller's buffer without copying it
+	/*!
+		The buffer is referenced, not copied, so it must stay valid until it
+		is replaced by another Set/Copy/Allocate call or the window object is
+		deleted. It is read whenever the window repaints or shows pixel
+		values, not only during this call. A 16-bit buffer is converted
+		directly into the 8-bit display buffer (at UpdateImage(), or at paint
+		time in lazy conversion mode); call UpdateImage() after changing its
+		contents.
+
+		inLineSize is the distance between two lines in bytes, so padded
+		camera buffers and sub-rectangles of a larger image can be shown as
+		they are. 0 means tightly packed lines. An 8 or 24-bit buffer whose
+		line size differs from the DIB line size (4-byte aligned) can't be
+		handed to GDI directly, it is repacked into the display buffer at
+		UpdateImage() instead.
+
+		inColorFormat selects the channel order of a color image (see
+		ColorFormat). 32-bit BGRA and RGBA buffers are displayed as they are.
+	*/
+	void	SetImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsColor, bool inIsBottomUp = false, bool inIs16Bits = false,
+							unsigned int inLineSize = 0, ColorFormat inColorFormat = COLOR_FORMAT_BGR)
+	{
+		DWORD	result;
+		bool	doUpdateSize;
+
+		if (IsColorFormatSupported(inIsColor, inIs16Bits, inColorFormat) == false)
+			return;
+		ResetImageSource();
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (SetMonoImageBufferPtr)\n");
+			return;
+		}
+
+		doUpdateSize = CreateBitmapInfo(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat);
+		DeleteFrameBuffers();
+		mIsImageDispConverted = 0;
+		if (inLineSize == 0)
+			inLineSize = GetPackedImageLineSize();
+
+		//	A 16-bit external buffer is converted (and a non DIB line size one
+		//	is repacked) straight into the display buffer, which is kept as
+		//	long as the size does not change
+		bool	isDirect = (inIs16Bits == false && inLineSize == GetBitmapLineSize());
+		if (mAllocatedImageBuffer != NULL &&
+			(isDirect != false || doUpdateSize != false))
+		{
+			FreeBuffer(mAllocatedImageBuffer);
+			mAllocatedImageBuffer = NULL;
+		}
+		if (mAllocated16BitsImageBuffer != NULL)
+		{
+			FreeBuffer(mAllocated16BitsImageBuffer);
+			mAllocated16BitsImageBuffer = NULL;
+		}
+
+		mExternal16BitsImageBuffer = NULL;
+		mExternalImageBuffer = NULL;
+		if (isDirect)
+		{
+			mBitmapBits = inImagePtr;
 		}
 		else
 		{
-			for (int y = 0; y < height / 2; y++)
+			if (mAllocatedImageBuffer == NULL)
+				CreateNewImageBuffer(true);
+			else
+				mBitmapBits = mAllocatedImageBuffer;
+			if (inIs16Bits)
 			{
-				srcPtr = &(inBitmapBits[width * 3 * y]);
-				dstPtr = &(inBitmapBits[width * 3 * (height - y - 1)]);
-				for (int x = 0; x < width * 3; x++)
-				{
-					tmp = *dstPtr;
-					*dstPtr = *srcPtr;
-					*srcPtr = tmp;
-					srcPtr++;
-					dstPtr++;
-				}
-			}			
+				mExternal16BitsImageBuffer = (unsigned short *)inImagePtr;
+				m16BitsImageLineSize = inLineSize;
+			}
+			else
+			{
+				mExternalImageBuffer = inImagePtr;
+				mExternalImageLineSize = inLineSize;
+			}
 		}
+		ReleaseMutex(mMutexHandle);
 
-		inBitmapInfo->biHeight *= -1;
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
 	}
 
-	bool	IsScrollable()
+	//	inLineSize sets the line size of an allocated 16-bit buffer (0 means
+	//	tightly packed). 8 and 24-bit buffers are displayed directly, so their
+	//	line size is always the DIB line size (see GetImageLineSize())
+	void	AllocateImageBuffer(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp = false, bool inIs16Bits = false,
+							unsigned int inLineSize = 0, ColorFormat inColorFormat = COLOR_FORMAT_BGR)
 	{
-			int	imageWidth = (int )(mImageSize.cx * mImageDispScale / 100.0);
-			int	imageHeight = (int )(mImageSize.cy * mImageDispScale / 100.0);
+		DWORD	result;
+		bool	doUpdateSize;
 
-			if (imageWidth > mImageDispSize.cx)
-				return true;
-			if (imageHeight > mImageDispSize.cy)
-				return true;
+		if (IsColorFormatSupported(inIsColor, inIs16Bits, inColorFormat) == false)
+			return;
+		ResetImageSource();
 
-			return false;
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (AllocateMonoImageBuffer)\n");
+			return;
+		}
+
+		doUpdateSize = PrepareImageBuffers(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat, inLineSize);
+
+		ReleaseMutex(mMutexHandle);
+		
+		if (doUpdateSize)
+			UpdateWindowSize();
 	}
 
-	void	SetDrawOverlayFunc(void (*inFunc)(ImageWindow *, HDC, void *), void *inFuncData)
+	//	inLineSize is the line size of inImage in bytes (0 means tightly
+	//	packed), the lines are copied into the window's own layout
+	void	CopyIntoImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsColor, bool inIsBottomUp = false, bool inIs16Bits = false,
+							unsigned int inLineSize = 0, ColorFormat inColorFormat = COLOR_FORMAT_BGR)
 	{
-		mDrawOverlayFunc = inFunc;
-		mOverlayFuncData = inFuncData;
-	}
+		DWORD	result;
+		bool	doUpdateSize;
 
+		if (IsColorFormatSupported(inIsColor, inIs16Bits, inColorFormat) == false)
+			return;
+		ResetImageSource();
 
-int					mImageClickNum;
-int					mLastImageClickX;
-int					mLastImageClickY;
-	
-//	HWND			GetWindowHandle() { return mWindowH; }
-	const BITMAPINFOHEADER	*GetBitmapInfo() { return mBitmapInfo; }
-	
-protected:
-	enum
+		if (EnterFrameProducer())
+		{
+			CopyIntoFrameBuffer(inWidth, inHeight, inImage, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat, inLineSize);
+			return;
+		}
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (AllocateMonoImageBuffer)\n");
+			return;
+		}
+
+		doUpdateSize = PrepareImageBuffers(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat, 0);
+		if (inLineSize == 0)
+			inLineSize = GetPackedImageLineSize();
+		CopyImageLines(GetImageBufferPtr(), GetImageLineSize(), inImage, inLineSize,
+						GetPackedImageLineSize(), abs(mBitmapInfo->biHeight));
+
+		ReleaseMutex(mMutexHandle);
+		
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
+	}
+
+	//	Copies a part of the image, for sources that deliver a band of lines
+	//	(or a tile) at a time. The image must have been set up by a
+	//	CopyInto...() call. inY counts the lines in the order they were given
+	//	to CopyIntoImageBuffer(), inImage holds inHeight lines of inWidth
+	//	pixels in the same format (inLineSize 0 means packed). Only the region
+	//	is converted and only its part of the screen is repainted. The auto
+	//	window/level is left for the next full frame.
+	void	UpdateImageRegion(int inX, int inY, int inWidth, int inHeight, const unsigned char *inImage,
+							unsigned int inLineSize = 0)
 	{
-		IDM_SAVE	=	100,
-		IDM_SAVE_AS,
-		IDM_PROPERTY,
-		IDM_CLOSE,
-		IDM_UNDO,
-		IDM_CUT,
+		DWORD	result;
+
+		if (mBitmapInfo == NULL || mBitmapBits == NULL)
+		{
+			printf("Error: No image to update (UpdateImageRegion)\n");
+			return;
+		}
+		if (inX < 0 || inY < 0 || inWidth <= 0 || inHeight <= 0 ||
+			inX + inWidth > mBitmapInfo->biWidth || inY + inHeight > abs(mBitmapInfo->biHeight))
+		{
+			printf("Error: Invalid region (UpdateImageRegion)\n");
+			return;
+		}
+		if (mIsTripleBufferEnabled || mExternalImageBuffer != NULL || mExternal16BitsImageBuffer != NULL ||
+			mIsBayerImage || mIsYUVImage || mIsFloatImage || mIsWaterfallEnabled)
+		{
+			printf("Error: Unsupported image source (UpdateImageRegion)\n");
+			return;
+		}
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (UpdateImageRegion)\n");
+			return;
+		}
+
+		CopyImageRegion(inX, inY, inWidth, inHeight, inImage, inLineSize);
+
+		ReleaseMutex(mMutexHandle);
+
+		//	The pixel readout follows at the paint of the region (see DrawImage())
+		if (IsWindowOpen() == false)
+			return;
+		InterlockedExchange(&mIsReadoutPending, 1);
+		UpdateImageRegionDisp(inX, inY, inWidth, inHeight);
+	}
+
+	bool	IsWaterfallEnabled()
+	{
+		return mIsWaterfallEnabled;
+	}
+	//	Sets up an empty inWidth x inHeight image that AppendWaterfallLines()
+	//	scrolls up. The buffer is used as a ring, the top line is an offset
+	//	into it, so appending only copies the new lines. Any CopyInto...()
+	//	call ends the waterfall.
+	void	EnableWaterfall(int inWidth, int inHeight, bool inIsColor = false, bool inIs16Bits = false)
+	{
+		DWORD	result;
+		bool	doUpdateSize;
+
+		if (inWidth <= 0 || inHeight <= 0)
+		{
+			printf("Error: Invalid image size (EnableWaterfall)\n");
+			return;
+		}
+		if (mIsTripleBufferEnabled)
+		{
+			printf("Error: Not supported with the triple buffer (EnableWaterfall)\n");
+			return;
+		}
+		ResetImageSource();
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (EnableWaterfall)\n");
+			return;
+		}
+
+		doUpdateSize = PrepareImageBuffers(inWidth, inHeight, inIsColor, false, inIs16Bits, COLOR_FORMAT_BGR, 0);
+		if (mBitmapBits != NULL)
+			ZeroMemory(mBitmapBits, GetBitmapLineSize() * inHeight);
+		if (mIs16BitsImage && Get16BitsImageBufferPtr() != NULL)
+			ZeroMemory(Get16BitsImageBufferPtr(), m16BitsImageLineSize * inHeight);
+		mIsWaterfallEnabled = true;
+		mWaterfallTopLine = 0;
+
+		ReleaseMutex(mMutexHandle);
+
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
+	}
+	//	The lines are put back in display order, the image stays as it is
+	void	DisableWaterfall()
+	{
+		DWORD	result;
+
+		if (mIsWaterfallEnabled == false)
+			return;
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (DisableWaterfall)\n");
+			return;
+		}
+
+		int	height = abs(mBitmapInfo->biHeight);
+		RotateImageLines(mBitmapBits, GetBitmapLineSize(), height, mWaterfallTopLine);
+		if (mIs16BitsImage)
+			RotateImageLines((unsigned char *)Get16BitsImageBufferPtr(), m16BitsImageLineSize, height,
+							mWaterfallTopLine);
+		mIsWaterfallEnabled = false;
+		mWaterfallTopLine = 0;
+
+		ReleaseMutex(mMutexHandle);
+		UpdateImage();
+	}
+	//	Adds inLineNum lines at the bottom, the oldest lines go out at the top.
+	//	The lines are in the format given to EnableWaterfall() (inLineSize 0
+	//	means packed). Only the new lines are copied and converted, and the
+	//	window is invalidated once until it has been painted. Nothing is
+	//	sent to the window thread.
+	void	AppendWaterfallLines(const unsigned char *inLines, int inLineNum, unsigned int inLineSize = 0)
+	{
+		DWORD	result;
+
+		if (mIsWaterfallEnabled == false)
+		{
+			printf("Error: The waterfall is not enabled (AppendWaterfallLines)\n");
+			return;
+		}
+		if (inLines == NULL || inLineNum <= 0)
+			return;
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (AppendWaterfallLines)\n");
+			return;
+		}
+
+		int	width = mBitmapInfo->biWidth;
+		int	height = abs(mBitmapInfo->biHeight);
+		if (inLineSize == 0)
+			inLineSize = GetPackedImageLineSize();
+
+		//	Only the last height lines can be seen
+		if (inLineNum > height)
+		{
+			inLines += (size_t )inLineSize * (inLineNum - height);
+			inLineNum = height;
+		}
+
+		//	The new lines take the place of the oldest ones, from the top line
+		//	on, wrapping to the first buffer line
+		int	lineNum = height - mWaterfallTopLine;
+		if (lineNum > inLineNum)
+			lineNum = inLineNum;
+		CopyImageRegion(0, mWaterfallTopLine, width, lineNum, inLines, inLineSize);
+		if (lineNum < inLineNum)
+			CopyImageRegion(0, 0, width, inLineNum - lineNum, inLines + (size_t )inLineSize * lineNum, inLineSize);
+		mWaterfallTopLine = (mWaterfallTopLine + inLineNum) % height;
+
+		ReleaseMutex(mMutexHandle);
+
+		//	The pixel readout follows at the paint (see DrawImage())
+		if (IsWindowOpen() == false)
+			return;
+		if (InterlockedExchange(&mIsWaterfallPaintPending, 1) == 0)
+			UpdateImageDisp();
+	}
+
+	void	SetMonoImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		SetImageBufferPtr(inWidth, inHeight, inImagePtr, false, inIsBottomUp, false, inLineSize);
+	}
+
+	void	AllocateMonoImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		AllocateImageBuffer(inWidth, inHeight, false, inIsBottomUp, false, inLineSize);
+	}
+
+	void	CopyIntoMonoImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		CopyIntoImageBuffer(inWidth, inHeight, inImage, false, inIsBottomUp, false, inLineSize);
+	}
+
+	void	Set16BitsMonoImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		SetImageBufferPtr(inWidth, inHeight, inImagePtr, false, inIsBottomUp, true, inLineSize);
+	}
+
+	void	Allocate16BitsMonoImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		AllocateImageBuffer(inWidth, inHeight, false, inIsBottomUp, true, inLineSize);
+	}
+
+	void	CopyInto16BitsMonoImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		CopyIntoImageBuffer(inWidth, inHeight, inImage, false, inIsBottomUp, true, inLineSize);
+	}
+
+	void	SetColorImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		SetImageBufferPtr(inWidth, inHeight, inImagePtr, true, inIsBottomUp, false, inLineSize);
+	}
+
+	void	AllocateColorImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		AllocateImageBuffer(inWidth, inHeight, true, inIsBottomUp, false, inLineSize);
+	}
+	void	CopyIntoColorImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		CopyIntoImageBuffer(inWidth, inHeight, inImage, true, inIsBottomUp, false, inLineSize);
+	}
+
+	void	SetBGRAImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		SetImageBufferPtr(inWidth, inHeight, inImagePtr, true, inIsBottomUp, false, inLineSize, COLOR_FORMAT_BGRA);
+	}
+
+	void	AllocateBGRAImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		AllocateImageBuffer(inWidth, inHeight, true, inIsBottomUp, false, inLineSize, COLOR_FORMAT_BGRA);
+	}
+
+	void	CopyIntoBGRAImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		CopyIntoImageBuffer(inWidth, inHeight, inImage, true, inIsBottomUp, false, inLineSize, COLOR_FORMAT_BGRA);
+	}
+
+	void	SetRGBAImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		SetImageBufferPtr(inWidth, inHeight, inImagePtr, true, inIsBottomUp, false, inLineSize, COLOR_FORMAT_RGBA);
+	}
+
+	void	AllocateRGBAImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		AllocateImageBuffer(inWidth, inHeight, true, inIsBottomUp, false, inLineSize, COLOR_FORMAT_RGBA);
+	}
+
+	void	CopyIntoRGBAImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		CopyIntoImageBuffer(inWidth, inHeight, inImage, true, inIsBottomUp, false, inLineSize, COLOR_FORMAT_RGBA);
+	}
+
+	//	RGB48 (16 bits per channel, R first). It is converted to the 24-bit
+	//	display buffer like 16-bit mono images, see SetColorWindowLevel()
+	void	Set48BitsColorImageBufferPtr(int inWidth, int inHeight, unsigned char *inImagePtr, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		SetImageBufferPtr(inWidth, inHeight, inImagePtr, true, inIsBottomUp, true, inLineSize, COLOR_FORMAT_RGB);
+	}
+
+	void	Allocate48BitsColorImageBuffer(int inWidth, int inHeight, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		AllocateImageBuffer(inWidth, inHeight, true, inIsBottomUp, true, inLineSize, COLOR_FORMAT_RGB);
+	}
+
+	void	CopyInto48BitsColorImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		CopyIntoImageBuffer(inWidth, inHeight, inImage, true, inIsBottomUp, true, inLineSize, COLOR_FORMAT_RGB);
+	}
+
+	// -------------------------------------------------------------------------
+	//	CopyIntoPackedMonoImageBuffer(...)
+	// -------------------------------------------------------------------------
+	//!	Unpacks a Mono10p/Mono12p/Mono12Packed image
+	/*!
+		The image is handled as a 16-bit mono image holding the sensor values,
+		so the pixel readouts show the true values and SetMapMode() and
+		SetWindowLevel() take sensor values. Each line is unpacked and
+		converted to the display buffer in one pass.
+
+		inLineSize is the line size of inImage in bytes. 0 means one
+		continuous pixel stream, in which lines do not have to start on a
+		byte boundary. Without a display mapping the full 10 or 12-bit range
+		is shown (see Get16BitsImageBitDepth()).
+	*/
+	void	CopyIntoPackedMonoImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, PackedFormat inFormat,
+							bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		DWORD	result;
+		bool	doUpdateSize = false;
+		int		bitDepth = (inFormat == PACKED_FORMAT_MONO10P) ? 10 : 12;
+
+		if (EnterFrameProducer())
+		{
+			//	The frame is converted with the new bit depth and published after it
+			ResetImageSource(bitDepth);
+			if (IsFrameBufferCompatible(inWidth, inHeight, false, inIsBottomUp, true, COLOR_FORMAT_BGR) == false)
+			{
+				result = WaitForSingleObject(mMutexHandle, INFINITE);
+				if (result != WAIT_OBJECT_0)
+				{
+					printf("Error: WaitForSingleObject failed (CopyIntoPackedMonoImageBuffer)\n");
+					LeaveFrameProducer();
+					return;
+				}
+				doUpdateSize = PrepareFrameBuffers(inWidth, inHeight, false, inIsBottomUp, true, COLOR_FORMAT_BGR);
+				ReleaseMutex(mMutexHandle);
+				if (mFrameBuffers[0].ImageBuffer == NULL)
+				{
+					LeaveFrameProducer();
+					return;
+				}
+			}
+
+			//	Only the producer changes the producer index, no need to lock here
+			ImageFrameBuffer	*frameBuffer = &(mFrameBuffers[mFrameBufferState & 0x03]);
+			UnpackImage(inImage, inLineSize, inFormat, frameBuffer->ImageBuffer16Bits,
+						mIsLazyConversionEnabled ? NULL : frameBuffer->ImageBuffer);
+			PublishFrameBuffer();
+			LeaveFrameProducer();
+		}
+		else
+		{
+			result = WaitForSingleObject(mMutexHandle, INFINITE);
+			if (result != WAIT_OBJECT_0)
+			{
+				printf("Error: WaitForSingleObject failed (CopyIntoPackedMonoImageBuffer)\n");
+				return;
+			}
+			ResetImageSource(bitDepth);
+			doUpdateSize = PrepareImageBuffers(inWidth, inHeight, false, inIsBottomUp, true, COLOR_FORMAT_BGR, 0);
+			if (mIsLazyConversionEnabled == false)
+			{
+				UnpackImage(inImage, inLineSize, inFormat, mAllocated16BitsImageBuffer, mAllocatedImageBuffer);
+				//	UpdateImage() does not have to convert this frame again
+				InterlockedExchange(&mIsImageDispConverted, 1);
+			}
+			else
+				UnpackImage(inImage, inLineSize, inFormat, mAllocated16BitsImageBuffer, NULL);
+			ReleaseMutex(mMutexHandle);
+		}
+
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
+	}
+
+	// -------------------------------------------------------------------------
+	//	CopyIntoBayerImageBuffer(...)
+	// -------------------------------------------------------------------------
+	//!	Demosaics a raw Bayer image (BayerXX8 or BayerXX16) into a color image
+	/*!
+		An 8-bit image is demosaiced straight into the 24-bit display buffer.
+		A 16-bit image becomes a 48-bit color image (so the readouts show the
+		sensor values and SetColorWindowLevel() can be used) and each line is
+		converted to the display buffer right after it is demosaiced. The
+		lines are split over the worker threads.
+
+		The demosaic method is set with SetDemosaicMode(). inLineSize is the
+		line size of inImage in bytes (0 means tightly packed).
+	*/
+	void	CopyIntoBayerImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, BayerPattern inPattern,
+							bool inIsBottomUp = false, bool inIs16Bits = false, unsigned int inLineSize = 0)
+	{
+		DWORD	result;
+		bool	doUpdateSize = false;
+
+		ResetImageSource();
+		if (inLineSize == 0)
+			inLineSize = inWidth * (inIs16Bits ? 2 : 1);
+
+		if (EnterFrameProducer())
+		{
+			if (IsFrameBufferCompatible(inWidth, inHeight, true, inIsBottomUp, inIs16Bits, COLOR_FORMAT_BGR) == false)
+			{
+				result = WaitForSingleObject(mMutexHandle, INFINITE);
+				if (result != WAIT_OBJECT_0)
+				{
+					printf("Error: WaitForSingleObject failed (CopyIntoBayerImageBuffer)\n");
+					LeaveFrameProducer();
+					return;
+				}
+				doUpdateSize = PrepareFrameBuffers(inWidth, inHeight, true, inIsBottomUp, inIs16Bits, COLOR_FORMAT_BGR);
+				ReleaseMutex(mMutexHandle);
+				if (mFrameBuffers[0].ImageBuffer == NULL)
+				{
+					LeaveFrameProducer();
+					return;
+				}
+			}
+
+			//	Only the producer changes the producer index, no need to lock here
+			ImageFrameBuffer	*frameBuffer = &(mFrameBuffers[mFrameBufferState & 0x03]);
+			DemosaicImage(inImage, inLineSize, inPattern, NULL, frameBuffer->ImageBuffer16Bits,
+						(inIs16Bits && mIsLazyConversionEnabled) ? NULL : frameBuffer->ImageBuffer);
+			PublishFrameBuffer();
+			LeaveFrameProducer();
+		}
+		else
+		{
+			result = WaitForSingleObject(mMutexHandle, INFINITE);
+			if (result != WAIT_OBJECT_0)
+			{
+				printf("Error: WaitForSingleObject failed (CopyIntoBayerImageBuffer)\n");
+				return;
+			}
+			doUpdateSize = PrepareImageBuffers(inWidth, inHeight, true, inIsBottomUp, inIs16Bits, COLOR_FORMAT_BGR, 0);
+
+			//	The raw image is kept for SetDemosaicMode()
+			unsigned int	rawSize = inWidth * (inIs16Bits ? 2 : 1) * inHeight;
+			if (mBayerImageBuffer != NULL && mBayerImageBufferSize != rawSize)
+			{
+				FreeBuffer(mBayerImageBuffer);
+				mBayerImageBuffer = NULL;
+			}
+			if (mBayerImageBuffer == NULL)
+			{
+				mBayerImageBuffer = (unsigned char *)AllocateBuffer(rawSize);
+				mBayerImageBufferSize = rawSize;
+				if (mBayerImageBuffer == NULL)
+					printf("Error: Can't allocate mBayerImageBuffer (CopyIntoBayerImageBuffer)\n");
+			}
+
+			DemosaicImage(inImage, inLineSize, inPattern, mBayerImageBuffer, mAllocated16BitsImageBuffer,
+						(inIs16Bits && mIsLazyConversionEnabled) ? NULL : mAllocatedImageBuffer);
+			if (inIs16Bits && mIsLazyConversionEnabled == false)
+				InterlockedExchange(&mIsImageDispConverted, 1);
+			mIsBayerImage = (mBayerImageBuffer != NULL);
+			mBayerPattern = inPattern;
+			ReleaseMutex(mMutexHandle);
+		}
+
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
+	}
+	void	CopyInto16BitsBayerImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, BayerPattern inPattern,
+							bool inIsBottomUp = false, unsigned int inLineSize = 0)
+	{
+		CopyIntoBayerImageBuffer(inWidth, inHeight, inImage, inPattern, inIsBottomUp, true, inLineSize);
+	}
+
+	// -------------------------------------------------------------------------
+	//	CopyIntoYUVImageBuffer(...)
+	// -------------------------------------------------------------------------
+	//!	Converts a YUYV, NV12 or I420 image into a 24-bit color image
+	/*!
+		inLineSize is the line size of the Y plane (of the YUYV image) in
+		bytes, 0 means tightly packed. The chroma planes follow the Y plane:
+		NV12 has one UV plane with the same line size, I420 has a U and a V
+		plane with half of it.
+
+		In lazy conversion mode the image is kept as it is and only the tiles
+		that are visible are converted at paint time, so a zoomed in view of
+		a large stream only costs the visible part. Otherwise (and in triple
+		buffer mode) the whole image is converted on the worker threads.
+	*/
+	void	CopyIntoYUVImageBuffer(int inWidth, int inHeight, const unsigned char *inImage, YUVFormat inFormat,
+							unsigned int inLineSize = 0)
+	{
+		DWORD	result;
+		bool	doUpdateSize = false;
+
+		ResetImageSource();
+		if (inLineSize == 0)
+			inLineSize = (inFormat == YUV_FORMAT_YUYV) ? (inWidth + 1) / 2 * 4 : inWidth;
+
+		if (EnterFrameProducer())
+		{
+			if (IsFrameBufferCompatible(inWidth, inHeight, true, false, false, COLOR_FORMAT_BGR) == false)
+			{
+				result = WaitForSingleObject(mMutexHandle, INFINITE);
+				if (result != WAIT_OBJECT_0)
+				{
+					printf("Error: WaitForSingleObject failed (CopyIntoYUVImageBuffer)\n");
+					LeaveFrameProducer();
+					return;
+				}
+				doUpdateSize = PrepareFrameBuffers(inWidth, inHeight, true, false, false, COLOR_FORMAT_BGR);
+				ReleaseMutex(mMutexHandle);
+				if (mFrameBuffers[0].ImageBuffer == NULL)
+				{
+					LeaveFrameProducer();
+					return;
+				}
+			}
+
+			//	Only the producer changes the producer index, no need to lock here
+			ImageFrameBuffer	*frameBuffer = &(mFrameBuffers[mFrameBufferState & 0x03]);
+			ConvertYUVImage(inImage, inLineSize, inFormat, frameBuffer->ImageBuffer);
+			PublishFrameBuffer();
+			LeaveFrameProducer();
+		}
+		else
+		{
+			result = WaitForSingleObject(mMutexHandle, INFINITE);
+			if (result != WAIT_OBJECT_0)
+			{
+				printf("Error: WaitForSingleObject failed (CopyIntoYUVImageBuffer)\n");
+				return;
+			}
+			doUpdateSize = PrepareImageBuffers(inWidth, inHeight, true, false, false, COLOR_FORMAT_BGR, 0);
+
+			unsigned int	size = GetYUVImageSize(inLineSize, inHeight, inFormat);
+			if (mIsLazyConversionEnabled && PrepareYUVImageBuffer(size))
+			{
+				CopyMemory(mYUVImageBuffer, inImage, size);
+				mYUVFormat = inFormat;
+				mYUVImageLineSize = inLineSize;
+				mIsYUVImage = true;
+				//	Makes all tiles dirty even if the window isn't open
+				IncrementFrameGeneration();
+			}
+			else
+				ConvertYUVImage(inImage, inLineSize, inFormat, mAllocatedImageBuffer);
+			ReleaseMutex(mMutexHandle);
+		}
+
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
+	}
+
+	// -------------------------------------------------------------------------
+	//	CopyIntoFloatImageBuffer(...)
+	// -------------------------------------------------------------------------
+	//!	Copies a 32-bit float mono image
+	/*!
+		The float values are kept for the pixel readout (and SaveBitmapFile()
+		saves the 8-bit display image). They are mapped to 8 bits with
+		SetFloatWindowLevel(), or by default with the finite min/max range of
+		the frame, which is taken while the frame is copied. NaN and -Inf
+		are shown as 0 and +Inf as 255.
+
+		inLineSize is the line size of inImage in bytes (0 means tightly
+		packed). Float images don't use the triple buffer.
+	*/
+	void	CopyIntoFloatImageBuffer(int inWidth, int inHeight, const float *inImage, bool inIsBottomUp = false,
+							unsigned int inLineSize = 0)
+	{
+		DWORD	result;
+		bool	doUpdateSize;
+
+		ResetImageSource();
+		if (inLineSize == 0)
+			inLineSize = inWidth * sizeof(float);
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (CopyIntoFloatImageBuffer)\n");
+			return;
+		}
+		doUpdateSize = PrepareImageBuffers(inWidth, inHeight, false, inIsBottomUp, false, COLOR_FORMAT_BGR, 0);
+
+		unsigned int	size = inWidth * inHeight * sizeof(float);
+		if (mFloatImageBuffer != NULL && mFloatImageBufferSize < size)
+		{
+			FreeBuffer(mFloatImageBuffer);
+			mFloatImageBuffer = NULL;
+		}
+		if (mFloatImageBuffer == NULL)
+		{
+			mFloatImageBuffer = (float *)AllocateBuffer(size);
+			mFloatImageBufferSize = size;
+			if (mFloatImageBuffer == NULL)
+			{
+				ReleaseMutex(mMutexHandle);
+				printf("Error: Can't allocate mFloatImageBuffer (CopyIntoFloatImageBuffer)\n");
+				return;
+			}
+		}
+
+		CopyFloatImage(inImage, inLineSize);
+		mIsFloatImage = true;
+		UpdateFloatImageDisp();
+		InterlockedExchange(&mIsImageDispConverted, 1);
+		ReleaseMutex(mMutexHandle);
+
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
+	}
+	bool	IsFloatImage()
+	{
+		return mIsFloatImage;
+	}
+	float	*GetFloatImageBufferPtr()
+	{
+		if (mIsFloatImage == false)
+			return NULL;
+		return mFloatImageBuffer;
+	}
+	//	Finite min/max of the current float image. false if it has no finite value
+	bool	GetFloatImageRange(float *outMinValue, float *outMaxValue)
+	{
+		if (mIsFloatImage == false || mFloatMinValue > mFloatMaxValue)
+			return false;
+
+		*outMinValue = mFloatMinValue;
+		*outMaxValue = mFloatMaxValue;
+		return true;
+	}
+	//	inBottomValue is mapped to 0 and inTopValue to 255. Disables the auto range
+	void	SetFloatWindowLevel(float inBottomValue, float inTopValue)
+	{
+		mIsFloatAutoRange = false;
+		mFloatBottomValue = inBottomValue;
+		mFloatTopValue = inTopValue;
+		if (mIsFloatImage)
+			UpdateImage();
+	}
+	bool	IsFloatAutoRangeEnabled()
+	{
+		return mIsFloatAutoRange;
+	}
+	void	EnableFloatAutoRange()
+	{
+		mIsFloatAutoRange = true;
+		if (mIsFloatImage)
+			UpdateImage();
+	}
+	void	DisableFloatAutoRange()
+	{
+		mIsFloatAutoRange = false;
+	}
+	YUVMatrix	GetYUVMatrix()
+	{
+		return mYUVMatrix;
+	}
+	//	Used from the next frame, or right away for a lazily converted image
+	void	SetYUVMatrix(YUVMatrix inMatrix)
+	{
+		mYUVMatrix = inMatrix;
+		if (mIsYUVImage)
+			UpdateImage();
+	}
+	DemosaicMode	GetDemosaicMode()
+	{
+		return mDemosaicMode;
+	}
+	//	DEMOSAIC_MODE_BILINEAR is fast enough for every frame of a stream.
+	//	DEMOSAIC_MODE_HIGH_QUALITY is meant for paused streams: switching
+	//	demosaics the current Bayer image again from the raw data it was
+	//	made from (not in triple buffer mode, where the raw data isn't kept).
+	void	SetDemosaicMode(DemosaicMode inMode)
+	{
+		DWORD	result;
+
+		if (mDemosaicMode == inMode)
+			return;
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (SetDemosaicMode)\n");
+			return;
+		}
+
+		mDemosaicMode = inMode;
+		bool	isUpdated = (mIsBayerImage && mIsTripleBufferEnabled == false);
+		if (isUpdated)
+		{
+			DemosaicImage(mBayerImageBuffer, mBitmapInfo->biWidth * (mIs16BitsImage ? 2 : 1), mBayerPattern,
+						NULL, mAllocated16BitsImageBuffer,
+						(mIs16BitsImage && mIsLazyConversionEnabled) ? NULL : mAllocatedImageBuffer);
+			if (mIs16BitsImage && mIsLazyConversionEnabled == false)
+				InterlockedExchange(&mIsImageDispConverted, 1);
+		}
+
+		ReleaseMutex(mMutexHandle);
+		if (isUpdated)
+			UpdateImage();
+	}
+	//	Significant bits of the 16-bit image (16 unless a packed image is shown)
+	int		Get16BitsImageBitDepth()
+	{
+		return m16BitsImageBitDepth;
+	}
+	void	SetMapMode(unsigned short inMapBottomValue, unsigned short inMapTopValue,
+						bool inIsMapReverse, unsigned short inDirectMapLimit)
+	{
+		if (mIs16BitsImage == false)
+			return;
+		mIsAutoWindowLevelEnabled = false;
+
+		//	The 64K-entry table is rebuilt only when the map parameters change
+		bool	doUpdateTable = (mIsMapTableValid == false ||
+								 mMapBottomValue != inMapBottomValue ||
+								 mMapTopValue != inMapTopValue ||
+								 mIsMapReverse != inIsMapReverse ||
+								 mMapDirectMapLimit != inDirectMapLimit);
+
+		mIsMapModeEnabled = true;
+		mIsMapLinear = false;
+		mIsMapPerChannel = false;
+		mIsImageDispConverted = 0;
+		mMapBottomValue = inMapBottomValue;
+		mMapTopValue = inMapTopValue;
+		mIsMapReverse = inIsMapReverse;
+		mMapDirectMapLimit = inDirectMapLimit;
+		if (doUpdateTable)
+			UpdateMapTable();
+
+		UpdateImage();
+	}
+	//	Plain linear window/level. Unlike SetMapMode() this has no direct map
+	//	range and is converted with the SIMD kernel instead of the 64K table
+	void	SetWindowLevel(unsigned short inBottomValue, unsigned short inTopValue)
+	{
+		if (mIs16BitsImage == false)
+			return;
+		mIsAutoWindowLevelEnabled = false;
+
+		if (mMapBottomValue != inBottomValue || mMapTopValue != inTopValue ||
+			mIsMapReverse != false || mMapDirectMapLimit != 0)
+			mIsMapTableValid = false;
+
+		mIsMapModeEnabled = true;
+		mIsMapLinear = true;
+		mIsMapPerChannel = false;
+		mIsImageDispConverted = 0;
+		mMapBottomValue = inBottomValue;
+		mMapTopValue = inTopValue;
+		mIsMapReverse = false;
+		mMapDirectMapLimit = 0;
+
+		UpdateImage();
+	}
+	//	Linear window/level with one window per channel of a 48-bit color
+	//	image. The values are given in R, G, B order.
+	void	SetColorWindowLevel(const unsigned short inBottomValues[3], const unsigned short inTopValues[3])
+	{
+		if (mIs16BitsImage == false || mIsColorImage == false)
+			return;
+
+		mIsAutoWindowLevelEnabled = false;
+		mIsMapTableValid = false;
+		mIsMapModeEnabled = true;
+		mIsMapLinear = true;
+		mIsMapPerChannel = true;
+		mIsImageDispConverted = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			mMapBottomValues[i] = inBottomValues[i];
+			mMapTopValues[i] = inTopValues[i];
+		}
+		mIsMapReverse = false;
+		mMapDirectMapLimit = 0;
+
+		UpdateImage();
+	}
+	ColorFormat	GetColorFormat()
+	{
+		return mColorFormat;
+	}
+	void	DisableMapMode()
+	{
+		mIsMapModeEnabled = false;
+		mIsAutoWindowLevelEnabled = false;
+	}
+	// -------------------------------------------------------------------------
+	//	EnableAutoWindowLevel(...)
+	// -------------------------------------------------------------------------
+	//!	Sets the window of every 16-bit frame from its histogram
+	/*!
+		inLowPercent and inHighPercent of the samples are below the bottom
+		and the top of the window. The histogram is taken from a strided
+		subsample of the frame (at most IMAGE_AUTO_WL_SAMPLE_NUM samples)
+		just before it is converted. inSmoothing is the weight of the
+		previous window (0 follows every frame, 0.9 changes slowly) so that
+		the display doesn't flicker. SetMapMode(), SetWindowLevel(),
+		SetColorWindowLevel() and DisableMapMode() turn it off.
+	*/
+	void	EnableAutoWindowLevel(double inLowPercent = 1.0, double inHighPercent = 99.0,
+								double inSmoothing = 0.8)
+	{
+		if (inLowPercent < 0)
+			inLowPercent = 0;
+		if (inHighPercent > 100)
+			inHighPercent = 100;
+		if (inHighPercent < inLowPercent)
+			inHighPercent = inLowPercent;
+		if (inSmoothing < 0)
+			inSmoothing = 0;
+		if (inSmoothing > 0.99)
+			inSmoothing = 0.99;
+
+		mAutoWindowLevelLowPercent = inLowPercent;
+		mAutoWindowLevelHighPercent = inHighPercent;
+		mAutoWindowLevelSmoothing = inSmoothing;
+		mIsAutoWindowLevelValid = false;
+		mAutoWindowLevelGeneration = 0;
+		mIsAutoWindowLevelEnabled = true;
+		mIsImageDispConverted = 0;
+		UpdateImage();
+	}
+	void	DisableAutoWindowLevel()
+	{
+		mIsAutoWindowLevelEnabled = false;
+	}
+	bool	IsAutoWindowLevelEnabled()
+	{
+		return mIsAutoWindowLevelEnabled;
+	}
+	//	The current window of 16-bit images, set by the caller or by the
+	//	auto window/level
+	void	GetWindowLevel(unsigned short *outBottomValue, unsigned short *outTopValue)
+	{
+		*outBottomValue = mMapBottomValue;
+		*outTopValue = mMapTopValue;
+	}
+	int		GetWorkerThreadNum()
+	{
+		if (mWorkerThreadNum > 0)
+			return mWorkerThreadNum;
+
+		SYSTEM_INFO	systemInfo;
+		GetSystemInfo(&systemInfo);
+		if (systemInfo.dwNumberOfProcessors > IMAGE_THREAD_NUM_MAX)
+			return IMAGE_THREAD_NUM_MAX;
+		return (int )systemInfo.dwNumberOfProcessors;
+	}
+	//	inThreadNum = 0 uses all the processors, 1 disables the worker threads.
+	//	Waits for a running RunLineBands() before the pool is deleted
+	void	SetWorkerThreadNum(int inThreadNum)
+	{
+		if (inThreadNum < 0)
+			inThreadNum = 0;
+		if (inThreadNum > IMAGE_THREAD_NUM_MAX)
+			inThreadNum = IMAGE_THREAD_NUM_MAX;
+
+		DWORD	result = WaitForSingleObject(mThreadPoolMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (SetWorkerThreadNum)\n");
+			return;
+		}
+
+		mWorkerThreadNum = inThreadNum;
+		if (mThreadPool != NULL)
+		{
+			delete mThreadPool;
+			mThreadPool = NULL;
+		}
+
+		ReleaseMutex(mThreadPoolMutexHandle);
+	}
+	//	Frames smaller than inSize bytes are processed on the caller's thread only
+	void	SetParallelMinSize(unsigned int inSize)
+	{
+		mParallelMinSize = inSize;
+	}
+	bool	IsLazyConversionEnabled()
+	{
+		return mIsLazyConversionEnabled;
+	}
+	//	In lazy conversion mode, 16-bit images are converted to 8 bits at
+	//	paint time, and only the tiles that are visible. Tiles that are not
+	//	visible stay dirty until they come back into view.
+	void	EnableLazyConversion()
+	{
+		mIsLazyConversionEnabled = true;
+		IncrementFrameGeneration();
+	}
+	void	DisableLazyConversion()
+	{
+		if (mIsLazyConversionEnabled == false)
+			return;
+
+		ConvertAllDirtyTiles();
+		mIsLazyConversionEnabled = false;
+	}
+	//	Bytes of image, bitmap info and pyramid buffers this window holds in
+	//	ImageWindowBufferPool
+	unsigned __int64	GetBufferMemorySize()
+	{
+		return mBufferMemorySize;
+	}
+	bool	IsPyramidEnabled()
+	{
+		return mIsPyramidEnabled;
+	}
+	//	When zoomed out to 50% or less, paint uses an area-averaged 1/2, 1/4,
+	//	... image instead of the full resolution one. Levels are built on
+	//	demand from the previous level and kept until the frame changes.
+	void	EnablePyramid()
+	{
+		mIsPyramidEnabled = true;
+		UpdateImageDisp();
+	}
+	void	DisablePyramid()
+	{
+		DWORD	result;
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (DisablePyramid)\n");
+			return;
+		}
+
+		mIsPyramidEnabled = false;
+		DeletePyramid();
+
+		ReleaseMutex(mMutexHandle);
+		UpdateImageDisp();
+	}
+	bool	IsRenderCoalescingEnabled()
+	{
+		return mIsRenderCoalescingEnabled;
+	}
+	//	Caps painting and status bar updates at the present rate. UpdateImage()
+	//	then returns immediately and frames that arrive between two
+	//	presentations are counted but not drawn.
+	void	EnableRenderCoalescing()
+	{
+		mIsRenderCoalescingEnabled = true;
+	}
+	void	DisableRenderCoalescing()
+	{
+		mIsRenderCoalescingEnabled = false;
+	}
+	//	0 means the display refresh rate
+	void	SetPresentRate(double inRate)
+	{
+		if (inRate < 0)
+			inRate = 0;
+		mPresentRate = inRate;
+	}
+	double	GetPresentRate()
+	{
+		if (mPresentRate > 0)
+			return mPresentRate;
+		return mDisplayRefreshRate;
+	}
+	unsigned __int64	GetCoalescedFrameNum()
+	{
+		return mCoalescedFrameNum;
+	}
+	bool	IsTripleBufferEnabled()
+	{
+		return mIsTripleBufferEnabled;
+	}
+	//	In triple buffer mode, CopyIntoImageBuffer() writes into a producer slot
+	//	and publishes it without taking mMutexHandle. WM_PAINT always picks up
+	//	the newest published frame, older unpainted frames are overwritten.
+	//	The mutex is only taken when the image size or format changes.
+	void	EnableTripleBuffer()
+	{
+		mIsTripleBufferEnabled = true;
+	}
+	//	Can be called while a producer is running, a frame in flight is
+	//	finished (and published) before the slots are freed. Later frames take
+	//	the mutex path.
+	void	DisableTripleBuffer()
+	{
+		DWORD	result;
+
+		mIsTripleBufferEnabled = false;
+		while (InterlockedCompareExchange(&mFrameProducerNum, 0, 0) != 0)
+			SwitchToThread();
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (DisableTripleBuffer)\n");
+			return;
+		}
+
+		if (mFrameBuffers[0].ImageBuffer != NULL)
+		{
+			//	Move the newest frame back into the regular (mutex path) buffers.
+			//	CreateNewImageBuffer*() release the mutex when they fail, the
+			//	16-bit buffer is allocated first so a failure leaves the frame
+			//	buffers as they are (the next frame recreates the buffers).
+			AcquireFrameBuffer();
+			if (mIs16BitsImage)
+			{
+				if (CreateNewImageBuffer16Bits(false) == 0)
+					return;
+				CopyMemory(mAllocated16BitsImageBuffer, mExternal16BitsImageBuffer,
+							Get16BitsImageBufferSize());
+			}
+			unsigned char	*imagePtr = mBitmapBits;
+			if (CreateNewImageBuffer(false) == 0)
+				return;
+			CopyMemory(mAllocatedImageBuffer, imagePtr, mBitmapBitsSize);
+			mExternal16BitsImageBuffer = NULL;
+			DeleteFrameBuffers();
+		}
+
+		ReleaseMutex(mMutexHandle);
+	}
+	void	UpdateImage()
+	{
+		if (IsWindowOpen() == false)
+			return;
+
+		IncrementFrameGeneration();
+		//	The frame rate is measured by UpdateImage() (or by OnPresent() on the
+		//	window thread when coalescing), the copy functions don't count frames
+		if (mIsRenderCoalescingEnabled || mIsTripleBufferEnabled)
+		{
+			//	Only count the frame here. The window thread presents the latest
+			//	one when the presentation clock allows (see OnPresent()). The
+			//	triple buffer producer never waits for the window thread.
+			InterlockedIncrement(&mPendingFrameNum);
+			if (InterlockedExchange(&mIsPresentPosted, 1) == 0)
+				PostMessage(mWindowH, IMAGE_WM_PRESENT, 0, 0);
+			return;
+		}
+
+		UpdateFPS();
+		UpdateMousePixelReadout();
+		UpdateConvertedImageDisp();
+		UpdateFramePlot();
+		UpdateImageDisp();
+	}	
+	void	DumpBitmapInfo()
+	{
+		printf("[Dump BitmapInfo : %s]\n", mWindowTitle);
+
+		if (mBitmapInfo == NULL)
+		{
+			printf("BitmapInfo is NULL \n");
+			return;
+		}
+
+		printf(" biSize: %d\n", mBitmapInfo->biSize);
+		printf(" biWidth: %d\n", mBitmapInfo->biWidth);
+		if (mBitmapInfo->biHeight < 0)
+			printf(" biHeight: %d (Top-down DIB)\n", mBitmapInfo->biHeight);
+		else
+			printf(" biHeight: %d (Bottom-up DIB)\n", mBitmapInfo->biHeight);
+		printf(" biPlanes: %d\n", mBitmapInfo->biPlanes);
+		printf(" biBitCount: %d\n", mBitmapInfo->biBitCount);
+		printf(" biCompression: %d\n", mBitmapInfo->biCompression);
+		printf(" biSizeImage: %d\n", mBitmapInfo->biSizeImage);
+		printf(" biXPelsPerMeter: %d\n", mBitmapInfo->biXPelsPerMeter);
+		printf(" biYPelsPerMeter: %d\n", mBitmapInfo->biYPelsPerMeter);
+		printf(" biClrUsed: %d\n", mBitmapInfo->biClrUsed);
+		printf(" biClrImportant: %d\n", mBitmapInfo->biClrImportant);
+		printf("\n");
+
+		printf(" mBitmapInfoSize =  %d bytes\n", mBitmapInfoSize);
+		printf(" RGBQUAD number  =  %d\n", (mBitmapInfoSize - mBitmapInfo->biSize) / sizeof(RGBQUAD));
+		printf(" mBitmapBitsSize =  %d bytes\n", mBitmapBitsSize);
+	}
+
+	unsigned char	*CreateDIB(bool inForceConvertToBottomUp = true)
+	{
+		if (mBitmapInfo == NULL)
+			return NULL;
+
+		unsigned char	*buf = new unsigned char[mBitmapInfoSize + mBitmapBitsSize];
+		if (buf == NULL)
+		{
+			printf("Error: Can't allocate buf (CreateDIB)\n");
+			return NULL;
+		}
+		WriteDIB(buf, inForceConvertToBottomUp);
+
+		return buf;
+	}
+	//	Writes the bitmap info and bits into outBuf (mBitmapInfoSize +
+	//	mBitmapBitsSize bytes). A top-down image is converted to bottom-up while
+	//	copying, so no separate flip pass is needed. The waterfall lines are
+	//	written in the order they are shown.
+	void	WriteDIB(unsigned char *outBuf, bool inForceConvertToBottomUp)
+	{
+		ConvertAllDirtyTiles();
+
+		CopyMemory(outBuf, mBitmapInfo, mBitmapInfoSize);
+		if (mIsWaterfallEnabled && mWaterfallTopLine != 0)
+		{
+			bool	isBottomUp = (mBitmapInfo->biHeight > 0);
+			bool	isDstBottomUp = (inForceConvertToBottomUp || isBottomUp);
+			int		height = abs(mBitmapInfo->biHeight);
+
+			ImageWindowKernel::CopyRingLines(mBitmapBits, isBottomUp, &(outBuf[mBitmapInfoSize]), isDstBottomUp,
+								GetBitmapLineSize(), height, mWaterfallTopLine);
+			if (isDstBottomUp)
+				((BITMAPINFOHEADER *)outBuf)->biHeight = height;
+			return;
+		}
+		if (inForceConvertToBottomUp == false || mBitmapInfo->biHeight > 0)
+		{
+			CopyImageMemory(&(outBuf[mBitmapInfoSize]), mBitmapBits, mBitmapBitsSize);
+			return;
+		}
+
+		int	height = abs(mBitmapInfo->biHeight);
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= mBitmapBits;
+		param.Dst		= &(outBuf[mBitmapInfoSize]);
+		param.LineSize	= GetBitmapLineSize();
+		param.LineNum	= height;
+		RunLineBands(CopyFlippedLinesFunc, &param, height, mBitmapBitsSize);
+		((BITMAPINFOHEADER *)outBuf)->biHeight = height;
+	}
+
+	void	FlipImageBuffer()
+	{
+		if (mBitmapInfo == NULL || mBitmapBits == NULL)
+			return;
+
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= NULL;
+		param.Dst		= mBitmapBits;
+		param.LineSize	= GetBitmapLineSize();
+		param.LineNum	= abs(mBitmapInfo->biHeight);
+		RunLineBands(FlipLinesFunc, &param, param.LineNum / 2, mBitmapBitsSize);
+		mBitmapInfo->biHeight *= -1;
+	}
+
+	bool	OpenBitmapFile(const char *inFileName)
+	{	
+		FILE	*fp;
+		BITMAPFILEHEADER	fileHeader;
+
+		if (fopen_s(&fp, inFileName, "rb") != 0)
+		{
+			printf("Error: Can't open file %s (OpenBitmapFile)\n", inFileName);
+			return false;
+		}
+
+		if (fread(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp) != 1)
+		{
+			printf("Error: fread failed (OpenBitmapFile)\n");
+			fclose(fp);
+			return false;
+		}
+
+		
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (OpenBitmapFile)\n");
+			fclose(fp);
+			return false;
+		}
+
+		if (mBitmapInfo != NULL)
+		{
+			FreeBuffer(mBitmapInfo);
+			FreeBuffer(mAllocatedImageBuffer);
+			mAllocatedImageBuffer = NULL;
+		}
+		DeleteFrameBuffers();
+		mExternalImageBuffer = NULL;
+
+		mBitmapInfoSize = fileHeader.bfOffBits - sizeof(BITMAPFILEHEADER);
+		mBitmapInfo = (BITMAPINFOHEADER *)AllocateBuffer(mBitmapInfoSize);
+		if (mBitmapInfo == NULL)
+		{
+			printf("Error: Can't allocate mBitmapInfo (OpenBitmapFile)\n");
+			ReleaseMutex(mMutexHandle);
+			fclose(fp);
+			return false;
+		}
+
+		mBitmapBitsSize = fileHeader.bfSize - fileHeader.bfOffBits;
+		mAllocatedImageBuffer = (unsigned char *)AllocateBuffer(mBitmapBitsSize);
+		if (mAllocatedImageBuffer == NULL)
+		{
+			printf("Error: Can't allocate mBitmapBits (OpenBitmapFile)\n");
+			FreeBuffer(mBitmapInfo);
+			mBitmapInfo = NULL;
+			ReleaseMutex(mMutexHandle);
+			fclose(fp);
+			return false;
+		}
+		mBitmapBits = mAllocatedImageBuffer;
+
+		if (fread(mBitmapInfo, mBitmapInfoSize, 1, fp) != 1)
+		{
+			printf("Error: fread failed (OpenBitmapFile)\n");
+			ReleaseMutex(mMutexHandle);
+			fclose(fp);
+			return false;
+		}
+		if (fread(mBitmapBits, mBitmapBitsSize, 1, fp) != 1)
+		{
+			printf("Error: fread failed (OpenBitmapFile)\n");
+			ReleaseMutex(mMutexHandle);
+			fclose(fp);
+			return false;
+		}
+		fclose(fp);
+
+		//if (mBitmapInfo->biHeight > 0)
+		//	FlipImageBuffer();
+
+		IncrementFrameGeneration();
+		ReleaseMutex(mMutexHandle);
+
+		UpdateWindowSize();
+		UpdateImageDisp();
+
+		printf("Bitmap File opened: %s\n", inFileName);
+
+		return true;
+	}
+
+	bool	CopyToClipboard()
+	{
+		if (mBitmapInfo == NULL || mBitmapBits == NULL)
+		{
+			printf("Error: mBitmapInfo == NULL || mBitmapBits == NULL CopyToClipboard()\n");
+			return false;
+		}
+
+		//	CF_DIB data has to be in global memory, so the DIB is written
+		//	straight into it (the clipboard owns it after SetClipboardData)
+		HANDLE	globalH = GlobalAlloc(GMEM_MOVEABLE, mBitmapInfoSize + mBitmapBitsSize);
+		if (globalH == NULL)
+		{
+			printf("Error: GlobalAlloc failed (CopyToClipboard)\n");
+			return false;
+		}
+		WriteDIB((unsigned char *)GlobalLock(globalH), true);
+		GlobalUnlock(globalH);
+
+		OpenClipboard(mWindowH);
+		EmptyClipboard();
+		if (SetClipboardData(CF_DIB, globalH) == NULL)
+			GlobalFree(globalH);
+		CloseClipboard();
+
+		return true;
+	}
+
+	bool	SaveAsBitmapFile()
+	{
+		const int	BUF_LEN = 512;
+		OPENFILENAME	fileName;
+		TCHAR	buf[BUF_LEN] = TEXT("Untitled.bmp");
+
+		ZeroMemory(&fileName, sizeof(fileName));
+		fileName.lStructSize = sizeof(fileName);
+		fileName.hwndOwner = mWindowH;
+		fileName.lpstrFilter = TEXT("Bitmap File (*.bmp)\0*.bmp\0");
+		fileName.nFilterIndex = 1;
+		fileName.lpstrFile = buf;
+		fileName.nMaxFile = BUF_LEN;
+		fileName.lpstrTitle = TEXT("Save Image As");
+		//fileName.Flags = OFN_EXTENSIONDIFFERENT;
+		fileName.lpstrDefExt = TEXT("bmp");
+
+		if (GetSaveFileName(&fileName) == 0)
+			return false;
+
+		return SaveBitmapFile((const char *)fileName.lpstrFile, true);
+	}
+
+	bool	SaveBitmapFile(const char *inFileName = NULL, bool inIsUnicode = false)
+	{
+		if (mBitmapInfo == NULL || mBitmapBits == NULL)
+		{
+			printf("Error: mBitmapInfo == NULL || mBitmapBits == NULL SaveBitmap()\n");
+			return false;
+		}
+
+//DumpBitmapInfo();
+
+		FILE	*fp;
+		char	fileName[IMAGE_FILE_NAME_BUF_LEN];
+
+		BITMAPFILEHEADER	fileHeader;
+		fileHeader.bfType = 'MB';
+		fileHeader.bfSize = sizeof(BITMAPFILEHEADER) + mBitmapInfoSize + mBitmapBitsSize;
+		fileHeader.bfReserved1 = 0;
+		fileHeader.bfReserved2 = 0;
+		fileHeader.bfOffBits = sizeof(BITMAPFILEHEADER) + mBitmapInfoSize;
+		
+		if (inIsUnicode == false)
+		{
+			if (inFileName != NULL)
+			{
+				sprintf_s(fileName, IMAGE_FILE_NAME_BUF_LEN, "%s", inFileName);
+			}
+			else
+			{
+				sprintf_s(fileName, IMAGE_FILE_NAME_BUF_LEN, "%s%d.bmp", mWindowTitle, mFileNameIndex);
+				mFileNameIndex++;
+			}
+
+			if (fopen_s(&fp, fileName, "wb") != 0)
+			{
+				printf("Error: Can't create file %s (SaveBitmapFile)\n", fileName);
+				ReleaseMutex(mMutexHandle);
+				return false;
+			}
+		}
+		else
+		{
+			if (_wfopen_s(&fp, (wchar_t *)inFileName, L"wb") != 0)
+			{
+				printf("Error: Can't create file %s (SaveBitmapFile)\n", fileName);
+				ReleaseMutex(mMutexHandle);
+				return false;
+			}
+		}
+
+		if (fwrite(&fileHeader, sizeof(BITMAPFILEHEADER), 1, fp) != 1)
+		{
+			printf("Error: Can't write file (SaveBitmapFile)\n");
+			ReleaseMutex(mMutexHandle);
+			fclose(fp);
+			return false;
+		}
+		if (WriteBitmapFileBody(fp) == false)
+		{
+			printf("Error: Can't write file (SaveBitmapFile)\n");
+			ReleaseMutex(mMutexHandle);
+			fclose(fp);
+			return false;
+		}
+		fclose(fp);
+
+//		if (inIsUnicode == false)
+//			printf("Bitmap File saved: %s\n", fileName);
+//		else
+//			wprintf(TEXT("Bitmap File saved: %s\n"), inFileName);
+
+		return true;
+	}
+	//	Writes the bitmap info and the bits as a bottom-up DIB. Lines of a
+	//	top-down image are written in reverse order straight from mBitmapBits,
+	//	the waterfall lines in the order they are shown.
+	bool	WriteBitmapFileBody(FILE *fp)
+	{
+		BITMAPINFOHEADER	header = *mBitmapInfo;
+		int	height = abs(mBitmapInfo->biHeight);
+
+		ConvertAllDirtyTiles();
+
+		header.biHeight = height;
+		if (fwrite(&header, sizeof(BITMAPINFOHEADER), 1, fp) != 1)
+			return false;
+		if (mBitmapInfoSize > sizeof(BITMAPINFOHEADER))
+			if (fwrite(&(((unsigned char *)mBitmapInfo)[sizeof(BITMAPINFOHEADER)]),
+						mBitmapInfoSize - sizeof(BITMAPINFOHEADER), 1, fp) != 1)
+				return false;
+
+		int	topLine = mIsWaterfallEnabled ? mWaterfallTopLine : 0;
+		if (mBitmapInfo->biHeight > 0 && topLine == 0)
+			return (fwrite(mBitmapBits, mBitmapBitsSize, 1, fp) == 1);
+
+		unsigned int	lineSize = GetBitmapLineSize();
+		for (int y = height - 1; y >= 0; y--)
+		{
+			int	line = ImageWindowKernel::GetRingLine(y, topLine, height, mBitmapInfo->biHeight > 0);
+			if (fwrite(&(mBitmapBits[lineSize * line]), lineSize, 1, fp) != 1)
+				return false;
+		}
+
+		return true;
+	}
+
+	int	GetImageWidth()
+	{
+		if (mBitmapInfo == NULL)
+			return 0;
+		return mBitmapInfo->biWidth;
+	}
+
+	int	GetImageHeight()
+	{
+		if (mBitmapInfo == NULL)
+			return 0;
+		return abs(mBitmapInfo->biHeight);
+	}
+
+	RECT	GetImageClientRect()
+	{
+		return mImageDispRect;
+	}
+
+	bool	IsBottomUpImage()
+	{
+		if (mBitmapInfo == NULL)
+			return false;
+
+		if (mBitmapInfo->biHeight > 0)
+			return true;
+
+		return false;
+	}
+
+	int	GetImageBitCount()
+	{
+		if (mBitmapInfo == NULL)
+			return 0;
+		return mBitmapInfo->biBitCount;
+	}
+	unsigned char	*GetImageBufferPtr()
+	{
+		if (mIs16BitsImage != false)
+			return (unsigned char *)Get16BitsImageBufferPtr();
+		if (mExternalImageBuffer != NULL)
+			return (unsigned char *)mExternalImageBuffer;
+
+		return mBitmapBits;
+	}
+	unsigned int	GetImageBufferSize()
+	{
+		if (mBitmapInfo == NULL)
+			return 0;
+
+		return GetImageLineSize() * abs(mBitmapInfo->biHeight);
+	}
+	//	Distance between two lines of GetImageBufferPtr() in bytes
+	unsigned int	GetImageLineSize()
+	{
+		if (mBitmapInfo == NULL)
+			return 0;
+		if (mIs16BitsImage != false)
+			return m16BitsImageLineSize;
+		if (mExternalImageBuffer != NULL)
+			return mExternalImageLineSize;
+
+		return GetBitmapLineSize();
+	}
+	double	GetDispScale()
+	{
+		return mImageDispScale;
+	}
+
+	void	SetDispScale(double inScale)
+	{
+		double	prevImageDispScale = mImageDispScale;
+
+		if (inScale <= 1.0)
+			inScale = 1.0;
+		mImageDispScale = inScale;
+		CheckImageDispOffset();
+		UpdateStatusBar();
+		
+		double	scale = mImageDispScale / 100.0;
+		if (prevImageDispScale > mImageDispScale &&
+			((int )(mImageSize.cx * scale) <= mImageDispRect.right - mImageDispRect.left ||
+			 (int )(mImageSize.cy * scale) <= mImageDispRect.bottom - mImageDispRect.top))
+			UpdateImageDisp(true);
+		else
+			UpdateImageDisp();
+
+		UpdateMouseCursor();
+	}
+
+	double	CalcWindowSizeFitScale()
+	{
+		double	imageRatio = (double )mImageSize.cy / (double )mImageSize.cx;
+		double	dispRatio = (double )mImageDispSize.cy / (double )mImageDispSize.cx;
+		double	scale;
+
+		if (imageRatio > dispRatio)
+			scale = (double )mImageDispSize.cy / (double )mImageSize.cy;
+		else
+			scale = (double )mImageDispSize.cx / (double )mImageSize.cx;
+
+		return scale * 100.0;
+	}
+
+	void	FitDispScaleToWindowSize()
+	{
+		SetDispScale(CalcWindowSizeFitScale());
+	}
+
+	void	ZoomIn()
+	{
+		SetDispScale(CalcImageScale(IMAGE_ZOOM_STEP));
+	}
+
+	void	ZoomOut()
+	{
+		SetDispScale(CalcImageScale(-IMAGE_ZOOM_STEP));
+	}
+
+	bool	IsFullScreenMode()
+	{
+		return mIsFullScreenMode;
+	}
+
+	void	EnableFullScreenMode(bool inFitDispScaleToWindowSize = true, int inMonitorIndex = -1)
+	{
+		if (mIsFullScreenMode)
+			return;
+
+		RECT	monitorRect = {0, 0, 0, 0};
+		int		index = 0;
+
+		mMonitorNum = 0;
+		EnumDisplayMonitors(NULL, NULL, (MONITORENUMPROC )MyMonitorEnumProc, (LPARAM )this);
+		GetWindowRect(mWindowH, &mLastWindowRect);
+
+		switch (inMonitorIndex)
+		{
+			case -1:
+				POINT	pos;
+				for (int i = 0; i < mMonitorNum; i++)
+				{
+					pos.x = mLastWindowRect.left;
+					pos.y = mLastWindowRect.top;
+					if (PtInRect(&mMonitorRect[i], pos) == TRUE)
+					{
+						index = i;
+						break;
+					}
+				}
+				monitorRect = mMonitorRect[index];
+				break;
+			case -2:
+				for (int i = 0; i < mMonitorNum; i++)
+				{
+					if (mMonitorRect[i].left < monitorRect.left)
+						monitorRect.left = mMonitorRect[i].left;
+					if (mMonitorRect[i].top < monitorRect.top)
+						monitorRect.top = mMonitorRect[i].top;
+					if (mMonitorRect[i].right > monitorRect.right)
+						monitorRect.right = mMonitorRect[i].right;
+					if (mMonitorRect[i].bottom > monitorRect.bottom)
+						monitorRect.bottom = mMonitorRect[i].bottom;
+				}
+				break;
+			default:
+				index = inMonitorIndex;
+				if (index < 0 || index >= mMonitorNum)
+					index = 0;
+				monitorRect = mMonitorRect[index];
+				break;
+		}
+
+		SetWindowLong(mWindowH, GWL_STYLE, WS_POPUP | WS_VISIBLE);
+		SetWindowPos(mWindowH, HWND_TOPMOST,
+			monitorRect.left, monitorRect.top,
+			monitorRect.right, monitorRect.bottom,
+			SWP_SHOWWINDOW);
+		DisableMenubar();
+		DisableToolbar();
+		DisableStatusbar();
+		CheckMenuItem(mMenuH, IDM_FULL_SCREEN, MF_CHECKED);
+		mIsFullScreenMode = true;
+		UpdateImageDispDispRect();
+		if (inFitDispScaleToWindowSize)
+			FitDispScaleToWindowSize();
+	}
+
+	void	DisableFullScreenMode(bool inFitDispScaleToWindowSize = true)
+	{
+		if (!mIsFullScreenMode)
+			return;
+
+		SetWindowLong(mWindowH, GWL_STYLE,
+			WS_THICKFRAME | WS_CAPTION | WS_SYSMENU | WS_VISIBLE | WS_MINIMIZEBOX | WS_MAXIMIZEBOX);
+		SetWindowPos(mWindowH, HWND_NOTOPMOST,
+			mLastWindowRect.left, mLastWindowRect.top,
+			mLastWindowRect.right - mLastWindowRect.left,
+			mLastWindowRect.bottom - mLastWindowRect.top,
+			SWP_SHOWWINDOW);
+		EnableMenubar();
+		EnableToolbar();
+		EnableStatusbar();
+		CheckMenuItem(mMenuH, IDM_FULL_SCREEN, MF_UNCHECKED);
+		mIsFullScreenMode = false;
+		UpdateImageDispDispRect();
+		if (inFitDispScaleToWindowSize)
+			FitDispScaleToWindowSize();
+	}
+
+	bool	IsMenubarEnabled()
+	{
+		return mIsMenubarEnabled;
+	}
+
+	void	EnableMenubar()
+	{
+		if (mIsMenubarEnabled)
+			return;
+
+		::SetMenu(mWindowH, mMenuH);
+		CheckMenuItem(mMenuH, IDM_MENUBAR, MF_CHECKED);
+		mIsMenubarEnabled = true;
+	}
+
+	void	DisableMenubar()
+	{
+		if (!mIsMenubarEnabled)
+			return;
+
+		::SetMenu(mWindowH, NULL);
+		CheckMenuItem(mMenuH, IDM_MENUBAR, MF_UNCHECKED);
+		mIsMenubarEnabled = false;
+	}
+
+	bool	IsToolbarEnabled()
+	{
+		return mIsToolbarEnabled;
+	}
+
+	void	EnableToolbar()
+	{
+		if (mIsToolbarEnabled)
+			return;
+
+		::ShowWindow(mRebarH, SW_SHOW);
+		CheckMenuItem(mMenuH, IDM_TOOLBAR, MF_CHECKED);
+		mIsToolbarEnabled = true;
+		UpdateImageDispDispRect();
+		UpdateImageDisp(true);
+	}
+
+	void	DisableToolbar()
+	{
+		if (!mIsToolbarEnabled)
+			return;
+
+		::ShowWindow(mRebarH, SW_HIDE);
+		CheckMenuItem(mMenuH, IDM_TOOLBAR, MF_UNCHECKED);
+		mIsToolbarEnabled = false;
+		UpdateImageDispDispRect();
+		UpdateImageDisp(true);
+	}
+
+	bool	IsStatusbarEnabled()
+	{
+		return mIsStatusbarEnabled;
+	}
+
+	void	EnableStatusbar()
+	{
+		if (mIsStatusbarEnabled)
+			return;
+
+		::ShowWindow(mStatusbarH, SW_SHOW);
+		CheckMenuItem(mMenuH, IDM_STATUSBAR, MF_CHECKED);
+		mIsStatusbarEnabled = true;
+	}
+
+	void	DisableStatusbar()
+	{
+		if (!mIsStatusbarEnabled)
+			return;
+
+		::ShowWindow(mStatusbarH, SW_HIDE);
+		CheckMenuItem(mMenuH, IDM_STATUSBAR, MF_UNCHECKED);
+		mIsStatusbarEnabled = false;
+	}
+
+	bool	IsPlotEnabled()
+	{
+		return mIsPlotEnabled;
+	}
+
+	void	EnablePlot()
+	{
+		if (mIsPlotEnabled)
+			return;
+
+		CheckMenuItem(mMenuH, IDM_PLOT, MF_CHECKED);
+		mIsPlotEnabled = true;
+	}
+
+	void	DisablePlot()
+	{
+		if (!mIsPlotEnabled)
+			return;
+
+		CheckMenuItem(mMenuH, IDM_PLOT, MF_UNCHECKED);
+		mIsPlotEnabled = false;
+	}
+
+
+	//	Lines are DWORD aligned as the DIB format requires
+	static void	FlipBitmap(BITMAPINFOHEADER *inBitmapInfo, unsigned char *inBitmapBits)
+	{
+		if (inBitmapInfo == NULL)
+			return;
+		if (inBitmapBits == NULL)
+			return;
+
+		unsigned int	lineSize = ((inBitmapInfo->biWidth * inBitmapInfo->biBitCount + 31) / 32) * 4;
+		int	height = abs(inBitmapInfo->biHeight);
+		FlipBitmapLines(inBitmapBits, lineSize, height, 0, height / 2);
+		inBitmapInfo->biHeight *= -1;
+	}
+
+	//	Swaps line y and line (inLineNum - y - 1) for y in [inStartLine, inEndLine)
+	static void	FlipBitmapLines(unsigned char *inBitmapBits, unsigned int inLineSize, int inLineNum,
+								int inStartLine, int inEndLine)
+	{
+		const unsigned int	BUF_SIZE = 4096;
+		unsigned char	buf[BUF_SIZE];
+
+		for (int y = inStartLine; y < inEndLine; y++)
+		{
+			unsigned char	*srcPtr = &(inBitmapBits[inLineSize * y]);
+			unsigned char	*dstPtr = &(inBitmapBits[inLineSize * (inLineNum - y - 1)]);
+
+			for (unsigned int i = 0; i < inLineSize; i += BUF_SIZE)
+			{
+				unsigned int	size = inLineSize - i;
+				if (size > BUF_SIZE)
+					size = BUF_SIZE;
+				memcpy(buf, &(srcPtr[i]), size);
+				memcpy(&(srcPtr[i]), &(dstPtr[i]), size);
+				memcpy(&(dstPtr[i]), buf, size);
+			}
+		}
+	}
+
+	bool	IsScrollable()
+	{
+			int	imageWidth = (int )(mImageSize.cx * mImageDispScale / 100.0);
+			int	imageHeight = (int )(mImageSize.cy * mImageDispScale / 100.0);
+
+			if (imageWidth > mImageDispSize.cx)
+				return true;
+			if (imageHeight > mImageDispSize.cy)
+				return true;
+
+			return false;
+	}
+
+	void	SetDrawOverlayFunc(void (*inFunc)(ImageWindow *, HDC, void *), void *inFuncData)
+	{
+		mDrawOverlayFunc = inFunc;
+		mOverlayFuncData = inFuncData;
+	}
+	//	Overlay function for the software renderer. It is called with the
+	//	rendered viewport (24-bit BGR, top-down) after the image, pixel values
+	//	and plot are drawn.
+	void	SetRenderOverlayFunc(void (*inFunc)(ImageWindow *, unsigned char *, int, int, unsigned int, void *),
+								void *inFuncData)
+	{
+		mRenderOverlayFunc = inFunc;
+		mRenderOverlayFuncData = inFuncData;
+	}
+
+	bool	IsSoftwareRenderEnabled()
+	{
+		return mIsSoftwareRenderEnabled;
+	}
+	//	When enabled, the view is composed by RenderImage() into an off-screen
+	//	buffer and painted with a single SetDIBitsToDevice() call
+	void	EnableSoftwareRender()
+	{
+		mIsSoftwareRenderEnabled = true;
+		UpdateImageDisp();
+	}
+	void	DisableSoftwareRender()
+	{
+		mIsSoftwareRenderEnabled = false;
+		UpdateImageDisp();
+	}
+
+	// -------------------------------------------------------------------------
+	//	RenderImage(...)
+	// -------------------------------------------------------------------------
+	//!	Renders the current view into a caller-supplied buffer
+	/*!
+		The output is a 24-bit BGR (DIB order), top-down image of
+		inWidth x inHeight pixels with inLineSize bytes per line. The view is
+		given by the current display offset and scale, the same state DrawImage()
+		uses. It does not need a window, so it can be used headlessly.
+	*/
+	bool	RenderImage(unsigned char *outBuffer, int inWidth, int inHeight, unsigned int inLineSize,
+						COLORREF inBkColor = RGB(0xFF, 0xFF, 0xFF))
+	{
+		DWORD	result;
+
+		if (outBuffer == NULL || inWidth <= 0 || inHeight <= 0 || inLineSize < (unsigned int )inWidth * 3)
+		{
+			printf("Error: Invalid render buffer (RenderImage)\n");
+			return false;
+		}
+
+		result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (RenderImage)\n");
+			return false;
+		}
+
+		if (mBitmapInfo == NULL || mBitmapBits == NULL)
+		{
+			ReleaseMutex(mMutexHandle);
+			printf("Error: No image (RenderImage)\n");
+			return false;
+		}
+
+		AcquireFrameBuffer();
+		ConvertAllDirtyTiles();
+		bool	isSucceeded = RenderView(outBuffer, inWidth, inHeight, inLineSize, inBkColor);
+
+		ReleaseMutex(mMutexHandle);
+		return isSucceeded;
+	}
+
+
+int					mImageClickNum;
+int					mLastImageClickX;
+int					mLastImageClickY;
+	
+//	HWND			GetWindowHandle() { return mWindowH; }
+	const BITMAPINFOHEADER	*GetBitmapInfo() { return mBitmapInfo; }
+	
+protected:
+	enum
+	{
+		IDM_SAVE	=	100,
+		IDM_SAVE_AS,
+		IDM_PROPERTY,
+		IDM_CLOSE,
+		IDM_UNDO,
+		IDM_CUT,
 		IDM_COPY,
 		IDM_PASTE,
 		IDM_MENUBAR,
@@ -1379,1317 +3728,3606 @@ protected:
 		IDM_ABOUT
 	};
 
-	virtual void	OnCommand(WPARAM inWParam, LPARAM inLParam)
+	virtual void	OnCommand(WPARAM inWParam, LPARAM inLParam)
+	{
+		switch (LOWORD(inWParam))
+		{
+			case IDM_SAVE:
+				SaveBitmapFile();
+				break;
+			case IDM_SAVE_AS:
+				SaveAsBitmapFile();
+				break;
+			case IDM_PROPERTY:
+				DumpBitmapInfo();
+				break;
+			case IDM_CLOSE:
+				PostQuitMessage(0);
+				break;
+			case IDM_COPY:
+				CopyToClipboard();
+				break;
+			case IDM_MENUBAR:
+				if (IsMenubarEnabled())
+					DisableMenubar();
+				else
+					EnableMenubar();
+				break;
+			case IDM_TOOLBAR:
+				if (IsToolbarEnabled())
+					DisableToolbar();
+				else
+					EnableToolbar();
+				break;
+			case IDM_STATUSBAR:
+				if (IsStatusbarEnabled())
+					DisableStatusbar();
+				else
+					EnableStatusbar();
+				break;
+			case IDM_ZOOMPANE:
+				break;
+			case IDM_FULL_SCREEN:
+				if (IsFullScreenMode())
+					DisableFullScreenMode();
+				else
+					EnableFullScreenMode();
+				break;
+			case IDM_FPS:
+				break;
+			case IDM_PLOT:
+				if (IsPlotEnabled())
+					DisablePlot();
+				else
+					EnablePlot();
+				break;
+			case IDM_FREEZE:
+				break;
+			case IDM_SCROLL_TOOL:
+				SetCursorMode(CURSOR_MODE_SCROLL_TOOL);
+				break;
+			case IDM_ZOOM_TOOL:
+				SetCursorMode(CURSOR_MODE_ZOOM_TOOL);
+				break;
+			case IDM_INFO_TOOL:
+				SetCursorMode(CURSOR_MODE_INFO_TOOL);
+				break;
+			case IDM_ZOOM_IN:
+				ZoomIn();
+				if (GetKeyState(VK_CONTROL) < 0)
+					UpdateWindowSize(true);
+				break;
+			case IDM_ZOOM_OUT:
+				ZoomOut();
+				if (GetKeyState(VK_CONTROL) < 0)
+					UpdateWindowSize(true);
+				break;
+			case IDM_ACTUAL_SIZE:
+				if (GetKeyState(VK_CONTROL) < 0 || IsFullScreenMode() == true)
+					SetDispScale(100);
+				else
+				{
+					UpdateWindowSize();
+					UpdateImageDisp();
+				}
+				break;
+			case IDM_FIT_WINDOW:
+				FitDispScaleToWindowSize();
+				break;
+			case IDM_ADJUST_WINDOW_SIZE:
+				if (IsFullScreenMode() == false)
+					UpdateWindowSize(true);
+				break;
+			case IDM_CASCADE_WINDOW:
+				break;
+			case IDM_TILE_WINDOW:
+				break;
+			case IDM_ABOUT:
+				::MessageBox(mWindowH,
+					TEXT("ImageWindow Ver.1.0.0\nDairoku Sekiguchi (2007/10/13)"),
+					TEXT("About ImageWindow"), MB_OK);
+				break;
+		}
+	}
+
+	virtual void	OnKeyDown(WPARAM ininWParam, LPARAM inLParam)
+	{
+		switch (ininWParam)
+		{
+			case VK_SHIFT:
+				UpdateMouseCursor();
+				break;
+		}
+	}
+
+	virtual void	OnKeyUp(WPARAM ininWParam, LPARAM inLParam)
+	{
+		switch (ininWParam)
+		{
+			case VK_SHIFT:
+				UpdateMouseCursor();
+				break;
+		}
+	}
+
+	virtual void	OnChar(WPARAM ininWParam, LPARAM inLParam)
+	{
+		switch (ininWParam)
+		{
+			case VK_ESCAPE:
+				if (IsFullScreenMode())
+					DisableFullScreenMode();
+				break;
+			case 's':
+			case 'S':
+				SaveBitmapFile();
+				break;
+			case 'd':
+			case 'D':
+				DumpBitmapInfo();
+				break;
+			case 'f':
+			case 'F':
+				if (IsFullScreenMode())
+					DisableFullScreenMode();
+				else
+					EnableFullScreenMode();
+				break;
+			case '+':
+				ZoomIn();
+				break;
+			case '-':
+				ZoomOut();
+				break;
+			case '=':
+				SetDispScale(100);
+				break;
+		}
+	}
+
+	virtual void	OnLButtonDown(UINT inMessage, WPARAM inWParam, LPARAM inLParam)
+	{
+		POINT	localPos;
+		int	x, y;
+		double	scale;
+
+		mMouseDownPos.x = (short )LOWORD(inLParam);
+		mMouseDownPos.y = (short )HIWORD(inLParam);
+
+		if ((inWParam & MK_CONTROL) == 0)
+			mMouseDownMode = mCursorMode;
+		else
+			mMouseDownMode = CURSOR_MODE_SCROLL_TOOL;
+
+		switch (mMouseDownMode)
+		{
+			case CURSOR_MODE_SCROLL_TOOL:
+				mIsMouseDragging = true;
+				mImageDispOffsetStart = mImageDispOffset;
+				SetCapture(mWindowH);
+				break;
+			case CURSOR_MODE_ZOOM_TOOL:
+				localPos = mMouseDownPos;
+				localPos.x -= mImageDispRect.left;
+				localPos.y -= mImageDispRect.top;
+				scale = mImageDispScale / 100.0;
+				x = (int )(localPos.x / scale);
+				y = (int )(localPos.y / scale);
+				x += mImageDispOffset.cx;
+				y += mImageDispOffset.cy;
+
+				if ((inWParam & MK_SHIFT) == 0)
+					scale = CalcImageScale(IMAGE_ZOOM_STEP);
+				else
+					scale = CalcImageScale(-IMAGE_ZOOM_STEP);
+
+				mImageDispOffset.cx = x - (int )(localPos.x / (scale / 100.0));
+				mImageDispOffset.cy = y - (int )(localPos.y / (scale / 100.0));
+				SetDispScale(scale);
+				break;
+			case CURSOR_MODE_INFO_TOOL:
+				localPos = mMouseDownPos;
+				localPos.x -= mImageDispRect.left;
+				localPos.y -= mImageDispRect.top;
+				scale = mImageDispScale / 100.0;
+				x = (int )(localPos.x / scale);
+				y = (int )(localPos.y / scale);
+				x += mImageDispOffset.cx;
+				y += mImageDispOffset.cy;
+
+				if (x <0 || y < 0 ||
+					x >= GetImageWidth() || y >= GetImageHeight())
+					break;
+
+				mImageClickNum++;
+				mLastImageClickX = x;
+				mLastImageClickY = y;
+
+				unsigned char	*pixelPtr = GetPixelPointer(x, y);
+				if (pixelPtr == NULL)
+					break;
+
+				int	v = *pixelPtr;
+				char	buf[256];
+
+				if (mIs16BitsImage == true)
+				{
+					unsigned short	value = 0;
+					const unsigned short	*imagePtr = Get16BitsPixelPointer(x, y);
+
+					if (imagePtr != NULL)
+						value = *imagePtr;
+
+					printf("%d: X:%.4d Y:%.4d VALUE:%.3d %.5d\n", mImageClickNum, x, y, v, value);
+				}
+				else
+				{
+					_itoa(v, buf, 2);
+					printf("%d: X:%.4d Y:%.4d VALUE:%.3d %.2X %s\n", mImageClickNum, x, y, v, v, buf);
+				}
+				break;
+		}
+	}
+
+	virtual void	OnMButtonDown(UINT inMessage, WPARAM inWParam, LPARAM inLParam)
+	{
+		POINT	localPos;
+		int	x, y;
+		double	scale;
+
+		localPos.x = (short )LOWORD(inLParam);
+		localPos.y = (short )HIWORD(inLParam);
+
+		localPos.x -= mImageDispRect.left;
+		localPos.y -= mImageDispRect.top;
+		scale = mImageDispScale / 100.0;
+		x = (int )(localPos.x / scale);
+		y = (int )(localPos.y / scale);
+		x += mImageDispOffset.cx;
+		y += mImageDispOffset.cy;
+
+		if ((inWParam & (MK_SHIFT + MK_CONTROL)) == 0)
+			scale = 100;
+		else
+		{
+			if ((inWParam & MK_SHIFT) == 0)
+				scale = 3000;
+			else
+				scale = CalcWindowSizeFitScale();
+		}
+
+		if (mImageDispScale == scale)
+			scale = mImagePrevScale;
+
+		mImagePrevScale = mImageDispScale;
+
+		mImageDispOffset.cx = x - (int )(localPos.x / (scale / 100.0));
+		mImageDispOffset.cy = y - (int )(localPos.y / (scale / 100.0));
+		SetDispScale(scale);
+	}
+
+	virtual void	OnMouseMove(WPARAM inWParam, LPARAM inLParam)
+	{
+		if (mIsMouseDragging == false)
+			return;
+
+		POINT	currentPos;
+
+		currentPos.x = (short )LOWORD(inLParam);
+		currentPos.y = (short )HIWORD(inLParam);
+
+		switch (mMouseDownMode)
+		{
+			case CURSOR_MODE_SCROLL_TOOL:
+				//	Only the latest position is kept, OnPan() scrolls to it at
+				//	most once per present interval
+				mPanPos = currentPos;
+				if (mIsPanPending == false)
+				{
+					mIsPanPending = true;
+					SchedulePan();
+				}
+				break;
+			case CURSOR_MODE_ZOOM_TOOL:
+				break;
+			case CURSOR_MODE_INFO_TOOL:
+				break;
+		}
+	}
+
+	virtual void	OnLButtonUp(WPARAM inWParam, LPARAM inLParam)
+	{
+		switch (mMouseDownMode)
+		{
+			case CURSOR_MODE_SCROLL_TOOL:
+				if (mIsPanPending)
+				{
+					::KillTimer(mWindowH, IMAGE_PAN_TIMER_ID);
+					OnPan();
+				}
+				mIsMouseDragging = false;
+				ReleaseCapture();
+				break;
+			case CURSOR_MODE_ZOOM_TOOL:
+				break;
+			case CURSOR_MODE_INFO_TOOL:
+				break;
+		}
+	}
+
+	virtual void	OnRButtonDown(UINT inMessage, WPARAM inWParam, LPARAM inLParam)
+	{
+		POINT	pos;
+
+		pos.x = (short )LOWORD(inLParam);
+		pos.y = (short )HIWORD(inLParam);
+
+		HMENU	menu = GetSubMenu(mPopupMenuH, 0);
+		ClientToScreen(mWindowH, &pos);
+		TrackPopupMenu(menu, TPM_LEFTALIGN, pos.x, pos.y, 0, mWindowH, NULL);
+	}
+
+	virtual void	OnMouseWheel(WPARAM inWParam, LPARAM inLParam)
+	{
+		POINT	mousePos;
+		int	x, y, zDelta;
+		double	scale;
+
+		mousePos.x = (short )LOWORD(inLParam);
+		mousePos.y = (short )HIWORD(inLParam);
+		ScreenToClient(mWindowH, &mousePos);
+		if (PtInRect(&mImageDispRect, mousePos) == 0)
+			return;
+
+		zDelta = GET_WHEEL_DELTA_WPARAM(inWParam);
+
+		mousePos.x -= mImageDispRect.left;
+		mousePos.y -= mImageDispRect.top;
+		scale = mImageDispScale / 100.0;
+		x = (int )(mousePos.x / scale);
+		y = (int )(mousePos.y / scale);
+		x += mImageDispOffset.cx;
+		y += mImageDispOffset.cy;
+
+		if ((inWParam & (MK_SHIFT + MK_CONTROL)) == 0)
+			scale = CalcImageScale(zDelta / MOUSE_WHEEL_STEP);
+		else
+		{
+			if ((inWParam & MK_SHIFT) == 0)
+				scale = CalcImageScale(zDelta / MOUSE_WHEEL_STEP * 4);
+			else
+				scale = CalcImageScale(zDelta / MOUSE_WHEEL_STEP / 2);
+		}
+
+		mImageDispOffset.cx = x - (int )(mousePos.x / (scale / 100.0));
+		mImageDispOffset.cy = y - (int )(mousePos.y / (scale / 100.0));
+		SetDispScale(scale);
+	}
+
+	virtual void	OnSize(WPARAM inWParam, LPARAM inLParam)
+	{
+		UpdateImageDispDispRect();
+		if (GetKeyState(VK_SHIFT) < 0)
+		{
+			FitDispScaleToWindowSize();
+			return;
+		}
+
+		if (CheckImageDispOffset())
+			UpdateImageDisp();
+
+		UpdateStatusBar();
+	}
+
+	virtual bool	OnSetCursor(WPARAM inWParam, LPARAM inLParam)
+	{
+		return UpdateMouseCursor();
+	}
+
+
+	bool	UpdateMouseCursor()
+	{
+		if (UpdateMousePixelReadout() == false)
+			return false;
+
+		switch (mCursorMode)
+		{
+			case CURSOR_MODE_SCROLL_TOOL:
+				if (IsScrollable())
+					SetCursor(mScrollCursor);
+				else
+					SetCursor(mArrowCursor);
+				break;
+			case CURSOR_MODE_ZOOM_TOOL:
+				if (GetKeyState(VK_SHIFT) < 0)
+					SetCursor(mZoomMinusCursor);
+				else
+					SetCursor(mZoomPlusCursor);
+				break;
+			case CURSOR_MODE_INFO_TOOL:
+				SetCursor(mInfoCursor);
+				break;
+		}
+
+		return true;
+	}
+
+	virtual void	SetCursorMode(int inCursorMode)
+	{
+		mCursorMode = inCursorMode;
+
+		if (mMenuH == NULL)
+			return;
+
+		switch (mCursorMode)
+		{
+			case CURSOR_MODE_SCROLL_TOOL:
+				CheckMenuItem(mMenuH, IDM_SCROLL_TOOL, MF_CHECKED);
+				CheckMenuItem(mMenuH, IDM_ZOOM_TOOL, MF_UNCHECKED);
+				CheckMenuItem(mMenuH, IDM_INFO_TOOL, MF_UNCHECKED);
+				break;
+			case CURSOR_MODE_ZOOM_TOOL:
+				CheckMenuItem(mMenuH, IDM_SCROLL_TOOL, MF_UNCHECKED);
+				CheckMenuItem(mMenuH, IDM_ZOOM_TOOL, MF_CHECKED);
+				CheckMenuItem(mMenuH, IDM_INFO_TOOL, MF_UNCHECKED);
+				break;
+			case CURSOR_MODE_INFO_TOOL:
+				CheckMenuItem(mMenuH, IDM_SCROLL_TOOL, MF_UNCHECKED);
+				CheckMenuItem(mMenuH, IDM_ZOOM_TOOL, MF_UNCHECKED);
+				CheckMenuItem(mMenuH, IDM_INFO_TOOL, MF_CHECKED);
+				break;
+		}
+	}
+
+	void	UpdateImageDisp(bool inErase = false)
+	{
+		if (mWindowState != WINDOW_OPEN_STATE)
+			return;
+		::InvalidateRect(mWindowH, &mImageDispRect, inErase);
+	}
+
+	//	Pans right away if the last pan is a present interval old, otherwise
+	//	when IMAGE_PAN_TIMER_ID fires
+	void	SchedulePan()
+	{
+		unsigned __int64	currentCount;
+		unsigned __int64	interval = (unsigned __int64 )(mFrequency / GetPresentRate());
+
+		::QueryPerformanceCounter((LARGE_INTEGER *)&currentCount);
+		if (currentCount - mLastPanCount >= interval)
+		{
+			OnPan();
+			return;
+		}
+
+		UINT	waitTime = (UINT )((interval - (currentCount - mLastPanCount)) * 1000 / mFrequency);
+		if (waitTime == 0)
+			waitTime = 1;
+		::SetTimer(mWindowH, IMAGE_PAN_TIMER_ID, waitTime, NULL);
+	}
+	void	OnPan()
+	{
+		double	scale = mImageDispScale / 100.0;
+		SIZE	prevOffset = mImageDispOffset;
+
+		mIsPanPending = false;
+		::QueryPerformanceCounter((LARGE_INTEGER *)&mLastPanCount);
+
+		mImageDispOffset = mImageDispOffsetStart;
+		mImageDispOffset.cx -= (int )((mPanPos.x - mMouseDownPos.x) / scale);
+		mImageDispOffset.cy -= (int )((mPanPos.y - mMouseDownPos.y) / scale);
+		CheckImageDispOffset();
+		ScrollImageDisp(prevOffset);
+	}
+	//	Moves the pixels already on the screen by the pan and repaints only
+	//	the exposed strips. Everything is repainted when the move isn't a
+	//	whole number of screen pixels, when a pyramid level is drawn (its
+	//	offset is rounded per level) or when something is drawn on top that
+	//	doesn't scroll with the image (the plot and the overlays).
+	void	ScrollImageDisp(SIZE inPrevOffset)
+	{
+		double	scale = mImageDispScale / 100.0;
+		double	dx = (inPrevOffset.cx - mImageDispOffset.cx) * scale;
+		double	dy = (inPrevOffset.cy - mImageDispOffset.cy) * scale;
+		int		width = mImageDispRect.right - mImageDispRect.left;
+		int		height = mImageDispRect.bottom - mImageDispRect.top;
+
+		if (mWindowState != WINDOW_OPEN_STATE)
+			return;
+		if (dx == 0 && dy == 0)
+			return;
+
+		if (dx != floor(dx) || dy != floor(dy) ||
+			fabs(dx) >= width || fabs(dy) >= height || (mIsPyramidEnabled && scale < 1.0) ||
+			mIsPlotEnabled || mDrawOverlayFunc != NULL || mRenderOverlayFunc != NULL)
+		{
+			UpdateImageDisp();
+			return;
+		}
+
+		::ScrollWindowEx(mWindowH, (int )dx, (int )dy, &mImageDispRect, &mImageDispRect,
+						NULL, NULL, SW_INVALIDATE);
+		::UpdateWindow(mWindowH);
+	}
+
+	double	CalcImageScale(int inStep)
+	{
+		double	val, scale;
+
+		val = log10(mImageDispScale) + inStep / 100.0;
+		scale = pow(10, val);
+
+		// 100% snap & 1% limit (just in case...)
+		if (fabs(scale - 100.0) <= 1.0)
+			scale = 100;
+		if (scale <= 1.0)
+			scale = 1.0;
+
+		return scale;
+	}
+
+private:
+
+	enum
+	{
+		WINDOW_INIT_STATE	=	1,
+		WINDOW_OPEN_STATE,
+		WINDOW_CLOSED_STATE,
+		WINDOW_ERROR_STATE
+	};
+
+	int					mWindowState;
+	int					mPosX, mPosY;
+	char				*mWindowTitle;
+	int					mFileNameIndex;
+
+	HINSTANCE			mModuleH;
+	HWND				mWindowH;
+	HWND				mToolbarH;
+	HWND				mStatusbarH;
+	HWND				mRebarH;
+	HMENU				mMenuH;
+	HMENU				mPopupMenuH;
+
+	HCURSOR				mArrowCursor;
+	HCURSOR				mScrollCursor;
+	HCURSOR				mZoomPlusCursor;
+	HCURSOR				mZoomMinusCursor;
+	HCURSOR				mInfoCursor;
+
+	HICON				mAppIconH;
+
+	int					mPixValueGlyphScale;
+	std::vector< unsigned char >	mPixValueGlyphs;	// digit atlas, one mask byte per pixel
+
+	HANDLE				mMutexHandle;
+	HANDLE				mThreadHandle;
+	HANDLE				mEventHandle;
+	BITMAPINFOHEADER	*mBitmapInfo;
+	unsigned int		mBitmapInfoSize;
+	unsigned char		*mBitmapBits;
+	unsigned int		mBitmapBitsSize;
+
+	bool				mIsHiDPI;
+
+	bool				mIsThreadRunning;
+
+	unsigned char		*mAllocatedImageBuffer;
+	unsigned short		*mAllocated16BitsImageBuffer;
+	unsigned short		*mExternal16BitsImageBuffer;
+	unsigned int		m16BitsImageLineSize;
+	const unsigned char	*mExternalImageBuffer;
+	unsigned int		mExternalImageLineSize;
+
+	SIZE				mImageSize;
+	RECT				mImageDispRect;
+	SIZE				mImageDispSize;
+	SIZE				mImageDispOffset;
+	double				mImageDispScale;
+	double				mImagePrevScale;
+	SIZE				mImageDispOffsetStart;
+
+	bool				mIsColorImage;
+	bool				mIs16BitsImage;
+	ColorFormat			mColorFormat;
+	int					m16BitsImageBitDepth;
+	volatile LONG		mIsImageDispConverted;
+	bool				mIsBayerImage;		// mBayerImageBuffer has the raw image
+	BayerPattern		mBayerPattern;
+	DemosaicMode		mDemosaicMode;
+	unsigned char		*mBayerImageBuffer;
+	unsigned int		mBayerImageBufferSize;
+	bool				mIsYUVImage;		// mYUVImageBuffer has the image (lazy conversion)
+	YUVFormat			mYUVFormat;
+	YUVMatrix			mYUVMatrix;
+	unsigned char		*mYUVImageBuffer;
+	unsigned int		mYUVImageBufferSize;
+	unsigned int		mYUVImageLineSize;
+	bool				mIsWaterfallEnabled;
+	int					mWaterfallTopLine;	// buffer line shown at the top
+	volatile LONG		mIsWaterfallPaintPending;
+	volatile LONG		mIsReadoutPending;	// UpdateImageRegion() readout left to the paint
+	bool				mIsFloatImage;
+	bool				mIsFloatAutoRange;
+	float				mFloatBottomValue;
+	float				mFloatTopValue;
+	float				mFloatMinValue;		// finite range of the current float image
+	float				mFloatMaxValue;
+	float				*mFloatImageBuffer;
+	unsigned int		mFloatImageBufferSize;
+	std::vector<float>	mFloatLineRanges;	// min, max of each line
+	float				mFloatMapBottomValue;	// used by ConvertFloatLinesFunc()
+	float				mFloatMapScale;
+
+	int					mCursorMode;
+	int					mMouseDownMode;
+	bool				mIsMouseDragging;
+	POINT				mMouseDownPos;
+
+	bool				mIsFullScreenMode;
+	RECT				mLastWindowRect;
+
+	bool				mIsMenubarEnabled;
+	bool				mIsToolbarEnabled;
+	bool				mIsStatusbarEnabled;
+	bool				mIsPlotEnabled;
+	bool				mIsPlotValid;
+	ImagePlotParam		mPlotParam;		// frame and view the points were made for
+	std::vector< unsigned short >	mPlotLine;
+	std::vector< POINT >	mPlotPoints;	// relative to the image area
+
+	void				(*mDrawOverlayFunc)(ImageWindow *, HDC, void *);
+	void				*mOverlayFuncData;
+
+	bool				mIsSoftwareRenderEnabled;
+	void				(*mRenderOverlayFunc)(ImageWindow *, unsigned char *, int, int, unsigned int, void *);
+	void				*mRenderOverlayFuncData;
+	BITMAPINFOHEADER	mRenderBitmapInfo;
+	unsigned char		*mRenderBuffer;
+	unsigned int		mRenderBufferSize;
+	int					*mRenderXTable;
+	int					mRenderXTableSize;
+
+#define	FPS_DATA_NUM	25
+	double				mFPSValue;
+	double				mFPSData[FPS_DATA_NUM];
+	int					mFPSDataCount;
+
+	unsigned __int64	mFrequency;
+	unsigned __int64	mPrevCount;
+
+	bool				mIsRenderCoalescingEnabled;
+	double				mPresentRate;
+	int					mDisplayRefreshRate;
+	volatile LONG		mPendingFrameNum;
+	volatile LONG		mIsPresentPosted;
+	unsigned __int64	mLastPresentCount;
+	bool				mIsPanPending;
+	POINT				mPanPos;		// latest mouse position while panning
+	unsigned __int64	mLastPanCount;
+	unsigned __int64	mCoalescedFrameNum;
+
+	int					mMonitorNum;
+	RECT				mMonitorRect[MONITOR_ENUM_MAX];
+
+	bool				mIsMapModeEnabled;
+	unsigned short		mMapBottomValue;
+	unsigned short		mMapTopValue;
+	bool				mIsMapReverse;
+	unsigned short		mMapDirectMapLimit;
+	unsigned char		*mMapTable;
+	bool				mIsMapTableValid;
+	bool				mIsMapLinear;
+	bool				mIsMapPerChannel;
+	unsigned short		mMapBottomValues[3];	// RGB
+	unsigned short		mMapTopValues[3];		// RGB
+
+	bool				mIsAutoWindowLevelEnabled;
+	double				mAutoWindowLevelLowPercent;
+	double				mAutoWindowLevelHighPercent;
+	double				mAutoWindowLevelSmoothing;	// weight of the previous window
+	double				mAutoBottomValue;			// smoothed window
+	double				mAutoTopValue;
+	bool				mIsAutoWindowLevelValid;	// false until the first frame
+	LONG				mAutoWindowLevelGeneration;	// frame the lazy tiles took it from
+	std::vector< unsigned int >	mAutoWindowLevelHistogram;
+
+	int					mColormapIndex;
+	RGBQUAD				mColormapPalette[IMAGE_PALLET_SIZE_8BIT];
+	bool				mIs16BitsColormapEnabled;
+	unsigned int		*mColormapTable;	// 64K BGRA entries for 16-bit mono images
+	bool				mIsColormapTableValid;
+	ImageColormapTableParam	mColormapTableParam;	// map parameters the table was built for
+
+	ImageWindowThreadPool	*mThreadPool;
+	HANDLE				mThreadPoolMutexHandle;	// guards mThreadPool
+	int					mWorkerThreadNum;
+	unsigned int		mParallelMinSize;
+
+	bool				mIsLazyConversionEnabled;
+	LONG				*mTileGenerations;	// frame generation each tile was converted for
+	int					mTileNumX, mTileNumY;
+	SIZE				mTileImageSize;
+	RECT				mConvertTileRect;
+	volatile LONG		mFrameGeneration;
+	LONG				mConvertGeneration;
+
+	volatile LONGLONG	mBufferMemorySize;
+
+	bool				mIsPyramidEnabled;
+	ImagePyramidLevel	mPyramid[IMAGE_PYRAMID_LEVEL_MAX + 1];	// [0] is the image itself
+
+	bool				mIsTripleBufferEnabled;
+	ImageFrameBuffer	mFrameBuffers[FRAME_BUFFER_NUM];
+	volatile LONG		mFrameBufferState;	// [1:0] producer, [3:2] ready, [5:4] display, [6] new frame
+	volatile LONG		mFrameProducerNum;	// Producers writing into a slot (see EnterFrameProducer)
+
+	void	OnPresent()
+	{
+		unsigned __int64	currentCount;
+		unsigned __int64	interval = (unsigned __int64 )(mFrequency / GetPresentRate());
+
+		//	Triple buffered frames without coalescing are presented right away
+		::QueryPerformanceCounter((LARGE_INTEGER *)&currentCount);
+		if (mIsRenderCoalescingEnabled && currentCount - mLastPresentCount < interval)
+		{
+			//	Too early. mIsPresentPosted stays set, so no more messages are
+			//	posted until the timer fires.
+			UINT	waitTime = (UINT )((interval - (currentCount - mLastPresentCount)) * 1000 / mFrequency);
+			if (waitTime == 0)
+				waitTime = 1;
+			::SetTimer(mWindowH, IMAGE_PRESENT_TIMER_ID, waitTime, NULL);
+			return;
+		}
+
+		//	Cleared before presenting so that frames arriving from now on post again
+		InterlockedExchange(&mIsPresentPosted, 0);
+		mLastPresentCount = currentCount;
+
+		LONG	frameNum = InterlockedExchange(&mPendingFrameNum, 0);
+		if (frameNum == 0)
+			return;
+		mCoalescedFrameNum += frameNum - 1;
+
+		UpdateFPS(frameNum);
+		UpdateMousePixelReadout();
+		UpdateConvertedImageDisp();
+		UpdateFramePlot();
+		UpdateImageDisp();
+	}
+	void	UpdateDisplayRefreshRate()
+	{
+		HDC	hdc = ::GetDC(mWindowH);
+		int	refreshRate = ::GetDeviceCaps(hdc, VREFRESH);
+		::ReleaseDC(mWindowH, hdc);
+
+		//	0 and 1 mean the hardware default
+		if (refreshRate <= 1)
+			refreshRate = IMAGE_DEFAULT_REFRESH_RATE;
+		mDisplayRefreshRate = refreshRate;
+	}
+
+	void	InitFPS()
+	{
+		::QueryPerformanceFrequency((LARGE_INTEGER *)&mFrequency);
+		::QueryPerformanceCounter((LARGE_INTEGER *)&mPrevCount);
+
+		mFPSValue = 0;
+		mFPSDataCount = 0;
+	}
+
+	void	UpdateFPS(int inFrameNum = 1)
+	{
+		if (mWindowState != WINDOW_OPEN_STATE || mBitmapInfo == NULL)
+			return;
+		
+		unsigned __int64	currentCount;
+		::QueryPerformanceCounter((LARGE_INTEGER *)&currentCount);
+
+		mFPSValue = inFrameNum * (double )mFrequency / (double )(currentCount - mPrevCount);
+		mPrevCount = currentCount;
+		
+		if (mFPSDataCount < FPS_DATA_NUM)
+			mFPSDataCount++;
+		else
+			::MoveMemory(mFPSData, &(mFPSData[1]), sizeof(double) * (FPS_DATA_NUM - 1));	
+		mFPSData[mFPSDataCount - 1] = mFPSValue;
+
+		double	averageValue = 0;
+		for (int i = 0; i < mFPSDataCount; i++)
+			averageValue += mFPSData[i];
+		averageValue /= mFPSDataCount;
+
+#ifdef _UNICODE
+		wchar_t	buf[IMAGE_STR_BUF_SIZE];
+
+		swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f (avg.=%.1f)"), mFPSValue, averageValue);
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
+#else
+		char	buf[IMAGE_STR_BUF_SIZE];
+
+		sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f (avg.=%.1f)"), mFPSValue, averageValue);
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
+#endif
+	}
+
+	unsigned char	*GetPixelPointer(int inX, int inY)
+	{
+		if (inX < 0 || inX >= mImageSize.cx ||
+			inY < 0 || inY >= mImageSize.cy)
+			return NULL;
+
+		unsigned int	lineSize = GetBitmapLineSize();
+		int	pixelSize = mBitmapInfo->biBitCount / 8;
+
+		if (mIsWaterfallEnabled)
+			inY = GetWaterfallLine(inY);
+		if (mBitmapInfo->biHeight < 0)	// Topdown-up DIB
+			return &(mBitmapBits[lineSize * inY + (inX * pixelSize)]);
+
+		return &(mBitmapBits[lineSize * (mImageSize.cy - inY - 1) + (inX * pixelSize)]);
+	}
+	//	The 16-bit source lines are kept in the same order as the DIB lines
+	unsigned short	*Get16BitsPixelPointer(int inX, int inY)
+	{
+		unsigned char	*imagePtr = (unsigned char *)Get16BitsImageBufferPtr();
+
+		if (imagePtr == NULL || mBitmapInfo == NULL)
+			return NULL;
+
+		int	height = abs(mBitmapInfo->biHeight);
+		if (inX < 0 || inX >= mBitmapInfo->biWidth ||
+			inY < 0 || inY >= height)
+			return NULL;
+
+		if (mIsWaterfallEnabled)
+			inY = GetWaterfallLine(inY);
+		if (mBitmapInfo->biHeight > 0)
+			inY = height - inY - 1;
+		return &(((unsigned short *)&(imagePtr[m16BitsImageLineSize * inY]))[inX * Get16BitsChannelNum()]);
+	}
+
+	bool	UpdateMousePixelReadout()
+	{
+		POINT	pos;
+		int	x, y;
+		bool	result;
+
+		GetCursorPos(&pos);
+		ScreenToClient(mWindowH, &pos);
+		if (PtInRect(&mImageDispRect, pos) == 0)
+			result = false;
+		else
+			result = true;
+
+		pos.x -= mImageDispRect.left;
+		pos.y -= mImageDispRect.top;
+		x = (int )(pos.x / (mImageDispScale / 100.0));
+		y = (int )(pos.y / (mImageDispScale / 100.0));
+		x += mImageDispOffset.cx;
+		y += mImageDispOffset.cy;
+
+		unsigned char	*pixelPtr = GetPixelPointer(x, y);
+		unsigned short	value = 0;
+		int				rgb[3] = {0, 0, 0};
+		const float		*floatPtr = GetFloatPixelPointer(x, y);
+
+		if (mIs16BitsImage == true && result == true && pixelPtr != NULL)
+		{
+			const unsigned short	*imagePtr = Get16BitsPixelPointer(x, y);
+			if (imagePtr != NULL)
+			{
+				value = *imagePtr;
+				if (mIsColorImage == true)
+				{
+					int	redIndex = Get16BitsRedIndex();
+					rgb[0] = imagePtr[redIndex];
+					rgb[1] = imagePtr[1];
+					rgb[2] = imagePtr[2 - redIndex];
+				}
+			}
+		}
+		else if (mIsYUVImage && mIsLazyConversionEnabled && result == true && pixelPtr != NULL)
+		{
+			//	The tile may not be converted yet. The producer reallocates
+			//	mYUVImageBuffer under the mutex (see PrepareYUVImageBuffer)
+			DWORD	waitResult = WaitForSingleObject(mMutexHandle, INFINITE);
+			if (waitResult != WAIT_OBJECT_0)
+			{
+				printf("Error: WaitForSingleObject failed (UpdateMousePixelReadout)\n");
+				return false;
+			}
+			if (mIsYUVImage && mYUVImageBuffer != NULL &&
+				x < mBitmapInfo->biWidth && y < abs(mBitmapInfo->biHeight))
+			{
+				unsigned char	bgr[2 * 3];
+				ConvertYUVImageLine(mYUVImageBuffer, mYUVImageLineSize, mYUVFormat, y, x & ~1,
+									((x & ~1) + 1 < mBitmapInfo->biWidth) ? 2 : 1, bgr);
+				rgb[0] = bgr[(x & 1) * 3 + 2];
+				rgb[1] = bgr[(x & 1) * 3 + 1];
+				rgb[2] = bgr[(x & 1) * 3];
+			}
+			ReleaseMutex(mMutexHandle);
+		}
+		else if (mBitmapInfo != NULL && mBitmapInfo->biBitCount != 8 && pixelPtr != NULL)
+		{
+			int	redIndex = GetRedIndex();
+			rgb[0] = pixelPtr[redIndex];
+			rgb[1] = pixelPtr[1];
+			rgb[2] = pixelPtr[2 - redIndex];
+		}
+
+#ifdef _UNICODE
+		wchar_t	buf[IMAGE_STR_BUF_SIZE];
+
+		if (result == false || pixelPtr == NULL)
+			swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT(""));
+		else
+		{
+			if (floatPtr != NULL)
+			{
+				swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%g (%d,%d)"), *floatPtr, x, y);
+			}
+			else if (mIs16BitsImage == true && mIsColorImage == false)
+			{
+				swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%05d (%d,%d)"), value, x, y);
+			}
+			else if (mIs16BitsImage == true)
+			{
+				swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%05d %05d %05d (%d,%d)"),
+								rgb[0], rgb[1], rgb[2], x, y);
+			}
+			else
+			{
+				if (mBitmapInfo->biBitCount == 8)
+					swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d (%d,%d)"), pixelPtr[0], x, y);
+				else
+					swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d %03d %03d (%d,%d)"),
+								rgb[0], rgb[1], rgb[2], x, y);
+			}
+		}
+
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )2, (LPARAM )buf);
+#else
+		char	buf[IMAGE_STR_BUF_SIZE];
+
+		if (result == false || pixelPtr == NULL)
+			sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT(""));
+		else
+		{
+			if (floatPtr != NULL)
+			{
+				sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%g (%d,%d)"), *floatPtr, x, y);
+			}
+			else if (mIs16BitsImage == true && mIsColorImage == false)
+			{
+				sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%05d (%d,%d)"), value, x, y);
+			}
+			else if (mIs16BitsImage == true)
+			{
+				sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%05d %05d %05d (%d,%d)"),
+								rgb[0], rgb[1], rgb[2], x, y);
+			}
+			else
+			{
+				if (mBitmapInfo->biBitCount == 8)
+					sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d (%d,%d)"), pixelPtr[0], x, y);
+				else
+					sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d %03d %03d (%d,%d)"),
+								rgb[0], rgb[1], rgb[2], x, y);
+			}
+		}
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )2, (LPARAM )buf);
+#endif
+
+		return result;
+	}
+
+	void	UpdateWindowSize(bool inKeepDispScale = false)
 	{
-		switch (LOWORD(inWParam))
+		if (mWindowState != WINDOW_OPEN_STATE || mBitmapInfo == NULL)
+			return;
+
+		RECT	rebarRect, statusbarRect, rect;
+		int		imageWidth, imageHeight;
+
+		GetWindowRect(mRebarH, &rebarRect);
+		int	rebarHeight = rebarRect.bottom - rebarRect.top;
+		if (!IsToolbarEnabled())
+			rebarHeight = 0;
+		GetWindowRect(mStatusbarH, &statusbarRect);
+		int	statusbarHeight = statusbarRect.bottom - statusbarRect.top;
+		if (!IsStatusbarEnabled())
+			statusbarHeight = 0;
+
+		mImageSize.cx = mBitmapInfo->biWidth;
+		mImageSize.cy = abs(mBitmapInfo->biHeight);
+
+		if (inKeepDispScale == false)
 		{
-			case IDM_SAVE:
-				SaveBitmapFile();
-				break;
-			case IDM_SAVE_AS:
-				SaveAsBitmapFile();
-				break;
-			case IDM_PROPERTY:
-				DumpBitmapInfo();
-				break;
-			case IDM_CLOSE:
-				PostQuitMessage(0);
-				break;
-			case IDM_COPY:
-				CopyToClipboard();
-				break;
-			case IDM_MENUBAR:
-				if (IsMenubarEnabled())
-					DisableMenubar();
-				else
-					EnableMenubar();
-				break;
-			case IDM_TOOLBAR:
-				if (IsToolbarEnabled())
-					DisableToolbar();
-				else
-					EnableToolbar();
-				break;
-			case IDM_STATUSBAR:
-				if (IsStatusbarEnabled())
-					DisableStatusbar();
-				else
-					EnableStatusbar();
-				break;
-			case IDM_ZOOMPANE:
-				break;
-			case IDM_FULL_SCREEN:
-				if (IsFullScreenMode())
-					DisableFullScreenMode();
-				else
-					EnableFullScreenMode();
-				break;
-			case IDM_FPS:
-				break;
-			case IDM_PLOT:
-				if (IsPlotEnabled())
-					DisablePlot();
-				else
-					EnablePlot();
-				break;
-			case IDM_FREEZE:
-				break;
-			case IDM_SCROLL_TOOL:
-				SetCursorMode(CURSOR_MODE_SCROLL_TOOL);
-				break;
-			case IDM_ZOOM_TOOL:
-				SetCursorMode(CURSOR_MODE_ZOOM_TOOL);
-				break;
-			case IDM_INFO_TOOL:
-				SetCursorMode(CURSOR_MODE_INFO_TOOL);
-				break;
-			case IDM_ZOOM_IN:
-				ZoomIn();
-				if (GetKeyState(VK_CONTROL) < 0)
-					UpdateWindowSize(true);
-				break;
-			case IDM_ZOOM_OUT:
-				ZoomOut();
-				if (GetKeyState(VK_CONTROL) < 0)
-					UpdateWindowSize(true);
-				break;
-			case IDM_ACTUAL_SIZE:
-				if (GetKeyState(VK_CONTROL) < 0 || IsFullScreenMode() == true)
-					SetDispScale(100);
-				else
-				{
-					UpdateWindowSize();
-					UpdateImageDisp();
-				}
-				break;
-			case IDM_FIT_WINDOW:
-				FitDispScaleToWindowSize();
-				break;
-			case IDM_ADJUST_WINDOW_SIZE:
-				if (IsFullScreenMode() == false)
-					UpdateWindowSize(true);
-				break;
-			case IDM_CASCADE_WINDOW:
-				break;
-			case IDM_TILE_WINDOW:
-				break;
-			case IDM_ABOUT:
-				::MessageBox(mWindowH,
-					TEXT("ImageWindow Ver.1.0.0\nDairoku Sekiguchi (2007/10/13)"),
-					TEXT("About ImageWindow"), MB_OK);
-				break;
+			mImageDispScale = 100.0;
+			imageWidth = mImageSize.cx;
+			imageHeight = mImageSize.cy;
+		}
+		else
+		{
+			imageWidth = (int )(mImageSize.cx * mImageDispScale / 100.0);
+			imageHeight = (int )(mImageSize.cy * mImageDispScale / 100.0);
 		}
+
+		int	displayWidth = GetSystemMetrics(SM_CXSCREEN);
+		int	displayHEIGHT = GetSystemMetrics(SM_CYSCREEN);
+
+		if (imageWidth > displayWidth)
+			imageWidth = displayWidth;
+		if (imageHeight > displayHEIGHT)
+			imageHeight = displayHEIGHT;
+
+		rect.left = 0;
+		rect.top = 0;
+		rect.right = imageWidth;
+		rect.bottom = imageHeight + rebarHeight + statusbarHeight;
+		mImageDispRect = rect;
+		mImageDispRect.top = rebarHeight;
+		mImageDispRect.bottom -= statusbarHeight;
+		mImageDispSize.cx = mImageDispRect.right - mImageDispRect.left;
+		mImageDispSize.cy = mImageDispRect.bottom - mImageDispRect.top;
+		mImageDispOffset.cx = 0;
+		mImageDispOffset.cy = 0;
+		AdjustWindowRect(&rect, WS_OVERLAPPEDWINDOW, TRUE);	// if menu is enabled
+
+		SetWindowPos(mWindowH, NULL, 0, 0,
+			rect.right - rect.left, rect.bottom - rect.top, SWP_NOMOVE | SWP_NOOWNERZORDER);
+
+		UpdateStatusBar();
 	}
 
-	virtual void	OnKeyDown(WPARAM ininWParam, LPARAM inLParam)
+	void	UpdateImageDispDispRect()
 	{
-		switch (ininWParam)
+		if (mWindowState != WINDOW_OPEN_STATE || mBitmapInfo == NULL)
+			return;
+
+		RECT	rebarRect, statusbarRect, rect;
+
+		GetWindowRect(mRebarH, &rebarRect);
+		int	rebarHeight = rebarRect.bottom - rebarRect.top;
+		if (!IsToolbarEnabled())
+			rebarHeight = 0;
+		GetWindowRect(mStatusbarH, &statusbarRect);
+		int	statusbarHeight = statusbarRect.bottom - statusbarRect.top;
+		if (!IsStatusbarEnabled())
+			statusbarHeight = 0;
+
+		GetClientRect(mWindowH, &rect);
+		rect.top += rebarHeight;
+		rect.bottom -= statusbarHeight;
+		mImageDispRect = rect;
+		mImageDispSize.cx = mImageDispRect.right - mImageDispRect.left;
+		mImageDispSize.cy = mImageDispRect.bottom - mImageDispRect.top;
+	}
+
+
+	void	UpdateStatusBar()
+	{
+		RECT	rect;
+		GetClientRect(mWindowH, &rect);
+
+		int	statusbarSize[] = {100, 300, rect.right - 200, rect.right};
+		SendMessage(mStatusbarH, SB_SETPARTS, (WPARAM )4, (LPARAM )(LPINT)statusbarSize);
+
+#ifdef _UNICODE
+		wchar_t	buf[IMAGE_STR_BUF_SIZE];
+
+		swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("Zoom: %.0f%%"), mImageDispScale);
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )0, (LPARAM )buf);
+
+		if (mBitmapInfo != NULL)
 		{
-			case VK_SHIFT:
-				UpdateMouseCursor();
-				break;
+			swprintf_s(buf, IMAGE_STR_BUF_SIZE,
+				TEXT("Image: %dx%dx%d"),
+				mBitmapInfo->biWidth, abs(mBitmapInfo->biHeight), mBitmapInfo->biBitCount);
+			SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )1, (LPARAM )buf);
+		}
+
+		swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f"), mFPSValue);
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
+#else
+		char	buf[IMAGE_STR_BUF_SIZE];
+
+		sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("Zoom: %.0f%%"), mImageDispScale);
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )0, (LPARAM )buf);
+
+		if (mBitmapInfo != NULL)
+		{
+			sprintf_s(buf, IMAGE_STR_BUF_SIZE,
+				TEXT("Image: %dx%dx%d"),
+				mBitmapInfo->biWidth, abs(mBitmapInfo->biHeight), mBitmapInfo->biBitCount);
+			SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )1, (LPARAM )buf);
+		}
+
+		sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f"), mFPSValue);
+		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
+#endif
+	}
+
+	bool	CheckImageDispOffset()
+	{
+		int	limit;
+		double	scale = mImageDispScale / 100.0;
+		bool	update = false;
+		SIZE	prevOffset = mImageDispOffset;
+
+		limit = (int )(mImageSize.cx - mImageDispSize.cx / scale);
+		if (mImageDispOffset.cx > limit)
+		{
+			mImageDispOffset.cx = limit;
+			update = true;
+		}
+		if (mImageDispOffset.cx < 0)
+		{
+			mImageDispOffset.cx = 0;
+			update = true;
+		}
+		limit = (int )(mImageSize.cy - mImageDispSize.cy / scale);
+		if (mImageDispOffset.cy > limit)
+		{
+			mImageDispOffset.cy = limit;
+			update = true;
 		}
+		if (mImageDispOffset.cy < 0)
+		{
+			mImageDispOffset.cy = 0;
+			update = true;
+		}
+
+		if (prevOffset.cx == mImageDispOffset.cx &&
+			prevOffset.cy == mImageDispOffset.cy)
+			update = false;
+
+		return update;
 	}
 
-	virtual void	OnKeyUp(WPARAM ininWParam, LPARAM inLParam)
+	void	DrawImage(HDC inHDC)
 	{
-		switch (ininWParam)
+		//	Called with mMutexHandle held, the lines under the mouse can be read
+		bool	isReadoutPending = (InterlockedExchange(&mIsReadoutPending, 0) != 0);
+		if (InterlockedExchange(&mIsWaterfallPaintPending, 0) != 0 || isReadoutPending)
+			UpdateMousePixelReadout();
+
+		//	The pixel values are drawn into the rendered view from the glyph
+		//	atlas, so the view is blitted once instead of one TextOut per pixel.
+		//	The waterfall lines are put in order by the renderer.
+		if ((mIsSoftwareRenderEnabled || IsPixelValueVisible() || mIsWaterfallEnabled) &&
+			DrawRenderedImage(inHDC))
 		{
-			case VK_SHIFT:
-				UpdateMouseCursor();
-				break;
+			if (mDrawOverlayFunc != NULL)
+				mDrawOverlayFunc(this, inHDC, mOverlayFuncData);
+			return;
 		}
-	}
 
-	virtual void	OnChar(WPARAM ininWParam, LPARAM inLParam)
-	{
-		switch (ininWParam)
+		if (mImageDispScale == 100)
 		{
-			case VK_ESCAPE:
-				if (IsFullScreenMode())
-					DisableFullScreenMode();
-				break;
-			case 's':
-			case 'S':
-				SaveBitmapFile();
-				break;
-			case 'd':
-			case 'D':
-				DumpBitmapInfo();
-				break;
-			case 'f':
-			case 'F':
-				if (IsFullScreenMode())
-					DisableFullScreenMode();
-				else
-					EnableFullScreenMode();
-				break;
-			case '+':
-				ZoomIn();
-				break;
-			case '-':
-				ZoomOut();
-				break;
-			case '=':
-				SetDispScale(100);
-				break;
+			SetDIBitsToDevice(inHDC,
+				mImageDispRect.left, mImageDispRect.top,
+				mImageSize.cx, mImageSize.cy,
+				mImageDispOffset.cx, -1 * mImageDispOffset.cy,
+				0, mImageSize.cy,
+				mBitmapBits, (BITMAPINFO *)mBitmapInfo, DIB_RGB_COLORS);
 		}
-	}
-
-	virtual void	OnLButtonDown(UINT inMessage, WPARAM inWParam, LPARAM inLParam)
-	{
-		POINT	localPos;
-		int	x, y;
-		double	scale;
-
-		mMouseDownPos.x = (short )LOWORD(inLParam);
-		mMouseDownPos.y = (short )HIWORD(inLParam);
-
-		if ((inWParam & MK_CONTROL) == 0)
-			mMouseDownMode = mCursorMode;
 		else
-			mMouseDownMode = CURSOR_MODE_SCROLL_TOOL;
+		{
+			double	scale = (mImageDispScale / 100.0);
+			int		level = PreparePyramidLevel(scale);
 
-		switch (mMouseDownMode)
+			SetStretchBltMode(inHDC, COLORONCOLOR);
+			if (level == 0)
+			{
+				StretchDIBits(inHDC,
+					mImageDispRect.left, mImageDispRect.top,
+					(int )(mImageSize.cx * scale),
+					(int )(mImageSize.cy * scale),
+					mImageDispOffset.cx, -1 * mImageDispOffset.cy,
+					mImageSize.cx, mImageSize.cy,
+					mBitmapBits, (BITMAPINFO *)mBitmapInfo, DIB_RGB_COLORS, SRCCOPY);
+			}
+			else
+			{
+				ImagePyramidLevel	*pyramidLevel = &(mPyramid[level]);
+				StretchDIBits(inHDC,
+					mImageDispRect.left, mImageDispRect.top,
+					(int )(mImageSize.cx * scale),
+					(int )(mImageSize.cy * scale),
+					mImageDispOffset.cx >> level, -1 * (mImageDispOffset.cy >> level),
+					pyramidLevel->Width, pyramidLevel->Height,
+					pyramidLevel->BitmapBits, (BITMAPINFO *)pyramidLevel->BitmapInfo,
+					DIB_RGB_COLORS, SRCCOPY);
+			}
+		}
+
+		if (mIsPlotEnabled)
 		{
-			case CURSOR_MODE_SCROLL_TOOL:
-				mIsMouseDragging = true;
-				mImageDispOffsetStart = mImageDispOffset;
-				SetCapture(mWindowH);
-				break;
-			case CURSOR_MODE_ZOOM_TOOL:
-				localPos = mMouseDownPos;
-				localPos.x -= mImageDispRect.left;
-				localPos.y -= mImageDispRect.top;
-				scale = mImageDispScale / 100.0;
-				x = (int )(localPos.x / scale);
-				y = (int )(localPos.y / scale);
-				x += mImageDispOffset.cx;
-				y += mImageDispOffset.cy;
+			RECT	rect = GetImageClientRect();
+			POINT	prevOrigin;
 
-				if ((inWParam & MK_SHIFT) == 0)
-					scale = CalcImageScale(IMAGE_ZOOM_STEP);
-				else
-					scale = CalcImageScale(-IMAGE_ZOOM_STEP);
+			UpdatePlot(rect.right - rect.left, rect.bottom - rect.top);
+			if (mPlotPoints.size() >= 2)
+			{
+				HPEN	hPen = CreatePen(PS_SOLID, 1, RGB(0xFF, 0xFF, 0xFF));
+				HGDIOBJ	prevPen = SelectObject(inHDC, hPen);
+
+				OffsetViewportOrgEx(inHDC, rect.left, rect.top, &prevOrigin);
+				Polyline(inHDC, &(mPlotPoints[0]), (int )mPlotPoints.size());
+				SetViewportOrgEx(inHDC, prevOrigin.x, prevOrigin.y, NULL);
+				SelectObject(inHDC, prevPen);
+				DeleteObject(hPen);
+			}
+		}
 
-				mImageDispOffset.cx = x - (int )(localPos.x / (scale / 100.0));
-				mImageDispOffset.cy = y - (int )(localPos.y / (scale / 100.0));
-				SetDispScale(scale);
-				break;
-			case CURSOR_MODE_INFO_TOOL:
-				localPos = mMouseDownPos;
-				localPos.x -= mImageDispRect.left;
-				localPos.y -= mImageDispRect.top;
-				scale = mImageDispScale / 100.0;
-				x = (int )(localPos.x / scale);
-				y = (int )(localPos.y / scale);
-				x += mImageDispOffset.cx;
-				y += mImageDispOffset.cy;
+		if (mDrawOverlayFunc != NULL)
+			mDrawOverlayFunc(this, inHDC, mOverlayFuncData);
+	}
 
-				if (x <0 || y < 0 ||
-					x >= GetImageWidth() || y >= GetImageHeight())
-					break;
+	bool	DrawRenderedImage(HDC inHDC)
+	{
+		RECT	rect = mImageDispRect;
+		RECT	clipRect;
 
-				mImageClickNum++;
-				mLastImageClickX = x;
-				mLastImageClickY = y;
+		//	Only the clip box is rendered (the exposed strip after a pan,
+		//	see ScrollImageDisp()) unless something is drawn for the whole view
+		if (IsPixelValueVisible() == false && mIsPlotEnabled == false && mRenderOverlayFunc == NULL &&
+			::GetClipBox(inHDC, &clipRect) != ERROR)
+		{
+			if (::IntersectRect(&rect, &mImageDispRect, &clipRect) == FALSE)
+				return true;
+		}
 
-				int	v = mBitmapBits[mImageSize.cx * y + x];
-				char	buf[256];
+		int	width = rect.right - rect.left;
+		int	height = rect.bottom - rect.top;
+		unsigned int	lineSize = ((width * 3) + 3) & ~3;	// DWORD aligned
 
-				if (mIs16BitsImage == true)
-				{
-					unsigned short	value = 0;
+		if (width <= 0 || height <= 0)
+			return false;
 
-					if (mAllocated16BitsImageBuffer != NULL)
-						value = mAllocated16BitsImageBuffer[x + y * mImageSize.cx];
-					if (mExternal16BitsImageBuffer != NULL)
-						value = mExternal16BitsImageBuffer[x + y * mImageSize.cx];
-					
-					printf("%d: X:%.4d Y:%.4d VALUE:%.3d %.5d\n", mImageClickNum, x, y, v, value);
-				}
-				else
-				{
-					_itoa(v, buf, 2);
-					printf("%d: X:%.4d Y:%.4d VALUE:%.3d %.2X %s\n", mImageClickNum, x, y, v, v, buf);
-				}
-				break;
+		if (mRenderBuffer == NULL || mRenderBufferSize < lineSize * height)
+		{
+			if (mRenderBuffer != NULL)
+				delete [] mRenderBuffer;
+			mRenderBufferSize = lineSize * height;
+			mRenderBuffer = new unsigned char[mRenderBufferSize];
+			if (mRenderBuffer == NULL)
+			{
+				printf("Error: Can't allocate mRenderBuffer (DrawRenderedImage)\n");
+				mRenderBufferSize = 0;
+				return false;
+			}
 		}
+
+		if (RenderView(mRenderBuffer, width, height, lineSize, GetSysColor(COLOR_WINDOW),
+						rect.left - mImageDispRect.left, rect.top - mImageDispRect.top) == false)
+			return false;
+
+		mRenderBitmapInfo.biSize			= sizeof(BITMAPINFOHEADER);
+		mRenderBitmapInfo.biWidth			= width;
+		mRenderBitmapInfo.biHeight			= -1 * height;	// Top-down DIB
+		mRenderBitmapInfo.biPlanes			= 1;
+		mRenderBitmapInfo.biBitCount		= 24;
+		mRenderBitmapInfo.biCompression		= BI_RGB;
+		mRenderBitmapInfo.biSizeImage		= lineSize * height;
+
+		SetDIBitsToDevice(inHDC,
+			rect.left, rect.top,
+			width, height,
+			0, 0, 0, height,
+			mRenderBuffer, (BITMAPINFO *)&mRenderBitmapInfo, DIB_RGB_COLORS);
+		return true;
 	}
 
-	virtual void	OnMButtonDown(UINT inMessage, WPARAM inWParam, LPARAM inLParam)
+	//	Software version of DrawImage(). It samples the image the same way as
+	//	StretchDIBits() with COLORONCOLOR (nearest neighbor), the lines are
+	//	rendered by ImageWindowKernel::RenderLines() from plain buffers.
+	//	inOriginX and inOriginY place outBuffer in the view, so that a part of
+	//	it can be rendered. The pixel values, the plot and the render overlay
+	//	are drawn for the whole view, only use them with a zero origin.
+	bool	RenderView(unsigned char *outBuffer, int inWidth, int inHeight, unsigned int inLineSize,
+						COLORREF inBkColor, int inOriginX = 0, int inOriginY = 0)
 	{
-		POINT	localPos;
-		int	x, y;
-		double	scale;
+		if (mBitmapInfo == NULL || mBitmapBits == NULL)
+			return false;
+		if (mBitmapInfo->biBitCount != 8 && mBitmapInfo->biBitCount != 24 &&
+			mBitmapInfo->biBitCount != 32)
+		{
+			printf("Error: Unsupported biBitCount (RenderView)\n");
+			return false;
+		}
 
-		localPos.x = (short )LOWORD(inLParam);
-		localPos.y = (short )HIWORD(inLParam);
+		if (mRenderXTable == NULL || mRenderXTableSize < inWidth)
+		{
+			if (mRenderXTable != NULL)
+				delete [] mRenderXTable;
+			mRenderXTableSize = inWidth;
+			mRenderXTable = new int[mRenderXTableSize];
+			if (mRenderXTable == NULL)
+			{
+				printf("Error: Can't allocate mRenderXTable (RenderView)\n");
+				mRenderXTableSize = 0;
+				return false;
+			}
+		}
 
-		localPos.x -= mImageDispRect.left;
-		localPos.y -= mImageDispRect.top;
-		scale = mImageDispScale / 100.0;
-		x = (int )(localPos.x / scale);
-		y = (int )(localPos.y / scale);
-		x += mImageDispOffset.cx;
-		y += mImageDispOffset.cy;
+		double	scale = (mImageDispScale / 100.0);
+		int		level = PreparePyramidLevel(scale);
+		ImageRenderParam	renderParam;
 
-		if ((inWParam & (MK_SHIFT + MK_CONTROL)) == 0)
-			scale = 100;
+		if (level == 0)
+		{
+			int	height = abs(mBitmapInfo->biHeight);
+			renderParam.Bits		= mBitmapBits;
+			renderParam.LineSize	= GetBitmapLineSize();
+			renderParam.Width		= mBitmapInfo->biWidth;
+			renderParam.Height		= height;
+			renderParam.OffsetX		= mImageDispOffset.cx;
+			renderParam.OffsetY		= mImageDispOffset.cy;
+			renderParam.Scale		= scale;
+		}
 		else
 		{
-			if ((inWParam & MK_SHIFT) == 0)
-				scale = 3000;
-			else
-				scale = CalcWindowSizeFitScale();
+			renderParam.Bits		= mPyramid[level].BitmapBits;
+			renderParam.LineSize	= mPyramid[level].LineSize;
+			renderParam.Width		= mPyramid[level].Width;
+			renderParam.Height		= mPyramid[level].Height;
+			renderParam.OffsetX		= mImageDispOffset.cx >> level;
+			renderParam.OffsetY		= mImageDispOffset.cy >> level;
+			renderParam.Scale		= scale * (1 << level);
+		}
+		renderParam.IsBottomUp		= (mBitmapInfo->biHeight > 0);
+		renderParam.OriginX			= inOriginX;
+		renderParam.OriginY			= inOriginY;
+		renderParam.TopLine			= (level == 0 && mIsWaterfallEnabled) ? mWaterfallTopLine : 0;
+		renderParam.BitCount		= mBitmapInfo->biBitCount;
+		renderParam.RedIndex		= GetRedIndex();
+		renderParam.XTable			= mRenderXTable;
+		renderParam.Buffer			= outBuffer;
+		renderParam.BufferWidth		= inWidth;
+		renderParam.BufferLineSize	= inLineSize;
+		renderParam.BkColor[0]		= GetBValue(inBkColor);
+		renderParam.BkColor[1]		= GetGValue(inBkColor);
+		renderParam.BkColor[2]		= GetRValue(inBkColor);
+
+		if (renderParam.BitCount == 8)
+		{
+			const RGBQUAD	*palette = (const RGBQUAD *)((const unsigned char *)mBitmapInfo + mBitmapInfo->biSize);
+			int	paletteNum = (mBitmapInfoSize - mBitmapInfo->biSize) / sizeof(RGBQUAD);
+			for (int i = 0; i < 256; i++)
+			{
+				int	index = (i < paletteNum) ? i : paletteNum - 1;
+				renderParam.Palette[i][0] = (index < 0) ? i : palette[index].rgbBlue;
+				renderParam.Palette[i][1] = (index < 0) ? i : palette[index].rgbGreen;
+				renderParam.Palette[i][2] = (index < 0) ? i : palette[index].rgbRed;
+			}
 		}
 
-		if (mImageDispScale == scale)
-			scale = mImagePrevScale;
+		ImageWindowKernel::MakeRenderXTable(&renderParam, mRenderXTable);
 
-		mImagePrevScale = mImageDispScale;
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= &renderParam;
+		param.Dst		= outBuffer;
+		param.LineSize	= inLineSize;
+		RunLineBands(RenderLinesFunc, &param, inHeight, inLineSize * inHeight);
 
-		mImageDispOffset.cx = x - (int )(localPos.x / (scale / 100.0));
-		mImageDispOffset.cy = y - (int )(localPos.y / (scale / 100.0));
-		SetDispScale(scale);
+		if (IsPixelValueVisible() && level == 0)
+			RenderPixelValues(&renderParam, inHeight);
+
+		if (mIsPlotEnabled)
+			RenderPlot(outBuffer, inWidth, inHeight, inLineSize);
+
+		if (mRenderOverlayFunc != NULL)
+			mRenderOverlayFunc(this, outBuffer, inWidth, inHeight, inLineSize, mRenderOverlayFuncData);
+
+		return true;
+	}
+	static void	RenderLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
+
+		ImageWindowKernel::RenderLines((const ImageRenderParam *)param->Src, inStartLine, inEndLine);
+	}
+	//	Float values don't fit the digit glyphs
+	bool	IsPixelValueVisible()
+	{
+		return (mImageDispScale >= IMAGE_PIXEL_VALUE_MIN_SCALE && mBitmapInfo != NULL &&
+				mIsFloatImage == false);
 	}
+	//	Scales the 3x5 digit glyphs into the atlas. Rebuilt only when the
+	//	glyph scale changes.
+	void	UpdatePixValueGlyphs(int inScale)
+	{
+		static const unsigned char	digitGlyphs[10][5] =
+		{
+			{7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7}, {5, 5, 7, 1, 1},
+			{7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1}, {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7}
+		};
+		int	glyphWidth = 3 * inScale;
+		int	glyphHeight = 5 * inScale;
 
-	virtual void	OnMouseMove(WPARAM inWParam, LPARAM inLParam)
+		if (mPixValueGlyphScale == inScale)
+			return;
+
+		mPixValueGlyphs.assign(10 * glyphWidth * glyphHeight, 0);
+		for (int d = 0; d < 10; d++)
+			for (int gy = 0; gy < glyphHeight; gy++)
+				for (int gx = 0; gx < glyphWidth; gx++)
+					if (digitGlyphs[d][gy / inScale] & (4 >> (gx / inScale)))
+						mPixValueGlyphs[(d * glyphHeight + gy) * glyphWidth + gx] = 1;
+		mPixValueGlyphScale = inScale;
+	}
+	typedef struct
 	{
-		if (mIsMouseDragging == false)
+		const ImageRenderParam	*RenderParam;
+		int					Height;			// of the render buffer
+		int					DigitNum;		// 3 for 8-bit, 5 for 16-bit values
+		int					ValueNum;		// 1 for mono, 3 (R, G, B lines) for color
+		int					GlyphScale;
+	} PixelValueParam;
+
+	//	One line of digits per value, centered in the zoomed pixel. The text
+	//	is black or white depending on the displayed color.
+	void	RenderPixelValues(const ImageRenderParam *inParam, int inHeight)
+	{
+		PixelValueParam	valueParam;
+		double	scale = inParam->Scale;
+
+		valueParam.RenderParam	= inParam;
+		valueParam.Height		= inHeight;
+		valueParam.DigitNum		= mIs16BitsImage ? 5 : 3;
+		valueParam.ValueNum		= mIsColorImage ? 3 : 1;
+
+		//	The largest glyph scale the text fits the pixel with
+		valueParam.GlyphScale = IMAGE_PIXEL_VALUE_GLYPH_SCALE;
+		while (valueParam.GlyphScale > 0 &&
+			   (valueParam.DigitNum * (3 * valueParam.GlyphScale + 1) + 1 > scale ||
+				valueParam.ValueNum * (5 * valueParam.GlyphScale + 1) + 1 > scale))
+			valueParam.GlyphScale--;
+		if (valueParam.GlyphScale == 0)
 			return;
+		UpdatePixValueGlyphs(valueParam.GlyphScale);
+
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= &valueParam;
+		param.Dst		= inParam->Buffer;
+		int	numY = (int )ceil(inHeight / scale);
+		RunLineBands(PixelValueLinesFunc, &param, numY, inParam->BufferLineSize * inHeight);
+	}
+	static void	PixelValueLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
 
-		POINT	currentPos;
-		double	scale = mImageDispScale / 100.0;
+		param->Window->RenderPixelValueRows((const PixelValueParam *)param->Src, inStartLine, inEndLine);
+	}
+	void	RenderPixelValueRows(const PixelValueParam *inParam, int inStartRow, int inEndRow)
+	{
+		const ImageRenderParam	*renderParam = inParam->RenderParam;
+		double	scale = renderParam->Scale;
+		int		numX = (int )ceil(renderParam->BufferWidth / scale);
+		int		glyphScale = inParam->GlyphScale;
+		int		textWidth = inParam->DigitNum * (3 * glyphScale + 1) - 1;
+		int		textHeight = inParam->ValueNum * (5 * glyphScale + 1) - 1;
+		int		redIndex = renderParam->RedIndex;
+		int		redIndex16 = Get16BitsRedIndex();
+
+		for (int y = inStartRow; y < inEndRow; y++)
+		{
+			int	srcY = renderParam->OffsetY + y;
+			if (srcY < 0 || srcY >= renderParam->Height)
+				continue;
+			int	dibY = (srcY + renderParam->TopLine) % renderParam->Height;
+			if (renderParam->IsBottomUp)
+				dibY = renderParam->Height - dibY - 1;
+			const unsigned char	*srcLine = &(renderParam->Bits[renderParam->LineSize * dibY]);
+			int	textY = (int )((double )y * scale + (scale - textHeight) * 0.5);
+
+			for (int x = 0; x < numX; x++)
+			{
+				int	srcX = renderParam->OffsetX + x;
+				if (srcX < 0 || srcX >= renderParam->Width)
+					continue;
 
-		currentPos.x = (short )LOWORD(inLParam);
-		currentPos.y = (short )HIWORD(inLParam);
+				unsigned int	values[3];
+				if (mIs16BitsImage)
+				{
+					const unsigned short	*pixelPtr = Get16BitsPixelPointer(srcX, srcY);
+					if (pixelPtr == NULL)
+						continue;
+					values[0] = pixelPtr[(inParam->ValueNum == 1) ? 0 : redIndex16];
+					values[1] = pixelPtr[1];
+					values[2] = pixelPtr[2 - redIndex16];
+				}
+				else if (inParam->ValueNum == 1)
+					values[0] = srcLine[srcX];
+				else
+				{
+					const unsigned char	*pixelPtr = &(srcLine[srcX * (renderParam->BitCount / 8)]);
+					values[0] = pixelPtr[redIndex];
+					values[1] = pixelPtr[1];
+					values[2] = pixelPtr[2 - redIndex];
+				}
 
-		switch (mMouseDownMode)
-		{
-			case CURSOR_MODE_SCROLL_TOOL:
-				mImageDispOffset = mImageDispOffsetStart;
-				mImageDispOffset.cx -= (int )((currentPos.x - mMouseDownPos.x) / scale);
-				mImageDispOffset.cy -= (int )((currentPos.y - mMouseDownPos.y) / scale);
-				CheckImageDispOffset();
-				UpdateImageDisp();
-				break;
-			case CURSOR_MODE_ZOOM_TOOL:
-				break;
-			case CURSOR_MODE_INFO_TOOL:
-				break;
+				//	The text color follows the displayed pixel at the cell center
+				int	textX = (int )((double )x * scale + (scale - textWidth) * 0.5);
+				int	centerX = (int )((double )x * scale + scale * 0.5);
+				int	centerY = (int )((double )y * scale + scale * 0.5);
+				if (centerX >= renderParam->BufferWidth)
+					centerX = renderParam->BufferWidth - 1;
+				if (centerY >= inParam->Height)
+					centerY = inParam->Height - 1;
+				const unsigned char	*dispPtr = &(renderParam->Buffer[renderParam->BufferLineSize * centerY + centerX * 3]);
+				int	luminance = (dispPtr[2] * 77 + dispPtr[1] * 151 + dispPtr[0] * 28) >> 8;
+				unsigned char	color = (luminance > 0x80) ? 0x00 : 0xFF;
+
+				for (int i = 0; i < inParam->ValueNum; i++)
+					DrawPixelValueText(inParam, textX, textY + i * (5 * glyphScale + 1), values[i], color);
+			}
 		}
 	}
-
-	virtual void	OnLButtonUp(WPARAM inWParam, LPARAM inLParam)
+	//	Copies the digits of inValue (with leading zeros) from the glyph atlas
+	void	DrawPixelValueText(const PixelValueParam *inParam, int inX, int inY, unsigned int inValue,
+								unsigned char inColor)
 	{
-		switch (mMouseDownMode)
+		const ImageRenderParam	*renderParam = inParam->RenderParam;
+		int		glyphWidth = 3 * inParam->GlyphScale;
+		int		glyphHeight = 5 * inParam->GlyphScale;
+		int		digits[5];
+
+		for (int i = inParam->DigitNum - 1; i >= 0; i--)
 		{
-			case CURSOR_MODE_SCROLL_TOOL:
-				mIsMouseDragging = false;
-				ReleaseCapture();
-				break;
-			case CURSOR_MODE_ZOOM_TOOL:
-				break;
-			case CURSOR_MODE_INFO_TOOL:
-				break;
+			digits[i] = inValue % 10;
+			inValue /= 10;
+		}
+
+		for (int i = 0; i < inParam->DigitNum; i++)
+		{
+			const unsigned char	*glyph = &(mPixValueGlyphs[digits[i] * glyphWidth * glyphHeight]);
+			int	glyphX = inX + i * (glyphWidth + 1);
+
+			for (int gy = 0; gy < glyphHeight; gy++)
+			{
+				int	py = inY + gy;
+				if (py < 0 || py >= inParam->Height)
+					continue;
+				const unsigned char	*mask = &(glyph[gy * glyphWidth]);
+				unsigned char		*dstPtr = &(renderParam->Buffer[renderParam->BufferLineSize * py]);
+				for (int gx = 0; gx < glyphWidth; gx++)
+				{
+					int	px = glyphX + gx;
+					if (mask[gx] == 0 || px < 0 || px >= renderParam->BufferWidth)
+						continue;
+					dstPtr[px * 3] = dstPtr[px * 3 + 1] = dstPtr[px * 3 + 2] = inColor;
+				}
+			}
+		}
+	}
+	void	RenderPlot(unsigned char *outBuffer, int inWidth, int inHeight, unsigned int inLineSize)
+	{
+		UpdatePlot(inWidth, inHeight);
+		for (size_t i = 1; i < mPlotPoints.size(); i++)
+			RenderLine(outBuffer, inWidth, inHeight, inLineSize,
+						mPlotPoints[i - 1].x, mPlotPoints[i - 1].y, mPlotPoints[i].x, mPlotPoints[i].y);
+	}
+	//	Decimates the new frame on the calling thread, so that painting only
+	//	draws the points (unless the view changes in between)
+	void	UpdateFramePlot()
+	{
+		if (mIsPlotEnabled == false)
+			return;
+
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (UpdateFramePlot)\n");
+			return;
 		}
+		UpdatePlot(mImageDispRect.right - mImageDispRect.left, mImageDispRect.bottom - mImageDispRect.top);
+		ReleaseMutex(mMutexHandle);
 	}
-
-	virtual void	OnRButtonDown(UINT inMessage, WPARAM inWParam, LPARAM inLParam)
+	//	Makes the plot points of the clicked line (the center line if not
+	//	clicked) for an inWidth x inHeight view. Zoomed out, each screen column
+	//	gets the min and max of the pixels it covers, zoomed in, each pixel
+	//	gets a point at its center. Nothing is done if neither the frame nor
+	//	the view changed.
+	void	UpdatePlot(int inWidth, int inHeight)
 	{
-		POINT	pos;
+		int	width = GetImageWidth();
+		int	height = GetImageHeight();
+		ImagePlotParam	plotParam;
+
+		plotParam.Generation	= mFrameGeneration;
+		plotParam.ImageWidth	= width;
+		plotParam.LineY			= height / 2;
+		if (mImageClickNum != 0 && mLastImageClickY < height && mLastImageClickY >= 0)
+			plotParam.LineY		= mLastImageClickY;
+		plotParam.Scale			= mImageDispScale;
+		plotParam.OffsetX		= mImageDispOffset.cx;
+		plotParam.Width			= inWidth;
+		plotParam.Height		= inHeight;
+
+		if (mIsPlotValid &&
+			mPlotParam.Generation	== plotParam.Generation &&
+			mPlotParam.ImageWidth	== plotParam.ImageWidth &&
+			mPlotParam.LineY		== plotParam.LineY &&
+			mPlotParam.Scale		== plotParam.Scale &&
+			mPlotParam.OffsetX		== plotParam.OffsetX &&
+			mPlotParam.Width		== plotParam.Width &&
+			mPlotParam.Height		== plotParam.Height)
+			return;
 
-		pos.x = (short )LOWORD(inLParam);
-		pos.y = (short )HIWORD(inLParam);
+		mPlotParam = plotParam;
+		mIsPlotValid = true;
+		mPlotPoints.clear();
 
-		HMENU	menu = GetSubMenu(mPopupMenuH, 0);
-		ClientToScreen(mWindowH, &pos);
-		TrackPopupMenu(menu, TPM_LEFTALIGN, pos.x, pos.y, 0, mWindowH, NULL);
-	}
+		unsigned int	maxValue;
+		if (UpdatePlotLine(plotParam.LineY, &maxValue) == false)
+			return;
 
-	virtual void	OnMouseWheel(WPARAM inWParam, LPARAM inLParam)
-	{
-		POINT	mousePos;
-		int	x, y, zDelta;
-		double	scale;
+		double	scale = mImageDispScale / 100.0;
+		double	k = inHeight / (double )maxValue;
+		int		offsetX = plotParam.OffsetX;
+		POINT	point;
 
-		mousePos.x = (short )LOWORD(inLParam);
-		mousePos.y = (short )HIWORD(inLParam);
-		ScreenToClient(mWindowH, &mousePos);
-		if (PtInRect(&mImageDispRect, mousePos) == 0)
+		if (scale >= 1.0)
+		{
+			int	startX = (offsetX > 0) ? offsetX : 0;
+			int	endX = offsetX + (int )ceil(inWidth / scale) + 1;
+			if (endX > width)
+				endX = width;
+
+			mPlotPoints.reserve(endX > startX ? endX - startX : 0);
+			for (int i = startX; i < endX; i++)
+			{
+				point.x = (LONG )((i - offsetX + 0.5) * scale);
+				point.y = inHeight - (int )(k * mPlotLine[i]);
+				mPlotPoints.push_back(point);
+			}
 			return;
+		}
 
-		zDelta = GET_WHEEL_DELTA_WPARAM(inWParam);
+		//	The columns cover the same pixels as in RenderView()
+		mPlotPoints.reserve(inWidth * 2);
+		for (int x = 0; x < inWidth; x++)
+		{
+			int	startX = offsetX + (int )floor(x / scale);
+			int	endX = offsetX + (int )floor((x + 1) / scale);
+			if (startX < 0)
+				startX = 0;
+			if (endX > width)
+				endX = width;
+			if (startX >= endX)
+				continue;
+
+			unsigned short	minValue = 0xFFFF;
+			unsigned short	maxValue = 0;
+			ImageWindowKernel::MinMax16(&(mPlotLine[startX]), endX - startX, &minValue, &maxValue);
+
+			//	Starts from the end nearer to the previous column
+			int	minY = inHeight - (int )(k * minValue);
+			int	maxY = inHeight - (int )(k * maxValue);
+			if (mPlotPoints.empty() == false &&
+				abs(mPlotPoints.back().y - minY) < abs(mPlotPoints.back().y - maxY))
+			{
+				int	y = minY;
+				minY = maxY;
+				maxY = y;
+			}
+			point.x = x;
+			point.y = maxY;
+			mPlotPoints.push_back(point);
+			if (minY != maxY)
+			{
+				point.y = minY;
+				mPlotPoints.push_back(point);
+			}
+		}
+	}
+	//	Copies the samples of line inY into mPlotLine. Color images are
+	//	plotted with the green channel.
+	bool	UpdatePlotLine(int inY, unsigned int *outMaxValue)
+	{
+		int	width = GetImageWidth();
 
-		mousePos.x -= mImageDispRect.left;
-		mousePos.y -= mImageDispRect.top;
-		scale = mImageDispScale / 100.0;
-		x = (int )(mousePos.x / scale);
-		y = (int )(mousePos.y / scale);
-		x += mImageDispOffset.cx;
-		y += mImageDispOffset.cy;
+		if (mBitmapInfo == NULL || width <= 0)
+			return false;
 
-		if ((inWParam & (MK_SHIFT + MK_CONTROL)) == 0)
-			scale = CalcImageScale(zDelta / MOUSE_WHEEL_STEP);
+		mPlotLine.resize(width);
+		if (mIs16BitsImage)
+		{
+			const unsigned short	*imagePtr = Get16BitsPixelPointer(0, inY);
+			int	channelNum = Get16BitsChannelNum();
+
+			if (imagePtr == NULL)
+				return false;
+			imagePtr += (channelNum == 1) ? 0 : 1;
+			for (int i = 0; i < width; i++)
+				mPlotLine[i] = imagePtr[i * channelNum];
+			*outMaxValue = 65535;
+		}
 		else
 		{
-			if ((inWParam & MK_SHIFT) == 0)
-				scale = CalcImageScale(zDelta / MOUSE_WHEEL_STEP * 4);
-			else
-				scale = CalcImageScale(zDelta / MOUSE_WHEEL_STEP / 2);
+			const unsigned char	*imagePtr = GetPixelPointer(0, inY);
+			int	pixelSize = mBitmapInfo->biBitCount / 8;
+
+			if (imagePtr == NULL)
+				return false;
+			imagePtr += (pixelSize == 1) ? 0 : 1;
+			for (int i = 0; i < width; i++)
+				mPlotLine[i] = imagePtr[i * pixelSize];
+			*outMaxValue = 255;
 		}
+		return true;
+	}
+	//	Draws a white line like MoveToEx() and LineTo() do (the end point is excluded)
+	static void	RenderLine(unsigned char *outBuffer, int inWidth, int inHeight, unsigned int inLineSize,
+							int inX0, int inY0, int inX1, int inY1)
+	{
+		int	dx = abs(inX1 - inX0);
+		int	dy = abs(inY1 - inY0);
+		int	sx = (inX0 < inX1) ? 1 : -1;
+		int	sy = (inY0 < inY1) ? 1 : -1;
+		int	err = dx - dy;
 
-		mImageDispOffset.cx = x - (int )(mousePos.x / (scale / 100.0));
-		mImageDispOffset.cy = y - (int )(mousePos.y / (scale / 100.0));
-		SetDispScale(scale);
+		while (inX0 != inX1 || inY0 != inY1)
+		{
+			if (inX0 >= 0 && inX0 < inWidth && inY0 >= 0 && inY0 < inHeight)
+			{
+				unsigned char	*dstPtr = &(outBuffer[inLineSize * inY0 + inX0 * 3]);
+				dstPtr[0] = dstPtr[1] = dstPtr[2] = 0xFF;
+			}
+
+			int	err2 = err * 2;
+			if (err2 > -dy)
+			{
+				err -= dy;
+				inX0 += sx;
+			}
+			if (err2 < dx)
+			{
+				err += dx;
+				inY0 += sy;
+			}
+		}
 	}
 
-	virtual void	OnSize(WPARAM inWParam, LPARAM inLParam)
+	static unsigned int _stdcall	ThreadFunc(void *arg)
 	{
-		UpdateImageDispDispRect();
-		if (GetKeyState(VK_SHIFT) < 0)
+		ImageWindow	*imageDisp = (ImageWindow *)arg;	
+		LPCTSTR	windowName;
+
+		//	Initialze important vairables
+		imageDisp->mImageDispScale = 100;
+		imageDisp->mImagePrevScale = 100;
+		imageDisp->InitFPS();
+
+		imageDisp->InitMenu();
+
+#ifdef _UNICODE
+		int wcharsize = MultiByteToWideChar(CP_ACP, 0, imageDisp->mWindowTitle, -1, NULL, 0);
+		windowName = new WCHAR[wcharsize];
+		MultiByteToWideChar(CP_ACP, 0, imageDisp->mWindowTitle, -1, (LPWSTR )windowName, wcharsize);
+#else
+		windowName = (LPCSTR )imageDisp->mWindowTitle;
+#endif
+		//	Create WinDisp window
+		imageDisp->mWindowH = ::CreateWindow(
+				IMAGE_WINDOW_CLASS_NAME,		//	window class name
+				windowName,						//	window title
+				WS_OVERLAPPEDWINDOW,			//	normal window style
+				imageDisp->mPosX,				//	x
+				imageDisp->mPosY,				//	y
+				IMAGE_WINDOW_DEFAULT_SIZE,	//	width
+				IMAGE_WINDOW_DEFAULT_SIZE,	//	height
+				HWND_DESKTOP,					//	no parent window
+				imageDisp->mMenuH,				//	no menus
+				GetModuleHandle(NULL),			//	handle to this module
+				NULL);							//	no lpParam
+
+		if (imageDisp->mWindowH == NULL)
 		{
-			FitDispScaleToWindowSize();
-			return;
+			imageDisp->mWindowState = WINDOW_ERROR_STATE;
+			return 1;
 		}
 
-		if (CheckImageDispOffset())
-			UpdateImageDisp();
+#ifdef _UNICODE
+		delete windowName;
+#endif
 
-		UpdateStatusBar();
-	}
+#ifdef _WIN64
+		::SetWindowLongPtr(imageDisp->mWindowH, GWLP_USERDATA, (LONG_PTR )imageDisp);
+#else
+		::SetWindowLongPtr(imageDisp->mWindowH, GWLP_USERDATA, PtrToLong(imageDisp));
+#endif
 
-	virtual bool	OnSetCursor(WPARAM inWParam, LPARAM inLParam)
-	{
-		return UpdateMouseCursor();
-	}
+		// Check DPI
+		double fx = GetSystemMetrics(SM_CXSMICON) / 16.0f;
+		double fy = GetSystemMetrics(SM_CYSMICON) / 16.0f;
+		if (fx < 1) fx = 1;
+		if (fy < 1) fy = 1;
+		//printf("%f, %f\n", fx, fy);
+		if (fx >= 1.5 || fy >= 1.5)
+			imageDisp->mIsHiDPI = true;
 
+		imageDisp->InitToolbar();
+		imageDisp->InitCursor();
 
-	bool	UpdateMouseCursor()
-	{
-		if (UpdateMousePixelReadout() == false)
-			return false;
+		
+		imageDisp->UpdateDisplayRefreshRate();
+		imageDisp->mWindowState = WINDOW_OPEN_STATE;
 
-		switch (mCursorMode)
+		imageDisp->UpdateWindowSize();
+		::ShowWindow(imageDisp->mWindowH, SW_SHOW);
+		SetEvent(imageDisp->mEventHandle);
+		MSG	msg;
+		while (::GetMessage(&msg, NULL, 0, 0) != 0)
 		{
-			case CURSOR_MODE_SCROLL_TOOL:
-				if (IsScrollable())
-					SetCursor(mScrollCursor);
-				else
-					SetCursor(mArrowCursor);
-				break;
-			case CURSOR_MODE_ZOOM_TOOL:
-				if (GetKeyState(VK_SHIFT) < 0)
-					SetCursor(mZoomMinusCursor);
-				else
-					SetCursor(mZoomPlusCursor);
-				break;
-			case CURSOR_MODE_INFO_TOOL:
-				SetCursor(mInfoCursor);
-				break;
+			::TranslateMessage(&msg);
+			::DispatchMessage(&msg);
 		}
 
-		return true;
+		::DestroyWindow(imageDisp->mWindowH);
+		imageDisp->mWindowState = WINDOW_INIT_STATE;
+		imageDisp->mWindowH = NULL;
+		imageDisp->mIsThreadRunning = false;
+		return 0;
 	}
 
-	virtual void	SetCursorMode(int inCursorMode)
+	static LRESULT CALLBACK	WindowFunc(HWND hwnd, UINT inMessage, WPARAM inWParam, LPARAM inLParam)
 	{
-		mCursorMode = inCursorMode;
+		ImageWindow	*imageDisp;
+		HDC	hdc;
+		PAINTSTRUCT	paintstruct;
+		DWORD	result;
 
-		if (mMenuH == NULL)
-			return;
+#ifdef _WIN64
+		imageDisp = (ImageWindow *)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+#else
+		imageDisp = (ImageWindow *)LongToPtr(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+#endif
 
-		switch (mCursorMode)
+		switch (inMessage)
 		{
-			case CURSOR_MODE_SCROLL_TOOL:
-				CheckMenuItem(mMenuH, IDM_SCROLL_TOOL, MF_CHECKED);
-				CheckMenuItem(mMenuH, IDM_ZOOM_TOOL, MF_UNCHECKED);
-				CheckMenuItem(mMenuH, IDM_INFO_TOOL, MF_UNCHECKED);
+			case WM_PAINT:
+				if (imageDisp == NULL)
+					break;
+				if (imageDisp->mBitmapInfo == NULL)
+					break;
+
+				result = WaitForSingleObject(imageDisp->mMutexHandle, INFINITE);
+				if (result != WAIT_OBJECT_0)
+					break;
+
+				imageDisp->AcquireFrameBuffer();
+				imageDisp->ConvertVisibleTiles();
+				hdc = BeginPaint(hwnd, &paintstruct);
+				imageDisp->DrawImage(hdc);
+				EndPaint(hwnd, &paintstruct);
+				ReleaseMutex(imageDisp->mMutexHandle);
+				break;
+			case WM_SIZE:
+				SendMessage(imageDisp->mRebarH, inMessage, inWParam, inLParam);
+				SendMessage(imageDisp->mStatusbarH, inMessage, inWParam, inLParam);
+				imageDisp->OnSize(inWParam, inLParam);
+				break;
+			case WM_COMMAND:
+				if (imageDisp == NULL)
+					break;
+				imageDisp->OnCommand(inWParam, inLParam);
+				break;
+			case WM_KEYDOWN:
+				imageDisp->OnKeyDown(inWParam, inLParam);
+				break;
+			case WM_KEYUP:
+				imageDisp->OnKeyUp(inWParam, inLParam);
+				break;
+			case WM_CHAR:
+				if (imageDisp == NULL)
+					break;
+				imageDisp->OnChar(inWParam, inLParam);
+				break;
+			case WM_LBUTTONDBLCLK:
+			case WM_LBUTTONDOWN:
+				imageDisp->OnLButtonDown(inMessage, inWParam, inLParam);
+				break;
+			case WM_MBUTTONDBLCLK:
+			case WM_MBUTTONDOWN:
+				imageDisp->OnMButtonDown(inMessage, inWParam, inLParam);
+				break;
+			case WM_MOUSEMOVE:
+				imageDisp->OnMouseMove(inWParam, inLParam);
+				break;
+			case WM_LBUTTONUP:
+				imageDisp->OnLButtonUp(inWParam, inLParam);
+				break;
+			case WM_RBUTTONDOWN:
+				imageDisp->OnRButtonDown(inMessage, inWParam, inLParam);
+				break;
+			case WM_SETCURSOR:
+				if (imageDisp->OnSetCursor(inWParam, inLParam) == false)
+					return DefWindowProc(hwnd, inMessage, inWParam, inLParam);
+				break;
+			case WM_MOUSEWHEEL:
+				imageDisp->OnMouseWheel(inWParam, inLParam);
 				break;
-			case CURSOR_MODE_ZOOM_TOOL:
-				CheckMenuItem(mMenuH, IDM_SCROLL_TOOL, MF_UNCHECKED);
-				CheckMenuItem(mMenuH, IDM_ZOOM_TOOL, MF_CHECKED);
-				CheckMenuItem(mMenuH, IDM_INFO_TOOL, MF_UNCHECKED);
+			case WM_TIMER:
+				if (inWParam == IMAGE_PAN_TIMER_ID)
+				{
+					KillTimer(hwnd, IMAGE_PAN_TIMER_ID);
+					if (imageDisp->mIsPanPending)
+						imageDisp->OnPan();
+					break;
+				}
+				if (inWParam != IMAGE_PRESENT_TIMER_ID)
+					return DefWindowProc(hwnd, inMessage, inWParam, inLParam);
+				KillTimer(hwnd, IMAGE_PRESENT_TIMER_ID);
+				imageDisp->OnPresent();
 				break;
-			case CURSOR_MODE_INFO_TOOL:
-				CheckMenuItem(mMenuH, IDM_SCROLL_TOOL, MF_UNCHECKED);
-				CheckMenuItem(mMenuH, IDM_ZOOM_TOOL, MF_UNCHECKED);
-				CheckMenuItem(mMenuH, IDM_INFO_TOOL, MF_CHECKED);
+			case IMAGE_WM_PRESENT:
+				imageDisp->OnPresent();
 				break;
+			case WM_DESTROY:
+				PostQuitMessage(0);
+				break;
+			default:
+				return DefWindowProc(hwnd, inMessage, inWParam, inLParam);
 		}
-	}
 
-	void	UpdateImageDisp(bool inErase = false)
-	{
-		if (mWindowState != WINDOW_OPEN_STATE)
-			return;
-		::InvalidateRect(mWindowH, &mImageDispRect, inErase);
+		return 0;
 	}
 
-	double	CalcImageScale(int inStep)
+	static BOOL CALLBACK	MyMonitorEnumProc(HMONITOR hMon, HDC hdcMon, LPRECT inMonRect, LPARAM inLParam)
 	{
-		double	val, scale;
-
-		val = log10(mImageDispScale) + inStep / 100.0;
-		scale = pow(10, val);
-
-		// 100% snap & 1% limit (just in case...)
-		if (fabs(scale - 100.0) <= 1.0)
-			scale = 100;
-		if (scale <= 1.0)
-			scale = 1.0;
+		ImageWindow	*imageWindow = (ImageWindow *)inLParam;
 
-		return scale;
+		printf("Monitor(%d) %d, %d, %d, %d\n", imageWindow->mMonitorNum, 
+			inMonRect->left, inMonRect->top, inMonRect->right, inMonRect->bottom);
+		imageWindow->mMonitorRect[imageWindow->mMonitorNum].left = inMonRect->left;
+		imageWindow->mMonitorRect[imageWindow->mMonitorNum].top = inMonRect->top;
+		imageWindow->mMonitorRect[imageWindow->mMonitorNum].right = inMonRect->right;
+		imageWindow->mMonitorRect[imageWindow->mMonitorNum].bottom = inMonRect->bottom;
+		if (imageWindow->mMonitorNum == MONITOR_ENUM_MAX - 1)
+			return FALSE;
+		imageWindow->mMonitorNum++;
+		return TRUE;
 	}
 
-private:
-
-	enum
+	int	RegisterWindowClass()
 	{
-		WINDOW_INIT_STATE	=	1,
-		WINDOW_OPEN_STATE,
-		WINDOW_CLOSED_STATE,
-		WINDOW_ERROR_STATE
-	};
-
-	int					mWindowState;
-	int					mPosX, mPosY;
-	char				*mWindowTitle;
-	int					mFileNameIndex;
-
-	HINSTANCE			mModuleH;
-	HWND				mWindowH;
-	HWND				mToolbarH;
-	HWND				mStatusbarH;
-	HWND				mRebarH;
-	HMENU				mMenuH;
-	HMENU				mPopupMenuH;
-
-	HCURSOR				mArrowCursor;
-	HCURSOR				mScrollCursor;
-	HCURSOR				mZoomPlusCursor;
-	HCURSOR				mZoomMinusCursor;
-	HCURSOR				mInfoCursor;
-
-	HICON				mAppIconH;
-
-	HFONT				mPixValueFont;
-
-	HANDLE				mMutexHandle;
-	HANDLE				mThreadHandle;
-	HANDLE				mEventHandle;
-	BITMAPINFOHEADER	*mBitmapInfo;
-	unsigned int		mBitmapInfoSize;
-	unsigned char		*mBitmapBits;
-	unsigned int		mBitmapBitsSize;
+		WNDCLASSEX	wcx;
 
-	bool				mIsHiDPI;
+		if (GetClassInfoEx(
+				GetModuleHandle(NULL),
+				IMAGE_WINDOW_CLASS_NAME,
+				&wcx) != 0)
+		{
+			return 1;
+		}
 
-	bool				mIsThreadRunning;
+		InitIcon();
 
-	unsigned char		*mAllocatedImageBuffer;
-	unsigned short		*mAllocated16BitsImageBuffer;
-	unsigned short		*mExternal16BitsImageBuffer;
+		ZeroMemory(&wcx,sizeof(WNDCLASSEX));
+		wcx.cbSize = sizeof(WNDCLASSEX); 
 
-	SIZE				mImageSize;
-	RECT				mImageDispRect;
-	SIZE				mImageDispSize;
-	SIZE				mImageDispOffset;
-	double				mImageDispScale;
-	double				mImagePrevScale;
-	SIZE				mImageDispOffsetStart;
+		wcx.hInstance = mModuleH;
+		wcx.lpszClassName = IMAGE_WINDOW_CLASS_NAME;
+		wcx.lpfnWndProc = WindowFunc;
+		wcx.style = CS_DBLCLKS ; // Class styles
 
-	bool				mIsColorImage;
-	bool				mIs16BitsImage;
+		wcx.cbClsExtra = 0;
+		wcx.cbWndExtra = 0;
 
-	int					mCursorMode;
-	int					mMouseDownMode;
-	bool				mIsMouseDragging;
-	POINT				mMouseDownPos;
+		wcx.hIcon = mAppIconH;
+		wcx.hIconSm = mAppIconH;
+		wcx.hCursor = LoadCursor(NULL, IDC_ARROW);
+		wcx.lpszMenuName = NULL;
 
-	bool				mIsFullScreenMode;
-	RECT				mLastWindowRect;
+		wcx.hbrBackground = (HBRUSH)COLOR_WINDOW; // Background brush
 
-	bool				mIsMenubarEnabled;
-	bool				mIsToolbarEnabled;
-	bool				mIsStatusbarEnabled;
-	bool				mIsPlotEnabled;
+		if (RegisterClassEx(&wcx) == 0)
+			return 0;
 
-	void				(*mDrawOverlayFunc)(ImageWindow *, HDC, void *);
-	void				*mOverlayFuncData;
+		return 1;
+	}
+	bool	PrepareImageBuffers(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp, bool inIs16Bits,
+								ColorFormat inColorFormat, unsigned int inLineSize)
+	{
+		bool	doUpdateSize = CreateBitmapInfo(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat);
 
-#define	FPS_DATA_NUM	25
-	double				mFPSValue;
-	double				mFPSData[FPS_DATA_NUM];
-	int					mFPSDataCount;
+		DeleteFrameBuffers();
+		mExternal16BitsImageBuffer = NULL;
+		mExternalImageBuffer = NULL;
+		mIsImageDispConverted = 0;
 
-	unsigned __int64	mFrequency;
-	unsigned __int64	mPrevCount;
+		if (inIs16Bits == false)
+		{
+			if (inLineSize != 0 && inLineSize != GetBitmapLineSize())
+				printf("Error: 8 and 24-bit buffers use the DIB line size (PrepareImageBuffers)\n");
+			inLineSize = GetBitmapLineSize();
+		}
+		else
+		{
+			if (inLineSize < GetPackedImageLineSize())
+				inLineSize = GetPackedImageLineSize();
+		}
 
-	int					mMonitorNum;
-	RECT				mMonitorRect[MONITOR_ENUM_MAX];
+		//	An existing 16-bit buffer with a different line size can't be reused
+		if ((inIs16Bits == false || inLineSize != m16BitsImageLineSize) &&
+			mAllocated16BitsImageBuffer != NULL)
+		{
+			FreeBuffer(mAllocated16BitsImageBuffer);
+			mAllocated16BitsImageBuffer = NULL;
+		}
+		
+		if (mAllocatedImageBuffer != NULL && doUpdateSize != false)
+		{
+			FreeBuffer(mAllocatedImageBuffer);
+			mAllocatedImageBuffer = NULL;
+			if (mAllocated16BitsImageBuffer != NULL)
+			{
+				FreeBuffer(mAllocated16BitsImageBuffer);
+				mAllocated16BitsImageBuffer = NULL;
+			}
+		}
 
-	bool				mIsMapModeEnabled;
-	unsigned short		mMapBottomValue;
-	unsigned short		mMapTopValue;
-	bool				mIsMapReverse;
-	unsigned short		mMapDirectMapLimit;
+		if (mAllocatedImageBuffer == NULL)
+			CreateNewImageBuffer(true);
 
-	void	InitFPS()
-	{
-		::QueryPerformanceFrequency((LARGE_INTEGER *)&mFrequency);
-		::QueryPerformanceCounter((LARGE_INTEGER *)&mPrevCount);
+		if (inIs16Bits == true && mAllocated16BitsImageBuffer == NULL)
+		{
+			m16BitsImageLineSize = inLineSize;
+			CreateNewImageBuffer16Bits(true);
+		}
 
-		mFPSValue = 0;
-		mFPSDataCount = 0;
+		return doUpdateSize;
 	}
-
-	void	UpdateFPS()
+	//	Called after EnterFrameProducer(), leaves it once the frame is published
+	void	CopyIntoFrameBuffer(int inWidth, int inHeight, const unsigned char *inImage, bool inIsColor, bool inIsBottomUp, bool inIs16Bits,
+								ColorFormat inColorFormat, unsigned int inLineSize)
 	{
-		if (mWindowState != WINDOW_OPEN_STATE || mBitmapInfo == NULL)
-			return;
-		
-		unsigned __int64	currentCount;
-		::QueryPerformanceCounter((LARGE_INTEGER *)&currentCount);
+		bool	doUpdateSize = false;
 
-		mFPSValue = 1.0 * (double )mFrequency / (double )(currentCount - mPrevCount);
-		mPrevCount = currentCount;
-		
-		if (mFPSDataCount < FPS_DATA_NUM)
-			mFPSDataCount++;
-		else
-			::MoveMemory(mFPSData, &(mFPSData[1]), sizeof(double) * (FPS_DATA_NUM - 1));	
-		mFPSData[mFPSDataCount - 1] = mFPSValue;
+		if (IsFrameBufferCompatible(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat) == false)
+		{
+			DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+			if (result != WAIT_OBJECT_0)
+			{
+				printf("Error: WaitForSingleObject failed (CopyIntoFrameBuffer)\n");
+				LeaveFrameProducer();
+				return;
+			}
 
-		double	averageValue = 0;
-		for (int i = 0; i < mFPSDataCount; i++)
-			averageValue += mFPSData[i];
-		averageValue /= mFPSDataCount;
+			doUpdateSize = PrepareFrameBuffers(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat);
 
-#ifdef _UNICODE
-		wchar_t	buf[IMAGE_STR_BUF_SIZE];
+			ReleaseMutex(mMutexHandle);
+			if (mFrameBuffers[0].ImageBuffer == NULL)
+			{
+				LeaveFrameProducer();
+				return;
+			}
+		}
 
-		swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f (avg.=%.1f)"), mFPSValue, averageValue);
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
-#else
-		char	buf[IMAGE_STR_BUF_SIZE];
+		//	Only the producer changes the producer index, no need to lock here
+		ImageFrameBuffer	*frameBuffer = &(mFrameBuffers[mFrameBufferState & 0x03]);
+		unsigned int	packedLineSize = GetPackedImageLineSize();
+		int				lineNum = abs(mBitmapInfo->biHeight);
+		if (inLineSize == 0)
+			inLineSize = packedLineSize;
+		if (inIs16Bits == false)
+		{
+			CopyImageLines(frameBuffer->ImageBuffer, GetBitmapLineSize(), inImage, inLineSize,
+							packedLineSize, lineNum);
+		}
+		else
+		{
+			CopyImageLines(frameBuffer->ImageBuffer16Bits, m16BitsImageLineSize, inImage, inLineSize,
+							packedLineSize, lineNum);
+			if (mIsLazyConversionEnabled == false)
+				Convert16BitsImage(frameBuffer->ImageBuffer16Bits, frameBuffer->ImageBuffer);
+		}
+		PublishFrameBuffer();
+		LeaveFrameProducer();
 
-		sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f (avg.=%.1f)"), mFPSValue, averageValue);
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
-#endif
+		if (doUpdateSize)
+			UpdateWindowSize();
+		else
+			UpdateImage();
 	}
-
-	unsigned char	*GetPixelPointer(int inX, int inY)
+	//	A triple buffer producer counts itself in before it checks the mode,
+	//	DisableTripleBuffer() clears the mode and then waits for the count to
+	//	drop to zero, so no frame is in flight when the slots are freed.
+	//	The interlocked operations are full barriers on both sides.
+	bool	EnterFrameProducer()
 	{
-		if (inX < 0 || inX >= mImageSize.cx ||
-			inY < 0 || inY >= mImageSize.cy)
-			return NULL;
-
-		if (mBitmapInfo->biBitCount == 8)
-			return &(mBitmapBits[mImageSize.cx * inY + inX]);
-
-		int	lineSize = mImageSize.cx * 3;
-		if (lineSize % 4 != 0)
-			lineSize = lineSize + (4 - (lineSize % 4));
-
-		if (mBitmapInfo->biHeight < 0)	// Topdown-up DIB
-			return &(mBitmapBits[lineSize * inY+ (inX * 3)]);
-
-		return &(mBitmapBits[lineSize * (mImageSize.cy - inY - 1)+ (inX * 3)]);
+		InterlockedIncrement(&mFrameProducerNum);
+		if (mIsTripleBufferEnabled)
+			return true;
+		InterlockedDecrement(&mFrameProducerNum);
+		return false;
 	}
-
-	bool	UpdateMousePixelReadout()
+	void	LeaveFrameProducer()
 	{
-		POINT	pos;
-		int	x, y;
-		bool	result;
+		InterlockedDecrement(&mFrameProducerNum);
+	}
+	bool	IsFrameBufferCompatible(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp, bool inIs16Bits,
+								ColorFormat inColorFormat)
+	{
+		if (mFrameBuffers[0].ImageBuffer == NULL || mBitmapInfo == NULL)
+			return false;
 
-		GetCursorPos(&pos);
-		ScreenToClient(mWindowH, &pos);
-		if (PtInRect(&mImageDispRect, pos) == 0)
-			result = false;
+		if (mIsColorImage != inIsColor || mIs16BitsImage != inIs16Bits)
+			return false;
+		if (inIsColor && mColorFormat != inColorFormat)
+			return false;
+		if (inIs16Bits && inIsColor == false && Is16BitsColormapImage() != mIs16BitsColormapEnabled)
+			return false;
+
+		//	Mono DIBs are always created as top-down (see CreateMonoBitmapInfo)
+		if (inIsBottomUp == false || inIsColor == false)
+			inHeight = -1 * abs(inHeight);
 		else
-			result = true;
+			inHeight = abs(inHeight);
 
-		pos.x -= mImageDispRect.left;
-		pos.y -= mImageDispRect.top;
-		x = (int )(pos.x / (mImageDispScale / 100.0));
-		y = (int )(pos.y / (mImageDispScale / 100.0));
-		x += mImageDispOffset.cx;
-		y += mImageDispOffset.cy;
+		if (mBitmapInfo->biWidth != inWidth || mBitmapInfo->biHeight != inHeight)
+			return false;
 
-		unsigned char	*pixelPtr = GetPixelPointer(x, y);
-		unsigned short	value = 0;
+		return true;
+	}
+	bool	PrepareFrameBuffers(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp, bool inIs16Bits,
+								ColorFormat inColorFormat)
+	{
+		bool	doUpdateSize = CreateBitmapInfo(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits, inColorFormat);
 
-		if (mIs16BitsImage == true && mIsColorImage == false
-			&& result == true && pixelPtr != NULL)
+		DeleteFrameBuffers();
+		if (mAllocatedImageBuffer != NULL)
 		{
-			if (mAllocated16BitsImageBuffer != NULL)
-				value = mAllocated16BitsImageBuffer[x + y * mImageSize.cx];
-			if (mExternal16BitsImageBuffer != NULL)
-				value = mExternal16BitsImageBuffer[x + y * mImageSize.cx];
+			FreeBuffer(mAllocatedImageBuffer);
+			mAllocatedImageBuffer = NULL;
 		}
+		if (mAllocated16BitsImageBuffer != NULL)
+		{
+			FreeBuffer(mAllocated16BitsImageBuffer);
+			mAllocated16BitsImageBuffer = NULL;
+		}
+		mExternalImageBuffer = NULL;
+		if (inIs16Bits)
+			m16BitsImageLineSize = GetPackedImageLineSize();
 
-#ifdef _UNICODE
-		wchar_t	buf[IMAGE_STR_BUF_SIZE];
-
-		if (result == false || pixelPtr == NULL)
-			swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT(""));
-		else
+		for (int i = 0; i < FRAME_BUFFER_NUM; i++)
 		{
-			if (mIs16BitsImage == true && mIsColorImage == false)
+			mFrameBuffers[i].ImageBuffer = (unsigned char *)AllocateBuffer(mBitmapBitsSize);
+			if (mFrameBuffers[i].ImageBuffer == NULL)
 			{
-				swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%05d (%d,%d)"), value, x, y);
+				printf("Error: Can't allocate ImageBuffer (PrepareFrameBuffers)\n");
+				DeleteFrameBuffers();
+				return doUpdateSize;
 			}
-			else
+			ZeroMemory(mFrameBuffers[i].ImageBuffer, mBitmapBitsSize);
+
+			if (inIs16Bits == false)
+				continue;
+
+			mFrameBuffers[i].ImageBuffer16Bits = (unsigned short *)AllocateBuffer(Get16BitsImageBufferSize());
+			if (mFrameBuffers[i].ImageBuffer16Bits == NULL)
 			{
-				if (mBitmapInfo->biBitCount == 8)
-					swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d (%d,%d)"), pixelPtr[0], x, y);
-				else
-					swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d %03d %03d (%d,%d)"),
-								(int )pixelPtr[2], (int )pixelPtr[1], (int )pixelPtr[0], x, y);
+				printf("Error: Can't allocate ImageBuffer16Bits (PrepareFrameBuffers)\n");
+				DeleteFrameBuffers();
+				return doUpdateSize;
 			}
+			ZeroMemory(mFrameBuffers[i].ImageBuffer16Bits, Get16BitsImageBufferSize());
 		}
 
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )2, (LPARAM )buf);
-#else
-		char	buf[IMAGE_STR_BUF_SIZE];
+		//	The frame buffers are owned by the window, but the rest of the class
+		//	sees the display slot just like an external (SetImageBufferPtr) buffer
+		int	index = (mFrameBufferState >> 4) & 0x03;
+		mBitmapBits = mFrameBuffers[index].ImageBuffer;
+		mExternal16BitsImageBuffer = mFrameBuffers[index].ImageBuffer16Bits;
 
-		if (result == false || pixelPtr == NULL)
-			sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT(""));
-		else
+		return doUpdateSize;
+	}
+	void	DeleteFrameBuffers()
+	{
+		for (int i = 0; i < FRAME_BUFFER_NUM; i++)
 		{
-			if (mIs16BitsImage == true && mIsColorImage == false)
+			if (mFrameBuffers[i].ImageBuffer != NULL)
 			{
-				sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%05d (%d,%d)"), value, x, y);
+				if (mBitmapBits == mFrameBuffers[i].ImageBuffer)
+					mBitmapBits = NULL;
+				FreeBuffer(mFrameBuffers[i].ImageBuffer);
+				mFrameBuffers[i].ImageBuffer = NULL;
 			}
-			else
+			if (mFrameBuffers[i].ImageBuffer16Bits != NULL)
 			{
-				if (mBitmapInfo->biBitCount == 8)
-					sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d (%d,%d)"), pixelPtr[0], x, y);
-				else
-					sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d %03d %03d (%d,%d)"),
-								(int )pixelPtr[2], (int )pixelPtr[1], (int )pixelPtr[0], x, y);
+				if (mExternal16BitsImageBuffer == mFrameBuffers[i].ImageBuffer16Bits)
+					mExternal16BitsImageBuffer = NULL;
+				FreeBuffer(mFrameBuffers[i].ImageBuffer16Bits);
+				mFrameBuffers[i].ImageBuffer16Bits = NULL;
 			}
 		}
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )2, (LPARAM )buf);
-#endif
-
-		return result;
+		mFrameBufferState = FRAME_BUFFER_INIT_STATE;
 	}
+	void	PublishFrameBuffer()
+	{
+		LONG	state, newState;
 
-	void	UpdateWindowSize(bool inKeepDispScale = false)
+		//	Swap the producer and ready slots and raise the new frame flag.
+		//	An unpainted ready frame is simply overwritten by the next one.
+		do
+		{
+			state = mFrameBufferState;
+			newState = (state & 0x30) | ((state & 0x03) << 2) | ((state & 0x0C) >> 2) | FRAME_BUFFER_NEW_FRAME;
+		}
+		while (InterlockedCompareExchange(&mFrameBufferState, newState, state) != state);
+	}
+	bool	AcquireFrameBuffer()
 	{
-		if (mWindowState != WINDOW_OPEN_STATE || mBitmapInfo == NULL)
-			return;
+		LONG	state, newState;
 
-		RECT	rebarRect, statusbarRect, rect;
-		int		imageWidth, imageHeight;
+		if (mFrameBuffers[0].ImageBuffer == NULL)
+			return false;
 
-		GetWindowRect(mRebarH, &rebarRect);
-		int	rebarHeight = rebarRect.bottom - rebarRect.top;
-		if (!IsToolbarEnabled())
-			rebarHeight = 0;
-		GetWindowRect(mStatusbarH, &statusbarRect);
-		int	statusbarHeight = statusbarRect.bottom - statusbarRect.top;
-		if (!IsStatusbarEnabled())
-			statusbarHeight = 0;
+		//	Swap the display and ready slots if a new frame has been published
+		do
+		{
+			state = mFrameBufferState;
+			if ((state & FRAME_BUFFER_NEW_FRAME) == 0)
+				return false;
+			newState = (state & 0x03) | ((state & 0x0C) << 2) | ((state & 0x30) >> 2);
+		}
+		while (InterlockedCompareExchange(&mFrameBufferState, newState, state) != state);
 
-		mImageSize.cx = mBitmapInfo->biWidth;
-		mImageSize.cy = abs(mBitmapInfo->biHeight);
+		int	index = (newState >> 4) & 0x03;
+		mBitmapBits = mFrameBuffers[index].ImageBuffer;
+		mExternal16BitsImageBuffer = mFrameBuffers[index].ImageBuffer16Bits;
+		IncrementFrameGeneration();
 
-		if (inKeepDispScale == false)
+		return true;
+	}
+	unsigned short	*Get16BitsImageBufferPtr()
+	{
+		if (mAllocated16BitsImageBuffer != NULL)
+			return mAllocated16BitsImageBuffer;
+
+		return mExternal16BitsImageBuffer;
+	}
+	unsigned int	Get16BitsImageBufferSize()
+	{
+		return m16BitsImageLineSize * abs(mBitmapInfo->biHeight);
+	}
+	//	Brings the display buffer up to date with an external buffer that
+	//	can't be displayed as it is (16-bit or non DIB line size)
+	void	UpdateConvertedImageDisp()
+	{
+		if (mExternalImageBuffer != NULL && mAllocatedImageBuffer != NULL)
 		{
-			mImageDispScale = 100.0;
-			imageWidth = mImageSize.cx;
-			imageHeight = mImageSize.cy;
+			CopyImageLines(mAllocatedImageBuffer, GetBitmapLineSize(),
+							mExternalImageBuffer, mExternalImageLineSize,
+							GetPackedImageLineSize(), abs(mBitmapInfo->biHeight));
+			return;
 		}
-		else
+		if (InterlockedExchange(&mIsImageDispConverted, 0) != 0)
+			return;
+		if (mIsFloatImage)
 		{
-			imageWidth = (int )(mImageSize.cx * mImageDispScale / 100.0);
-			imageHeight = (int )(mImageSize.cy * mImageDispScale / 100.0);
+			UpdateFloatImageDisp();
+			return;
 		}
+		if (mIs16BitsImage && mFrameBuffers[0].ImageBuffer == NULL &&
+			mIsLazyConversionEnabled == false)
+			Update16BitsImageDisp();
+	}
+	//	Copies and converts a region given in buffer lines. The pyramid and
+	//	the plot are made again, the frame generation isn't changed so that
+	//	the other lazy tiles stay valid.
+	void	CopyImageRegion(int inX, int inY, int inWidth, int inHeight, const unsigned char *inImage,
+							unsigned int inLineSize)
+	{
+		unsigned int	pixelSize = GetPackedImageLineSize() / mBitmapInfo->biWidth;
+		unsigned int	lineSize = GetImageLineSize();
 
-		int	displayWidth = GetSystemMetrics(SM_CXSCREEN);
-		int	displayHEIGHT = GetSystemMetrics(SM_CYSCREEN);
-
-		if (imageWidth > displayWidth)
-			imageWidth = displayWidth;
-		if (imageHeight > displayHEIGHT)
-			imageHeight = displayHEIGHT;
-
-		rect.left = 0;
-		rect.top = 0;
-		rect.right = imageWidth;
-		rect.bottom = imageHeight + rebarHeight + statusbarHeight;
-		mImageDispRect = rect;
-		mImageDispRect.top = rebarHeight;
-		mImageDispRect.bottom -= statusbarHeight;
-		mImageDispSize.cx = mImageDispRect.right - mImageDispRect.left;
-		mImageDispSize.cy = mImageDispRect.bottom - mImageDispRect.top;
-		mImageDispOffset.cx = 0;
-		mImageDispOffset.cy = 0;
-		AdjustWindowRect(&rect, WS_OVERLAPPEDWINDOW, TRUE);	// if menu is enabled
-
-		SetWindowPos(mWindowH, NULL, 0, 0,
-			rect.right - rect.left, rect.bottom - rect.top, SWP_NOMOVE | SWP_NOOWNERZORDER);
+		if (inLineSize == 0)
+			inLineSize = pixelSize * inWidth;
+		CopyImageLines(&(GetImageBufferPtr()[lineSize * inY + pixelSize * inX]), lineSize,
+						inImage, inLineSize, pixelSize * inWidth, inHeight);
+		if (mIs16BitsImage)
+			ConvertImageRegion(inX, inY, inWidth, inHeight);
 
-		UpdateStatusBar();
+		for (int i = 1; i <= IMAGE_PYRAMID_LEVEL_MAX; i++)
+			mPyramid[i].Generation = 0;
+		mIsPlotValid = false;
 	}
-
-	void	UpdateImageDispDispRect()
+	//	Lazily converted images only get the tiles of the region marked dirty.
+	//	The waterfall converts the lines right away, every line is shown as
+	//	it scrolls through.
+	void	ConvertImageRegion(int inX, int inY, int inWidth, int inHeight)
 	{
-		if (mWindowState != WINDOW_OPEN_STATE || mBitmapInfo == NULL)
+		if (mIsLazyConversionEnabled && mIsWaterfallEnabled == false)
+		{
+			if (mTileGenerations == NULL || mTileImageSize.cx != mBitmapInfo->biWidth ||
+				mTileImageSize.cy != abs(mBitmapInfo->biHeight))
+				return;	// every tile is dirty anyway
+
+			for (int ty = inY / IMAGE_LAZY_TILE_SIZE; ty <= (inY + inHeight - 1) / IMAGE_LAZY_TILE_SIZE; ty++)
+				for (int tx = inX / IMAGE_LAZY_TILE_SIZE; tx <= (inX + inWidth - 1) / IMAGE_LAZY_TILE_SIZE; tx++)
+					mTileGenerations[ty * mTileNumX + tx] = 0;
 			return;
+		}
 
-		RECT	rebarRect, statusbarRect, rect;
+		const unsigned short	*srcImagePtr = Get16BitsImageBufferPtr();
+		unsigned int	srcLineSize = m16BitsImageLineSize / sizeof(unsigned short);
+		int	channelNum = Get16BitsChannelNum();
 
-		GetWindowRect(mRebarH, &rebarRect);
-		int	rebarHeight = rebarRect.bottom - rebarRect.top;
-		if (!IsToolbarEnabled())
-			rebarHeight = 0;
-		GetWindowRect(mStatusbarH, &statusbarRect);
-		int	statusbarHeight = statusbarRect.bottom - statusbarRect.top;
-		if (!IsStatusbarEnabled())
-			statusbarHeight = 0;
+		if (srcImagePtr == NULL || mAllocatedImageBuffer == NULL)
+			return;
 
-		GetClientRect(mWindowH, &rect);
-		rect.top += rebarHeight;
-		rect.bottom -= statusbarHeight;
-		mImageDispRect = rect;
-		mImageDispSize.cx = mImageDispRect.right - mImageDispRect.left;
-		mImageDispSize.cy = mImageDispRect.bottom - mImageDispRect.top;
+		LineBandParam	param;
+		param.Window		= this;
+		param.Src			= &(srcImagePtr[srcLineSize * inY + inX * channelNum]);
+		param.Dst			= &(mAllocatedImageBuffer[GetBitmapLineSize() * inY + inX * (mBitmapInfo->biBitCount / 8)]);
+		param.LineSize		= inWidth * channelNum;
+		param.SrcLineSize	= srcLineSize;
+		param.DstLineSize	= GetBitmapLineSize();
+		Update16BitsColormapTable();
+		RunLineBands(ConvertLinesFunc, &param, inHeight,
+					inWidth * inHeight * channelNum * sizeof(unsigned short));
 	}
-
-
-	void	UpdateStatusBar()
+	//	Invalidates the screen rectangle of a region given in image lines
+	void	UpdateImageRegionDisp(int inX, int inY, int inWidth, int inHeight)
 	{
+		double	scale = mImageDispScale / 100.0;
+		int		height = abs(mBitmapInfo->biHeight);
 		RECT	rect;
-		GetClientRect(mWindowH, &rect);
-
-		int	statusbarSize[] = {100, 300, rect.right - 200, rect.right};
-		SendMessage(mStatusbarH, SB_SETPARTS, (WPARAM )4, (LPARAM )(LPINT)statusbarSize);
-
-#ifdef _UNICODE
-		wchar_t	buf[IMAGE_STR_BUF_SIZE];
-
-		swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("Zoom: %.0f%%"), mImageDispScale);
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )0, (LPARAM )buf);
 
-		if (mBitmapInfo != NULL)
+		//	The plot spans the whole view
+		if (mIsPlotEnabled)
 		{
-			swprintf_s(buf, IMAGE_STR_BUF_SIZE,
-				TEXT("Image: %dx%dx%d"),
-				mBitmapInfo->biWidth, abs(mBitmapInfo->biHeight), mBitmapInfo->biBitCount);
-			SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )1, (LPARAM )buf);
+			UpdateImageDisp();
+			return;
 		}
 
-		swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f"), mFPSValue);
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
-#else
-		char	buf[IMAGE_STR_BUF_SIZE];
+		if (mBitmapInfo->biHeight > 0)	// Bottom-up DIB
+			inY = height - inY - inHeight;
 
-		sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("Zoom: %.0f%%"), mImageDispScale);
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )0, (LPARAM )buf);
+		//	One pixel more around for the rounding of StretchDIBits() and the pyramid levels
+		rect.left	= mImageDispRect.left + (int )floor((inX - mImageDispOffset.cx) * scale) - 1;
+		rect.top	= mImageDispRect.top + (int )floor((inY - mImageDispOffset.cy) * scale) - 1;
+		rect.right	= mImageDispRect.left + (int )ceil((inX + inWidth - mImageDispOffset.cx) * scale) + 1;
+		rect.bottom	= mImageDispRect.top + (int )ceil((inY + inHeight - mImageDispOffset.cy) * scale) + 1;
+		if (::IntersectRect(&rect, &rect, &mImageDispRect) == FALSE)
+			return;
+		::InvalidateRect(mWindowH, &rect, FALSE);
+	}
+	//	Line inY of the image counted from the top, in buffer line order
+	int		GetWaterfallLine(int inY)
+	{
+		return (inY + mWaterfallTopLine) % abs(mBitmapInfo->biHeight);
+	}
+	//	Moves line inLineIndex to the top, keeping the order of the lines
+	void	RotateImageLines(unsigned char *ioBuffer, unsigned int inLineSize, int inLineNum, int inLineIndex)
+	{
+		if (ioBuffer == NULL || inLineIndex <= 0 || inLineIndex >= inLineNum)
+			return;
+		std::rotate(ioBuffer, &(ioBuffer[inLineSize * inLineIndex]), &(ioBuffer[inLineSize * inLineNum]));
+	}
+	void	Update16BitsImageDisp()
+	{
+		unsigned short	*srcImagePtr = Get16BitsImageBufferPtr();
 
-		if (mBitmapInfo != NULL)
-		{
-			sprintf_s(buf, IMAGE_STR_BUF_SIZE,
-				TEXT("Image: %dx%dx%d"),
-				mBitmapInfo->biWidth, abs(mBitmapInfo->biHeight), mBitmapInfo->biBitCount);
-			SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )1, (LPARAM )buf);
-		}
+		if (srcImagePtr == NULL || mAllocatedImageBuffer == NULL)
+			return;
 
-		sprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("FPS: %.1f"), mFPSValue);
-		SendMessage(mStatusbarH, SB_SETTEXT, (WPARAM )3, (LPARAM )buf);
-#endif
+		Convert16BitsImage(srcImagePtr, mAllocatedImageBuffer);
 	}
-
-	bool	CheckImageDispOffset()
+	//	The source lines are m16BitsImageLineSize apart, the destination
+	//	lines are the DIB lines
+	void	Convert16BitsImage(const unsigned short *inSrcImage, unsigned char *outDstImage)
 	{
-		int	limit;
-		double	scale = mImageDispScale / 100.0;
-		bool	update = false;
-		SIZE	prevOffset = mImageDispOffset;
-
-		limit = (int )(mImageSize.cx - mImageDispSize.cx / scale);
-		if (mImageDispOffset.cx > limit)
-		{
-			mImageDispOffset.cx = limit;
-			update = true;
-		}
-		if (mImageDispOffset.cx < 0)
-		{
-			mImageDispOffset.cx = 0;
-			update = true;
-		}
-		limit = (int )(mImageSize.cy - mImageDispSize.cy / scale);
-		if (mImageDispOffset.cy > limit)
+		LineBandParam	param;
+		param.Window		= this;
+		param.Src			= inSrcImage;
+		param.Dst			= outDstImage;
+		param.LineSize		= mBitmapInfo->biWidth * Get16BitsChannelNum();
+		param.SrcLineSize	= m16BitsImageLineSize / sizeof(unsigned short);
+		param.DstLineSize	= GetBitmapLineSize();
+		UpdateAutoWindowLevel(inSrcImage);
+		Update16BitsColormapTable();
+		RunLineBands(ConvertLinesFunc, &param, abs(mBitmapInfo->biHeight),
+					Get16BitsImageBufferSize());
+	}
+	//	inPixelNum is the number of samples (3 per pixel for color images)
+	void	Convert16BitsImageLines(const unsigned short *inSrcImage, unsigned char *outDstImage,
+								unsigned int inPixelNum)
+	{
+		if (mIsColorImage)
 		{
-			mImageDispOffset.cy = limit;
-			update = true;
+			Convert48BitsImageLines(inSrcImage, outDstImage, inPixelNum / 3);
+			return;
 		}
-		if (mImageDispOffset.cy < 0)
+		if (Is16BitsColormapImage())
 		{
-			mImageDispOffset.cy = 0;
-			update = true;
+			//	Update16BitsColormapTable() is called before the lines are split
+			if (mColormapTable != NULL)
+				ImageWindowKernel::Lookup16To32(inSrcImage, (unsigned int *)outDstImage, inPixelNum,
+								mColormapTable);
+			return;
 		}
 
-		if (prevOffset.cx == mImageDispOffset.cx &&
-			prevOffset.cy == mImageDispOffset.cy)
-			update = false;
-
-		return update;
+		if (mIsMapModeEnabled == false)
+			Shift16BitsImageLines(inSrcImage, outDstImage, inPixelNum);
+		else if (mIsMapLinear)
+			ImageWindowKernel::WindowLevel16To8(inSrcImage, outDstImage, inPixelNum,
+								mMapBottomValue, mMapTopValue);
+		else if (mIsMapTableValid)
+			ImageWindowKernel::Lookup16To8(inSrcImage, outDstImage, inPixelNum, mMapTable);
+		else
+			Shift16BitsImageLines(inSrcImage, outDstImage, inPixelNum);
 	}
-
-	void	DrawImage(HDC inHDC)
+	//	The default mapping, the top 8 of the significant bits
+	void	Shift16BitsImageLines(const unsigned short *inSrcImage, unsigned char *outDstImage,
+								unsigned int inPixelNum)
 	{
-		if (mImageDispScale == 100)
-		{
-			SetDIBitsToDevice(inHDC,
-				mImageDispRect.left, mImageDispRect.top,
-				mImageSize.cx, mImageSize.cy,
-				mImageDispOffset.cx, -1 * mImageDispOffset.cy,
-				0, mImageSize.cy,
-				mBitmapBits, (BITMAPINFO *)mBitmapInfo, DIB_RGB_COLORS);
-		}
+		if (m16BitsImageBitDepth >= 16)
+			ImageWindowKernel::Shift16To8(inSrcImage, outDstImage, inPixelNum);
 		else
+			ImageWindowKernel::WindowLevel16To8(inSrcImage, outDstImage, inPixelNum,
+								0, (unsigned short )((1 << m16BitsImageBitDepth) - 1));
+	}
+	void	Convert48BitsImageLines(const unsigned short *inSrcImage, unsigned char *outDstImage,
+								unsigned int inPixelNum)
+	{
+		if (mIsMapModeEnabled && mIsMapLinear && mIsMapPerChannel)
 		{
-			double	scale = (mImageDispScale / 100.0);
-			SetStretchBltMode(inHDC, COLORONCOLOR);
-			StretchDIBits(inHDC,
-				mImageDispRect.left, mImageDispRect.top,
-				(int )(mImageSize.cx * scale),
-				(int )(mImageSize.cy * scale),
-				mImageDispOffset.cx, -1 * mImageDispOffset.cy,
-				mImageSize.cx, mImageSize.cy,
-				mBitmapBits, (BITMAPINFO *)mBitmapInfo, DIB_RGB_COLORS, SRCCOPY);
+			unsigned short	bottomValues[3], topValues[3];
+			int	redIndex = Get16BitsRedIndex();
+
+			//	The windows are kept in RGB order, the kernel takes the source order
+			for (int i = 0; i < 3; i++)
+			{
+				int	index = (redIndex == 0) ? i : 2 - i;
+				bottomValues[i] = mMapBottomValues[index];
+				topValues[i] = mMapTopValues[index];
+			}
+			ImageWindowKernel::WindowLevel48To24(inSrcImage, outDstImage, inPixelNum,
+								bottomValues, topValues);
+		}
+		else if (mIsMapModeEnabled == false)
+			Shift16BitsImageLines(inSrcImage, outDstImage, inPixelNum * 3);
+		else if (mIsMapLinear)
+			ImageWindowKernel::WindowLevel16To8(inSrcImage, outDstImage, inPixelNum * 3,
+								mMapBottomValue, mMapTopValue);
+		else if (mIsMapTableValid)
+			ImageWindowKernel::Lookup16To8(inSrcImage, outDstImage, inPixelNum * 3, mMapTable);
+		else
+			Shift16BitsImageLines(inSrcImage, outDstImage, inPixelNum * 3);
 
-			if (mImageDispScale >= 3000 && mBitmapInfo->biBitCount == 8)
-			{
-				int	numX = (int )ceil((mImageDispRect.right - mImageDispRect.left) / scale);
-				int	numY = (int )ceil((mImageDispRect.bottom - mImageDispRect.top) / scale);
-				int	x, y;
+		//	The display buffer is always BGR
+		if (Get16BitsRedIndex() == 0)
+			ImageWindowKernel::SwapRB24(outDstImage, inPixelNum);
+	}
+	typedef struct
+	{
+		const unsigned char	*Src;
+		unsigned int		SrcLineSize;	// 0 for a continuous pixel stream
+		PackedFormat		Format;
+		int					Width;
+		unsigned short		*Dst16Bits;
+		unsigned char		*Dst;			// NULL in lazy conversion mode
+	} PackedImageParam;
+
+	//	Called by every function that takes a new image. They set what their
+	//	source needs again.
+	//	in16BitsImageBitDepth is the significant bits of the new 16-bit image
+	void	ResetImageSource(int in16BitsImageBitDepth = 16)
+	{
+		m16BitsImageBitDepth = in16BitsImageBitDepth;
+		mIsBayerImage = false;
+		mIsYUVImage = false;
+		mIsFloatImage = false;
+		mIsWaterfallEnabled = false;
+		mWaterfallTopLine = 0;
+	}
+	//	Copies inImage into mFloatImageBuffer and takes the finite min/max
+	//	on the way, one range per line so that the bands don't share state
+	void	CopyFloatImage(const float *inImage, unsigned int inLineSize)
+	{
+		int	height = abs(mBitmapInfo->biHeight);
 
-				HGDIOBJ	prevFont = SelectObject(inHDC, mPixValueFont);
-				SetBkMode(inHDC, TRANSPARENT);
-				for (y = 0; y < numY; y++)
-				{
-					unsigned char	*pixelPtr = GetPixelPointer(mImageDispOffset.cx, mImageDispOffset.cy + y);
-					for (x = 0; x < numX; x++)
-					{
-						wchar_t	buf[IMAGE_STR_BUF_SIZE];
-						unsigned char	pixelValue = pixelPtr[x];
-
-						swprintf_s(buf, IMAGE_STR_BUF_SIZE, TEXT("%03d"), pixelValue);
-
-						if (pixelValue > 0x80)
-							SetTextColor(inHDC, RGB(0x00, 0x00, 0x00));
-						else
-							SetTextColor(inHDC, RGB(0xFF, 0xFF, 0xFF));
-						TextOut(inHDC,
-							(int )((double )x * scale + scale * 0.5 - 10) + mImageDispRect.left,
-							(int )((double )y * scale + scale * 0.5 - 5) + mImageDispRect.top,
-							buf, 3);
-					}
-				}
-				SelectObject(inHDC, prevFont);
-			}
+		mFloatLineRanges.resize(height * 2);
+
+		LineBandParam	param;
+		param.Window		= this;
+		param.Src			= inImage;
+		param.Dst			= mFloatImageBuffer;
+		param.LineSize		= mBitmapInfo->biWidth;
+		param.SrcLineSize	= inLineSize;
+		RunLineBands(CopyFloatLinesFunc, &param, height, mBitmapInfo->biWidth * height * sizeof(float));
+
+		mFloatMinValue = HUGE_VALF;
+		mFloatMaxValue = -HUGE_VALF;
+		for (int y = 0; y < height; y++)
+		{
+			if (mFloatLineRanges[y * 2] < mFloatMinValue)
+				mFloatMinValue = mFloatLineRanges[y * 2];
+			if (mFloatLineRanges[y * 2 + 1] > mFloatMaxValue)
+				mFloatMaxValue = mFloatLineRanges[y * 2 + 1];
 		}
+	}
+	static void	CopyFloatLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
+		float	*ranges = &(param->Window->mFloatLineRanges[0]);
 
-		if (mIsPlotEnabled)
+		for (int y = inStartLine; y < inEndLine; y++)
 		{
-			RECT	rect = GetImageClientRect();
-			int	width = GetImageWidth();
-			int	height = GetImageHeight();
-			double	v;
-			int	x, y, prevY;
+			ranges[y * 2] = HUGE_VALF;
+			ranges[y * 2 + 1] = -HUGE_VALF;
+			ImageWindowKernel::CopyFloatMinMax(
+					(const float *)&(((const unsigned char *)param->Src)[param->SrcLineSize * y]),
+					&(((float *)param->Dst)[param->LineSize * y]), param->LineSize,
+					&(ranges[y * 2]), &(ranges[y * 2 + 1]));
+		}
+	}
+	void	UpdateFloatImageDisp()
+	{
+		if (mFloatImageBuffer == NULL || mAllocatedImageBuffer == NULL)
+			return;
 
-			HPEN	hPen = CreatePen(PS_SOLID, 1, RGB(0xFF, 0xFF, 0xFF));
-			SelectObject(inHDC, hPen);
+		float	bottomValue = mFloatBottomValue;
+		float	topValue = mFloatTopValue;
+		if (mIsFloatAutoRange)
+		{
+			bottomValue = mFloatMinValue;
+			topValue = mFloatMaxValue;
+		}
+		if (bottomValue > topValue)		// no finite value
+		{
+			bottomValue = 0.0f;
+			topValue = 1.0f;
+		}
 
-			if (mIs16BitsImage)
-			{
-				unsigned short	*imagePtr = (unsigned short *)GetImageBufferPtr();
-				double	k = (rect.bottom - rect.top) / 65535.0;
+		LineBandParam	param;
+		param.Window		= this;
+		param.Src			= mFloatImageBuffer;
+		param.Dst			= mAllocatedImageBuffer;
+		param.LineSize		= mBitmapInfo->biWidth;
+		param.DstLineSize	= GetBitmapLineSize();
+		mFloatMapBottomValue = bottomValue;
+		mFloatMapScale = (topValue > bottomValue) ? 255.0f / (topValue - bottomValue) : 255.0f;
+		RunLineBands(ConvertFloatLinesFunc, &param, abs(mBitmapInfo->biHeight),
+					mBitmapInfo->biWidth * abs(mBitmapInfo->biHeight) * sizeof(float));
+	}
+	static void	ConvertFloatLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
+		ImageWindow	*window = param->Window;
 
-				if (mImageClickNum == 0 || mLastImageClickY > height || mLastImageClickY < 0)
-					imagePtr += (width * (height / 2));
-				else
-					imagePtr += (width * mLastImageClickY);
-				x = rect.left;
+		for (int y = inStartLine; y < inEndLine; y++)
+			ImageWindowKernel::WindowLevelFloatTo8(&(((const float *)param->Src)[param->LineSize * y]),
+					&(((unsigned char *)param->Dst)[param->DstLineSize * y]), param->LineSize,
+					window->mFloatMapBottomValue, window->mFloatMapScale);
+	}
+	//	The float lines are kept in the same order as the DIB lines
+	float	*GetFloatPixelPointer(int inX, int inY)
+	{
+		if (mIsFloatImage == false || mFloatImageBuffer == NULL || mBitmapInfo == NULL)
+			return NULL;
 
-				for (int i = 0; i < width; i++)
-				{
-					v = k * (*imagePtr);
-					y = rect.bottom - (int )v;
-					if (x != 0)
-					{
-						MoveToEx(inHDC, (x - 1), prevY, NULL);
-						LineTo(inHDC, x, y);
-					}
-					prevY = y;
-					imagePtr++;
-					x++;
-				}
-			}
-			else
-			{
-				unsigned char	*imagePtr = GetImageBufferPtr();
-				double	k = (rect.bottom - rect.top) / 255.0;
+		int	height = abs(mBitmapInfo->biHeight);
+		if (inX < 0 || inX >= mBitmapInfo->biWidth ||
+			inY < 0 || inY >= height)
+			return NULL;
 
-				if (mImageClickNum == 0 || mLastImageClickY > height || mLastImageClickY < 0)
-					imagePtr += (width * (height / 2));
-				else
-					imagePtr += (width * mLastImageClickY);
-				x = rect.left;
+		if (mBitmapInfo->biHeight > 0)
+			inY = height - inY - 1;
+		return &(mFloatImageBuffer[mBitmapInfo->biWidth * inY + inX]);
+	}
+	//	{B-U, G-U, G-V, R-V} in 1/64 units, see ImageWindowKernel::YUYVToBGR24()
+	const short	*GetYUVCoefs()
+	{
+		static const short	sCoefs[2][4] = {
+			{129, 25, 52, 102},		// BT.601
+			{135, 14, 34, 115}};	// BT.709
 
-				for (int i = 0; i < width; i++)
-				{
-					v = k * (*imagePtr);
-					y = rect.bottom - (int )v;
-					if (x != 0)
-					{
-						MoveToEx(inHDC, (x - 1), prevY, NULL);
-						LineTo(inHDC, x, y);
-					}
-					prevY = y;
-					imagePtr++;
-					x++;
-				}
-			}
+		return sCoefs[(mYUVMatrix == YUV_MATRIX_BT709) ? 1 : 0];
+	}
+	static unsigned int	GetYUVImageSize(unsigned int inLineSize, int inHeight, YUVFormat inFormat)
+	{
+		unsigned int	chromaHeight = (inHeight + 1) / 2;
 
-			DeleteObject(hPen);
+		switch (inFormat)
+		{
+			case YUV_FORMAT_NV12:
+				return inLineSize * inHeight + ((inLineSize + 1) & ~1) * chromaHeight;
+			case YUV_FORMAT_I420:
+				return inLineSize * inHeight + (inLineSize + 1) / 2 * chromaHeight * 2;
 		}
-
-		if (mDrawOverlayFunc != NULL)
-			mDrawOverlayFunc(this, inHDC, mOverlayFuncData);
+		return inLineSize * inHeight;
 	}
+	bool	PrepareYUVImageBuffer(unsigned int inSize)
+	{
+		if (mYUVImageBuffer != NULL && mYUVImageBufferSize >= inSize)
+			return true;
 
-	static unsigned int _stdcall	ThreadFunc(void *arg)
+		FreeBuffer(mYUVImageBuffer);
+		mYUVImageBuffer = (unsigned char *)AllocateBuffer(inSize);
+		if (mYUVImageBuffer == NULL)
+		{
+			printf("Error: Can't allocate mYUVImageBuffer (PrepareYUVImageBuffer)\n");
+			mYUVImageBufferSize = 0;
+			return false;
+		}
+		mYUVImageBufferSize = inSize;
+		return true;
+	}
+	//	Converts inPixelNum pixels of line inY from pixel inX (must be even)
+	void	ConvertYUVImageLine(const unsigned char *inImage, unsigned int inLineSize, YUVFormat inFormat,
+								int inY, int inX, int inPixelNum, unsigned char *outDst)
 	{
-		ImageWindow	*imageDisp = (ImageWindow *)arg;	
-		LPCTSTR	windowName;
+		const unsigned char	*chroma = &(inImage[inLineSize * abs(mBitmapInfo->biHeight)]);
+		const short			*coefs = GetYUVCoefs();
 
-		//	Initialze important vairables
-		imageDisp->mImageDispScale = 100;
-		imageDisp->mImagePrevScale = 100;
-		imageDisp->InitFPS();
+		switch (inFormat)
+		{
+			case YUV_FORMAT_YUYV:
+				ImageWindowKernel::YUYVToBGR24(&(inImage[inLineSize * inY + inX * 2]), outDst, inPixelNum, coefs);
+				break;
+			case YUV_FORMAT_NV12:
+				ImageWindowKernel::NV12ToBGR24(&(inImage[inLineSize * inY + inX]),
+								&(chroma[((inLineSize + 1) & ~1) * (inY / 2) + inX]), outDst, inPixelNum, coefs);
+				break;
+			case YUV_FORMAT_I420:
+			{
+				unsigned int	chromaLineSize = (inLineSize + 1) / 2;
+				unsigned int	chromaOffset = chromaLineSize * (inY / 2) + inX / 2;
+				ImageWindowKernel::I420ToBGR24(&(inImage[inLineSize * inY + inX]), &(chroma[chromaOffset]),
+								&(chroma[chromaLineSize * ((abs(mBitmapInfo->biHeight) + 1) / 2) + chromaOffset]),
+								outDst, inPixelNum, coefs);
+				break;
+			}
+		}
+	}
+	typedef struct
+	{
+		const unsigned char	*Src;
+		unsigned int		SrcLineSize;
+		YUVFormat			Format;
+	} YUVImageParam;
+
+	//	inImage has the size of the current bitmap info
+	void	ConvertYUVImage(const unsigned char *inImage, unsigned int inLineSize, YUVFormat inFormat,
+							unsigned char *outDst)
+	{
+		if (inImage == NULL || outDst == NULL)
+			return;
 
-		imageDisp->InitMenu();
+		YUVImageParam	yuvParam;
+		yuvParam.Src			= inImage;
+		yuvParam.SrcLineSize	= inLineSize;
+		yuvParam.Format			= inFormat;
 
-#ifdef _UNICODE
-		int wcharsize = MultiByteToWideChar(CP_ACP, 0, imageDisp->mWindowTitle, -1, NULL, 0);
-		windowName = new WCHAR[wcharsize];
-		MultiByteToWideChar(CP_ACP, 0, imageDisp->mWindowTitle, -1, (LPWSTR )windowName, wcharsize);
-#else
-		windowName = (LPCSTR )imageDisp->mWindowTitle;
-#endif
-		//	Create WinDisp window
-		imageDisp->mWindowH = ::CreateWindow(
-				IMAGE_WINDOW_CLASS_NAME,		//	window class name
-				windowName,						//	window title
-				WS_OVERLAPPEDWINDOW,			//	normal window style
-				imageDisp->mPosX,				//	x
-				imageDisp->mPosY,				//	y
-				IMAGE_WINDOW_DEFAULT_SIZE,	//	width
-				IMAGE_WINDOW_DEFAULT_SIZE,	//	height
-				HWND_DESKTOP,					//	no parent window
-				imageDisp->mMenuH,				//	no menus
-				GetModuleHandle(NULL),			//	handle to this module
-				NULL);							//	no lpParam
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= &yuvParam;
+		param.Dst		= outDst;
+		RunLineBands(ConvertYUVLinesFunc, &param, abs(mBitmapInfo->biHeight), mBitmapBitsSize);
+	}
+	static void	ConvertYUVLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam		*param = (LineBandParam *)inContext;
+		const YUVImageParam	*yuvParam = (const YUVImageParam *)param->Src;
+		ImageWindow	*window = param->Window;
+		unsigned int	dstLineSize = window->GetBitmapLineSize();
+
+		for (int y = inStartLine; y < inEndLine; y++)
+			window->ConvertYUVImageLine(yuvParam->Src, yuvParam->SrcLineSize, yuvParam->Format, y, 0,
+							window->mBitmapInfo->biWidth, &(((unsigned char *)param->Dst)[dstLineSize * y]));
+	}
+	typedef struct
+	{
+		const unsigned char	*Src;
+		unsigned int		SrcLineSize;
+		BayerPattern		Pattern;
+		unsigned char		*Raw;			// tight copy of the raw lines, or NULL
+		unsigned short		*Dst16Bits;		// used for 16-bit images
+		unsigned char		*Dst;			// NULL in lazy conversion mode
+	} BayerImageParam;
+
+	//	inImage has the size of the current bitmap info, 8 or 16 bits per pixel
+	//	depending on mIs16BitsImage
+	void	DemosaicImage(const unsigned char *inImage, unsigned int inLineSize, BayerPattern inPattern,
+						unsigned char *outRaw, unsigned short *outDst16Bits, unsigned char *outDst)
+	{
+		if (inImage == NULL || (mIs16BitsImage ? (void *)outDst16Bits : (void *)outDst) == NULL)
+			return;
 
-		if (imageDisp->mWindowH == NULL)
+		//	The window has to be known before the first line is converted
+		if (mIs16BitsImage && mIsAutoWindowLevelEnabled && outDst != NULL)
 		{
-			imageDisp->mWindowState = WINDOW_ERROR_STATE;
-			return 1;
+			DemosaicImage(inImage, inLineSize, inPattern, outRaw, outDst16Bits, NULL);
+			Convert16BitsImage(outDst16Bits, outDst);
+			return;
 		}
 
-#ifdef _UNICODE
-		delete windowName;
-#endif
-
-#ifdef _WIN64
-		::SetWindowLongPtr(imageDisp->mWindowH, GWLP_USERDATA, (LONG_PTR )imageDisp);
-#else
-		::SetWindowLongPtr(imageDisp->mWindowH, GWLP_USERDATA, PtrToLong(imageDisp));
-#endif
+		BayerImageParam	bayerParam;
+		bayerParam.Src			= inImage;
+		bayerParam.SrcLineSize	= inLineSize;
+		bayerParam.Pattern		= inPattern;
+		bayerParam.Raw			= outRaw;
+		bayerParam.Dst16Bits	= outDst16Bits;
+		bayerParam.Dst			= outDst;
+
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= &bayerParam;
+		param.Dst		= outDst;
+		RunLineBands(DemosaicLinesFunc, &param, abs(mBitmapInfo->biHeight),
+					mIs16BitsImage ? Get16BitsImageBufferSize() : mBitmapBitsSize);
+	}
+	static void	DemosaicLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam			*param = (LineBandParam *)inContext;
+		const BayerImageParam	*bayerParam = (const BayerImageParam *)param->Src;
+		ImageWindow	*window = param->Window;
+		bool			is16Bits = window->mIs16BitsImage;
+		unsigned int	width = window->mBitmapInfo->biWidth;
+		unsigned int	height = abs(window->mBitmapInfo->biHeight);
+		unsigned int	rawLineSize = width * (is16Bits ? 2 : 1);
+		unsigned int	dstLineSize = window->GetBitmapLineSize();
+		bool			isHighQuality = (window->mDemosaicMode == DEMOSAIC_MODE_HIGH_QUALITY);
+		BayerPattern	pattern = bayerParam->Pattern;
+		bool			isRedFirst = (pattern == BAYER_PATTERN_RG || pattern == BAYER_PATTERN_GR);
+		unsigned int	colorPhase = (pattern == BAYER_PATTERN_RG || pattern == BAYER_PATTERN_BG) ? 0 : 1;
+
+		for (int y = inStartLine; y < inEndLine; y++)
+		{
+			const unsigned char	*lines[5];
+			for (int i = 0; i < 5; i++)
+				lines[i] = &(bayerParam->Src[bayerParam->SrcLineSize *
+								ImageWindowKernel::MirrorIndex(y + i - 2, height)]);
+			bool			isRedLine = (((y & 1) == 0) == isRedFirst);
+			unsigned int	phase = colorPhase ^ (y & 1);
 
-		// Check DPI
-		double fx = GetSystemMetrics(SM_CXSMICON) / 16.0f;
-		double fy = GetSystemMetrics(SM_CYSMICON) / 16.0f;
-		if (fx < 1) fx = 1;
-		if (fy < 1) fy = 1;
-		//printf("%f, %f\n", fx, fy);
-		if (fx >= 1.5 || fy >= 1.5)
-			imageDisp->mIsHiDPI = true;
+			if (bayerParam->Raw != NULL)
+				CopyMemory(&(bayerParam->Raw[rawLineSize * y]), lines[2], rawLineSize);
 
-		imageDisp->InitToolbar();
-		imageDisp->InitCursor();
+			if (is16Bits == false)
+			{
+				unsigned char	*dst = &(bayerParam->Dst[dstLineSize * y]);
+				if (isHighQuality)
+					ImageWindowKernel::DemosaicHighQuality8(lines, dst, width, phase, isRedLine);
+				else
+					ImageWindowKernel::DemosaicBilinear8(lines[1], lines[2], lines[3], dst, width, phase, isRedLine);
+				continue;
+			}
 
-		imageDisp->mPixValueFont = CreateFont(
-			10, 0, 0, 0, FW_REGULAR, FALSE, FALSE, FALSE, ANSI_CHARSET,
-			OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
-			ANTIALIASED_QUALITY | PROOF_QUALITY,
-			//PROOF_QUALITY,
-			FIXED_PITCH | FF_MODERN,
-			TEXT("Lucida Console"));
-//			TEXT("Courier"));
+			const unsigned short	*lines16Bits[5];
+			for (int i = 0; i < 5; i++)
+				lines16Bits[i] = (const unsigned short *)lines[i];
+			unsigned short	*dst16Bits = (unsigned short *)&(((unsigned char *)bayerParam->Dst16Bits)[
+											window->m16BitsImageLineSize * y]);
+			if (isHighQuality)
+				ImageWindowKernel::DemosaicHighQuality16(lines16Bits, dst16Bits, width, phase, isRedLine);
+			else
+				ImageWindowKernel::DemosaicBilinear16(lines16Bits[1], lines16Bits[2], lines16Bits[3],
+													dst16Bits, width, phase, isRedLine);
 
-		
-		imageDisp->mWindowState = WINDOW_OPEN_STATE;
+			//	Converted while the line is still in the cache
+			if (bayerParam->Dst != NULL)
+				window->Convert16BitsImageLines(dst16Bits, &(bayerParam->Dst[dstLineSize * y]), width * 3);
+		}
+	}
+	//	inImage has the size of the current bitmap info
+	void	UnpackImage(const unsigned char *inImage, unsigned int inLineSize, PackedFormat inFormat,
+						unsigned short *outDst16Bits, unsigned char *outDst)
+	{
+		if (inImage == NULL || outDst16Bits == NULL)
+			return;
 
-		imageDisp->UpdateWindowSize();
-		::ShowWindow(imageDisp->mWindowH, SW_SHOW);
-		SetEvent(imageDisp->mEventHandle);
-		MSG	msg;
-		while (::GetMessage(&msg, NULL, 0, 0) != 0)
+		//	The window has to be known before the first line is converted
+		if (mIsAutoWindowLevelEnabled && outDst != NULL)
 		{
-			::TranslateMessage(&msg);
-			::DispatchMessage(&msg);
+			UnpackImage(inImage, inLineSize, inFormat, outDst16Bits, NULL);
+			Convert16BitsImage(outDst16Bits, outDst);
+			return;
 		}
 
-		::DestroyWindow(imageDisp->mWindowH);
-		imageDisp->mWindowState = WINDOW_INIT_STATE;
-		imageDisp->mWindowH = NULL;
-		imageDisp->mIsThreadRunning = false;
-		return 0;
+		PackedImageParam	packedParam;
+		packedParam.Src			= inImage;
+		packedParam.SrcLineSize	= inLineSize;
+		packedParam.Format		= inFormat;
+		packedParam.Width		= mBitmapInfo->biWidth;
+		packedParam.Dst16Bits	= outDst16Bits;
+		packedParam.Dst			= outDst;
+		if (outDst != NULL)
+			Update16BitsColormapTable();
+
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= &packedParam;
+		param.Dst		= outDst;
+		RunLineBands(UnpackLinesFunc, &param, abs(mBitmapInfo->biHeight),
+					Get16BitsImageBufferSize());
 	}
-
-	static LRESULT CALLBACK	WindowFunc(HWND hwnd, UINT inMessage, WPARAM inWParam, LPARAM inLParam)
+	static void	UnpackLinesFunc(void *inContext, int inStartLine, int inEndLine)
 	{
-		ImageWindow	*imageDisp;
-		HDC	hdc;
-		PAINTSTRUCT	paintstruct;
-		DWORD	result;
-
-#ifdef _WIN64
-		imageDisp = (ImageWindow *)GetWindowLongPtr(hwnd, GWLP_USERDATA);
-#else
-		imageDisp = (ImageWindow *)LongToPtr(GetWindowLongPtr(hwnd, GWLP_USERDATA));
-#endif
+		LineBandParam			*param = (LineBandParam *)inContext;
+		const PackedImageParam	*packedParam = (const PackedImageParam *)param->Src;
+		ImageWindow	*window = param->Window;
+		unsigned int	dstLineSize = window->GetBitmapLineSize();
+		int				width = packedParam->Width;
 
-		switch (inMessage)
+		for (int y = inStartLine; y < inEndLine; y++)
 		{
-			case WM_PAINT:
-				if (imageDisp == NULL)
-					break;
-				if (imageDisp->mBitmapInfo == NULL)
-					break;
+			const unsigned char	*src = packedParam->Src;
+			unsigned int	startPixel = 0;
+			unsigned short	*dst16Bits = (unsigned short *)&(((unsigned char *)packedParam->Dst16Bits)[
+											window->m16BitsImageLineSize * y]);
 
-				result = WaitForSingleObject(imageDisp->mMutexHandle, INFINITE);
-				if (result != WAIT_OBJECT_0)
-					break;
+			if (packedParam->SrcLineSize == 0)
+				startPixel = width * y;
+			else
+				src += packedParam->SrcLineSize * y;
 
-				hdc = BeginPaint(hwnd, &paintstruct);
-				imageDisp->DrawImage(hdc);
-				EndPaint(hwnd, &paintstruct);
-				ReleaseMutex(imageDisp->mMutexHandle);
-				break;
-			case WM_SIZE:
-				SendMessage(imageDisp->mRebarH, inMessage, inWParam, inLParam);
-				SendMessage(imageDisp->mStatusbarH, inMessage, inWParam, inLParam);
-				imageDisp->OnSize(inWParam, inLParam);
-				break;
-			case WM_COMMAND:
-				if (imageDisp == NULL)
+			switch (packedParam->Format)
+			{
+				case PACKED_FORMAT_MONO10P:
+					ImageWindowKernel::UnpackMono10p(src, startPixel, dst16Bits, width);
 					break;
-				imageDisp->OnCommand(inWParam, inLParam);
-				break;
-			case WM_KEYDOWN:
-				imageDisp->OnKeyDown(inWParam, inLParam);
-				break;
-			case WM_KEYUP:
-				imageDisp->OnKeyUp(inWParam, inLParam);
-				break;
-			case WM_CHAR:
-				if (imageDisp == NULL)
+				case PACKED_FORMAT_MONO12P:
+					ImageWindowKernel::UnpackMono12p(src, startPixel, dst16Bits, width);
 					break;
-				imageDisp->OnChar(inWParam, inLParam);
-				break;
-			case WM_LBUTTONDBLCLK:
-			case WM_LBUTTONDOWN:
-				imageDisp->OnLButtonDown(inMessage, inWParam, inLParam);
-				break;
-			case WM_MBUTTONDBLCLK:
-			case WM_MBUTTONDOWN:
-				imageDisp->OnMButtonDown(inMessage, inWParam, inLParam);
-				break;
-			case WM_MOUSEMOVE:
-				imageDisp->OnMouseMove(inWParam, inLParam);
-				break;
-			case WM_LBUTTONUP:
-				imageDisp->OnLButtonUp(inWParam, inLParam);
-				break;
-			case WM_RBUTTONDOWN:
-				imageDisp->OnRButtonDown(inMessage, inWParam, inLParam);
-				break;
-			case WM_SETCURSOR:
-				if (imageDisp->OnSetCursor(inWParam, inLParam) == false)
-					return DefWindowProc(hwnd, inMessage, inWParam, inLParam);
-				break;
-			case WM_MOUSEWHEEL:
-				imageDisp->OnMouseWheel(inWParam, inLParam);
-				break;
-			case WM_DESTROY:
-				PostQuitMessage(0);
-				break;
-			default:
-				return DefWindowProc(hwnd, inMessage, inWParam, inLParam);
+				case PACKED_FORMAT_MONO12_PACKED:
+					ImageWindowKernel::UnpackMono12Packed(src, startPixel, dst16Bits, width);
+					break;
+			}
+
+			//	Converted while the line is still in the cache
+			if (packedParam->Dst != NULL)
+				window->Convert16BitsImageLines(dst16Bits, &(packedParam->Dst[dstLineSize * y]), width);
+		}
+	}
+	typedef struct
+	{
+		ImageWindow		*Window;
+		const void		*Src;
+		void			*Dst;
+		unsigned int	LineSize;	// in pixels or bytes, depends on the function
+		int				LineNum;	// total line number, used by the flip functions
+		unsigned int	SrcLineSize;	// line pitch of Src and Dst, used by the
+		unsigned int	DstLineSize;	// strided functions (same unit as LineSize)
+	} LineBandParam;
+
+	//	Called with mThreadPoolMutexHandle held, the producer and the window
+	//	thread both get here
+	ImageWindowThreadPool	*GetThreadPool()
+	{
+		if (mThreadPool == NULL && GetWorkerThreadNum() > 1)
+		{
+			mThreadPool = new ImageWindowThreadPool(GetWorkerThreadNum());
+			if (mThreadPool == NULL)
+				printf("Error: Can't allocate mThreadPool (GetThreadPool)\n");
+		}
+		return mThreadPool;
+	}
+	void	RunLineBands(ImageWindowThreadPool::LineFunc inFunc, LineBandParam *inParam,
+						int inLineNum, unsigned int inDataSize)
+	{
+		if (inDataSize < mParallelMinSize)
+		{
+			inFunc(inParam, 0, inLineNum);
+			return;
+		}
+
+		//	Held for the whole Run() so that SetWorkerThreadNum() can't delete
+		//	the pool under it. Run() serializes the jobs anyway.
+		DWORD	result = WaitForSingleObject(mThreadPoolMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			inFunc(inParam, 0, inLineNum);
+			return;
+		}
+
+		ImageWindowThreadPool	*threadPool = GetThreadPool();
+		if (threadPool == NULL)
+			inFunc(inParam, 0, inLineNum);
+		else
+			threadPool->Run(inFunc, inParam, inLineNum);
+
+		ReleaseMutex(mThreadPoolMutexHandle);
+	}
+	void	CopyImageMemory(void *outDst, const void *inSrc, unsigned int inSize)
+	{
+		int	lineNum = abs(mBitmapInfo->biHeight);
+
+		if (inSize < mParallelMinSize || lineNum == 0 || inSize % lineNum != 0)
+		{
+			CopyMemory(outDst, inSrc, inSize);
+			return;
 		}
 
-		return 0;
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= inSrc;
+		param.Dst		= outDst;
+		param.LineSize	= inSize / lineNum;
+		RunLineBands(CopyLinesFunc, &param, lineNum, inSize);
 	}
+	//	Copies inLineNum lines of inLineSize bytes between buffers with
+	//	different line pitches
+	void	CopyImageLines(void *outDst, unsigned int inDstLineSize,
+						const void *inSrc, unsigned int inSrcLineSize,
+						unsigned int inLineSize, int inLineNum)
+	{
+		if (outDst == NULL || inSrc == NULL)
+			return;
 
-	static BOOL CALLBACK	MyMonitorEnumProc(HMONITOR hMon, HDC hdcMon, LPRECT inMonRect, LPARAM inLParam)
+		if (inSrcLineSize == inLineSize && inDstLineSize == inLineSize)
+		{
+			CopyImageMemory(outDst, inSrc, inLineSize * inLineNum);
+			return;
+		}
+
+		LineBandParam	param;
+		param.Window		= this;
+		param.Src			= inSrc;
+		param.Dst			= outDst;
+		param.LineSize		= inLineSize;
+		param.SrcLineSize	= inSrcLineSize;
+		param.DstLineSize	= inDstLineSize;
+		RunLineBands(CopyStridedLinesFunc, &param, inLineNum, inLineSize * inLineNum);
+	}
+	static void	CopyStridedLinesFunc(void *inContext, int inStartLine, int inEndLine)
 	{
-		ImageWindow	*imageWindow = (ImageWindow *)inLParam;
+		LineBandParam	*param = (LineBandParam *)inContext;
+		const unsigned char	*src = (const unsigned char *)param->Src;
+		unsigned char	*dst = (unsigned char *)param->Dst;
 
-		printf("Monitor(%d) %d, %d, %d, %d\n", imageWindow->mMonitorNum, 
-			inMonRect->left, inMonRect->top, inMonRect->right, inMonRect->bottom);
-		imageWindow->mMonitorRect[imageWindow->mMonitorNum].left = inMonRect->left;
-		imageWindow->mMonitorRect[imageWindow->mMonitorNum].top = inMonRect->top;
-		imageWindow->mMonitorRect[imageWindow->mMonitorNum].right = inMonRect->right;
-		imageWindow->mMonitorRect[imageWindow->mMonitorNum].bottom = inMonRect->bottom;
-		if (imageWindow->mMonitorNum == MONITOR_ENUM_MAX - 1)
-			return FALSE;
-		imageWindow->mMonitorNum++;
-		return TRUE;
+		for (int y = inStartLine; y < inEndLine; y++)
+			memcpy(&(dst[param->DstLineSize * y]), &(src[param->SrcLineSize * y]), param->LineSize);
 	}
+	static void	CopyLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
+		unsigned int	offset = param->LineSize * inStartLine;
 
-	int	RegisterWindowClass()
+		CopyMemory(&(((unsigned char *)param->Dst)[offset]),
+					&(((const unsigned char *)param->Src)[offset]),
+					param->LineSize * (inEndLine - inStartLine));
+	}
+	static void	ConvertLinesFunc(void *inContext, int inStartLine, int inEndLine)
 	{
-		WNDCLASSEX	wcx;
+		LineBandParam	*param = (LineBandParam *)inContext;
+		const unsigned short	*src = (const unsigned short *)param->Src;
+		unsigned char	*dst = (unsigned char *)param->Dst;
 
-		if (GetClassInfoEx(
-				GetModuleHandle(NULL),
-				IMAGE_WINDOW_CLASS_NAME,
-				&wcx) != 0)
+		//	Packed lines are converted as one run
+		if (param->SrcLineSize == param->LineSize && param->DstLineSize == param->LineSize)
 		{
-			return 1;
+			unsigned int	offset = param->LineSize * inStartLine;
+			param->Window->Convert16BitsImageLines(&(src[offset]), &(dst[offset]),
+					param->LineSize * (inEndLine - inStartLine));
+			return;
 		}
 
-		InitIcon();
+		for (int y = inStartLine; y < inEndLine; y++)
+			param->Window->Convert16BitsImageLines(&(src[param->SrcLineSize * y]),
+					&(dst[param->DstLineSize * y]), param->LineSize);
+	}
+	static void	FlipLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
 
-		ZeroMemory(&wcx,sizeof(WNDCLASSEX));
-		wcx.cbSize = sizeof(WNDCLASSEX); 
+		FlipBitmapLines((unsigned char *)param->Dst, param->LineSize, param->LineNum,
+						inStartLine, inEndLine);
+	}
+	static void	CopyFlippedLinesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
+		const unsigned char	*src = (const unsigned char *)param->Src;
+		unsigned char	*dst = (unsigned char *)param->Dst;
 
-		wcx.hInstance = mModuleH;
-		wcx.lpszClassName = IMAGE_WINDOW_CLASS_NAME;
-		wcx.lpfnWndProc = WindowFunc;
-		wcx.style = CS_DBLCLKS ; // Class styles
+		for (int y = inStartLine; y < inEndLine; y++)
+			memcpy(&(dst[param->LineSize * (param->LineNum - y - 1)]),
+					&(src[param->LineSize * y]), param->LineSize);
+	}
+	//	The frame generation is used to find out of date lazy tiles and
+	//	pyramid levels
+	void	IncrementFrameGeneration()
+	{
+		//	Generation 0 is reserved for "never converted"
+		if (InterlockedIncrement(&mFrameGeneration) == 0)
+			InterlockedIncrement(&mFrameGeneration);
+	}
+	void	ConvertVisibleTiles()
+	{
+		if (mIsLazyConversionEnabled == false || (mIs16BitsImage == false && mIsYUVImage == false) ||
+			mBitmapInfo == NULL)
+			return;
 
-		wcx.cbClsExtra = 0;
-		wcx.cbWndExtra = 0;
+		double	scale = mImageDispScale / 100.0;
+		RECT	rect;
 
-		wcx.hIcon = mAppIconH;
-		wcx.hIconSm = mAppIconH;
-		wcx.hCursor = LoadCursor(NULL, IDC_ARROW);
-		wcx.lpszMenuName = NULL;
+		rect.left	= mImageDispOffset.cx;
+		rect.top	= mImageDispOffset.cy;
+		rect.right	= rect.left + (int )ceil(mImageDispSize.cx / scale) + 1;
+		rect.bottom	= rect.top + (int )ceil(mImageDispSize.cy / scale) + 1;
+		ConvertDirtyTiles(rect);
+	}
+	void	ConvertAllDirtyTiles()
+	{
+		if (mIsLazyConversionEnabled == false || (mIs16BitsImage == false && mIsYUVImage == false) ||
+			mBitmapInfo == NULL)
+			return;
 
-		wcx.hbrBackground = (HBRUSH)COLOR_WINDOW; // Background brush
+		RECT	rect;
 
-		if (RegisterClassEx(&wcx) == 0)
-			return 0;
+		rect.left	= 0;
+		rect.top	= 0;
+		rect.right	= mBitmapInfo->biWidth;
+		rect.bottom	= abs(mBitmapInfo->biHeight);
+		ConvertDirtyTiles(rect);
+	}
+	void	ConvertDirtyTiles(RECT inRect)
+	{
+		int	width = mBitmapInfo->biWidth;
+		int	height = abs(mBitmapInfo->biHeight);
+		const unsigned short	*srcImagePtr = Get16BitsImageBufferPtr();
 
-		return 1;
+		if ((srcImagePtr == NULL && mIsYUVImage == false) || mBitmapBits == NULL)
+			return;
+
+		if (mTileGenerations == NULL ||
+			mTileImageSize.cx != width || mTileImageSize.cy != height)
+		{
+			if (mTileGenerations != NULL)
+				delete [] mTileGenerations;
+
+			mTileNumX = (width + IMAGE_LAZY_TILE_SIZE - 1) / IMAGE_LAZY_TILE_SIZE;
+			mTileNumY = (height + IMAGE_LAZY_TILE_SIZE - 1) / IMAGE_LAZY_TILE_SIZE;
+			mTileGenerations = new LONG[mTileNumX * mTileNumY];
+			if (mTileGenerations == NULL)
+			{
+				printf("Error: Can't allocate mTileGenerations (ConvertDirtyTiles)\n");
+				return;
+			}
+			ZeroMemory(mTileGenerations, sizeof(LONG) * mTileNumX * mTileNumY);
+			mTileImageSize.cx = width;
+			mTileImageSize.cy = height;
+		}
+
+		if (inRect.left < 0)
+			inRect.left = 0;
+		if (inRect.top < 0)
+			inRect.top = 0;
+		if (inRect.right > width)
+			inRect.right = width;
+		if (inRect.bottom > height)
+			inRect.bottom = height;
+		if (inRect.left >= inRect.right || inRect.top >= inRect.bottom)
+			return;
+
+		mConvertTileRect.left	= inRect.left / IMAGE_LAZY_TILE_SIZE;
+		mConvertTileRect.top	= inRect.top / IMAGE_LAZY_TILE_SIZE;
+		mConvertTileRect.right	= (inRect.right + IMAGE_LAZY_TILE_SIZE - 1) / IMAGE_LAZY_TILE_SIZE;
+		mConvertTileRect.bottom	= (inRect.bottom + IMAGE_LAZY_TILE_SIZE - 1) / IMAGE_LAZY_TILE_SIZE;
+		mConvertGeneration = mFrameGeneration;
+
+		if (mIsYUVImage == false)
+		{
+			//	Once per frame, all the tiles of a frame use the same window
+			if (mAutoWindowLevelGeneration != mConvertGeneration)
+			{
+				UpdateAutoWindowLevel(srcImagePtr);
+				mAutoWindowLevelGeneration = mConvertGeneration;
+			}
+			Update16BitsColormapTable();
+		}
+
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= srcImagePtr;
+		param.Dst		= mBitmapBits;
+		param.LineSize	= width;
+		int	tileRowNum = mConvertTileRect.bottom - mConvertTileRect.top;
+		RunLineBands(ConvertTilesFunc, &param, tileRowNum,
+					tileRowNum * (mConvertTileRect.right - mConvertTileRect.left) *
+					IMAGE_LAZY_TILE_SIZE * IMAGE_LAZY_TILE_SIZE * sizeof(unsigned short));
 	}
-	bool	PrepareImageBuffers(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp, bool inIs16Bits)
+	void	ConvertTileRows(const unsigned short *inSrcImage, unsigned char *outDstImage,
+							int inStartTileRow, int inEndTileRow)
 	{
-		bool	doUpdateSize = CreateBitmapInfo(inWidth, inHeight, inIsColor, inIsBottomUp, inIs16Bits);
+		int	width = mTileImageSize.cx;
+		int	height = mTileImageSize.cy;
+		unsigned int	srcLineSize = m16BitsImageLineSize / sizeof(unsigned short);
+		unsigned int	dstLineSize = GetBitmapLineSize();
+		int	channelNum = Get16BitsChannelNum();
+		int	pixelSize = mBitmapInfo->biBitCount / 8;
+
+		for (int ty = inStartTileRow; ty < inEndTileRow; ty++)
+		{
+			LONG	*generations = &(mTileGenerations[ty * mTileNumX]);
+			int		tx = mConvertTileRect.left;
 
-		mExternal16BitsImageBuffer = NULL;
+			while (tx < mConvertTileRect.right)
+			{
+				if (generations[tx] == mConvertGeneration)
+				{
+					tx++;
+					continue;
+				}
+
+				//	Merge the horizontally adjacent dirty tiles into one run
+				int	startTX = tx;
+				while (tx < mConvertTileRect.right && generations[tx] != mConvertGeneration)
+				{
+					generations[tx] = mConvertGeneration;
+					tx++;
+				}
+
+				int	x0 = startTX * IMAGE_LAZY_TILE_SIZE;
+				int	x1 = tx * IMAGE_LAZY_TILE_SIZE;
+				int	y0 = ty * IMAGE_LAZY_TILE_SIZE;
+				int	y1 = y0 + IMAGE_LAZY_TILE_SIZE;
+				if (x1 > width)
+					x1 = width;
+				if (y1 > height)
+					y1 = height;
 
-		if (inIs16Bits == false && mAllocated16BitsImageBuffer != NULL)
+				if (mIsYUVImage)
+				{
+					for (int y = y0; y < y1; y++)
+						ConvertYUVImageLine(mYUVImageBuffer, mYUVImageLineSize, mYUVFormat, y, x0, x1 - x0,
+											&(outDstImage[y * dstLineSize + x0 * 3]));
+					continue;
+				}
+				for (int y = y0; y < y1; y++)
+					Convert16BitsImageLines(&(inSrcImage[y * srcLineSize + x0 * channelNum]),
+											&(outDstImage[y * dstLineSize + x0 * pixelSize]),
+											(x1 - x0) * channelNum);
+			}
+		}
+	}
+	static void	ConvertTilesFunc(void *inContext, int inStartLine, int inEndLine)
+	{
+		LineBandParam	*param = (LineBandParam *)inContext;
+		int	top = param->Window->mConvertTileRect.top;
+
+		param->Window->ConvertTileRows(
+					(const unsigned short *)param->Src, (unsigned char *)param->Dst,
+					top + inStartLine, top + inEndLine);
+	}
+	int		PreparePyramidLevel(double inScale)
+	{
+		int	level = 0;
+
+		if (mIsPyramidEnabled == false || mIsWaterfallEnabled || mBitmapInfo == NULL || mBitmapBits == NULL)
+			return 0;
+		if (mBitmapInfo->biBitCount != 8 && mBitmapInfo->biBitCount != 24 &&
+			mBitmapInfo->biBitCount != 32)
+			return 0;
+
+		//	Pick the smallest level that is still not smaller than the display
+		while (level < IMAGE_PYRAMID_LEVEL_MAX && inScale <= 0.5)
 		{
-			delete mAllocated16BitsImageBuffer;
-			mAllocated16BitsImageBuffer = NULL;
+			inScale *= 2.0;
+			level++;
 		}
-		
-		if (mAllocatedImageBuffer != NULL && doUpdateSize != false)
+		if (level == 0)
+			return 0;
+
+		ConvertAllDirtyTiles();
+
+		int	height = abs(mBitmapInfo->biHeight);
+		mPyramid[0].BitmapInfo	= mBitmapInfo;
+		mPyramid[0].BitmapBits	= mBitmapBits;
+		mPyramid[0].Width		= mBitmapInfo->biWidth;
+		mPyramid[0].Height		= height;
+		mPyramid[0].LineSize	= GetBitmapLineSize();
+		mPyramid[0].Generation	= mFrameGeneration;
+
+		for (int i = 1; i <= level; i++)
+			if (UpdatePyramidLevel(i) == false)
+				return i - 1;
+
+		return level;
+	}
+	bool	UpdatePyramidLevel(int inLevel)
+	{
+		ImagePyramidLevel	*srcLevel = &(mPyramid[inLevel - 1]);
+		ImagePyramidLevel	*dstLevel = &(mPyramid[inLevel]);
+		int		channelNum = mBitmapInfo->biBitCount / 8;
+		int		width = srcLevel->Width / 2;
+		int		height = srcLevel->Height / 2;
+		unsigned int	lineSize = ((width * channelNum) + 3) & ~3;	// DWORD aligned
+
+		if (width < 1 || height < 1)
+			return false;
+
+		bool	isLevelUpToDate = true;
+
+		if (dstLevel->BitmapBits == NULL || dstLevel->BitmapInfoSize != mBitmapInfoSize ||
+			dstLevel->Width != width || dstLevel->Height != height ||
+			dstLevel->LineSize != lineSize)
 		{
-			delete mAllocatedImageBuffer;
-			mAllocatedImageBuffer = NULL;
-			if (mAllocated16BitsImageBuffer != NULL)
+			DeletePyramidLevel(dstLevel);
+			dstLevel->BitmapInfo = (BITMAPINFOHEADER *)AllocateBuffer(mBitmapInfoSize);
+			dstLevel->BitmapBits = (unsigned char *)AllocateBuffer(lineSize * height);
+			if (dstLevel->BitmapInfo == NULL || dstLevel->BitmapBits == NULL)
 			{
-				delete mAllocated16BitsImageBuffer;
-				mAllocated16BitsImageBuffer = NULL;
+				printf("Error: Can't allocate pyramid level (UpdatePyramidLevel)\n");
+				DeletePyramidLevel(dstLevel);
+				return false;
 			}
+			dstLevel->BitmapInfoSize	= mBitmapInfoSize;
+			dstLevel->Width				= width;
+			dstLevel->Height			= height;
+			dstLevel->LineSize			= lineSize;
+			isLevelUpToDate = false;
 		}
 
-		if (mAllocatedImageBuffer == NULL)
-			CreateNewImageBuffer(true);
+		//	The palette is copied every time since SetColormap() may change it
+		//	without changing the frame
+		CopyMemory(dstLevel->BitmapInfo, mBitmapInfo, mBitmapInfoSize);
+		dstLevel->BitmapInfo->biWidth = width;
+		dstLevel->BitmapInfo->biHeight = (mBitmapInfo->biHeight < 0) ? -height : height;
+		dstLevel->BitmapInfo->biSizeImage = lineSize * height;
 
-		if (inIs16Bits == true && mAllocated16BitsImageBuffer == NULL)
-			CreateNewImageBuffer16Bits(true);
+		if (isLevelUpToDate && dstLevel->Generation == srcLevel->Generation)
+			return true;
 
-		return doUpdateSize;
+		LineBandParam	param;
+		param.Window	= this;
+		param.Src		= srcLevel;
+		param.Dst		= dstLevel;
+		param.LineSize	= channelNum;
+		RunLineBands(PyramidLinesFunc, &param, height, srcLevel->LineSize * srcLevel->Height);
+
+		dstLevel->Generation = srcLevel->Generation;
+		return true;
 	}
-	void	Update16BitsImageDisp()
+	static void	PyramidLinesFunc(void *inContext, int inStartLine, int inEndLine)
 	{
-		unsigned short	*srcImagePtr = mAllocated16BitsImageBuffer;
-		unsigned char	*dstImagePtr = mAllocatedImageBuffer;
-		double	mapK = 255.0 / (double )(mMapTopValue - mMapBottomValue);
+		LineBandParam		*param = (LineBandParam *)inContext;
+		const ImagePyramidLevel	*srcLevel = (const ImagePyramidLevel *)param->Src;
+		ImagePyramidLevel	*dstLevel = (ImagePyramidLevel *)param->Dst;
 
-		if (mIsMapModeEnabled == false)
+		for (int y = inStartLine; y < inEndLine; y++)
+		{
+			const unsigned char	*srcPtr = &(srcLevel->BitmapBits[srcLevel->LineSize * y * 2]);
+			ImageWindowKernel::Downsample2x(srcPtr, srcPtr + srcLevel->LineSize,
+						&(dstLevel->BitmapBits[dstLevel->LineSize * y]),
+						dstLevel->Width, param->LineSize);
+		}
+	}
+	void	DeletePyramidLevel(ImagePyramidLevel *inLevel)
+	{
+		FreeBuffer(inLevel->BitmapInfo);
+		FreeBuffer(inLevel->BitmapBits);
+		ZeroMemory(inLevel, sizeof(ImagePyramidLevel));
+	}
+	void	DeletePyramid()
+	{
+		//	mPyramid[0] only refers to mBitmapInfo and mBitmapBits
+		ZeroMemory(&(mPyramid[0]), sizeof(ImagePyramidLevel));
+		for (int i = 1; i <= IMAGE_PYRAMID_LEVEL_MAX; i++)
+			DeletePyramidLevel(&(mPyramid[i]));
+	}
+	//	Takes the histogram of a strided subsample of inSrcImage (the layout
+	//	of the current 16-bit image) and sets the linear window from it
+	void	UpdateAutoWindowLevel(const unsigned short *inSrcImage)
+	{
+		if (mIsAutoWindowLevelEnabled == false || mIs16BitsImage == false ||
+			inSrcImage == NULL || mBitmapInfo == NULL)
+			return;
+
+		int		sampleNum = mBitmapInfo->biWidth * Get16BitsChannelNum();
+		int		height = abs(mBitmapInfo->biHeight);
+		unsigned int	srcLineSize = m16BitsImageLineSize / sizeof(unsigned short);
+		int		shift = (m16BitsImageBitDepth > IMAGE_AUTO_WL_BIN_BITS) ?
+							m16BitsImageBitDepth - IMAGE_AUTO_WL_BIN_BITS : 0;
+		unsigned int	binNum = 1 << (m16BitsImageBitDepth - shift);
+		int		step = (int )sqrt((double )sampleNum * height / IMAGE_AUTO_WL_SAMPLE_NUM);
+
+		if (step < IMAGE_AUTO_WL_MIN_STEP)
+			step = IMAGE_AUTO_WL_MIN_STEP;
+		if ((double )sampleNum * height / ((double )step * step) < IMAGE_AUTO_WL_MIN_SAMPLE_NUM)
+			step = (int )sqrt((double )sampleNum * height / IMAGE_AUTO_WL_MIN_SAMPLE_NUM);
+		if (step < 1)
+			step = 1;
+
+		mAutoWindowLevelHistogram.assign(binNum, 0);
+		unsigned int	*histogram = &(mAutoWindowLevelHistogram[0]);
+		unsigned int	totalNum = 0;
+
+		//	The first sample of a line moves with the line so that the
+		//	samples don't all fall on the same columns (or color channel)
+		for (int y = (step < height) ? step / 2 : 0; y < height; y += step)
 		{
-			for (int y = 0; y < mImageSize.cy; y++)
+			const unsigned short	*src = &(inSrcImage[srcLineSize * y]);
+			for (int x = (y / step) % step; x < sampleNum; x += step)
 			{
-				for (int x = 0; x < mImageSize.cx; x++)
-				{
-					unsigned short	value = (*srcImagePtr) >> 8;
-					*dstImagePtr = (unsigned char)value;
-					dstImagePtr++;
-					srcImagePtr++;
-				}
+				unsigned int	bin = src[x] >> shift;
+				if (bin >= binNum)
+					bin = binNum - 1;
+				histogram[bin]++;
+				totalNum++;
 			}
 		}
-		else
+		if (totalNum == 0)
+			return;
+
+		unsigned int	lowNum = (unsigned int )(totalNum * mAutoWindowLevelLowPercent / 100.0);
+		unsigned int	highNum = (unsigned int )ceil(totalNum * mAutoWindowLevelHighPercent / 100.0);
+		unsigned int	bottomBin = binNum - 1, topBin = binNum - 1;
+		unsigned int	count = 0;
+		bool	isBottomFound = false;
+
+		for (unsigned int i = 0; i < binNum; i++)
 		{
-			for (int y = 0; y < mImageSize.cy; y++)
+			count += histogram[i];
+			if (isBottomFound == false && count > lowNum)
 			{
-				for (int x = 0; x < mImageSize.cx; x++)
-				{
-					unsigned short	value;
+				bottomBin = i;
+				isBottomFound = true;
+			}
+			if (count >= highNum && count != 0)
+			{
+				topBin = i;
+				break;
+			}
+		}
 
-					if (*srcImagePtr <= mMapDirectMapLimit)
-						value = *srcImagePtr;
-					else
-					{
-						double	d;
-						if (mIsMapReverse == false)
-							d = mapK * (double )(*srcImagePtr - mMapBottomValue);
-						else
-							d = 255.0 - (mapK * (double )(*srcImagePtr - mMapBottomValue));
-
-						if (d > 255)
-							d = 255;
-						if (d <= mMapDirectMapLimit)
-							d = mMapDirectMapLimit + 1;
-						value = (unsigned short)d;
-					}
+		double	bottomValue = (double )(bottomBin << shift);
+		double	topValue = (double )(((topBin + 1) << shift) - 1);
+		if (mIsAutoWindowLevelValid)
+		{
+			double	k = mAutoWindowLevelSmoothing;
+			bottomValue = k * mAutoBottomValue + (1.0 - k) * bottomValue;
+			topValue = k * mAutoTopValue + (1.0 - k) * topValue;
+		}
+		mAutoBottomValue = bottomValue;
+		mAutoTopValue = topValue;
+		mIsAutoWindowLevelValid = true;
 
-					*dstImagePtr = (unsigned char)value;
-					dstImagePtr++;
-					srcImagePtr++;
-				}
+		unsigned short	bottom = (unsigned short )(bottomValue + 0.5);
+		unsigned short	top = (unsigned short )(topValue + 0.5);
+		if (top <= bottom)
+		{
+			if (bottom == 65535)
+				bottom--;
+			top = bottom + 1;
+		}
+
+		//	Same as SetWindowLevel() without the redraw
+		if (mMapBottomValue != bottom || mMapTopValue != top ||
+			mIsMapReverse != false || mMapDirectMapLimit != 0)
+			mIsMapTableValid = false;
+		mIsMapModeEnabled = true;
+		mIsMapLinear = true;
+		mIsMapPerChannel = false;
+		mMapBottomValue = bottom;
+		mMapTopValue = top;
+		mIsMapReverse = false;
+		mMapDirectMapLimit = 0;
+	}
+	void	UpdateMapTable()
+	{
+		if (mMapTable == NULL)
+		{
+			mMapTable = new unsigned char[IMAGE_MAP_TABLE_SIZE];
+			if (mMapTable == NULL)
+			{
+				printf("Error: Can't allocate mMapTable (UpdateMapTable)\n");
+				return;
+			}
+		}
+
+		ImageWindowKernel::MakeMapTable(mMapTable, mMapBottomValue, mMapTopValue,
+								mIsMapReverse, mMapDirectMapLimit);
+		mIsMapTableValid = true;
+		mIsColormapTableValid = false;
+	}
+	//	Composes the current 16 to 8-bit mapping with the colormap. Linear
+	//	mappings are interpolated between the palette entries so that no
+	//	precision is lost, the map table (SetMapMode()) is used as it is.
+	void	Update16BitsColormapTable()
+	{
+		if (Is16BitsColormapImage() == false)
+			return;
+
+		ImageColormapTableParam	tableParam;
+		tableParam.IsMapModeEnabled	= mIsMapModeEnabled;
+		tableParam.IsMapLinear		= mIsMapLinear;
+		tableParam.IsMapTableValid	= mIsMapTableValid;
+		tableParam.MapBottomValue	= mMapBottomValue;
+		tableParam.MapTopValue		= mMapTopValue;
+		tableParam.BitDepth			= m16BitsImageBitDepth;
+
+		if (mIsColormapTableValid &&
+			mColormapTableParam.IsMapModeEnabled	== tableParam.IsMapModeEnabled &&
+			mColormapTableParam.IsMapLinear			== tableParam.IsMapLinear &&
+			mColormapTableParam.IsMapTableValid		== tableParam.IsMapTableValid &&
+			mColormapTableParam.MapBottomValue		== tableParam.MapBottomValue &&
+			mColormapTableParam.MapTopValue			== tableParam.MapTopValue &&
+			mColormapTableParam.BitDepth			== tableParam.BitDepth)
+			return;
+
+		if (mColormapTable == NULL)
+		{
+			mColormapTable = new unsigned int[IMAGE_MAP_TABLE_SIZE];
+			if (mColormapTable == NULL)
+			{
+				printf("Error: Can't allocate mColormapTable (Update16BitsColormapTable)\n");
+				return;
 			}
 		}
+
+		double	bottomValue = 0;
+		double	scale = 1.0 / 256.0;
+		bool	isLinear = true;
+
+		if (mIsMapModeEnabled && mIsMapLinear)
+		{
+			bottomValue = mMapBottomValue;
+			scale = 255.0 / ((mMapTopValue > mMapBottomValue) ? (mMapTopValue - mMapBottomValue) : 1);
+		}
+		else if (mIsMapModeEnabled && mIsMapTableValid)
+			isLinear = false;
+		else if (m16BitsImageBitDepth < 16)
+			scale = 255.0 / ((1 << m16BitsImageBitDepth) - 1);
+
+		for (int i = 0; i < IMAGE_MAP_TABLE_SIZE; i++)
+		{
+			double	pos = isLinear ? (i - bottomValue) * scale : mMapTable[i];
+
+			if (pos < 0)
+				pos = 0;
+			if (pos > 255)
+				pos = 255;
+
+			//	Entries 0 and 1 are the black and white markers, not part of the ramp
+			int		index = (int )pos;
+			double	t = pos - index;
+			const RGBQUAD	*c0 = &(mColormapPalette[index]);
+			const RGBQUAD	*c1 = (index >= 2 && index < 255) ? &(mColormapPalette[index + 1]) : c0;
+
+			unsigned int	b = (unsigned int )(c0->rgbBlue + (c1->rgbBlue - c0->rgbBlue) * t + 0.5);
+			unsigned int	g = (unsigned int )(c0->rgbGreen + (c1->rgbGreen - c0->rgbGreen) * t + 0.5);
+			unsigned int	r = (unsigned int )(c0->rgbRed + (c1->rgbRed - c0->rgbRed) * t + 0.5);
+			mColormapTable[i] = (r << 16) | (g << 8) | b;
+		}
+
+		mColormapTableParam = tableParam;
+		mIsColormapTableValid = true;
+	}
+	//	Switches the display buffer of the current 16-bit mono image between
+	//	the 8-bit and the 32-bit DIB. The frame buffers are recreated with
+	//	the next frame instead.
+	void	Recreate16BitsImageDisp()
+	{
+		if (mBitmapInfo == NULL || mIs16BitsImage == false || mIsColorImage ||
+			mFrameBuffers[0].ImageBuffer != NULL || mAllocatedImageBuffer == NULL)
+			return;
+
+		DWORD	result = WaitForSingleObject(mMutexHandle, INFINITE);
+		if (result != WAIT_OBJECT_0)
+		{
+			printf("Error: WaitForSingleObject failed (Recreate16BitsImageDisp)\n");
+			return;
+		}
+
+		if (CreateBitmapInfo(mBitmapInfo->biWidth, abs(mBitmapInfo->biHeight), false, false, true,
+							COLOR_FORMAT_BGR))
+		{
+			FreeBuffer(mAllocatedImageBuffer);
+			mAllocatedImageBuffer = NULL;
+			if (CreateNewImageBuffer(true) == 0)
+				return;
+			mIsImageDispConverted = 0;
+			IncrementFrameGeneration();
+		}
+
+		ReleaseMutex(mMutexHandle);
+		UpdateImage();
 	}
-	bool	CreateBitmapInfo(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp, bool inIs16Bits)
+	bool	CreateBitmapInfo(int inWidth, int inHeight, bool inIsColor, bool inIsBottomUp, bool inIs16Bits,
+							ColorFormat inColorFormat)
 	{
 		mIsColorImage = inIsColor;
 		mIs16BitsImage = inIs16Bits;
+		mColorFormat = inIsColor ? inColorFormat : COLOR_FORMAT_BGR;
 
 		if (inIsColor)
-			return CreateColorBitmapInfo(inWidth, inHeight, inIsBottomUp);
-		else
-			return CreateMonoBitmapInfo(inWidth, inHeight, inIsBottomUp);
+			return CreateColorBitmapInfo(inWidth, inHeight, inIsBottomUp, mColorFormat);
+		//	Top-down like the mono DIBs
+		if (inIs16Bits && mIs16BitsColormapEnabled)
+			return CreateColorBitmapInfo(inWidth, inHeight, false, COLOR_FORMAT_BGRA);
+		return CreateMonoBitmapInfo(inWidth, inHeight, inIsBottomUp);
+	}
+	bool	IsColorFormatSupported(bool inIsColor, bool inIs16Bits, ColorFormat inColorFormat)
+	{
+		if (inIsColor == false)
+			return true;
+
+		//	There is no 24-bit RGB DIB and 64-bit images are not supported
+		if (inIs16Bits == false && inColorFormat == COLOR_FORMAT_RGB)
+		{
+			printf("Error: 8-bit RGB is not supported, use BGR or RGBA (IsColorFormatSupported)\n");
+			return false;
+		}
+		if (inIs16Bits != false &&
+			(inColorFormat == COLOR_FORMAT_BGRA || inColorFormat == COLOR_FORMAT_RGBA))
+		{
+			printf("Error: 16-bit BGRA/RGBA is not supported (IsColorFormatSupported)\n");
+			return false;
+		}
+		return true;
+	}
+	//	Index of the red channel in a display (DIB) pixel and in a 16-bit
+	//	source pixel
+	int		GetRedIndex()
+	{
+		return (mColorFormat == COLOR_FORMAT_RGBA) ? 0 : 2;
+	}
+	int		Get16BitsRedIndex()
+	{
+		return (mColorFormat == COLOR_FORMAT_RGB) ? 0 : 2;
+	}
+	//	DIB lines are aligned to 4 bytes
+	static unsigned int	CalcBitmapLineSize(int inWidth, int inBitCount)
+	{
+		return ((abs(inWidth) * inBitCount + 31) / 32) * 4;
+	}
+	//	Line size of a tightly packed caller's buffer in bytes
+	unsigned int	GetPackedImageLineSize()
+	{
+		if (mIs16BitsImage)
+			return mBitmapInfo->biWidth * Get16BitsChannelNum() * sizeof(unsigned short);
+		return mBitmapInfo->biWidth * (mBitmapInfo->biBitCount / 8);
+	}
+	//	The DIB of a 16-bit mono image is 32-bit when the colormap is applied
+	//	to the 16-bit values, so the source layout can't be taken from it
+	int		Get16BitsChannelNum()
+	{
+		return mIsColorImage ? 3 : 1;
+	}
+	bool	Is16BitsColormapImage()
+	{
+		return (mIs16BitsImage && mIsColorImage == false &&
+				mBitmapInfo != NULL && mBitmapInfo->biBitCount == 32);
+	}
+	unsigned int	GetBitmapLineSize()
+	{
+		int	height = abs(mBitmapInfo->biHeight);
+
+		if (height == 0)
+			return 0;
+		return mBitmapBitsSize / height;
+	}
+	void	*AllocateBuffer(size_t inSize)
+	{
+		void	*buffer = ImageWindowBufferPool::GetInstance()->Allocate(inSize);
+
+		if (buffer != NULL)
+			InterlockedExchangeAdd64(&mBufferMemorySize, ImageWindowBufferPool::GetBlockSize(buffer));
+		return buffer;
+	}
+	void	FreeBuffer(void *inBuffer)
+	{
+		if (inBuffer == NULL)
+			return;
+
+		InterlockedExchangeAdd64(&mBufferMemorySize, -1 * (LONGLONG )ImageWindowBufferPool::GetBlockSize(inBuffer));
+		ImageWindowBufferPool::GetInstance()->Free(inBuffer);
 	}
 	int		CreateNewImageBuffer(bool inDoZeroClear)
 	{
-		mAllocatedImageBuffer = new unsigned char[mBitmapBitsSize];
+		mAllocatedImageBuffer = (unsigned char *)AllocateBuffer(mBitmapBitsSize);
 		if (mAllocatedImageBuffer == NULL)
 		{
 			printf("Error: Can't allocate mBitmapBits (CreateNewImageBuffer)\n");
@@ -2704,7 +7342,7 @@ private:
 	}
 	int		CreateNewImageBuffer16Bits(bool inDoZeroClear)
 	{
-		mAllocated16BitsImageBuffer = new unsigned short[mBitmapBitsSize];
+		mAllocated16BitsImageBuffer = (unsigned short *)AllocateBuffer(Get16BitsImageBufferSize());
 		if (mAllocated16BitsImageBuffer == NULL)
 		{
 			printf("Error: Can't allocate mAllocated16BitsImageBuffer (CreateNewImageBuffer16Bits)\n");
@@ -2712,7 +7350,7 @@ private:
 			return 0;
 		}
 		if (inDoZeroClear == true)
-			ZeroMemory(mAllocated16BitsImageBuffer, mBitmapBitsSize * sizeof(unsigned short));
+			ZeroMemory(mAllocated16BitsImageBuffer, Get16BitsImageBufferSize());
 
 		return 1;
 	}
@@ -2722,10 +7360,8 @@ private:
 	{
 		bool	doCreateBitmapInfo = false;
 
-		if (inIsBottomUp == true)
-			inHeight = abs(inHeight);
-		else
-			inHeight = -1 * abs(inHeight);
+		//	Mono DIBs are always created as top-down
+		inHeight = -1 * abs(inHeight);
 
 		if (mBitmapInfo != NULL)
 		{
@@ -2743,11 +7379,10 @@ private:
 
 		if (doCreateBitmapInfo)
 		{
-			if (mBitmapInfo != NULL)
-				delete mBitmapInfo;
+			FreeBuffer(mBitmapInfo);
 
 			mBitmapInfoSize = sizeof(ImageBitmapInfoMono8);
-			mBitmapInfo = (BITMAPINFOHEADER *)(new unsigned char[mBitmapInfoSize]);
+			mBitmapInfo = (BITMAPINFOHEADER *)AllocateBuffer(mBitmapInfoSize);
 			if (mBitmapInfo == NULL)
 			{
 				printf("Error: Can't allocate mBitmapInfo (CreateMonoBitmapInfo)\n");
@@ -2766,23 +7401,27 @@ private:
 			bitmapInfo->Header.biClrUsed		= IMAGE_PALLET_SIZE_8BIT;
 			bitmapInfo->Header.biClrImportant	= IMAGE_PALLET_SIZE_8BIT;
 
-			for (int i = 0; i < IMAGE_PALLET_SIZE_8BIT; i++)
-			{
-				bitmapInfo->RGBQuad[i].rgbBlue		= i;
-				bitmapInfo->RGBQuad[i].rgbGreen		= i;
-				bitmapInfo->RGBQuad[i].rgbRed		= i;
-				bitmapInfo->RGBQuad[i].rgbReserved	= 0;
-			}
+			//	The colormap is kept across size changes
+			CopyMemory(bitmapInfo->RGBQuad, mColormapPalette, sizeof(mColormapPalette));
 
-			mBitmapBitsSize = abs(inWidth * inHeight);
+			mBitmapBitsSize = CalcBitmapLineSize(inWidth, 8) * abs(inHeight);
 		}
 
 		return doCreateBitmapInfo;
 	}
 
-	bool	CreateColorBitmapInfo(int inWidth, int inHeight, bool inIsBottomUp)
+	//	48-bit images are displayed through a 24-bit BGR DIB. RGBA is shown as
+	//	it is with BI_BITFIELDS masks.
+	bool	CreateColorBitmapInfo(int inWidth, int inHeight, bool inIsBottomUp, ColorFormat inColorFormat)
 	{
 		bool	doCreateBitmapInfo = false;
+		int		bitCount = 24;
+		DWORD	compression = BI_RGB;
+
+		if (inColorFormat == COLOR_FORMAT_BGRA || inColorFormat == COLOR_FORMAT_RGBA)
+			bitCount = 32;
+		if (inColorFormat == COLOR_FORMAT_RGBA)
+			compression = BI_BITFIELDS;
 
 		if (inIsBottomUp == true)
 			inHeight = abs(inHeight);
@@ -2791,9 +7430,10 @@ private:
 
 		if (mBitmapInfo != NULL)
 		{
-			if (mBitmapInfo->biBitCount		!= 24 ||
+			if (mBitmapInfo->biBitCount		!= bitCount ||
+				mBitmapInfo->biCompression	!= compression ||
 				mBitmapInfo->biWidth		!= inWidth ||
-				abs(mBitmapInfo->biHeight)	!= inHeight)
+				mBitmapInfo->biHeight		!= inHeight)
 			{
 				doCreateBitmapInfo = true;
 			}
@@ -2805,11 +7445,12 @@ private:
 
 		if (doCreateBitmapInfo)
 		{
-			if (mBitmapInfo != NULL)
-				delete mBitmapInfo;
+			FreeBuffer(mBitmapInfo);
 
 			mBitmapInfoSize = sizeof(BITMAPINFOHEADER);
-			mBitmapInfo = (BITMAPINFOHEADER *)(new unsigned char[mBitmapInfoSize]);
+			if (compression == BI_BITFIELDS)
+				mBitmapInfoSize += sizeof(DWORD) * 3;
+			mBitmapInfo = (BITMAPINFOHEADER *)AllocateBuffer(mBitmapInfoSize);
 			if (mBitmapInfo == NULL)
 			{
 				printf("Error: Can't allocate mBitmapInfo (CreateColorBitmapInfo)\n");
@@ -2819,15 +7460,24 @@ private:
 			mBitmapInfo->biWidth			= inWidth;
 			mBitmapInfo->biHeight			= inHeight;
 			mBitmapInfo->biPlanes			= 1;
-			mBitmapInfo->biBitCount			= 24;
-			mBitmapInfo->biCompression		= BI_RGB;
+			mBitmapInfo->biBitCount			= bitCount;
+			mBitmapInfo->biCompression		= compression;
 			mBitmapInfo->biSizeImage		= 0;
 			mBitmapInfo->biXPelsPerMeter	= 100;
 			mBitmapInfo->biYPelsPerMeter	= 100;
 			mBitmapInfo->biClrUsed			= 0;
 			mBitmapInfo->biClrImportant		= 0;
 
-			mBitmapBitsSize = abs(inWidth * inHeight * 3);
+			if (compression == BI_BITFIELDS)
+			{
+				//	R, G, B masks of the little endian 32-bit pixel
+				DWORD	*masks = (DWORD *)&(mBitmapInfo[1]);
+				masks[0] = 0x000000FF;
+				masks[1] = 0x0000FF00;
+				masks[2] = 0x00FF0000;
+			}
+
+			mBitmapBitsSize = CalcBitmapLineSize(inWidth, bitCount) * abs(inHeight);
 		}
 
 		return doCreateBitmapInfo;
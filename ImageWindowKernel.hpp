@@ -0,0 +1,2223 @@
+// =============================================================================
+//	ImageWindowKernel.hpp
+//
+//	MIT License
+//
+//	Copyright (c) 2007-2018 Dairoku Sekiguchi
+//
+//	Permission is hereby granted, free of charge, to any person obtaining a copy
+//	of this software and associated documentation files (the "Software"), to deal
+//	in the Software without restriction, including without limitation the rights
+//	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//	copies of the Software, and to permit persons to whom the Software is
+//	furnished to do so, subject to the following conditions:
+//
+//	The above copyright notice and this permission notice shall be included in all
+//	copies or substantial portions of the Software.
+//
+//	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//	SOFTWARE.
+// =============================================================================
+/*!
+	\file		ImageWindowKernel.hpp
+	\author		Dairoku Sekiguchi
+	\version	3.0 (Release.04)
+	\date		2018/07/07
+	\brief		Pixel conversion kernels of ImageWindow (no Win32 dependency)
+*/
+#ifndef __IMAGE_WINDOW_KERNEL_H
+#define __IMAGE_WINDOW_KERNEL_H
+
+
+
+// -----------------------------------------------------------------------------
+// 	include files
+// -----------------------------------------------------------------------------
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define	IMAGE_KERNEL_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+#define	IMAGE_KERNEL_NEON
+#include <arm_neon.h>
+#endif
+
+
+// -----------------------------------------------------------------------------
+// 	macros
+// -----------------------------------------------------------------------------
+#ifdef _MSC_VER
+#define	IMAGE_KERNEL_TARGET_AVX2
+#else
+#define	IMAGE_KERNEL_TARGET_AVX2		__attribute__((target("avx2")))
+#endif
+
+
+// -----------------------------------------------------------------------------
+// 	typedefs
+// -----------------------------------------------------------------------------
+//	The source image and the view of ImageWindowKernel::RenderLines(). The
+//	buffer is the integer rect (OriginX, OriginY) - (OriginX + BufferWidth,
+//	OriginY + buffer height) of the view.
+typedef struct
+{
+	const unsigned char	*Bits;
+	unsigned int		LineSize;
+	int					Width;
+	int					Height;
+	bool				IsBottomUp;
+	int					BitCount;
+	int					RedIndex;			// 2 for BGR(A), 0 for RGBA
+	unsigned char		Palette[256][3];	// BGR
+	int					OffsetX;
+	int					OffsetY;
+	double				Scale;
+	int					OriginX;			// view pixel of the first buffer pixel
+	int					OriginY;			// view line of the first buffer line
+	int					TopLine;			// image line shown at the top (waterfall)
+	const int			*XTable;
+	unsigned char		*Buffer;
+	int					BufferWidth;
+	unsigned int		BufferLineSize;
+	unsigned char		BkColor[3];			// BGR
+} ImageRenderParam;
+
+// -----------------------------------------------------------------------------
+//	ImageWindowKernel class
+// -----------------------------------------------------------------------------
+//!
+/*!
+	Pixel conversion kernels used by ImageWindow. The kernels only use plain
+	C types (no Win32 dependency, see test/KernelTest.cpp) and are dispatched
+	at runtime to SSE2, AVX2 or NEON. Every SIMD kernel gives exactly the same
+	result as its scalar (_C) version.
+*/
+class ImageWindowKernel
+{
+public:
+	// enum --------------------------------------------------------------------
+	enum SIMDType
+	{
+		SIMD_TYPE_NONE	=	0,
+		SIMD_TYPE_SSE2,
+		SIMD_TYPE_AVX2,
+		SIMD_TYPE_NEON
+	};
+
+	static int	GetSIMDType()
+	{
+		return GetSIMDTypeRef();
+	}
+
+	//	Mainly for testing and benchmarking. inType is limited to what the CPU supports
+	static void	SetSIMDType(int inType)
+	{
+		int	detectedType = DetectSIMDType();
+
+		if (inType == SIMD_TYPE_NONE || inType == detectedType ||
+			(inType == SIMD_TYPE_SSE2 && detectedType == SIMD_TYPE_AVX2))
+			GetSIMDTypeRef() = inType;
+		else
+			GetSIMDTypeRef() = detectedType;
+	}
+
+	// -------------------------------------------------------------------------
+	//	Shift16To8(...)
+	// -------------------------------------------------------------------------
+	//!	outDst[i] = inSrc[i] >> 8
+	static void	Shift16To8(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = Shift16To8_AVX2(inSrc, outDst, inNum);
+				break;
+			case SIMD_TYPE_SSE2:
+				num = Shift16To8_SSE2(inSrc, outDst, inNum);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = Shift16To8_NEON(inSrc, outDst, inNum);
+				break;
+#endif
+		}
+
+		Shift16To8_C(&(inSrc[num]), &(outDst[num]), inNum - num);
+	}
+
+	static void	Shift16To8_C(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum)
+	{
+		for (unsigned int i = 0; i < inNum; i++)
+			outDst[i] = (unsigned char )(inSrc[i] >> 8);
+	}
+
+	// -------------------------------------------------------------------------
+	//	WindowLevel16To8(...)
+	// -------------------------------------------------------------------------
+	//!	Linear window/level mapping
+	/*!
+		Values <= inBottomValue are mapped to 0, values >= inTopValue to 255
+		and values in between linearly (rounded down, within 1 LSB of the
+		exact value). The mapping is done in 16-bit fixed point.
+	*/
+	static void	WindowLevel16To8(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum,
+								unsigned short inBottomValue, unsigned short inTopValue)
+	{
+		unsigned int	num = 0;
+		unsigned short	range, scale;
+		int				shift;
+
+		CalcWindowLevelParams(inBottomValue, inTopValue, &range, &scale, &shift);
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = WindowLevel16To8_AVX2(inSrc, outDst, inNum, inBottomValue, range, scale, shift);
+				break;
+			case SIMD_TYPE_SSE2:
+				num = WindowLevel16To8_SSE2(inSrc, outDst, inNum, inBottomValue, range, scale, shift);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = WindowLevel16To8_NEON(inSrc, outDst, inNum, inBottomValue, range, scale, shift);
+				break;
+#endif
+		}
+
+		WindowLevel16To8_C(&(inSrc[num]), &(outDst[num]), inNum - num, inBottomValue, range, scale, shift);
+	}
+
+	static void	WindowLevel16To8_C(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum,
+								unsigned short inBottomValue, unsigned short inRange,
+								unsigned short inScale, int inShift)
+	{
+		for (unsigned int i = 0; i < inNum; i++)
+		{
+			unsigned int	value = inSrc[i];
+
+			value = (value > inBottomValue) ? value - inBottomValue : 0;
+			if (value > inRange)
+				value = inRange;
+			outDst[i] = (unsigned char )(((value << inShift) * inScale) >> 16);
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	WindowLevel48To24(...)
+	// -------------------------------------------------------------------------
+	//!	Linear window/level mapping of 3-channel pixels, one window per channel
+	/*!
+		inBottomValues and inTopValues are in the channel order of inSrc and
+		the channels are written in the same order. Each channel is mapped
+		exactly like WindowLevel16To8().
+	*/
+	static void	WindowLevel48To24(const unsigned short *inSrc, unsigned char *outDst, unsigned int inPixelNum,
+								const unsigned short inBottomValues[3], const unsigned short inTopValues[3])
+	{
+		unsigned int	num = 0;
+		unsigned short	range[3], scale[3];
+		int				shift[3];
+
+		for (int c = 0; c < 3; c++)
+			CalcWindowLevelParams(inBottomValues[c], inTopValues[c], &(range[c]), &(scale[c]), &(shift[c]));
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+			case SIMD_TYPE_SSE2:
+				num = WindowLevel48To24_SSE2(inSrc, outDst, inPixelNum, inBottomValues, range, scale, shift);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = WindowLevel48To24_NEON(inSrc, outDst, inPixelNum, inBottomValues, range, scale, shift);
+				break;
+#endif
+		}
+
+		WindowLevel48To24_C(&(inSrc[num * 3]), &(outDst[num * 3]), inPixelNum - num,
+							inBottomValues, range, scale, shift);
+	}
+
+	static void	WindowLevel48To24_C(const unsigned short *inSrc, unsigned char *outDst, unsigned int inPixelNum,
+								const unsigned short inBottomValues[3], const unsigned short inRanges[3],
+								const unsigned short inScales[3], const int inShifts[3])
+	{
+		for (unsigned int i = 0; i < inPixelNum; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int	value = inSrc[c];
+
+				value = (value > inBottomValues[c]) ? value - inBottomValues[c] : 0;
+				if (value > inRanges[c])
+					value = inRanges[c];
+				outDst[c] = (unsigned char )(((value << inShifts[c]) * inScales[c]) >> 16);
+			}
+			inSrc += 3;
+			outDst += 3;
+		}
+	}
+
+	//!	Swaps the first and the third channel of 3-channel pixels (RGB <-> BGR)
+	static void	SwapRB24(unsigned char *ioBuf, unsigned int inPixelNum)
+	{
+		for (unsigned int i = 0; i < inPixelNum; i++, ioBuf += 3)
+		{
+			unsigned char	v = ioBuf[0];
+			ioBuf[0] = ioBuf[2];
+			ioBuf[2] = v;
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	Downsample2x(...)
+	// -------------------------------------------------------------------------
+	//!	Area-averages two source lines into one line of half width
+	/*!
+		inChannelNum is 1 (mono), 3 (BGR) or 4 (BGRA). Each output value is
+		avg(avg(a, c), avg(b, d)) where a, b are the horizontal pair on
+		inSrc0, c, d on inSrc1 and avg(x, y) = (x + y + 1) >> 1.
+	*/
+	static void	Downsample2x(const unsigned char *inSrc0, const unsigned char *inSrc1,
+							unsigned char *outDst, unsigned int inDstWidth, int inChannelNum)
+	{
+		const unsigned int	CHUNK_SIZE = 256;
+		unsigned char	buf[CHUNK_SIZE * 2 * 4];
+
+		for (unsigned int i = 0; i < inDstWidth; i += CHUNK_SIZE)
+		{
+			unsigned int	num = inDstWidth - i;
+			if (num > CHUNK_SIZE)
+				num = CHUNK_SIZE;
+
+			unsigned int	srcOffset = i * 2 * inChannelNum;
+			Average8(&(inSrc0[srcOffset]), &(inSrc1[srcOffset]), buf, num * 2 * inChannelNum);
+			HalveWidth8(buf, &(outDst[i * inChannelNum]), num, inChannelNum);
+		}
+	}
+
+	//!	outDst[i] = (inSrc0[i] + inSrc1[i] + 1) >> 1
+	static void	Average8(const unsigned char *inSrc0, const unsigned char *inSrc1,
+							unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = Average8_AVX2(inSrc0, inSrc1, outDst, inNum);
+				break;
+			case SIMD_TYPE_SSE2:
+				num = Average8_SSE2(inSrc0, inSrc1, outDst, inNum);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = Average8_NEON(inSrc0, inSrc1, outDst, inNum);
+				break;
+#endif
+		}
+
+		Average8_C(&(inSrc0[num]), &(inSrc1[num]), &(outDst[num]), inNum - num);
+	}
+
+	static void	Average8_C(const unsigned char *inSrc0, const unsigned char *inSrc1,
+							unsigned char *outDst, unsigned int inNum)
+	{
+		for (unsigned int i = 0; i < inNum; i++)
+			outDst[i] = (unsigned char )((inSrc0[i] + inSrc1[i] + 1) >> 1);
+	}
+
+	//!	Averages horizontally adjacent pixels, inDstWidth pixels are written
+	static void	HalveWidth8(const unsigned char *inSrc, unsigned char *outDst,
+							unsigned int inDstWidth, int inChannelNum)
+	{
+		unsigned int	num = 0;
+
+		if (inChannelNum == 1)
+		{
+			switch (GetSIMDType())
+			{
+#ifdef IMAGE_KERNEL_X86
+				case SIMD_TYPE_AVX2:
+				case SIMD_TYPE_SSE2:
+					num = HalveWidth8_SSE2(inSrc, outDst, inDstWidth);
+					break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+				case SIMD_TYPE_NEON:
+					num = HalveWidth8_NEON(inSrc, outDst, inDstWidth);
+					break;
+#endif
+			}
+		}
+
+		HalveWidth8_C(&(inSrc[num * 2 * inChannelNum]), &(outDst[num * inChannelNum]),
+						inDstWidth - num, inChannelNum);
+	}
+
+	static void	HalveWidth8_C(const unsigned char *inSrc, unsigned char *outDst,
+							unsigned int inDstWidth, int inChannelNum)
+	{
+		for (unsigned int i = 0; i < inDstWidth; i++)
+		{
+			for (int c = 0; c < inChannelNum; c++)
+				outDst[c] = (unsigned char )((inSrc[c] + inSrc[c + inChannelNum] + 1) >> 1);
+			inSrc += inChannelNum * 2;
+			outDst += inChannelNum;
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	UnpackMono10p(...)
+	// -------------------------------------------------------------------------
+	//!	Unpacks GenICam packed mono pixels into 16-bit values
+	/*!
+		inSrc is a packed pixel stream and pixels inStartPixel to
+		inStartPixel + inPixelNum - 1 are unpacked, so a line does not have to
+		start on a byte boundary.
+		Mono10p:		4 pixels in 5 bytes, LSB first
+		Mono12p:		2 pixels in 3 bytes, LSB first
+		Mono12Packed:	2 pixels in 3 bytes, the middle byte has the low
+						nibbles (GigE Vision)
+	*/
+	static void	UnpackMono10p(const unsigned char *inSrc, unsigned int inStartPixel,
+							unsigned short *outDst, unsigned int inPixelNum)
+	{
+		UnpackMono(inSrc, inStartPixel, outDst, inPixelNum, 4, 5, UnpackMono10p_C,
+#ifdef IMAGE_KERNEL_X86
+					(GetSIMDType() == SIMD_TYPE_AVX2) ? UnpackMono10p_AVX2 : NULL
+#else
+					NULL
+#endif
+					);
+	}
+
+	static void	UnpackMono12p(const unsigned char *inSrc, unsigned int inStartPixel,
+							unsigned short *outDst, unsigned int inPixelNum)
+	{
+		UnpackMono(inSrc, inStartPixel, outDst, inPixelNum, 2, 3, UnpackMono12p_C,
+#ifdef IMAGE_KERNEL_X86
+					(GetSIMDType() == SIMD_TYPE_AVX2) ? UnpackMono12p_AVX2 : NULL
+#elif defined(IMAGE_KERNEL_NEON)
+					(GetSIMDType() == SIMD_TYPE_NEON) ? UnpackMono12p_NEON : NULL
+#else
+					NULL
+#endif
+					);
+	}
+
+	static void	UnpackMono12Packed(const unsigned char *inSrc, unsigned int inStartPixel,
+							unsigned short *outDst, unsigned int inPixelNum)
+	{
+		UnpackMono(inSrc, inStartPixel, outDst, inPixelNum, 2, 3, UnpackMono12Packed_C,
+#ifdef IMAGE_KERNEL_X86
+					(GetSIMDType() == SIMD_TYPE_AVX2) ? UnpackMono12Packed_AVX2 : NULL
+#elif defined(IMAGE_KERNEL_NEON)
+					(GetSIMDType() == SIMD_TYPE_NEON) ? UnpackMono12Packed_NEON : NULL
+#else
+					NULL
+#endif
+					);
+	}
+
+	static void	UnpackMono10p_C(const unsigned char *inSrc, unsigned int inStartPixel,
+							unsigned short *outDst, unsigned int inPixelNum)
+	{
+		for (unsigned int i = 0; i < inPixelNum; i++)
+		{
+			unsigned int	bit = (inStartPixel + i) * 10;
+			const unsigned char	*src = &(inSrc[bit >> 3]);
+
+			outDst[i] = (unsigned short )(((src[0] | (src[1] << 8)) >> (bit & 7)) & 0x3FF);
+		}
+	}
+
+	static void	UnpackMono12p_C(const unsigned char *inSrc, unsigned int inStartPixel,
+							unsigned short *outDst, unsigned int inPixelNum)
+	{
+		for (unsigned int i = 0; i < inPixelNum; i++)
+		{
+			unsigned int	bit = (inStartPixel + i) * 12;
+			const unsigned char	*src = &(inSrc[bit >> 3]);
+
+			outDst[i] = (unsigned short )(((src[0] | (src[1] << 8)) >> (bit & 7)) & 0xFFF);
+		}
+	}
+
+	static void	UnpackMono12Packed_C(const unsigned char *inSrc, unsigned int inStartPixel,
+							unsigned short *outDst, unsigned int inPixelNum)
+	{
+		for (unsigned int i = 0; i < inPixelNum; i++)
+		{
+			unsigned int	pixel = inStartPixel + i;
+			const unsigned char	*src = &(inSrc[(pixel >> 1) * 3]);
+
+			if ((pixel & 1) == 0)
+				outDst[i] = (unsigned short )((src[0] << 4) | (src[1] & 0x0F));
+			else
+				outDst[i] = (unsigned short )((src[2] << 4) | (src[1] >> 4));
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	DemosaicBilinear8(...)
+	// -------------------------------------------------------------------------
+	//!	Bilinear demosaic of one Bayer line into BGR pixels
+	/*!
+		inUp and inDown are the lines above and below inLine, mirrored at the
+		image edges so that they keep the Bayer phase (see MirrorIndex()).
+		inColorPhase is the x parity of the red or blue pixels of inLine and
+		inIsRedLine tells which of the two they are. With
+		avg(x, y) = (x + y + 1) >> 1, h = avg(left, right), v = avg(up, down)
+		and d = avg(avg(up left, up right), avg(down left, down right)):
+		  red/blue pixels:	own color = c, G = avg(h, v), other color = d
+		  green pixels:		own color = h, G = c, other color = v
+	*/
+	static void	DemosaicBilinear8(const unsigned char *inUp, const unsigned char *inLine, const unsigned char *inDown,
+							unsigned char *outDst, unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		unsigned int	num = 0;
+
+		if (inWidth < 2)
+		{
+			DemosaicBilinear8_C(inUp, inLine, inDown, outDst, inWidth, 0, inWidth, inColorPhase, inIsRedLine);
+			return;
+		}
+
+		//	The first and the last pixel need the mirrored neighbors
+		DemosaicBilinear8_C(inUp, inLine, inDown, outDst, inWidth, 0, 1, inColorPhase, inIsRedLine);
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = DemosaicBilinear8_AVX2(inUp, inLine, inDown, outDst, inWidth, inColorPhase, inIsRedLine);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = DemosaicBilinear8_NEON(inUp, inLine, inDown, outDst, inWidth, inColorPhase, inIsRedLine);
+				break;
+#endif
+		}
+		DemosaicBilinear8_C(inUp, inLine, inDown, outDst, inWidth, 1 + num, inWidth - 1 - num,
+							inColorPhase, inIsRedLine);
+	}
+
+	//!	Same as DemosaicBilinear8() for 16-bit pixels
+	static void	DemosaicBilinear16(const unsigned short *inUp, const unsigned short *inLine, const unsigned short *inDown,
+							unsigned short *outDst, unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		unsigned int	num = 0;
+
+		if (inWidth < 2)
+		{
+			DemosaicBilinear16_C(inUp, inLine, inDown, outDst, inWidth, 0, inWidth, inColorPhase, inIsRedLine);
+			return;
+		}
+
+		DemosaicBilinear16_C(inUp, inLine, inDown, outDst, inWidth, 0, 1, inColorPhase, inIsRedLine);
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = DemosaicBilinear16_AVX2(inUp, inLine, inDown, outDst, inWidth, inColorPhase, inIsRedLine);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = DemosaicBilinear16_NEON(inUp, inLine, inDown, outDst, inWidth, inColorPhase, inIsRedLine);
+				break;
+#endif
+		}
+		DemosaicBilinear16_C(inUp, inLine, inDown, outDst, inWidth, 1 + num, inWidth - 1 - num,
+							inColorPhase, inIsRedLine);
+	}
+
+	//	Pixels inStartX to inStartX + inNum - 1 of the line
+	static void	DemosaicBilinear8_C(const unsigned char *inUp, const unsigned char *inLine, const unsigned char *inDown,
+							unsigned char *outDst, unsigned int inWidth, unsigned int inStartX, unsigned int inNum,
+							unsigned int inColorPhase, bool inIsRedLine)
+	{
+		int	ownIndex = inIsRedLine ? 2 : 0;
+
+		for (unsigned int x = inStartX; x < inStartX + inNum; x++)
+		{
+			unsigned int	left = MirrorIndex((int )x - 1, inWidth);
+			unsigned int	right = MirrorIndex((int )x + 1, inWidth);
+			unsigned int	h = (inLine[left] + inLine[right] + 1) >> 1;
+			unsigned int	v = (inUp[x] + inDown[x] + 1) >> 1;
+			unsigned char	*dst = &(outDst[x * 3]);
+
+			if ((x & 1) == inColorPhase)
+			{
+				unsigned int	dUp = (inUp[left] + inUp[right] + 1) >> 1;
+				unsigned int	dDown = (inDown[left] + inDown[right] + 1) >> 1;
+				dst[ownIndex]		= inLine[x];
+				dst[1]				= (unsigned char )((h + v + 1) >> 1);
+				dst[2 - ownIndex]	= (unsigned char )((dUp + dDown + 1) >> 1);
+			}
+			else
+			{
+				dst[ownIndex]		= (unsigned char )h;
+				dst[1]				= inLine[x];
+				dst[2 - ownIndex]	= (unsigned char )v;
+			}
+		}
+	}
+
+	static void	DemosaicBilinear16_C(const unsigned short *inUp, const unsigned short *inLine, const unsigned short *inDown,
+							unsigned short *outDst, unsigned int inWidth, unsigned int inStartX, unsigned int inNum,
+							unsigned int inColorPhase, bool inIsRedLine)
+	{
+		int	ownIndex = inIsRedLine ? 2 : 0;
+
+		for (unsigned int x = inStartX; x < inStartX + inNum; x++)
+		{
+			unsigned int	left = MirrorIndex((int )x - 1, inWidth);
+			unsigned int	right = MirrorIndex((int )x + 1, inWidth);
+			unsigned int	h = (inLine[left] + inLine[right] + 1) >> 1;
+			unsigned int	v = (inUp[x] + inDown[x] + 1) >> 1;
+			unsigned short	*dst = &(outDst[x * 3]);
+
+			if ((x & 1) == inColorPhase)
+			{
+				unsigned int	dUp = (inUp[left] + inUp[right] + 1) >> 1;
+				unsigned int	dDown = (inDown[left] + inDown[right] + 1) >> 1;
+				dst[ownIndex]		= inLine[x];
+				dst[1]				= (unsigned short )((h + v + 1) >> 1);
+				dst[2 - ownIndex]	= (unsigned short )((dUp + dDown + 1) >> 1);
+			}
+			else
+			{
+				dst[ownIndex]		= (unsigned short )h;
+				dst[1]				= inLine[x];
+				dst[2 - ownIndex]	= (unsigned short )v;
+			}
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	DemosaicHighQuality8(...)
+	// -------------------------------------------------------------------------
+	//!	Gradient-corrected linear demosaic of one Bayer line (Malvar-He-Cutler)
+	/*!
+		inLines are the 5 lines from 2 above to 2 below the line, mirrored at
+		the image edges like in DemosaicBilinear8(). The bilinear estimate is
+		corrected by the Laplacian of the pixel's own channel, which removes
+		most of the zipper and color fringes at edges. Scalar only, meant for
+		still frames.
+	*/
+	static void	DemosaicHighQuality8(const unsigned char *inLines[5], unsigned char *outDst,
+							unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		int	ownIndex = inIsRedLine ? 2 : 0;
+		int	value[3];
+
+		for (unsigned int x = 0; x < inWidth; x++)
+		{
+			unsigned int	xs[5];
+			int				p[5][5];
+
+			for (int i = 0; i < 5; i++)
+				xs[i] = MirrorIndex((int )x + i - 2, inWidth);
+			for (int j = 0; j < 5; j++)
+				for (int i = 0; i < 5; i++)
+					p[j][i] = inLines[j][xs[i]];
+
+			DemosaicHighQualityPixel(p, (x & 1) == inColorPhase, 255, value);
+			outDst[x * 3 + ownIndex]		= (unsigned char )value[0];
+			outDst[x * 3 + 1]				= (unsigned char )value[1];
+			outDst[x * 3 + 2 - ownIndex]	= (unsigned char )value[2];
+		}
+	}
+
+	static void	DemosaicHighQuality16(const unsigned short *inLines[5], unsigned short *outDst,
+							unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		int	ownIndex = inIsRedLine ? 2 : 0;
+		int	value[3];
+
+		for (unsigned int x = 0; x < inWidth; x++)
+		{
+			unsigned int	xs[5];
+			int				p[5][5];
+
+			for (int i = 0; i < 5; i++)
+				xs[i] = MirrorIndex((int )x + i - 2, inWidth);
+			for (int j = 0; j < 5; j++)
+				for (int i = 0; i < 5; i++)
+					p[j][i] = inLines[j][xs[i]];
+
+			DemosaicHighQualityPixel(p, (x & 1) == inColorPhase, 65535, value);
+			outDst[x * 3 + ownIndex]		= (unsigned short )value[0];
+			outDst[x * 3 + 1]				= (unsigned short )value[1];
+			outDst[x * 3 + 2 - ownIndex]	= (unsigned short )value[2];
+		}
+	}
+
+	//!	Reflects an out of range index back into [0, inNum) keeping its parity
+	static unsigned int	MirrorIndex(int inIndex, unsigned int inNum)
+	{
+		if (inNum < 2)
+			return 0;
+		if (inIndex < 0)
+			inIndex = -inIndex;
+		if (inIndex >= (int )inNum)
+			inIndex = 2 * (int )inNum - 2 - inIndex;
+		if (inIndex < 0)
+			inIndex = -inIndex;
+		return (unsigned int )inIndex;
+	}
+
+	// -------------------------------------------------------------------------
+	//	YUYVToBGR24(...)
+	// -------------------------------------------------------------------------
+	//!	Converts limited range YUV 4:2:2 / 4:2:0 pixels to BGR
+	/*!
+		inCoefs are the chroma coefficients {B-U, G-U, G-V, R-V} in 1/64 units
+		(G ones positive, they are subtracted). With y = max(Y - 16, 0),
+		yt = ((y << 8) * 19071) >> 16 (1.164 in 1/64 units), u = U - 128 and
+		v = V - 128:
+		  B = (yt + cbu * u + 32) >> 6
+		  G = (yt - cgu * u - cgv * v + 32) >> 6
+		  R = (yt + crv * v + 32) >> 6
+		clamped to [0, 255]. Two horizontally adjacent pixels share the
+		chroma, so the first pixel must be an even one.
+		YUYV:	Y0 U0 Y1 V0 ...
+		NV12:	Y plane and an interleaved U0 V0 ... plane
+		I420:	Y, U and V planes
+	*/
+	static void	YUYVToBGR24(const unsigned char *inSrc, unsigned char *outDst, unsigned int inPixelNum,
+							const short inCoefs[4])
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = YUYVToBGR24_AVX2(inSrc, outDst, inPixelNum, inCoefs);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = YUYVToBGR24_NEON(inSrc, outDst, inPixelNum, inCoefs);
+				break;
+#endif
+		}
+
+		YUVToBGR24_C(&(inSrc[num * 2]), 2, &(inSrc[num * 2 + 1]), &(inSrc[num * 2 + 3]), 4,
+					&(outDst[num * 3]), inPixelNum - num, inCoefs);
+	}
+
+	static void	NV12ToBGR24(const unsigned char *inY, const unsigned char *inUV, unsigned char *outDst,
+							unsigned int inPixelNum, const short inCoefs[4])
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = NV12ToBGR24_AVX2(inY, inUV, outDst, inPixelNum, inCoefs);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = NV12ToBGR24_NEON(inY, inUV, outDst, inPixelNum, inCoefs);
+				break;
+#endif
+		}
+
+		YUVToBGR24_C(&(inY[num]), 1, &(inUV[num]), &(inUV[num + 1]), 2,
+					&(outDst[num * 3]), inPixelNum - num, inCoefs);
+	}
+
+	static void	I420ToBGR24(const unsigned char *inY, const unsigned char *inU, const unsigned char *inV,
+							unsigned char *outDst, unsigned int inPixelNum, const short inCoefs[4])
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = I420ToBGR24_AVX2(inY, inU, inV, outDst, inPixelNum, inCoefs);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = I420ToBGR24_NEON(inY, inU, inV, outDst, inPixelNum, inCoefs);
+				break;
+#endif
+		}
+
+		YUVToBGR24_C(&(inY[num]), 1, &(inU[num / 2]), &(inV[num / 2]), 1,
+					&(outDst[num * 3]), inPixelNum - num, inCoefs);
+	}
+
+	//	inYStep and inUVStep are the byte distances between the Y samples and
+	//	between the chroma samples (one chroma sample per two pixels)
+	static void	YUVToBGR24_C(const unsigned char *inY, unsigned int inYStep,
+							const unsigned char *inU, const unsigned char *inV, unsigned int inUVStep,
+							unsigned char *outDst, unsigned int inPixelNum, const short inCoefs[4])
+	{
+		for (unsigned int i = 0; i < inPixelNum; i++)
+		{
+			int	y = inY[i * inYStep];
+			int	u = inU[(i >> 1) * inUVStep] - 128;
+			int	v = inV[(i >> 1) * inUVStep] - 128;
+			int	yt = ((((y > 16) ? y - 16 : 0) << 8) * 19071) >> 16;
+
+			outDst[i * 3 + 0] = ClampTo8((yt + inCoefs[0] * u + 32) >> 6);
+			outDst[i * 3 + 1] = ClampTo8((yt - inCoefs[1] * u - inCoefs[2] * v + 32) >> 6);
+			outDst[i * 3 + 2] = ClampTo8((yt + inCoefs[3] * v + 32) >> 6);
+		}
+	}
+
+	static unsigned char	ClampTo8(int inValue)
+	{
+		if (inValue < 0)
+			return 0;
+		if (inValue > 255)
+			return 255;
+		return (unsigned char )inValue;
+	}
+
+	// -------------------------------------------------------------------------
+	//	CopyFloatMinMax(...)
+	// -------------------------------------------------------------------------
+	//!	Copies float values and updates *ioMin and *ioMax with the finite ones
+	/*!
+		NaN and +/-Inf are copied but not counted. Start with *ioMin = +Inf
+		and *ioMax = -Inf, they stay like that if no value is finite.
+	*/
+	static void	CopyFloatMinMax(const float *inSrc, float *outDst, unsigned int inNum,
+								float *ioMin, float *ioMax)
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+			case SIMD_TYPE_SSE2:
+				num = CopyFloatMinMax_SSE2(inSrc, outDst, inNum, ioMin, ioMax);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = CopyFloatMinMax_NEON(inSrc, outDst, inNum, ioMin, ioMax);
+				break;
+#endif
+		}
+
+		CopyFloatMinMax_C(&(inSrc[num]), &(outDst[num]), inNum - num, ioMin, ioMax);
+	}
+
+	static void	CopyFloatMinMax_C(const float *inSrc, float *outDst, unsigned int inNum,
+								float *ioMin, float *ioMax)
+	{
+		float	minValue = *ioMin;
+		float	maxValue = *ioMax;
+
+		for (unsigned int i = 0; i < inNum; i++)
+		{
+			float	value = inSrc[i];
+
+			outDst[i] = value;
+			if (value - value != 0.0f)	// NaN or Inf
+				continue;
+			if (value < minValue)
+				minValue = value;
+			if (value > maxValue)
+				maxValue = value;
+		}
+		*ioMin = minValue;
+		*ioMax = maxValue;
+	}
+
+	// -------------------------------------------------------------------------
+	//	WindowLevelFloatTo8(...)
+	// -------------------------------------------------------------------------
+	//!	Linear mapping of float values to 8 bits
+	/*!
+		t = (inSrc[i] - inBottomValue) * inScale is clamped to [0, 255] and
+		rounded (half up). NaN and -Inf are mapped to 0, +Inf to 255.
+	*/
+	static void	WindowLevelFloatTo8(const float *inSrc, unsigned char *outDst, unsigned int inNum,
+								float inBottomValue, float inScale)
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+			case SIMD_TYPE_SSE2:
+				num = WindowLevelFloatTo8_SSE2(inSrc, outDst, inNum, inBottomValue, inScale);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = WindowLevelFloatTo8_NEON(inSrc, outDst, inNum, inBottomValue, inScale);
+				break;
+#endif
+		}
+
+		WindowLevelFloatTo8_C(&(inSrc[num]), &(outDst[num]), inNum - num, inBottomValue, inScale);
+	}
+
+	static void	WindowLevelFloatTo8_C(const float *inSrc, unsigned char *outDst, unsigned int inNum,
+								float inBottomValue, float inScale)
+	{
+		for (unsigned int i = 0; i < inNum; i++)
+		{
+			float	value = (inSrc[i] - inBottomValue) * inScale;
+
+			if (!(value > 0.0f))	// NaN too
+				value = 0.0f;
+			if (value > 255.0f)
+				value = 255.0f;
+			outDst[i] = (unsigned char )(value + 0.5f);
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	Lookup16To8(...)
+	// -------------------------------------------------------------------------
+	//!	outDst[i] = inTable[inSrc[i]] (inTable must have 65536 entries)
+	static void	Lookup16To8(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum,
+								const unsigned char *inTable)
+	{
+		for (unsigned int i = 0; i < inNum; i++)
+			outDst[i] = inTable[inSrc[i]];
+	}
+
+	// -------------------------------------------------------------------------
+	//	MakeMapTable(...)
+	// -------------------------------------------------------------------------
+	//!	Builds the 65536-entry table of ImageWindow::SetMapMode()
+	/*!
+		Values <= inDirectMapLimit are kept as they are, the others are
+		mapped linearly from [inBottomValue, inTopValue] to [0, 255] (or
+		[255, 0] if inIsReverse) and clamped to [inDirectMapLimit + 1, 255].
+		The table is bit-identical to the per-pixel mapping of the earlier
+		versions, see test/MapTableTest.cpp.
+	*/
+	static void	MakeMapTable(unsigned char *outTable, unsigned short inBottomValue, unsigned short inTopValue,
+								bool inIsReverse, unsigned short inDirectMapLimit)
+	{
+		double	mapK = 255.0 / (double )(inTopValue - inBottomValue);
+
+		for (int i = 0; i < 65536; i++)
+		{
+			unsigned short	value;
+
+			if (i <= inDirectMapLimit)
+				value = (unsigned short )i;
+			else
+			{
+				double	d;
+				if (inIsReverse == false)
+					d = mapK * (double )(i - inBottomValue);
+				else
+					d = 255.0 - (mapK * (double )(i - inBottomValue));
+
+				if (d > 255)
+					d = 255;
+				if (d <= inDirectMapLimit)
+					d = inDirectMapLimit + 1;
+				value = (unsigned short)d;
+			}
+
+			outTable[i] = (unsigned char)value;
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	Lookup16To32(...)
+	// -------------------------------------------------------------------------
+	//!	outDst[i] = inTable[inSrc[i]] (inTable must have 65536 entries)
+	/*!
+		Used to color 16-bit images through a 64K-entry BGRA table. There is
+		no gather instruction in SSE2 and NEON, they use the scalar version.
+	*/
+	static void	Lookup16To32(const unsigned short *inSrc, unsigned int *outDst, unsigned int inNum,
+								const unsigned int *inTable)
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = Lookup16To32_AVX2(inSrc, outDst, inNum, inTable);
+				break;
+#endif
+		}
+
+		Lookup16To32_C(&(inSrc[num]), &(outDst[num]), inNum - num, inTable);
+	}
+
+	static void	Lookup16To32_C(const unsigned short *inSrc, unsigned int *outDst, unsigned int inNum,
+								const unsigned int *inTable)
+	{
+		for (unsigned int i = 0; i < inNum; i++)
+			outDst[i] = inTable[inSrc[i]];
+	}
+
+	// -------------------------------------------------------------------------
+	//	MinMax16(...)
+	// -------------------------------------------------------------------------
+	//!	Updates *ioMin and *ioMax with the values of inSrc
+	static void	MinMax16(const unsigned short *inSrc, unsigned int inNum,
+								unsigned short *ioMin, unsigned short *ioMax)
+	{
+		unsigned int	num = 0;
+
+		switch (GetSIMDType())
+		{
+#ifdef IMAGE_KERNEL_X86
+			case SIMD_TYPE_AVX2:
+				num = MinMax16_AVX2(inSrc, inNum, ioMin, ioMax);
+				break;
+			case SIMD_TYPE_SSE2:
+				num = MinMax16_SSE2(inSrc, inNum, ioMin, ioMax);
+				break;
+#endif
+#ifdef IMAGE_KERNEL_NEON
+			case SIMD_TYPE_NEON:
+				num = MinMax16_NEON(inSrc, inNum, ioMin, ioMax);
+				break;
+#endif
+		}
+
+		MinMax16_C(&(inSrc[num]), inNum - num, ioMin, ioMax);
+	}
+
+	static void	MinMax16_C(const unsigned short *inSrc, unsigned int inNum,
+								unsigned short *ioMin, unsigned short *ioMax)
+	{
+		unsigned short	minValue = *ioMin;
+		unsigned short	maxValue = *ioMax;
+
+		for (unsigned int i = 0; i < inNum; i++)
+		{
+			if (inSrc[i] < minValue)
+				minValue = inSrc[i];
+			if (inSrc[i] > maxValue)
+				maxValue = inSrc[i];
+		}
+		*ioMin = minValue;
+		*ioMax = maxValue;
+	}
+
+	// -------------------------------------------------------------------------
+	//	GetRingLine(...)
+	// -------------------------------------------------------------------------
+	//!	The buffer line shown at line inY (from the top) of a ring of lines
+	/*!
+		The waterfall keeps inLineNum lines as a ring, inTopLine is the ring
+		line shown at the top. inIsBottomUp flips the line order of the
+		buffer on top of that.
+	*/
+	static int	GetRingLine(int inY, int inTopLine, int inLineNum, bool inIsBottomUp)
+	{
+		int	line = (inY + inTopLine) % inLineNum;
+
+		return inIsBottomUp ? inLineNum - line - 1 : line;
+	}
+
+	//!	Copies a ring of lines into outDst in the order they are shown
+	static void	CopyRingLines(const unsigned char *inSrc, bool inIsSrcBottomUp,
+								unsigned char *outDst, bool inIsDstBottomUp,
+								unsigned int inLineSize, int inLineNum, int inTopLine)
+	{
+		for (int y = 0; y < inLineNum; y++)
+		{
+			int	srcLine = GetRingLine(y, inTopLine, inLineNum, inIsSrcBottomUp);
+			int	dstLine = inIsDstBottomUp ? inLineNum - y - 1 : y;
+
+			memcpy(&(outDst[inLineSize * dstLine]), &(inSrc[inLineSize * srcLine]), inLineSize);
+		}
+	}
+
+	// -------------------------------------------------------------------------
+	//	RenderLines(...)
+	// -------------------------------------------------------------------------
+	//!	Renders lines inStartLine to inEndLine - 1 of inParam->Buffer
+	/*!
+		Software version of StretchDIBits() with COLORONCOLOR (nearest
+		neighbor): view pixel (x, y) shows image pixel
+		(OffsetX + floor(x / Scale), OffsetY + floor(y / Scale)), pixels
+		outside of the image are BkColor. The buffer is 24-bit BGR, top-down.
+		8-bit images go through Palette, 24 and 32-bit ones are BGR(A) or
+		RGBA (RedIndex). inParam->XTable is made by MakeRenderXTable().
+	*/
+	static void	RenderLines(const ImageRenderParam *inParam, int inStartLine, int inEndLine)
+	{
+		for (int y = inStartLine; y < inEndLine; y++)
+		{
+			unsigned char	*dstPtr = &(inParam->Buffer[inParam->BufferLineSize * y]);
+			int	srcY = inParam->OffsetY + (int )floor((y + inParam->OriginY) / inParam->Scale);
+
+			if (srcY < 0 || srcY >= inParam->Height)
+			{
+				for (int x = 0; x < inParam->BufferWidth; x++, dstPtr += 3)
+				{
+					dstPtr[0] = inParam->BkColor[0];
+					dstPtr[1] = inParam->BkColor[1];
+					dstPtr[2] = inParam->BkColor[2];
+				}
+				continue;
+			}
+
+			//	The waterfall is drawn as two parts of the ring, from the top line
+			//	down and from the first line on
+			srcY = GetRingLine(srcY, inParam->TopLine, inParam->Height, inParam->IsBottomUp);
+			const unsigned char	*srcLine = &(inParam->Bits[inParam->LineSize * srcY]);
+
+			int	pixelSize = inParam->BitCount / 8;
+			int	redIndex = inParam->RedIndex;
+
+			for (int x = 0; x < inParam->BufferWidth; x++, dstPtr += 3)
+			{
+				int	srcX = inParam->XTable[x];
+				const unsigned char	*color;
+
+				if (srcX < 0)
+					color = inParam->BkColor;
+				else if (inParam->BitCount == 8)
+					color = inParam->Palette[srcLine[srcX]];
+				else
+				{
+					color = &(srcLine[srcX * pixelSize]);
+					dstPtr[0] = color[2 - redIndex];
+					dstPtr[1] = color[1];
+					dstPtr[2] = color[redIndex];
+					continue;
+				}
+
+				dstPtr[0] = color[0];
+				dstPtr[1] = color[1];
+				dstPtr[2] = color[2];
+			}
+		}
+	}
+
+	//!	The image column of each buffer pixel, -1 outside of the image
+	static void	MakeRenderXTable(const ImageRenderParam *inParam, int *outXTable)
+	{
+		for (int x = 0; x < inParam->BufferWidth; x++)
+		{
+			int	srcX = inParam->OffsetX + (int )floor((x + inParam->OriginX) / inParam->Scale);
+			outXTable[x] = (srcX < 0 || srcX >= inParam->Width) ? -1 : srcX;
+		}
+	}
+
+	static void	CalcWindowLevelParams(unsigned short inBottomValue, unsigned short inTopValue,
+								unsigned short *outRange, unsigned short *outScale, int *outShift)
+	{
+		unsigned int	range = 1;
+		int				shift = 0;
+
+		if (inTopValue > inBottomValue)
+			range = inTopValue - inBottomValue;
+
+		//	Keep (range << shift) in [256, 65535] so that the scale fits 16 bits
+		while ((range << shift) < 256)
+			shift++;
+
+		*outRange = (unsigned short )range;
+		*outScale = (unsigned short )((256 * 65536 - 1) / (range << shift));
+		*outShift = shift;
+	}
+
+private:
+	typedef void	(*UnpackFunc_C)(const unsigned char *inSrc, unsigned int inStartPixel,
+								unsigned short *outDst, unsigned int inPixelNum);
+	typedef unsigned int	(*UnpackFunc_SIMD)(const unsigned char *inSrc,
+								unsigned short *outDst, unsigned int inPixelNum);
+
+	//	The scalar version does the pixels up to the first whole pixel group
+	//	(inGroupPixelNum pixels in inGroupSize bytes) and the remainder
+	static void	UnpackMono(const unsigned char *inSrc, unsigned int inStartPixel,
+							unsigned short *outDst, unsigned int inPixelNum,
+							unsigned int inGroupPixelNum, unsigned int inGroupSize,
+							UnpackFunc_C inFunc_C, UnpackFunc_SIMD inFunc_SIMD)
+	{
+		unsigned int	num = (inGroupPixelNum - inStartPixel % inGroupPixelNum) % inGroupPixelNum;
+
+		if (num > inPixelNum)
+			num = inPixelNum;
+		inFunc_C(inSrc, inStartPixel, outDst, num);
+
+		if (inFunc_SIMD != NULL)
+		{
+			unsigned int	groupIndex = (inStartPixel + num) / inGroupPixelNum;
+			num += inFunc_SIMD(&(inSrc[groupIndex * inGroupSize]), &(outDst[num]), inPixelNum - num);
+		}
+
+		inFunc_C(inSrc, inStartPixel + num, &(outDst[num]), inPixelNum - num);
+	}
+
+	//	outValues are the own color, G and the other color of the center pixel
+	//	of inP, clamped to [0, inMaxValue]
+	static void	DemosaicHighQualityPixel(const int inP[5][5], bool inIsColorPixel, int inMaxValue, int outValues[3])
+	{
+		int	c = inP[2][2];
+		int	cross = inP[1][2] + inP[3][2] + inP[2][1] + inP[2][3];
+		int	diag = inP[1][1] + inP[1][3] + inP[3][1] + inP[3][3];
+		int	farH = inP[2][0] + inP[2][4];
+		int	farV = inP[0][2] + inP[4][2];
+
+		if (inIsColorPixel)
+		{
+			outValues[0] = c;
+			outValues[1] = (8 * c + 4 * cross - 2 * (farH + farV) + 8) >> 4;
+			outValues[2] = (12 * c + 4 * diag - 3 * (farH + farV) + 8) >> 4;
+		}
+		else
+		{
+			int	h = inP[2][1] + inP[2][3];
+			int	v = inP[1][2] + inP[3][2];
+			outValues[0] = (10 * c + 8 * h - 2 * diag - 2 * farH + farV + 8) >> 4;
+			outValues[1] = c;
+			outValues[2] = (10 * c + 8 * v - 2 * diag - 2 * farV + farH + 8) >> 4;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (outValues[i] < 0)
+				outValues[i] = 0;
+			if (outValues[i] > inMaxValue)
+				outValues[i] = inMaxValue;
+		}
+	}
+
+	static int	&GetSIMDTypeRef()
+	{
+		static int	sSIMDType = DetectSIMDType();
+		return sSIMDType;
+	}
+
+	static int	DetectSIMDType()
+	{
+#ifdef IMAGE_KERNEL_X86
+		unsigned int	regs[4] = {0, 0, 0, 0};
+		unsigned int	maxLeaf;
+
+		CPUID(0, regs);
+		maxLeaf = regs[0];
+		CPUID(1, regs);
+		if ((regs[3] & (1 << 26)) == 0)		// SSE2
+			return SIMD_TYPE_NONE;
+
+		bool	isOSXSAVE = (regs[2] & (1 << 27)) != 0;
+		bool	isAVX = (regs[2] & (1 << 28)) != 0;
+		if (maxLeaf >= 7 && isOSXSAVE && isAVX && (XGETBV0() & 0x06) == 0x06)
+		{
+			CPUID(7, regs);
+			if ((regs[1] & (1 << 5)) != 0)		// AVX2
+				return SIMD_TYPE_AVX2;
+		}
+		return SIMD_TYPE_SSE2;
+#elif defined(IMAGE_KERNEL_NEON)
+		return SIMD_TYPE_NEON;
+#else
+		return SIMD_TYPE_NONE;
+#endif
+	}
+
+#ifdef IMAGE_KERNEL_X86
+	static void	CPUID(unsigned int inLeaf, unsigned int outRegs[4])
+	{
+#ifdef _MSC_VER
+		__cpuidex((int *)outRegs, (int )inLeaf, 0);
+#else
+		__cpuid_count(inLeaf, 0, outRegs[0], outRegs[1], outRegs[2], outRegs[3]);
+#endif
+	}
+
+	static uint64_t	XGETBV0()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int	eax, edx;
+		__asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t )edx << 32) | eax;
+#endif
+	}
+
+	static unsigned int	Shift16To8_SSE2(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = inNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	v0 = _mm_loadu_si128((const __m128i *)&(inSrc[i]));
+			__m128i	v1 = _mm_loadu_si128((const __m128i *)&(inSrc[i + 8]));
+			v0 = _mm_srli_epi16(v0, 8);
+			v1 = _mm_srli_epi16(v1, 8);
+			_mm_storeu_si128((__m128i *)&(outDst[i]), _mm_packus_epi16(v0, v1));
+		}
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	Shift16To8_AVX2(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = inNum & ~31;
+
+		for (unsigned int i = 0; i < num; i += 32)
+		{
+			__m256i	v0 = _mm256_loadu_si256((const __m256i *)&(inSrc[i]));
+			__m256i	v1 = _mm256_loadu_si256((const __m256i *)&(inSrc[i + 16]));
+			v0 = _mm256_srli_epi16(v0, 8);
+			v1 = _mm256_srli_epi16(v1, 8);
+			//	packus works per 128-bit lane, so fix the qword order afterwards
+			__m256i	d = _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), 0xD8);
+			_mm256_storeu_si256((__m256i *)&(outDst[i]), d);
+		}
+		return num;
+	}
+
+	static unsigned int	WindowLevel16To8_SSE2(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum,
+								unsigned short inBottomValue, unsigned short inRange,
+								unsigned short inScale, int inShift)
+	{
+		unsigned int	num = inNum & ~15;
+		__m128i	bottom = _mm_set1_epi16((short )inBottomValue);
+		__m128i	range = _mm_set1_epi16((short )inRange);
+		__m128i	scale = _mm_set1_epi16((short )inScale);
+		__m128i	shift = _mm_cvtsi32_si128(inShift);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	v0 = _mm_loadu_si128((const __m128i *)&(inSrc[i]));
+			__m128i	v1 = _mm_loadu_si128((const __m128i *)&(inSrc[i + 8]));
+			v0 = _mm_subs_epu16(v0, bottom);
+			v1 = _mm_subs_epu16(v1, bottom);
+			//	min(v, range) without SSE4.1
+			v0 = _mm_sub_epi16(v0, _mm_subs_epu16(v0, range));
+			v1 = _mm_sub_epi16(v1, _mm_subs_epu16(v1, range));
+			v0 = _mm_mulhi_epu16(_mm_sll_epi16(v0, shift), scale);
+			v1 = _mm_mulhi_epu16(_mm_sll_epi16(v1, shift), scale);
+			_mm_storeu_si128((__m128i *)&(outDst[i]), _mm_packus_epi16(v0, v1));
+		}
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	WindowLevel16To8_AVX2(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum,
+								unsigned short inBottomValue, unsigned short inRange,
+								unsigned short inScale, int inShift)
+	{
+		unsigned int	num = inNum & ~31;
+		__m256i	bottom = _mm256_set1_epi16((short )inBottomValue);
+		__m256i	range = _mm256_set1_epi16((short )inRange);
+		__m256i	scale = _mm256_set1_epi16((short )inScale);
+		__m128i	shift = _mm_cvtsi32_si128(inShift);
+
+		for (unsigned int i = 0; i < num; i += 32)
+		{
+			__m256i	v0 = _mm256_loadu_si256((const __m256i *)&(inSrc[i]));
+			__m256i	v1 = _mm256_loadu_si256((const __m256i *)&(inSrc[i + 16]));
+			v0 = _mm256_min_epu16(_mm256_subs_epu16(v0, bottom), range);
+			v1 = _mm256_min_epu16(_mm256_subs_epu16(v1, bottom), range);
+			v0 = _mm256_mulhi_epu16(_mm256_sll_epi16(v0, shift), scale);
+			v1 = _mm256_mulhi_epu16(_mm256_sll_epi16(v1, shift), scale);
+			__m256i	d = _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), 0xD8);
+			_mm256_storeu_si256((__m256i *)&(outDst[i]), d);
+		}
+		return num;
+	}
+#endif
+
+#ifdef IMAGE_KERNEL_X86
+	//	8 pixels (3 vectors) at a time. The channel pattern repeats every 3
+	//	lanes, so each of the 3 vectors gets its own parameter vectors. The
+	//	per-lane shift is done as a multiply by (1 << shift).
+	static unsigned int	WindowLevel48To24_SSE2(const unsigned short *inSrc, unsigned char *outDst, unsigned int inPixelNum,
+								const unsigned short inBottomValues[3], const unsigned short inRanges[3],
+								const unsigned short inScales[3], const int inShifts[3])
+	{
+		unsigned int	num = inPixelNum & ~7;
+		unsigned short	params[4][24];
+		__m128i	bottom[3], range[3], scale[3], mult[3];
+
+		for (int i = 0; i < 24; i++)
+		{
+			params[0][i] = inBottomValues[i % 3];
+			params[1][i] = inRanges[i % 3];
+			params[2][i] = inScales[i % 3];
+			params[3][i] = (unsigned short )(1 << inShifts[i % 3]);
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			bottom[k]	= _mm_loadu_si128((const __m128i *)&(params[0][k * 8]));
+			range[k]	= _mm_loadu_si128((const __m128i *)&(params[1][k * 8]));
+			scale[k]	= _mm_loadu_si128((const __m128i *)&(params[2][k * 8]));
+			mult[k]		= _mm_loadu_si128((const __m128i *)&(params[3][k * 8]));
+		}
+
+		for (unsigned int i = 0; i < num; i += 8)
+		{
+			__m128i	v[3];
+
+			for (int k = 0; k < 3; k++)
+			{
+				v[k] = _mm_loadu_si128((const __m128i *)&(inSrc[i * 3 + k * 8]));
+				v[k] = _mm_subs_epu16(v[k], bottom[k]);
+				v[k] = _mm_sub_epi16(v[k], _mm_subs_epu16(v[k], range[k]));
+				v[k] = _mm_mulhi_epu16(_mm_mullo_epi16(v[k], mult[k]), scale[k]);
+			}
+			_mm_storeu_si128((__m128i *)&(outDst[i * 3]), _mm_packus_epi16(v[0], v[1]));
+			_mm_storel_epi64((__m128i *)&(outDst[i * 3 + 16]), _mm_packus_epi16(v[2], v[2]));
+		}
+		return num;
+	}
+
+	//	16 pixels at a time, one 8 pixel group per 128-bit lane. The bytes of
+	//	each pixel are gathered into a 16-bit word and the pixel is aligned to
+	//	the top of the word with a multiply, so a single shift finishes it.
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	UnpackMono10p_AVX2(const unsigned char *inSrc,
+								unsigned short *outDst, unsigned int inPixelNum)
+	{
+		unsigned int	byteNum = (inPixelNum * 10 + 7) / 8;
+		unsigned int	num = 0;
+		const __m256i	shuffle = _mm256_setr_epi8(
+							0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9,
+							0, 1, 1, 2, 2, 3, 3, 4, 5, 6, 6, 7, 7, 8, 8, 9);
+		const __m256i	mult = _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1,
+												64, 16, 4, 1, 64, 16, 4, 1);
+
+		//	The second lane reads 16 bytes from offset 10
+		while (num + 16 <= inPixelNum && num / 8 * 10 + 26 <= byteNum)
+		{
+			const unsigned char	*src = &(inSrc[num / 8 * 10]);
+			__m256i	v = _mm256_inserti128_si256(
+							_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+							_mm_loadu_si128((const __m128i *)&(src[10])), 1);
+			v = _mm256_shuffle_epi8(v, shuffle);
+			v = _mm256_srli_epi16(_mm256_mullo_epi16(v, mult), 6);
+			_mm256_storeu_si256((__m256i *)&(outDst[num]), v);
+			num += 16;
+		}
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	UnpackMono12p_AVX2(const unsigned char *inSrc,
+								unsigned short *outDst, unsigned int inPixelNum)
+	{
+		unsigned int	byteNum = (inPixelNum * 12 + 7) / 8;
+		unsigned int	num = 0;
+		const __m256i	shuffle = _mm256_setr_epi8(
+							0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,
+							0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+		const __m256i	mult = _mm256_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1,
+												16, 1, 16, 1, 16, 1, 16, 1);
+
+		while (num + 16 <= inPixelNum && num / 8 * 12 + 28 <= byteNum)
+		{
+			const unsigned char	*src = &(inSrc[num / 8 * 12]);
+			__m256i	v = _mm256_inserti128_si256(
+							_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+							_mm_loadu_si128((const __m128i *)&(src[12])), 1);
+			v = _mm256_shuffle_epi8(v, shuffle);
+			v = _mm256_srli_epi16(_mm256_mullo_epi16(v, mult), 4);
+			_mm256_storeu_si256((__m256i *)&(outDst[num]), v);
+			num += 16;
+		}
+		return num;
+	}
+
+	//	Even pixels are (b0 << 4) | (b1 & 0x0F), odd ones (b2 << 4) | (b1 >> 4)
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	UnpackMono12Packed_AVX2(const unsigned char *inSrc,
+								unsigned short *outDst, unsigned int inPixelNum)
+	{
+		unsigned int	byteNum = (inPixelNum * 3 + 1) / 2;
+		unsigned int	num = 0;
+		const __m256i	shuffle = _mm256_setr_epi8(
+							1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11,
+							1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11);
+		const __m256i	highMask = _mm256_set1_epi32(0x0FFF0FF0);
+		const __m256i	lowMask = _mm256_set1_epi32(0x0000000F);
+
+		while (num + 16 <= inPixelNum && num / 8 * 12 + 28 <= byteNum)
+		{
+			const unsigned char	*src = &(inSrc[num / 8 * 12]);
+			__m256i	v = _mm256_inserti128_si256(
+							_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+							_mm_loadu_si128((const __m128i *)&(src[12])), 1);
+			v = _mm256_shuffle_epi8(v, shuffle);
+			v = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(v, 4), highMask),
+								_mm256_and_si256(v, lowMask));
+			_mm256_storeu_si256((__m256i *)&(outDst[num]), v);
+			num += 16;
+		}
+		return num;
+	}
+
+	//	16 pixels at a time from x = 1 while the right neighbors are in the
+	//	line. The channels are computed as planes with the same averages as
+	//	the scalar version, picked per pixel with the phase mask and
+	//	interleaved with pshufb.
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	DemosaicBilinear8_AVX2(const unsigned char *inUp,
+								const unsigned char *inLine, const unsigned char *inDown, unsigned char *outDst,
+								unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		unsigned char	masks[3][3][16];
+		__m128i	shuffle[3][3];
+		unsigned int	num = 0;
+
+		for (int j = 0; j < 3; j++)
+			for (int c = 0; c < 3; c++)
+				for (int k = 0; k < 16; k++)
+				{
+					int	pos = j * 16 + k;
+					masks[j][c][k] = (pos % 3 == c) ? (unsigned char )(pos / 3) : 0x80;
+				}
+		for (int j = 0; j < 3; j++)
+			for (int c = 0; c < 3; c++)
+				shuffle[j][c] = _mm_loadu_si128((const __m128i *)masks[j][c]);
+
+		//	Lane i is pixel 1 + num + i, so the even lanes are the red/blue
+		//	pixels when inColorPhase is 1
+		__m128i	siteMask = _mm_set1_epi16((inColorPhase == 1) ? 0x00FF : (short )0xFF00);
+
+		while (1 + num + 16 < inWidth)
+		{
+			unsigned int	x = 1 + num;
+			__m128i	c = _mm_loadu_si128((const __m128i *)&(inLine[x]));
+			__m128i	h = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)&(inLine[x - 1])),
+									_mm_loadu_si128((const __m128i *)&(inLine[x + 1])));
+			__m128i	v = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)&(inUp[x])),
+									_mm_loadu_si128((const __m128i *)&(inDown[x])));
+			__m128i	d = _mm_avg_epu8(
+							_mm_avg_epu8(_mm_loadu_si128((const __m128i *)&(inUp[x - 1])),
+										_mm_loadu_si128((const __m128i *)&(inUp[x + 1]))),
+							_mm_avg_epu8(_mm_loadu_si128((const __m128i *)&(inDown[x - 1])),
+										_mm_loadu_si128((const __m128i *)&(inDown[x + 1]))));
+			__m128i	ch[3];
+			__m128i	own = _mm_or_si128(_mm_and_si128(siteMask, c), _mm_andnot_si128(siteMask, h));
+			__m128i	other = _mm_or_si128(_mm_and_si128(siteMask, d), _mm_andnot_si128(siteMask, v));
+			ch[1] = _mm_or_si128(_mm_and_si128(siteMask, _mm_avg_epu8(h, v)), _mm_andnot_si128(siteMask, c));
+			ch[0] = inIsRedLine ? other : own;
+			ch[2] = inIsRedLine ? own : other;
+
+			for (int j = 0; j < 3; j++)
+			{
+				__m128i	out = _mm_or_si128(_mm_or_si128(
+									_mm_shuffle_epi8(ch[0], shuffle[j][0]),
+									_mm_shuffle_epi8(ch[1], shuffle[j][1])),
+									_mm_shuffle_epi8(ch[2], shuffle[j][2]));
+				_mm_storeu_si128((__m128i *)&(outDst[x * 3 + j * 16]), out);
+			}
+			num += 16;
+		}
+		return num;
+	}
+
+	//	8 pixels at a time, see DemosaicBilinear8_AVX2()
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	DemosaicBilinear16_AVX2(const unsigned short *inUp,
+								const unsigned short *inLine, const unsigned short *inDown, unsigned short *outDst,
+								unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		unsigned char	masks[3][3][16];
+		__m128i	shuffle[3][3];
+		unsigned int	num = 0;
+
+		for (int j = 0; j < 3; j++)
+			for (int c = 0; c < 3; c++)
+				for (int k = 0; k < 16; k++)
+				{
+					int	pos = j * 8 + k / 2;
+					masks[j][c][k] = (pos % 3 == c) ? (unsigned char )(pos / 3 * 2 + (k & 1)) : 0x80;
+				}
+		for (int j = 0; j < 3; j++)
+			for (int c = 0; c < 3; c++)
+				shuffle[j][c] = _mm_loadu_si128((const __m128i *)masks[j][c]);
+
+		__m128i	siteMask = _mm_set1_epi32((inColorPhase == 1) ? 0x0000FFFF : (int )0xFFFF0000);
+
+		while (1 + num + 8 < inWidth)
+		{
+			unsigned int	x = 1 + num;
+			__m128i	c = _mm_loadu_si128((const __m128i *)&(inLine[x]));
+			__m128i	h = _mm_avg_epu16(_mm_loadu_si128((const __m128i *)&(inLine[x - 1])),
+									_mm_loadu_si128((const __m128i *)&(inLine[x + 1])));
+			__m128i	v = _mm_avg_epu16(_mm_loadu_si128((const __m128i *)&(inUp[x])),
+									_mm_loadu_si128((const __m128i *)&(inDown[x])));
+			__m128i	d = _mm_avg_epu16(
+							_mm_avg_epu16(_mm_loadu_si128((const __m128i *)&(inUp[x - 1])),
+										_mm_loadu_si128((const __m128i *)&(inUp[x + 1]))),
+							_mm_avg_epu16(_mm_loadu_si128((const __m128i *)&(inDown[x - 1])),
+										_mm_loadu_si128((const __m128i *)&(inDown[x + 1]))));
+			__m128i	ch[3];
+			__m128i	own = _mm_or_si128(_mm_and_si128(siteMask, c), _mm_andnot_si128(siteMask, h));
+			__m128i	other = _mm_or_si128(_mm_and_si128(siteMask, d), _mm_andnot_si128(siteMask, v));
+			ch[1] = _mm_or_si128(_mm_and_si128(siteMask, _mm_avg_epu16(h, v)), _mm_andnot_si128(siteMask, c));
+			ch[0] = inIsRedLine ? other : own;
+			ch[2] = inIsRedLine ? own : other;
+
+			for (int j = 0; j < 3; j++)
+			{
+				__m128i	out = _mm_or_si128(_mm_or_si128(
+									_mm_shuffle_epi8(ch[0], shuffle[j][0]),
+									_mm_shuffle_epi8(ch[1], shuffle[j][1])),
+									_mm_shuffle_epi8(ch[2], shuffle[j][2]));
+				_mm_storeu_si128((__m128i *)&(outDst[x * 3 + j * 8]), out);
+			}
+			num += 8;
+		}
+		return num;
+	}
+
+	//	16 pixels from 16 Y bytes and 8 U, 8 V values (16-bit lanes, minus 128),
+	//	see YUYVToBGR24() for the arithmetic. The saturating adds only
+	//	saturate when the result is clamped to 255 anyway.
+	static IMAGE_KERNEL_TARGET_AVX2 void	YUVToBGR24Block_AVX2(__m128i inY, __m128i inU, __m128i inV,
+								const short inCoefs[4], unsigned char *outDst)
+	{
+		static const unsigned char	sShuffle[3][3][16] = {
+			{{0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80, 0x80, 5},
+			 {0x80, 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80, 0x80},
+			 {0x80, 0x80, 0, 0x80, 0x80, 1, 0x80, 0x80, 2, 0x80, 0x80, 3, 0x80, 0x80, 4, 0x80}},
+			{{0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80, 10, 0x80},
+			 {5, 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80, 10},
+			 {0x80, 5, 0x80, 0x80, 6, 0x80, 0x80, 7, 0x80, 0x80, 8, 0x80, 0x80, 9, 0x80, 0x80}},
+			{{0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15, 0x80, 0x80},
+			 {0x80, 0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15, 0x80},
+			 {10, 0x80, 0x80, 11, 0x80, 0x80, 12, 0x80, 0x80, 13, 0x80, 0x80, 14, 0x80, 0x80, 15}}};
+		const __m128i	zero = _mm_setzero_si128();
+		const __m128i	round = _mm_set1_epi16(32);
+		__m128i	ch[3];
+		__m128i	half[2][3];
+
+		for (int k = 0; k < 2; k++)
+		{
+			__m128i	y = (k == 0) ? _mm_unpacklo_epi8(inY, zero) : _mm_unpackhi_epi8(inY, zero);
+			__m128i	u = (k == 0) ? _mm_unpacklo_epi16(inU, inU) : _mm_unpackhi_epi16(inU, inU);
+			__m128i	v = (k == 0) ? _mm_unpacklo_epi16(inV, inV) : _mm_unpackhi_epi16(inV, inV);
+
+			y = _mm_subs_epu16(y, _mm_set1_epi16(16));
+			y = _mm_mulhi_epu16(_mm_slli_epi16(y, 8), _mm_set1_epi16((short )19071));
+			half[k][0] = _mm_adds_epi16(y, _mm_mullo_epi16(u, _mm_set1_epi16(inCoefs[0])));
+			half[k][1] = _mm_sub_epi16(_mm_sub_epi16(y, _mm_mullo_epi16(u, _mm_set1_epi16(inCoefs[1]))),
+										_mm_mullo_epi16(v, _mm_set1_epi16(inCoefs[2])));
+			half[k][2] = _mm_adds_epi16(y, _mm_mullo_epi16(v, _mm_set1_epi16(inCoefs[3])));
+			for (int c = 0; c < 3; c++)
+				half[k][c] = _mm_srai_epi16(_mm_adds_epi16(half[k][c], round), 6);
+		}
+		for (int c = 0; c < 3; c++)
+			ch[c] = _mm_packus_epi16(half[0][c], half[1][c]);
+
+		for (int j = 0; j < 3; j++)
+		{
+			__m128i	out = _mm_or_si128(_mm_or_si128(
+								_mm_shuffle_epi8(ch[0], _mm_loadu_si128((const __m128i *)sShuffle[j][0])),
+								_mm_shuffle_epi8(ch[1], _mm_loadu_si128((const __m128i *)sShuffle[j][1]))),
+								_mm_shuffle_epi8(ch[2], _mm_loadu_si128((const __m128i *)sShuffle[j][2])));
+			_mm_storeu_si128((__m128i *)&(outDst[j * 16]), out);
+		}
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	YUYVToBGR24_AVX2(const unsigned char *inSrc,
+								unsigned char *outDst, unsigned int inPixelNum, const short inCoefs[4])
+	{
+		unsigned int	num = inPixelNum & ~15;
+		const __m128i	lowMask = _mm_set1_epi16(0x00FF);
+		const __m128i	offset = _mm_set1_epi16(128);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	a = _mm_loadu_si128((const __m128i *)&(inSrc[i * 2]));
+			__m128i	b = _mm_loadu_si128((const __m128i *)&(inSrc[i * 2 + 16]));
+			__m128i	y = _mm_packus_epi16(_mm_and_si128(a, lowMask), _mm_and_si128(b, lowMask));
+			__m128i	uv = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+			__m128i	u = _mm_sub_epi16(_mm_and_si128(uv, lowMask), offset);
+			__m128i	v = _mm_sub_epi16(_mm_srli_epi16(uv, 8), offset);
+			YUVToBGR24Block_AVX2(y, u, v, inCoefs, &(outDst[i * 3]));
+		}
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	NV12ToBGR24_AVX2(const unsigned char *inY,
+								const unsigned char *inUV, unsigned char *outDst, unsigned int inPixelNum,
+								const short inCoefs[4])
+	{
+		unsigned int	num = inPixelNum & ~15;
+		const __m128i	lowMask = _mm_set1_epi16(0x00FF);
+		const __m128i	offset = _mm_set1_epi16(128);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	y = _mm_loadu_si128((const __m128i *)&(inY[i]));
+			__m128i	uv = _mm_loadu_si128((const __m128i *)&(inUV[i]));
+			__m128i	u = _mm_sub_epi16(_mm_and_si128(uv, lowMask), offset);
+			__m128i	v = _mm_sub_epi16(_mm_srli_epi16(uv, 8), offset);
+			YUVToBGR24Block_AVX2(y, u, v, inCoefs, &(outDst[i * 3]));
+		}
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	I420ToBGR24_AVX2(const unsigned char *inY,
+								const unsigned char *inU, const unsigned char *inV, unsigned char *outDst,
+								unsigned int inPixelNum, const short inCoefs[4])
+	{
+		unsigned int	num = inPixelNum & ~15;
+		const __m128i	zero = _mm_setzero_si128();
+		const __m128i	offset = _mm_set1_epi16(128);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	y = _mm_loadu_si128((const __m128i *)&(inY[i]));
+			__m128i	u = _mm_loadl_epi64((const __m128i *)&(inU[i / 2]));
+			__m128i	v = _mm_loadl_epi64((const __m128i *)&(inV[i / 2]));
+			u = _mm_sub_epi16(_mm_unpacklo_epi8(u, zero), offset);
+			v = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), offset);
+			YUVToBGR24Block_AVX2(y, u, v, inCoefs, &(outDst[i * 3]));
+		}
+		return num;
+	}
+
+	//	Non-finite lanes are replaced by +Inf / -Inf before the min / max
+	static unsigned int	CopyFloatMinMax_SSE2(const float *inSrc, float *outDst, unsigned int inNum,
+								float *ioMin, float *ioMax)
+	{
+		unsigned int	num = inNum & ~3;
+		const __m128	zero = _mm_setzero_ps();
+		const __m128	plusInf = _mm_set1_ps(HUGE_VALF);
+		const __m128	minusInf = _mm_set1_ps(-HUGE_VALF);
+		__m128	minValue = _mm_set1_ps(*ioMin);
+		__m128	maxValue = _mm_set1_ps(*ioMax);
+		float	buf[4];
+
+		for (unsigned int i = 0; i < num; i += 4)
+		{
+			__m128	v = _mm_loadu_ps(&(inSrc[i]));
+			__m128	isFinite = _mm_cmpeq_ps(_mm_sub_ps(v, v), zero);
+
+			_mm_storeu_ps(&(outDst[i]), v);
+			minValue = _mm_min_ps(minValue, _mm_or_ps(_mm_and_ps(isFinite, v), _mm_andnot_ps(isFinite, plusInf)));
+			maxValue = _mm_max_ps(maxValue, _mm_or_ps(_mm_and_ps(isFinite, v), _mm_andnot_ps(isFinite, minusInf)));
+		}
+
+		_mm_storeu_ps(buf, minValue);
+		for (int i = 0; i < 4; i++)
+			if (buf[i] < *ioMin)
+				*ioMin = buf[i];
+		_mm_storeu_ps(buf, maxValue);
+		for (int i = 0; i < 4; i++)
+			if (buf[i] > *ioMax)
+				*ioMax = buf[i];
+		return num;
+	}
+
+	//	_mm_max_ps(x, 0) returns 0 for NaN
+	static unsigned int	WindowLevelFloatTo8_SSE2(const float *inSrc, unsigned char *outDst, unsigned int inNum,
+								float inBottomValue, float inScale)
+	{
+		unsigned int	num = inNum & ~15;
+		const __m128	bottom = _mm_set1_ps(inBottomValue);
+		const __m128	scale = _mm_set1_ps(inScale);
+		const __m128	zero = _mm_setzero_ps();
+		const __m128	top = _mm_set1_ps(255.0f);
+		const __m128	half = _mm_set1_ps(0.5f);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	v[4];
+
+			for (int k = 0; k < 4; k++)
+			{
+				__m128	x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&(inSrc[i + k * 4])), bottom), scale);
+				x = _mm_min_ps(_mm_max_ps(x, zero), top);
+				v[k] = _mm_cvttps_epi32(_mm_add_ps(x, half));
+			}
+			_mm_storeu_si128((__m128i *)&(outDst[i]),
+							_mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
+		}
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	Lookup16To32_AVX2(const unsigned short *inSrc, unsigned int *outDst, unsigned int inNum,
+								const unsigned int *inTable)
+	{
+		unsigned int	num = inNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m256i	v = _mm256_loadu_si256((const __m256i *)&(inSrc[i]));
+			__m256i	index0 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v));
+			__m256i	index1 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1));
+			_mm256_storeu_si256((__m256i *)&(outDst[i]), _mm256_i32gather_epi32((const int *)inTable, index0, 4));
+			_mm256_storeu_si256((__m256i *)&(outDst[i + 8]), _mm256_i32gather_epi32((const int *)inTable, index1, 4));
+		}
+		return num;
+	}
+
+	//	SSE2 has only the signed 16-bit min / max, the sign bit is flipped around them
+	static unsigned int	MinMax16_SSE2(const unsigned short *inSrc, unsigned int inNum,
+								unsigned short *ioMin, unsigned short *ioMax)
+	{
+		unsigned int	num = inNum & ~7;
+		const __m128i	sign = _mm_set1_epi16((short )0x8000);
+		__m128i	minValue = _mm_set1_epi16((short )(*ioMin ^ 0x8000));
+		__m128i	maxValue = _mm_set1_epi16((short )(*ioMax ^ 0x8000));
+		unsigned short	buf[8];
+
+		for (unsigned int i = 0; i < num; i += 8)
+		{
+			__m128i	v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&(inSrc[i])), sign);
+			minValue = _mm_min_epi16(minValue, v);
+			maxValue = _mm_max_epi16(maxValue, v);
+		}
+
+		_mm_storeu_si128((__m128i *)buf, _mm_xor_si128(minValue, sign));
+		for (int i = 0; i < 8; i++)
+			if (buf[i] < *ioMin)
+				*ioMin = buf[i];
+		_mm_storeu_si128((__m128i *)buf, _mm_xor_si128(maxValue, sign));
+		for (int i = 0; i < 8; i++)
+			if (buf[i] > *ioMax)
+				*ioMax = buf[i];
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	MinMax16_AVX2(const unsigned short *inSrc, unsigned int inNum,
+								unsigned short *ioMin, unsigned short *ioMax)
+	{
+		unsigned int	num = inNum & ~15;
+		__m256i	minValue = _mm256_set1_epi16((short )*ioMin);
+		__m256i	maxValue = _mm256_set1_epi16((short )*ioMax);
+		unsigned short	buf[16];
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m256i	v = _mm256_loadu_si256((const __m256i *)&(inSrc[i]));
+			minValue = _mm256_min_epu16(minValue, v);
+			maxValue = _mm256_max_epu16(maxValue, v);
+		}
+
+		_mm256_storeu_si256((__m256i *)buf, minValue);
+		for (int i = 0; i < 16; i++)
+			if (buf[i] < *ioMin)
+				*ioMin = buf[i];
+		_mm256_storeu_si256((__m256i *)buf, maxValue);
+		for (int i = 0; i < 16; i++)
+			if (buf[i] > *ioMax)
+				*ioMax = buf[i];
+		return num;
+	}
+
+	static unsigned int	Average8_SSE2(const unsigned char *inSrc0, const unsigned char *inSrc1,
+							unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = inNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	v0 = _mm_loadu_si128((const __m128i *)&(inSrc0[i]));
+			__m128i	v1 = _mm_loadu_si128((const __m128i *)&(inSrc1[i]));
+			_mm_storeu_si128((__m128i *)&(outDst[i]), _mm_avg_epu8(v0, v1));
+		}
+		return num;
+	}
+
+	static IMAGE_KERNEL_TARGET_AVX2 unsigned int	Average8_AVX2(const unsigned char *inSrc0, const unsigned char *inSrc1,
+							unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = inNum & ~31;
+
+		for (unsigned int i = 0; i < num; i += 32)
+		{
+			__m256i	v0 = _mm256_loadu_si256((const __m256i *)&(inSrc0[i]));
+			__m256i	v1 = _mm256_loadu_si256((const __m256i *)&(inSrc1[i]));
+			_mm256_storeu_si256((__m256i *)&(outDst[i]), _mm256_avg_epu8(v0, v1));
+		}
+		return num;
+	}
+
+	static unsigned int	HalveWidth8_SSE2(const unsigned char *inSrc, unsigned char *outDst, unsigned int inDstWidth)
+	{
+		unsigned int	num = inDstWidth & ~15;
+		__m128i	mask = _mm_set1_epi16(0x00FF);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			__m128i	v0 = _mm_loadu_si128((const __m128i *)&(inSrc[i * 2]));
+			__m128i	v1 = _mm_loadu_si128((const __m128i *)&(inSrc[i * 2 + 16]));
+			v0 = _mm_avg_epu16(_mm_and_si128(v0, mask), _mm_srli_epi16(v0, 8));
+			v1 = _mm_avg_epu16(_mm_and_si128(v1, mask), _mm_srli_epi16(v1, 8));
+			_mm_storeu_si128((__m128i *)&(outDst[i]), _mm_packus_epi16(v0, v1));
+		}
+		return num;
+	}
+#endif
+
+#ifdef IMAGE_KERNEL_NEON
+	static unsigned int	Average8_NEON(const unsigned char *inSrc0, const unsigned char *inSrc1,
+							unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = inNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+			vst1q_u8(&(outDst[i]), vrhaddq_u8(vld1q_u8(&(inSrc0[i])), vld1q_u8(&(inSrc1[i]))));
+		return num;
+	}
+
+	static unsigned int	HalveWidth8_NEON(const unsigned char *inSrc, unsigned char *outDst, unsigned int inDstWidth)
+	{
+		unsigned int	num = inDstWidth & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			uint8x16x2_t	v = vld2q_u8(&(inSrc[i * 2]));
+			vst1q_u8(&(outDst[i]), vrhaddq_u8(v.val[0], v.val[1]));
+		}
+		return num;
+	}
+
+	static unsigned int	WindowLevel48To24_NEON(const unsigned short *inSrc, unsigned char *outDst, unsigned int inPixelNum,
+								const unsigned short inBottomValues[3], const unsigned short inRanges[3],
+								const unsigned short inScales[3], const int inShifts[3])
+	{
+		unsigned int	num = inPixelNum & ~7;
+
+		for (unsigned int i = 0; i < num; i += 8)
+		{
+			uint16x8x3_t	v = vld3q_u16(&(inSrc[i * 3]));
+			uint8x8x3_t		d;
+
+			for (int c = 0; c < 3; c++)
+			{
+				uint16x8_t	x = vminq_u16(vqsubq_u16(v.val[c], vdupq_n_u16(inBottomValues[c])),
+										vdupq_n_u16(inRanges[c]));
+				x = vshlq_u16(x, vdupq_n_s16((short )inShifts[c]));
+				uint32x4_t	lo = vmull_u16(vget_low_u16(x), vdup_n_u16(inScales[c]));
+				uint32x4_t	hi = vmull_u16(vget_high_u16(x), vdup_n_u16(inScales[c]));
+				d.val[c] = vmovn_u16(vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16)));
+			}
+			vst3_u8(&(outDst[i * 3]), d);
+		}
+		return num;
+	}
+
+	static unsigned int	UnpackMono12p_NEON(const unsigned char *inSrc,
+								unsigned short *outDst, unsigned int inPixelNum)
+	{
+		unsigned int	num = inPixelNum & ~15;
+		uint16x8_t		lowMask = vdupq_n_u16(0x0F);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			uint8x8x3_t		b = vld3_u8(&(inSrc[i / 2 * 3]));
+			uint16x8_t		b1 = vmovl_u8(b.val[1]);
+			uint16x8x2_t	d;
+
+			d.val[0] = vorrq_u16(vmovl_u8(b.val[0]), vshlq_n_u16(vandq_u16(b1, lowMask), 8));
+			d.val[1] = vorrq_u16(vshrq_n_u16(b1, 4), vshlq_n_u16(vmovl_u8(b.val[2]), 4));
+			vst2q_u16(&(outDst[i]), d);
+		}
+		return num;
+	}
+
+	static unsigned int	UnpackMono12Packed_NEON(const unsigned char *inSrc,
+								unsigned short *outDst, unsigned int inPixelNum)
+	{
+		unsigned int	num = inPixelNum & ~15;
+		uint16x8_t		lowMask = vdupq_n_u16(0x0F);
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			uint8x8x3_t		b = vld3_u8(&(inSrc[i / 2 * 3]));
+			uint16x8_t		b1 = vmovl_u8(b.val[1]);
+			uint16x8x2_t	d;
+
+			d.val[0] = vorrq_u16(vshlq_n_u16(vmovl_u8(b.val[0]), 4), vandq_u16(b1, lowMask));
+			d.val[1] = vorrq_u16(vshlq_n_u16(vmovl_u8(b.val[2]), 4), vshrq_n_u16(b1, 4));
+			vst2q_u16(&(outDst[i]), d);
+		}
+		return num;
+	}
+
+	static unsigned int	DemosaicBilinear8_NEON(const unsigned char *inUp,
+								const unsigned char *inLine, const unsigned char *inDown, unsigned char *outDst,
+								unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		unsigned int	num = 0;
+		//	Lane i is pixel 1 + num + i
+		uint8x16_t	siteMask = vreinterpretq_u8_u16(vdupq_n_u16((inColorPhase == 1) ? 0x00FF : 0xFF00));
+
+		while (1 + num + 16 < inWidth)
+		{
+			unsigned int	x = 1 + num;
+			uint8x16_t	c = vld1q_u8(&(inLine[x]));
+			uint8x16_t	h = vrhaddq_u8(vld1q_u8(&(inLine[x - 1])), vld1q_u8(&(inLine[x + 1])));
+			uint8x16_t	v = vrhaddq_u8(vld1q_u8(&(inUp[x])), vld1q_u8(&(inDown[x])));
+			uint8x16_t	d = vrhaddq_u8(vrhaddq_u8(vld1q_u8(&(inUp[x - 1])), vld1q_u8(&(inUp[x + 1]))),
+									vrhaddq_u8(vld1q_u8(&(inDown[x - 1])), vld1q_u8(&(inDown[x + 1]))));
+			uint8x16_t	own = vbslq_u8(siteMask, c, h);
+			uint8x16_t	other = vbslq_u8(siteMask, d, v);
+			uint8x16x3_t	dst;
+
+			dst.val[1] = vbslq_u8(siteMask, vrhaddq_u8(h, v), c);
+			dst.val[0] = inIsRedLine ? other : own;
+			dst.val[2] = inIsRedLine ? own : other;
+			vst3q_u8(&(outDst[x * 3]), dst);
+			num += 16;
+		}
+		return num;
+	}
+
+	static unsigned int	DemosaicBilinear16_NEON(const unsigned short *inUp,
+								const unsigned short *inLine, const unsigned short *inDown, unsigned short *outDst,
+								unsigned int inWidth, unsigned int inColorPhase, bool inIsRedLine)
+	{
+		unsigned int	num = 0;
+		uint16x8_t	siteMask = vreinterpretq_u16_u32(vdupq_n_u32((inColorPhase == 1) ? 0x0000FFFF : 0xFFFF0000));
+
+		while (1 + num + 8 < inWidth)
+		{
+			unsigned int	x = 1 + num;
+			uint16x8_t	c = vld1q_u16(&(inLine[x]));
+			uint16x8_t	h = vrhaddq_u16(vld1q_u16(&(inLine[x - 1])), vld1q_u16(&(inLine[x + 1])));
+			uint16x8_t	v = vrhaddq_u16(vld1q_u16(&(inUp[x])), vld1q_u16(&(inDown[x])));
+			uint16x8_t	d = vrhaddq_u16(vrhaddq_u16(vld1q_u16(&(inUp[x - 1])), vld1q_u16(&(inUp[x + 1]))),
+									vrhaddq_u16(vld1q_u16(&(inDown[x - 1])), vld1q_u16(&(inDown[x + 1]))));
+			uint16x8_t	own = vbslq_u16(siteMask, c, h);
+			uint16x8_t	other = vbslq_u16(siteMask, d, v);
+			uint16x8x3_t	dst;
+
+			dst.val[1] = vbslq_u16(siteMask, vrhaddq_u16(h, v), c);
+			dst.val[0] = inIsRedLine ? other : own;
+			dst.val[2] = inIsRedLine ? own : other;
+			vst3q_u16(&(outDst[x * 3]), dst);
+			num += 8;
+		}
+		return num;
+	}
+
+	//	16 pixels, see YUVToBGR24Block_AVX2()
+	static void	YUVToBGR24Block_NEON(uint8x16_t inY, int16x8_t inU, int16x8_t inV,
+								const short inCoefs[4], unsigned char *outDst)
+	{
+		int16x8_t	half[2][3];
+		uint8x16x3_t	dst;
+
+		for (int k = 0; k < 2; k++)
+		{
+			uint8x8_t	y8 = (k == 0) ? vget_low_u8(inY) : vget_high_u8(inY);
+			int16x8_t	u = vzipq_s16(inU, inU).val[k];
+			int16x8_t	v = vzipq_s16(inV, inV).val[k];
+			uint16x8_t	yw = vshlq_n_u16(vqsubq_u16(vmovl_u8(y8), vdupq_n_u16(16)), 8);
+			uint32x4_t	lo = vmull_u16(vget_low_u16(yw), vdup_n_u16(19071));
+			uint32x4_t	hi = vmull_u16(vget_high_u16(yw), vdup_n_u16(19071));
+			int16x8_t	y = vreinterpretq_s16_u16(vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16)));
+
+			half[k][0] = vqaddq_s16(y, vmulq_n_s16(u, inCoefs[0]));
+			half[k][1] = vsubq_s16(vsubq_s16(y, vmulq_n_s16(u, inCoefs[1])), vmulq_n_s16(v, inCoefs[2]));
+			half[k][2] = vqaddq_s16(y, vmulq_n_s16(v, inCoefs[3]));
+			for (int c = 0; c < 3; c++)
+				half[k][c] = vshrq_n_s16(vqaddq_s16(half[k][c], vdupq_n_s16(32)), 6);
+		}
+		for (int c = 0; c < 3; c++)
+			dst.val[c] = vcombine_u8(vqmovun_s16(half[0][c]), vqmovun_s16(half[1][c]));
+		vst3q_u8(outDst, dst);
+	}
+
+	static unsigned int	YUYVToBGR24_NEON(const unsigned char *inSrc,
+								unsigned char *outDst, unsigned int inPixelNum, const short inCoefs[4])
+	{
+		unsigned int	num = inPixelNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			uint8x16x2_t	yuyv = vld2q_u8(&(inSrc[i * 2]));	// Y, then U V U V ...
+			uint8x8x2_t		uv = vuzp_u8(vget_low_u8(yuyv.val[1]), vget_high_u8(yuyv.val[1]));
+			int16x8_t	u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uv.val[0])), vdupq_n_s16(128));
+			int16x8_t	v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uv.val[1])), vdupq_n_s16(128));
+			YUVToBGR24Block_NEON(yuyv.val[0], u, v, inCoefs, &(outDst[i * 3]));
+		}
+		return num;
+	}
+
+	static unsigned int	NV12ToBGR24_NEON(const unsigned char *inY,
+								const unsigned char *inUV, unsigned char *outDst, unsigned int inPixelNum,
+								const short inCoefs[4])
+	{
+		unsigned int	num = inPixelNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			uint8x8x2_t	uv = vld2_u8(&(inUV[i]));
+			int16x8_t	u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uv.val[0])), vdupq_n_s16(128));
+			int16x8_t	v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uv.val[1])), vdupq_n_s16(128));
+			YUVToBGR24Block_NEON(vld1q_u8(&(inY[i])), u, v, inCoefs, &(outDst[i * 3]));
+		}
+		return num;
+	}
+
+	static unsigned int	I420ToBGR24_NEON(const unsigned char *inY,
+								const unsigned char *inU, const unsigned char *inV, unsigned char *outDst,
+								unsigned int inPixelNum, const short inCoefs[4])
+	{
+		unsigned int	num = inPixelNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			int16x8_t	u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&(inU[i / 2])))), vdupq_n_s16(128));
+			int16x8_t	v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&(inV[i / 2])))), vdupq_n_s16(128));
+			YUVToBGR24Block_NEON(vld1q_u8(&(inY[i])), u, v, inCoefs, &(outDst[i * 3]));
+		}
+		return num;
+	}
+
+	static unsigned int	CopyFloatMinMax_NEON(const float *inSrc, float *outDst, unsigned int inNum,
+								float *ioMin, float *ioMax)
+	{
+		unsigned int	num = inNum & ~3;
+		const float32x4_t	zero = vdupq_n_f32(0.0f);
+		const float32x4_t	plusInf = vdupq_n_f32(HUGE_VALF);
+		const float32x4_t	minusInf = vdupq_n_f32(-HUGE_VALF);
+		float32x4_t	minValue = vdupq_n_f32(*ioMin);
+		float32x4_t	maxValue = vdupq_n_f32(*ioMax);
+		float	buf[4];
+
+		for (unsigned int i = 0; i < num; i += 4)
+		{
+			float32x4_t	v = vld1q_f32(&(inSrc[i]));
+			uint32x4_t	isFinite = vceqq_f32(vsubq_f32(v, v), zero);
+
+			vst1q_f32(&(outDst[i]), v);
+			minValue = vminq_f32(minValue, vbslq_f32(isFinite, v, plusInf));
+			maxValue = vmaxq_f32(maxValue, vbslq_f32(isFinite, v, minusInf));
+		}
+
+		vst1q_f32(buf, minValue);
+		for (int i = 0; i < 4; i++)
+			if (buf[i] < *ioMin)
+				*ioMin = buf[i];
+		vst1q_f32(buf, maxValue);
+		for (int i = 0; i < 4; i++)
+			if (buf[i] > *ioMax)
+				*ioMax = buf[i];
+		return num;
+	}
+
+	static unsigned int	MinMax16_NEON(const unsigned short *inSrc, unsigned int inNum,
+								unsigned short *ioMin, unsigned short *ioMax)
+	{
+		unsigned int	num = inNum & ~7;
+		uint16x8_t	minValue = vdupq_n_u16(*ioMin);
+		uint16x8_t	maxValue = vdupq_n_u16(*ioMax);
+		unsigned short	buf[8];
+
+		for (unsigned int i = 0; i < num; i += 8)
+		{
+			uint16x8_t	v = vld1q_u16(&(inSrc[i]));
+			minValue = vminq_u16(minValue, v);
+			maxValue = vmaxq_u16(maxValue, v);
+		}
+
+		vst1q_u16(buf, minValue);
+		for (int i = 0; i < 8; i++)
+			if (buf[i] < *ioMin)
+				*ioMin = buf[i];
+		vst1q_u16(buf, maxValue);
+		for (int i = 0; i < 8; i++)
+			if (buf[i] > *ioMax)
+				*ioMax = buf[i];
+		return num;
+	}
+
+	//	vmaxq_f32() keeps NaN, so the lanes that are not > 0 are zeroed with a mask
+	static unsigned int	WindowLevelFloatTo8_NEON(const float *inSrc, unsigned char *outDst, unsigned int inNum,
+								float inBottomValue, float inScale)
+	{
+		unsigned int	num = inNum & ~7;
+		const float32x4_t	bottom = vdupq_n_f32(inBottomValue);
+		const float32x4_t	zero = vdupq_n_f32(0.0f);
+		const float32x4_t	top = vdupq_n_f32(255.0f);
+		const float32x4_t	half = vdupq_n_f32(0.5f);
+
+		for (unsigned int i = 0; i < num; i += 8)
+		{
+			uint32x4_t	v[2];
+
+			for (int k = 0; k < 2; k++)
+			{
+				float32x4_t	x = vmulq_n_f32(vsubq_f32(vld1q_f32(&(inSrc[i + k * 4])), bottom), inScale);
+				x = vbslq_f32(vcgtq_f32(x, zero), x, zero);
+				x = vminq_f32(x, top);
+				v[k] = vcvtq_u32_f32(vaddq_f32(x, half));
+			}
+			vst1_u8(&(outDst[i]), vmovn_u16(vcombine_u16(vmovn_u32(v[0]), vmovn_u32(v[1]))));
+		}
+		return num;
+	}
+
+	static unsigned int	Shift16To8_NEON(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum)
+	{
+		unsigned int	num = inNum & ~15;
+
+		for (unsigned int i = 0; i < num; i += 16)
+		{
+			uint16x8_t	v0 = vld1q_u16(&(inSrc[i]));
+			uint16x8_t	v1 = vld1q_u16(&(inSrc[i + 8]));
+			vst1q_u8(&(outDst[i]), vcombine_u8(vshrn_n_u16(v0, 8), vshrn_n_u16(v1, 8)));
+		}
+		return num;
+	}
+
+	static unsigned int	WindowLevel16To8_NEON(const unsigned short *inSrc, unsigned char *outDst, unsigned int inNum,
+								unsigned short inBottomValue, unsigned short inRange,
+								unsigned short inScale, int inShift)
+	{
+		unsigned int	num = inNum & ~7;
+		uint16x8_t	bottom = vdupq_n_u16(inBottomValue);
+		uint16x8_t	range = vdupq_n_u16(inRange);
+		uint16x4_t	scale = vdup_n_u16(inScale);
+		int16x8_t	shift = vdupq_n_s16((short )inShift);
+
+		for (unsigned int i = 0; i < num; i += 8)
+		{
+			uint16x8_t	v = vld1q_u16(&(inSrc[i]));
+			v = vshlq_u16(vminq_u16(vqsubq_u16(v, bottom), range), shift);
+			uint32x4_t	lo = vmull_u16(vget_low_u16(v), scale);
+			uint32x4_t	hi = vmull_u16(vget_high_u16(v), scale);
+			uint16x8_t	d = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+			vst1_u8(&(outDst[i]), vmovn_u16(d));
+		}
+		return num;
+	}
+#endif
+};
+
+#endif	// #ifdef __IMAGE_WINDOW_KERNEL_H
@@ -0,0 +1,440 @@
+// =============================================================================
+//	KernelTest.cpp
+//
+//	Compares every SIMD kernel of ImageWindowKernel with its scalar (_C)
+//	version. Each dispatcher is run with SIMD_TYPE_NONE and with every SIMD
+//	type the CPU supports, over lengths 0 to 300 and unaligned start
+//	addresses, and the whole output buffers (including the bytes after the
+//	last element) must be identical.
+// =============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "ImageWindowKernel.hpp"
+
+// -----------------------------------------------------------------------------
+// 	macros
+// -----------------------------------------------------------------------------
+#define	TEST_MAX_NUM		300
+#define	TEST_OFFSET_NUM		4		// start addresses 0 to 3 elements off
+#define	TEST_DST_OFFSET_STEP	4		// bytes, keeps 16 and 32-bit outputs aligned to their size
+#define	TEST_BUF_SIZE		4096	// bytes, large enough for any kernel input
+#define	TEST_GUARD_VALUE	0xA5
+
+
+// -----------------------------------------------------------------------------
+// 	static variables
+// -----------------------------------------------------------------------------
+static unsigned int	sRandomSeed = 12345;
+static int			sErrorNum = 0;
+
+
+// -----------------------------------------------------------------------------
+// 	static functions
+// -----------------------------------------------------------------------------
+static unsigned int	Random()
+{
+	sRandomSeed = sRandomSeed * 1103515245 + 12345;
+	return (sRandomSeed >> 8) & 0xFFFFFF;
+}
+
+static void	FillRandom(void *outBuf, size_t inSize)
+{
+	unsigned char	*buf = (unsigned char *)outBuf;
+
+	for (size_t i = 0; i < inSize; i++)
+		buf[i] = (unsigned char )Random();
+}
+
+static const char	*GetSIMDTypeName(int inType)
+{
+	switch (inType)
+	{
+		case ImageWindowKernel::SIMD_TYPE_SSE2:
+			return "SSE2";
+		case ImageWindowKernel::SIMD_TYPE_AVX2:
+			return "AVX2";
+		case ImageWindowKernel::SIMD_TYPE_NEON:
+			return "NEON";
+	}
+	return "C";
+}
+
+static void	Check(bool inIsOK, const char *inKernelName, int inType, unsigned int inNum, unsigned int inOffset)
+{
+	if (inIsOK)
+		return;
+	if (sErrorNum < 20)
+		printf("Error: %s (%s) differs from the scalar version, num = %u, offset = %u\n",
+				inKernelName, GetSIMDTypeName(inType), inNum, inOffset);
+	sErrorNum++;
+}
+
+//	Runs the kernel with the scalar version and with inType into two guarded
+//	output buffers, the kernel functions fill outDst from the same input
+class KernelCase
+{
+public:
+	virtual ~KernelCase() {}
+	virtual const char	*GetName() = 0;
+	virtual void	Prepare(unsigned int inNum, unsigned int inOffset) = 0;
+	virtual void	Run(unsigned char *outDst) = 0;
+
+	void	Test(int inType)
+	{
+		std::vector<unsigned char>	refBuf(TEST_BUF_SIZE), buf(TEST_BUF_SIZE);
+
+		for (unsigned int num = 0; num <= TEST_MAX_NUM; num++)
+		{
+			for (unsigned int offset = 0; offset < TEST_OFFSET_NUM; offset++)
+			{
+				Prepare(num, offset);
+
+				memset(&(refBuf[0]), TEST_GUARD_VALUE, TEST_BUF_SIZE);
+				ImageWindowKernel::SetSIMDType(ImageWindowKernel::SIMD_TYPE_NONE);
+				Run(&(refBuf[offset * TEST_DST_OFFSET_STEP]));
+
+				memset(&(buf[0]), TEST_GUARD_VALUE, TEST_BUF_SIZE);
+				ImageWindowKernel::SetSIMDType(inType);
+				Run(&(buf[offset * TEST_DST_OFFSET_STEP]));
+
+				Check(memcmp(&(refBuf[0]), &(buf[0]), TEST_BUF_SIZE) == 0, GetName(), inType, num, offset);
+			}
+		}
+	}
+
+protected:
+	unsigned char	mSrc[TEST_BUF_SIZE * 3];
+	unsigned int	mNum;
+	unsigned int	mOffset;
+
+	void	PrepareSrc(unsigned int inNum, unsigned int inOffset)
+	{
+		mNum = inNum;
+		mOffset = inOffset;
+		FillRandom(mSrc, sizeof(mSrc));
+	}
+	//	An unaligned pointer into mSrc, inOffset elements of inElementSize off
+	const void	*GetSrc(unsigned int inPlane, size_t inElementSize)
+	{
+		return &(mSrc[TEST_BUF_SIZE * inPlane + mOffset * inElementSize]);
+	}
+};
+
+class Shift16To8Case : public KernelCase
+{
+public:
+	const char	*GetName() { return "Shift16To8"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		ImageWindowKernel::Shift16To8((const unsigned short *)GetSrc(0, 2), outDst, mNum);
+	}
+};
+
+class WindowLevel16To8Case : public KernelCase
+{
+public:
+	const char	*GetName() { return "WindowLevel16To8"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset)
+	{
+		PrepareSrc(inNum, inOffset);
+		mBottomValue = (unsigned short )Random();
+		mTopValue = (unsigned short )(mBottomValue + 1 + Random() % (65535 - mBottomValue));
+	}
+	void	Run(unsigned char *outDst)
+	{
+		ImageWindowKernel::WindowLevel16To8((const unsigned short *)GetSrc(0, 2), outDst, mNum,
+											mBottomValue, mTopValue);
+	}
+
+private:
+	unsigned short	mBottomValue, mTopValue;
+};
+
+class WindowLevel48To24Case : public KernelCase
+{
+public:
+	const char	*GetName() { return "WindowLevel48To24"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset)
+	{
+		PrepareSrc(inNum, inOffset);
+		for (int c = 0; c < 3; c++)
+		{
+			mBottomValues[c] = (unsigned short )(Random() & 0xFFF);
+			mTopValues[c] = (unsigned short )(mBottomValues[c] + 1 + Random() % (65535 - mBottomValues[c]));
+		}
+	}
+	void	Run(unsigned char *outDst)
+	{
+		ImageWindowKernel::WindowLevel48To24((const unsigned short *)GetSrc(0, 6), outDst, mNum,
+											mBottomValues, mTopValues);
+	}
+
+private:
+	unsigned short	mBottomValues[3], mTopValues[3];
+};
+
+class Downsample2xCase : public KernelCase
+{
+public:
+	Downsample2xCase(int inChannelNum) : mChannelNum(inChannelNum) {}
+	const char	*GetName() { return (mChannelNum == 1) ? "Downsample2x (mono)" : "Downsample2x (color)"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		ImageWindowKernel::Downsample2x((const unsigned char *)GetSrc(0, 1), (const unsigned char *)GetSrc(1, 1),
+										outDst, mNum, mChannelNum);
+	}
+
+private:
+	int	mChannelNum;
+};
+
+class UnpackMonoCase : public KernelCase
+{
+public:
+	typedef void	(*UnpackFunc)(const unsigned char *inSrc, unsigned int inStartPixel,
+								unsigned short *outDst, unsigned int inPixelNum);
+
+	UnpackMonoCase(const char *inName, UnpackFunc inFunc) : mName(inName), mFunc(inFunc) {}
+	const char	*GetName() { return mName; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		//	The offset is the start pixel here, that is not byte aligned
+		mFunc(mSrc, mOffset, (unsigned short *)outDst, mNum);
+	}
+
+private:
+	const char	*mName;
+	UnpackFunc	mFunc;
+};
+
+class DemosaicBilinear8Case : public KernelCase
+{
+public:
+	const char	*GetName() { return "DemosaicBilinear8"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		//	The offset also selects the Bayer phase and line color
+		ImageWindowKernel::DemosaicBilinear8((const unsigned char *)GetSrc(0, 1), (const unsigned char *)GetSrc(1, 1),
+										(const unsigned char *)GetSrc(2, 1), outDst, mNum, mOffset & 1, (mOffset & 2) != 0);
+	}
+};
+
+class DemosaicBilinear16Case : public KernelCase
+{
+public:
+	const char	*GetName() { return "DemosaicBilinear16"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		ImageWindowKernel::DemosaicBilinear16((const unsigned short *)GetSrc(0, 2), (const unsigned short *)GetSrc(1, 2),
+										(const unsigned short *)GetSrc(2, 2), (unsigned short *)outDst, mNum,
+										mOffset & 1, (mOffset & 2) != 0);
+	}
+};
+
+class YUVToBGR24Case : public KernelCase
+{
+public:
+	enum Format
+	{
+		FORMAT_YUYV	=	0,
+		FORMAT_NV12,
+		FORMAT_I420
+	};
+
+	YUVToBGR24Case(Format inFormat) : mFormat(inFormat) {}
+	const char	*GetName()
+	{
+		static const char	*sNames[] = {"YUYVToBGR24", "NV12ToBGR24", "I420ToBGR24"};
+		return sNames[mFormat];
+	}
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		static const short	sCoefs[2][4] = {
+			{129, 25, 52, 102},		// BT.601
+			{135, 14, 34, 115}};	// BT.709
+		const short	*coefs = sCoefs[mOffset & 1];
+
+		//	The first pixel has to be an even one, the offset moves whole pixel pairs
+		switch (mFormat)
+		{
+			case FORMAT_YUYV:
+				ImageWindowKernel::YUYVToBGR24((const unsigned char *)GetSrc(0, 4), outDst, mNum, coefs);
+				break;
+			case FORMAT_NV12:
+				ImageWindowKernel::NV12ToBGR24((const unsigned char *)GetSrc(0, 2), (const unsigned char *)GetSrc(1, 2),
+											outDst, mNum, coefs);
+				break;
+			case FORMAT_I420:
+				ImageWindowKernel::I420ToBGR24((const unsigned char *)GetSrc(0, 2), (const unsigned char *)GetSrc(1, 1),
+											(const unsigned char *)GetSrc(2, 1), outDst, mNum, coefs);
+				break;
+		}
+	}
+
+private:
+	Format	mFormat;
+};
+
+class CopyFloatMinMaxCase : public KernelCase
+{
+public:
+	const char	*GetName() { return "CopyFloatMinMax"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset)
+	{
+		PrepareSrc(inNum, inOffset);
+		FillFloat((float *)mSrc, TEST_BUF_SIZE / sizeof(float));
+	}
+	void	Run(unsigned char *outDst)
+	{
+		float	minMax[2] = {HUGE_VALF, -HUGE_VALF};
+
+		//	The min and max are written after the copied values
+		ImageWindowKernel::CopyFloatMinMax((const float *)GetSrc(0, 4), (float *)outDst, mNum,
+											&(minMax[0]), &(minMax[1]));
+		memcpy(&(outDst[mNum * sizeof(float)]), minMax, sizeof(minMax));
+	}
+
+	//	Mostly finite values with some NaN and +/-Inf
+	static void	FillFloat(float *outBuf, unsigned int inNum)
+	{
+		for (unsigned int i = 0; i < inNum; i++)
+		{
+			switch (Random() % 32)
+			{
+				case 0:
+					outBuf[i] = (float )sqrt(-1.0);
+					break;
+				case 1:
+					outBuf[i] = HUGE_VALF;
+					break;
+				case 2:
+					outBuf[i] = -HUGE_VALF;
+					break;
+				default:
+					outBuf[i] = ((float )Random() - 0x800000) / 1024.0f;
+					break;
+			}
+		}
+	}
+};
+
+class WindowLevelFloatTo8Case : public KernelCase
+{
+public:
+	const char	*GetName() { return "WindowLevelFloatTo8"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset)
+	{
+		PrepareSrc(inNum, inOffset);
+		CopyFloatMinMaxCase::FillFloat((float *)mSrc, TEST_BUF_SIZE / sizeof(float));
+		mBottomValue = ((float )Random() - 0x800000) / 1024.0f;
+		mScale = 255.0f / (1.0f + (float )(Random() % 0x10000));
+	}
+	void	Run(unsigned char *outDst)
+	{
+		ImageWindowKernel::WindowLevelFloatTo8((const float *)GetSrc(0, 4), outDst, mNum, mBottomValue, mScale);
+	}
+
+private:
+	float	mBottomValue, mScale;
+};
+
+class Lookup16To32Case : public KernelCase
+{
+public:
+	Lookup16To32Case() : mTable(65536)
+	{
+		FillRandom(&(mTable[0]), mTable.size() * sizeof(unsigned int));
+	}
+	const char	*GetName() { return "Lookup16To32"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		ImageWindowKernel::Lookup16To32((const unsigned short *)GetSrc(0, 2), (unsigned int *)outDst, mNum,
+										&(mTable[0]));
+	}
+
+private:
+	std::vector<unsigned int>	mTable;
+};
+
+class MinMax16Case : public KernelCase
+{
+public:
+	const char	*GetName() { return "MinMax16"; }
+	void	Prepare(unsigned int inNum, unsigned int inOffset) { PrepareSrc(inNum, inOffset); }
+	void	Run(unsigned char *outDst)
+	{
+		unsigned short	minMax[2] = {65535, 0};
+
+		ImageWindowKernel::MinMax16((const unsigned short *)GetSrc(0, 2), mNum, &(minMax[0]), &(minMax[1]));
+		memcpy(outDst, minMax, sizeof(minMax));
+	}
+};
+
+
+// -----------------------------------------------------------------------------
+// 	main
+// -----------------------------------------------------------------------------
+int	main()
+{
+	static const int	sTypes[] = {
+		ImageWindowKernel::SIMD_TYPE_SSE2,
+		ImageWindowKernel::SIMD_TYPE_AVX2,
+		ImageWindowKernel::SIMD_TYPE_NEON};
+	Shift16To8Case			shift16To8;
+	WindowLevel16To8Case	windowLevel16To8;
+	WindowLevel48To24Case	windowLevel48To24;
+	Downsample2xCase		downsample2xMono(1), downsample2xColor(3);
+	UnpackMonoCase			unpackMono10p("UnpackMono10p", ImageWindowKernel::UnpackMono10p);
+	UnpackMonoCase			unpackMono12p("UnpackMono12p", ImageWindowKernel::UnpackMono12p);
+	UnpackMonoCase			unpackMono12Packed("UnpackMono12Packed", ImageWindowKernel::UnpackMono12Packed);
+	DemosaicBilinear8Case	demosaicBilinear8;
+	DemosaicBilinear16Case	demosaicBilinear16;
+	YUVToBGR24Case			yuyvToBGR24(YUVToBGR24Case::FORMAT_YUYV);
+	YUVToBGR24Case			nv12ToBGR24(YUVToBGR24Case::FORMAT_NV12);
+	YUVToBGR24Case			i420ToBGR24(YUVToBGR24Case::FORMAT_I420);
+	CopyFloatMinMaxCase		copyFloatMinMax;
+	WindowLevelFloatTo8Case	windowLevelFloatTo8;
+	Lookup16To32Case		lookup16To32;
+	MinMax16Case			minMax16;
+	KernelCase	*cases[] = {
+		&shift16To8, &windowLevel16To8, &windowLevel48To24,
+		&downsample2xMono, &downsample2xColor,
+		&unpackMono10p, &unpackMono12p, &unpackMono12Packed,
+		&demosaicBilinear8, &demosaicBilinear16,
+		&yuyvToBGR24, &nv12ToBGR24, &i420ToBGR24,
+		&copyFloatMinMax, &windowLevelFloatTo8, &lookup16To32, &minMax16};
+	int	testedTypeNum = 0;
+
+	for (size_t t = 0; t < sizeof(sTypes) / sizeof(sTypes[0]); t++)
+	{
+		//	SetSIMDType() falls back to the detected type if the CPU does not have it
+		ImageWindowKernel::SetSIMDType(sTypes[t]);
+		if (ImageWindowKernel::GetSIMDType() != sTypes[t])
+			continue;
+
+		printf("Testing %s kernels\n", GetSIMDTypeName(sTypes[t]));
+		for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+			cases[i]->Test(sTypes[t]);
+		testedTypeNum++;
+	}
+
+	if (testedTypeNum == 0)
+		printf("No SIMD kernels on this CPU\n");
+	if (sErrorNum != 0)
+	{
+		printf("%d errors\n", sErrorNum);
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,140 @@
+// =============================================================================
+//	MapTableTest.cpp
+//
+//	Checks that the 64K-entry map table of ImageWindow::SetMapMode() gives
+//	bit-identical output to the per-pixel mapping of the earlier versions,
+//	for every 16-bit input value in every map mode.
+// =============================================================================
+#include <stdio.h>
+#include <vector>
+#include "ImageWindowKernel.hpp"
+
+// -----------------------------------------------------------------------------
+// 	static variables
+// -----------------------------------------------------------------------------
+static int	sErrorNum = 0;
+
+
+// -----------------------------------------------------------------------------
+// 	static functions
+// -----------------------------------------------------------------------------
+//	The per-pixel loop of ImageWindow::Convert16BitsImage() before the table
+static void	Convert16BitsImage(const unsigned short *inSrcImage, unsigned char *outDstImage, int inPixelNum,
+								bool inIsMapModeEnabled, unsigned short inMapBottomValue, unsigned short inMapTopValue,
+								bool inIsMapReverse, unsigned short inMapDirectMapLimit)
+{
+	const unsigned short	*srcImagePtr = inSrcImage;
+	unsigned char	*dstImagePtr = outDstImage;
+	double	mapK = 255.0 / (double )(inMapTopValue - inMapBottomValue);
+
+	if (inIsMapModeEnabled == false)
+	{
+		for (int i = 0; i < inPixelNum; i++)
+		{
+			unsigned short	value = (*srcImagePtr) >> 8;
+			*dstImagePtr = (unsigned char)value;
+			dstImagePtr++;
+			srcImagePtr++;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < inPixelNum; i++)
+		{
+			unsigned short	value;
+
+			if (*srcImagePtr <= inMapDirectMapLimit)
+				value = *srcImagePtr;
+			else
+			{
+				double	d;
+				if (inIsMapReverse == false)
+					d = mapK * (double )(*srcImagePtr - inMapBottomValue);
+				else
+					d = 255.0 - (mapK * (double )(*srcImagePtr - inMapBottomValue));
+
+				if (d > 255)
+					d = 255;
+				if (d <= inMapDirectMapLimit)
+					d = inMapDirectMapLimit + 1;
+				value = (unsigned short)d;
+			}
+
+			*dstImagePtr = (unsigned char)value;
+			dstImagePtr++;
+			srcImagePtr++;
+		}
+	}
+}
+
+static void	Compare(const std::vector<unsigned char> &inRef, const std::vector<unsigned char> &inDst,
+					const char *inModeName, unsigned short inBottomValue, unsigned short inTopValue,
+					bool inIsReverse, unsigned short inDirectMapLimit)
+{
+	for (size_t i = 0; i < inRef.size(); i++)
+	{
+		if (inRef[i] == inDst[i])
+			continue;
+		if (sErrorNum < 20)
+			printf("Error: %s (%u, %u, %s, %u) maps %u to %u instead of %u\n",
+					inModeName, inBottomValue, inTopValue, inIsReverse ? "reverse" : "normal",
+					inDirectMapLimit, (unsigned int )i, inDst[i], inRef[i]);
+		sErrorNum++;
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// 	main
+// -----------------------------------------------------------------------------
+int	main()
+{
+	//	inBottomValue == inTopValue is not in the list, the old mapping
+	//	converted NaN to an integer for it
+	static const unsigned short	sRanges[][2] = {
+		{0, 65535}, {0, 255}, {0, 1023}, {0, 4095}, {1000, 5000}, {5000, 1000},
+		{65534, 65535}, {1, 0}, {32768, 32769}, {100, 60000}, {65535, 0}};
+	static const unsigned short	sDirectMapLimits[] = {0, 1, 16, 200, 254, 255, 256, 1000, 65534, 65535};
+	std::vector<unsigned short>	src(65536);
+	std::vector<unsigned char>	ref(65536), dst(65536), table(65536);
+	int	modeNum = 0;
+
+	for (int i = 0; i < 65536; i++)
+		src[i] = (unsigned short )i;
+
+	//	Map mode off
+	Convert16BitsImage(&(src[0]), &(ref[0]), 65536, false, 0, 65535, false, 0);
+	ImageWindowKernel::Shift16To8(&(src[0]), &(dst[0]), 65536);
+	Compare(ref, dst, "Shift16To8", 0, 0, false, 0);
+	modeNum++;
+
+	//	SetMapMode()
+	for (size_t r = 0; r < sizeof(sRanges) / sizeof(sRanges[0]); r++)
+	{
+		for (size_t l = 0; l < sizeof(sDirectMapLimits) / sizeof(sDirectMapLimits[0]); l++)
+		{
+			for (int reverse = 0; reverse < 2; reverse++)
+			{
+				unsigned short	bottomValue = sRanges[r][0];
+				unsigned short	topValue = sRanges[r][1];
+				unsigned short	directMapLimit = sDirectMapLimits[l];
+				bool			isReverse = (reverse != 0);
+
+				Convert16BitsImage(&(src[0]), &(ref[0]), 65536, true,
+									bottomValue, topValue, isReverse, directMapLimit);
+				ImageWindowKernel::MakeMapTable(&(table[0]), bottomValue, topValue, isReverse, directMapLimit);
+				ImageWindowKernel::Lookup16To8(&(src[0]), &(dst[0]), 65536, &(table[0]));
+				Compare(ref, dst, "MakeMapTable", bottomValue, topValue, isReverse, directMapLimit);
+				modeNum++;
+			}
+		}
+	}
+
+	if (sErrorNum != 0)
+	{
+		printf("%d errors\n", sErrorNum);
+		return 1;
+	}
+	printf("OK (%d map modes x 65536 values)\n", modeNum);
+	return 0;
+}
@@ -0,0 +1,350 @@
+// =============================================================================
+//	RenderTest.cpp
+//
+//	Checks ImageWindowKernel::RenderLines(), the software renderer of
+//	ImageWindow, against the result StretchDIBits() with COLORONCOLOR gives
+//	for the same view: a hand-checked 2x2 image and a reference
+//	implementation of the GDI nearest neighbor mapping over 8, 24 and 32-bit,
+//	top-down and bottom-up images, scales, offsets, partial buffers, line
+//	bands and the waterfall ring, and the waterfall copied in display order.
+// =============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "ImageWindowKernel.hpp"
+
+// -----------------------------------------------------------------------------
+// 	macros
+// -----------------------------------------------------------------------------
+#define	TEST_IMAGE_WIDTH	16
+#define	TEST_IMAGE_HEIGHT	8
+#define	TEST_VIEW_WIDTH		41
+#define	TEST_VIEW_HEIGHT	29
+
+
+// -----------------------------------------------------------------------------
+// 	typedefs
+// -----------------------------------------------------------------------------
+//	A DIB as ImageWindow keeps it
+typedef struct
+{
+	std::vector<unsigned char>	Bits;
+	unsigned int	LineSize;
+	int				Width;
+	int				Height;
+	int				BitCount;
+	int				RedIndex;
+	bool			IsBottomUp;
+	unsigned char	Palette[256][3];	// BGR
+} TestImage;
+
+
+// -----------------------------------------------------------------------------
+// 	static variables
+// -----------------------------------------------------------------------------
+static unsigned int	sRandomSeed = 12345;
+static int			sErrorNum = 0;
+static const unsigned char	sBkColor[3] = {0x11, 0x22, 0x33};
+
+
+// -----------------------------------------------------------------------------
+// 	static functions
+// -----------------------------------------------------------------------------
+static unsigned int	Random()
+{
+	sRandomSeed = sRandomSeed * 1103515245 + 12345;
+	return (sRandomSeed >> 8) & 0xFFFFFF;
+}
+
+static void	Check(bool inIsOK, const char *inMessage)
+{
+	if (inIsOK)
+		return;
+	if (sErrorNum < 20)
+		printf("Error: %s\n", inMessage);
+	sErrorNum++;
+}
+
+static void	MakeImage(TestImage *outImage, int inWidth, int inHeight, int inBitCount, int inRedIndex, bool inIsBottomUp)
+{
+	outImage->Width = inWidth;
+	outImage->Height = inHeight;
+	outImage->BitCount = inBitCount;
+	outImage->RedIndex = inRedIndex;
+	outImage->IsBottomUp = inIsBottomUp;
+	outImage->LineSize = ((inWidth * inBitCount / 8) + 3) & ~3;		// DWORD aligned
+	outImage->Bits.resize(outImage->LineSize * inHeight);
+	for (size_t i = 0; i < outImage->Bits.size(); i++)
+		outImage->Bits[i] = (unsigned char )Random();
+	for (int i = 0; i < 256; i++)
+		for (int c = 0; c < 3; c++)
+			outImage->Palette[i][c] = (unsigned char )Random();
+}
+
+//	BGR of image pixel (inX, inY), inY counted from the top
+static const unsigned char	*GetPixel(const TestImage *inImage, int inX, int inY, unsigned char outColor[3])
+{
+	int	line = inImage->IsBottomUp ? inImage->Height - inY - 1 : inY;
+	const unsigned char	*src = &(inImage->Bits[inImage->LineSize * line + inX * inImage->BitCount / 8]);
+
+	if (inImage->BitCount == 8)
+		return inImage->Palette[*src];
+
+	outColor[0] = src[2 - inImage->RedIndex];
+	outColor[1] = src[1];
+	outColor[2] = src[inImage->RedIndex];
+	return outColor;
+}
+
+//	What DrawImage() shows with StretchDIBits(): the image from
+//	(inOffsetX, inOffsetY) on is stretched to the scale inScaleNum / inScaleDen,
+//	GDI maps the destination pixel x to the source column
+//	inOffsetX + x * Width / destination width. The rest of the view is the
+//	background.
+static void	StretchDIBitsReference(const TestImage *inImage, int inOffsetX, int inOffsetY,
+									int inScaleNum, int inScaleDen, std::vector<unsigned char> &outView)
+{
+	int	dstWidth = inImage->Width * inScaleNum / inScaleDen;
+	int	dstHeight = inImage->Height * inScaleNum / inScaleDen;
+
+	outView.resize(TEST_VIEW_WIDTH * TEST_VIEW_HEIGHT * 3);
+	for (int y = 0; y < TEST_VIEW_HEIGHT; y++)
+	{
+		for (int x = 0; x < TEST_VIEW_WIDTH; x++)
+		{
+			unsigned char	*dst = &(outView[(TEST_VIEW_WIDTH * y + x) * 3]);
+			const unsigned char	*color = sBkColor;
+			unsigned char	buf[3];
+
+			if (x < dstWidth && y < dstHeight)
+			{
+				int	srcX = inOffsetX + x * inImage->Width / dstWidth;
+				int	srcY = inOffsetY + y * inImage->Height / dstHeight;
+
+				if (srcX < inImage->Width && srcY < inImage->Height)
+					color = GetPixel(inImage, srcX, srcY, buf);
+			}
+			memcpy(dst, color, 3);
+		}
+	}
+}
+
+static void	SetRenderParam(const TestImage *inImage, int inOffsetX, int inOffsetY, double inScale,
+							int inOriginX, int inOriginY, int inWidth, unsigned char *outBuffer,
+							unsigned int inLineSize, int *outXTable, ImageRenderParam *outParam)
+{
+	outParam->Bits				= &(inImage->Bits[0]);
+	outParam->LineSize			= inImage->LineSize;
+	outParam->Width				= inImage->Width;
+	outParam->Height			= inImage->Height;
+	outParam->IsBottomUp		= inImage->IsBottomUp;
+	outParam->BitCount			= inImage->BitCount;
+	outParam->RedIndex			= inImage->RedIndex;
+	memcpy(outParam->Palette, inImage->Palette, sizeof(outParam->Palette));
+	outParam->OffsetX			= inOffsetX;
+	outParam->OffsetY			= inOffsetY;
+	outParam->Scale				= inScale;
+	outParam->OriginX			= inOriginX;
+	outParam->OriginY			= inOriginY;
+	outParam->TopLine			= 0;
+	outParam->XTable			= outXTable;
+	outParam->Buffer			= outBuffer;
+	outParam->BufferWidth		= inWidth;
+	outParam->BufferLineSize	= inLineSize;
+	memcpy(outParam->BkColor, sBkColor, 3);
+
+	ImageWindowKernel::MakeRenderXTable(outParam, outXTable);
+}
+
+//	Renders the rect (inOriginX, inOriginY, inWidth, inHeight) of the view
+//	in inBandNum line bands and returns it packed (no line padding)
+static void	Render(const TestImage *inImage, int inOffsetX, int inOffsetY, double inScale, int inTopLine,
+					int inOriginX, int inOriginY, int inWidth, int inHeight, int inBandNum,
+					std::vector<unsigned char> &outView)
+{
+	unsigned int	lineSize = ((inWidth * 3) + 3) & ~3;
+	std::vector<unsigned char>	buffer(lineSize * inHeight + 1);
+	std::vector<int>			xTable(inWidth + 1);
+	ImageRenderParam	param;
+
+	SetRenderParam(inImage, inOffsetX, inOffsetY, inScale, inOriginX, inOriginY, inWidth,
+					&(buffer[0]), lineSize, &(xTable[0]), &param);
+	param.TopLine = inTopLine;
+
+	for (int i = 0; i < inBandNum; i++)
+		ImageWindowKernel::RenderLines(&param, inHeight * i / inBandNum, inHeight * (i + 1) / inBandNum);
+
+	outView.resize(inWidth * inHeight * 3);
+	for (int y = 0; y < inHeight; y++)
+		if (inWidth > 0)
+			memcpy(&(outView[inWidth * 3 * y]), &(buffer[lineSize * y]), inWidth * 3);
+}
+
+//	A 2x2 8-bit image at 200% is four 2x2 blocks, then the background
+static void	TestKnownResult()
+{
+	TestImage	image;
+	std::vector<unsigned char>	view;
+	static const int	sExpected[4][5] = {
+		{0, 0, 1, 1, -1},
+		{0, 0, 1, 1, -1},
+		{2, 2, 3, 3, -1},
+		{2, 2, 3, 3, -1}};
+
+	MakeImage(&image, 2, 2, 8, 2, false);
+	image.Bits[0] = 0;
+	image.Bits[1] = 1;
+	image.Bits[image.LineSize] = 2;
+	image.Bits[image.LineSize + 1] = 3;
+
+	Render(&image, 0, 0, 2.0, 0, 0, 0, 5, 4, 1, view);
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 5; x++)
+		{
+			int	index = sExpected[y][x];
+			const unsigned char	*expected = (index < 0) ? sBkColor : image.Palette[index];
+			Check(memcmp(&(view[(5 * y + x) * 3]), expected, 3) == 0, "2x2 image at 200%");
+		}
+	}
+}
+
+static void	TestStretchDIBits(const TestImage *inImage, const char *inName)
+{
+	//	Image sizes are multiples of 8, GDI leaves out the last partly
+	//	covered column below 100% and RenderLines() draws it
+	static const int	sScales[][2] = {{1, 8}, {1, 4}, {1, 2}, {1, 1}, {2, 1}, {3, 1}, {4, 1}, {8, 1}};
+	static const int	sOffsets[][2] = {{0, 0}, {1, 0}, {0, 3}, {5, 2}, {15, 7}, {16, 8}};
+	char	message[256];
+
+	for (size_t s = 0; s < sizeof(sScales) / sizeof(sScales[0]); s++)
+	{
+		double	scale = (double )sScales[s][0] / sScales[s][1];
+		int		scalePercent = 100 * sScales[s][0] / sScales[s][1];
+
+		for (size_t o = 0; o < sizeof(sOffsets) / sizeof(sOffsets[0]); o++)
+		{
+			int	offsetX = sOffsets[o][0];
+			int	offsetY = sOffsets[o][1];
+			std::vector<unsigned char>	ref, view, part;
+
+			StretchDIBitsReference(inImage, offsetX, offsetY, sScales[s][0], sScales[s][1], ref);
+			Render(inImage, offsetX, offsetY, scale, 0, 0, 0, TEST_VIEW_WIDTH, TEST_VIEW_HEIGHT, 1, view);
+			sprintf(message, "%s at %d%%, offset (%d, %d) differs from StretchDIBits()",
+					inName, scalePercent, offsetX, offsetY);
+			Check(view == ref, message);
+
+			//	Line bands give the same result
+			Render(inImage, offsetX, offsetY, scale, 0, 0, 0, TEST_VIEW_WIDTH, TEST_VIEW_HEIGHT, 5, part);
+			sprintf(message, "%s at %d%%, offset (%d, %d) in line bands", inName, scalePercent, offsetX, offsetY);
+			Check(part == ref, message);
+
+			//	A part of the view (the exposed strip after a pan)
+			int	originX = 7, originY = 3, width = 19, height = 11;
+			Render(inImage, offsetX, offsetY, scale, 0, originX, originY, width, height, 1, part);
+			bool	isOK = true;
+			for (int y = 0; y < height; y++)
+				if (memcmp(&(part[width * 3 * y]), &(ref[(TEST_VIEW_WIDTH * (y + originY) + originX) * 3]), width * 3) != 0)
+					isOK = false;
+			sprintf(message, "%s at %d%%, offset (%d, %d) in a partial buffer", inName, scalePercent, offsetX, offsetY);
+			Check(isOK, message);
+		}
+	}
+}
+
+//	TopLine shows the ring of lines from TopLine on, like the lines rotated
+static void	TestWaterfall(const TestImage *inImage, const char *inName)
+{
+	char	message[256];
+
+	for (int topLine = 1; topLine < inImage->Height; topLine++)
+	{
+		TestImage	rotated = *inImage;
+		std::vector<unsigned char>	ref, view;
+
+		for (int y = 0; y < inImage->Height; y++)
+		{
+			int	srcY = (y + topLine) % inImage->Height;
+			int	srcLine = inImage->IsBottomUp ? inImage->Height - srcY - 1 : srcY;
+			int	dstLine = inImage->IsBottomUp ? inImage->Height - y - 1 : y;
+			memcpy(&(rotated.Bits[rotated.LineSize * dstLine]), &(inImage->Bits[inImage->LineSize * srcLine]),
+					inImage->LineSize);
+		}
+
+		Render(&rotated, 0, 0, 2.0, 0, 0, 0, TEST_VIEW_WIDTH, TEST_VIEW_HEIGHT, 1, ref);
+		Render(inImage, 0, 0, 2.0, topLine, 0, 0, TEST_VIEW_WIDTH, TEST_VIEW_HEIGHT, 3, view);
+		sprintf(message, "%s waterfall with top line %d", inName, topLine);
+		Check(view == ref, message);
+	}
+}
+
+//	The waterfall saved or copied with CopyRingLines() shows as it is drawn,
+//	in either line order
+static void	TestWaterfallCopy(const TestImage *inImage, const char *inName)
+{
+	char	message[256];
+
+	for (int topLine = 0; topLine < inImage->Height; topLine++)
+	{
+		for (int bottomUp = 0; bottomUp < 2; bottomUp++)
+		{
+			TestImage	copied = *inImage;
+			std::vector<unsigned char>	ref, view;
+
+			copied.IsBottomUp = (bottomUp != 0);
+			ImageWindowKernel::CopyRingLines(&(inImage->Bits[0]), inImage->IsBottomUp,
+											&(copied.Bits[0]), copied.IsBottomUp,
+											inImage->LineSize, inImage->Height, topLine);
+
+			Render(inImage, 0, 0, 2.0, topLine, 0, 0, TEST_VIEW_WIDTH, TEST_VIEW_HEIGHT, 1, ref);
+			Render(&copied, 0, 0, 2.0, 0, 0, 0, TEST_VIEW_WIDTH, TEST_VIEW_HEIGHT, 1, view);
+			sprintf(message, "%s waterfall with top line %d copied %s", inName, topLine,
+					copied.IsBottomUp ? "bottom-up" : "top-down");
+			Check(view == ref, message);
+		}
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// 	main
+// -----------------------------------------------------------------------------
+int	main()
+{
+	static const struct
+	{
+		const char	*Name;
+		int			BitCount;
+		int			RedIndex;
+		bool		IsBottomUp;
+	} sFormats[] = {
+		{"8-bit top-down", 8, 2, false},
+		{"8-bit bottom-up", 8, 2, true},
+		{"24-bit BGR top-down", 24, 2, false},
+		{"24-bit BGR bottom-up", 24, 2, true},
+		{"24-bit RGB top-down", 24, 0, false},
+		{"32-bit BGRA bottom-up", 32, 2, true},
+		{"32-bit RGBA top-down", 32, 0, false}};
+
+	TestKnownResult();
+
+	for (size_t i = 0; i < sizeof(sFormats) / sizeof(sFormats[0]); i++)
+	{
+		TestImage	image;
+
+		MakeImage(&image, TEST_IMAGE_WIDTH, TEST_IMAGE_HEIGHT,
+					sFormats[i].BitCount, sFormats[i].RedIndex, sFormats[i].IsBottomUp);
+		TestStretchDIBits(&image, sFormats[i].Name);
+		TestWaterfall(&image, sFormats[i].Name);
+		TestWaterfallCopy(&image, sFormats[i].Name);
+	}
+
+	if (sErrorNum != 0)
+	{
+		printf("%d errors\n", sErrorNum);
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}